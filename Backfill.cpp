@@ -0,0 +1,131 @@
+// Backfill.cpp - Request pacing and checkpoint format of the All Symbols backfill
+#include "Backfill.h"
+
+#include <stddef.h>
+#include <string.h>
+
+void InitTokenBucket(TokenBucket* pBucket, double fRate, DWORD dwNow)
+{
+	InitializeCriticalSection(&pBucket->lock);
+	pBucket->fTokens = 1.0;
+	pBucket->fRate = fRate;
+	pBucket->dwLast = dwNow;
+}
+
+void DeleteTokenBucket(TokenBucket* pBucket)
+{
+	DeleteCriticalSection(&pBucket->lock);
+}
+
+void ResetTokenBucket(TokenBucket* pBucket, double fRate, DWORD dwNow)
+{
+	EnterCriticalSection(&pBucket->lock);
+	pBucket->fTokens = 1.0;
+	pBucket->fRate = fRate;
+	pBucket->dwLast = dwNow;
+	LeaveCriticalSection(&pBucket->lock);
+}
+
+DWORD TakeToken(TokenBucket* pBucket, DWORD dwNow)
+{
+	DWORD dwWait = 0;
+
+	EnterCriticalSection(&pBucket->lock);
+
+	// Unsigned difference: correct across the 49.7-day wrap of the tick count
+	pBucket->fTokens = min(pBucket->fRate, pBucket->fTokens + (DWORD)(dwNow - pBucket->dwLast) * pBucket->fRate / 1000.0);
+	pBucket->dwLast = dwNow;
+
+	if (pBucket->fTokens >= 1.0)
+		pBucket->fTokens -= 1.0;
+	else
+		dwWait = (DWORD)((1.0 - pBucket->fTokens) * 1000.0 / pBucket->fRate) + 1;
+
+	LeaveCriticalSection(&pBucket->lock);
+
+	return dwWait;
+}
+
+void InitBackfillCheckpointHeader(BackfillCheckpointHeader* pHeader, int nPeriodicity, int nDays, UINT32 nSymbols)
+{
+	memset(pHeader, 0, sizeof(BackfillCheckpointHeader));
+	pHeader->nMagic = BACKFILL_CHECKPOINT_MAGIC;
+	pHeader->nVersion = BACKFILL_CHECKPOINT_VERSION;
+	pHeader->nPeriodicity = nPeriodicity;
+	pHeader->nDays = nDays;
+	pHeader->nSymbols = nSymbols;
+}
+
+BOOL FillBackfillCheckpointRecord(BackfillCheckpointRecord* pRecord, LPCTSTR pszTicker)
+{
+	int nTickerLength = (int)_tcslen(pszTicker);
+	if (nTickerLength == 0 || nTickerLength >= BACKFILL_TICKER_SIZE)
+		return FALSE;
+
+	memset(pRecord, 0, sizeof(BackfillCheckpointRecord));
+	for (int c = 0; c < nTickerLength; c++)
+		pRecord->szTicker[c] = (char)pszTicker[c];
+	pRecord->nState = BACKFILL_PENDING;
+	return TRUE;
+}
+
+INT64 BackfillStateOffset(int nIndex)
+{
+	return sizeof(BackfillCheckpointHeader) + (INT64)nIndex * sizeof(BackfillCheckpointRecord) +
+		offsetof(BackfillCheckpointRecord, nState);
+}
+
+// Read exactly dwBytes, in as many pieces as the reader returns
+static BOOL ReadBackfillBytes(BackfillReadProc pfnRead, void* pReader, void* pBuffer, DWORD dwBytes)
+{
+	BYTE* pBytes = (BYTE*)pBuffer;
+	while (dwBytes > 0)
+	{
+		DWORD dwRead = 0;
+		if (!pfnRead(pReader, pBytes, dwBytes, &dwRead) || dwRead == 0)
+			return FALSE;
+		pBytes += dwRead;
+		dwBytes -= dwRead;
+	}
+	return TRUE;
+}
+
+BackfillCheckpointRecord* ReadBackfillCheckpoint(BackfillReadProc pfnRead, void* pReader, UINT64 nFileSize,
+	BackfillCheckpointHeader* pHeader, int* pnDone)
+{
+	*pnDone = 0;
+
+	if (!ReadBackfillBytes(pfnRead, pReader, pHeader, sizeof(BackfillCheckpointHeader)))
+		return NULL;
+
+	if (pHeader->nMagic != BACKFILL_CHECKPOINT_MAGIC ||
+		pHeader->nVersion != BACKFILL_CHECKPOINT_VERSION ||
+		(pHeader->nPeriodicity != 60 && pHeader->nPeriodicity != 86400) ||
+		pHeader->nDays <= 0 || pHeader->nSymbols == 0 ||
+		nFileSize != sizeof(BackfillCheckpointHeader) + (UINT64)pHeader->nSymbols * sizeof(BackfillCheckpointRecord))
+		return NULL;
+
+	BackfillCheckpointRecord* pSymbols = new BackfillCheckpointRecord[pHeader->nSymbols];
+	BOOL bValid = ReadBackfillBytes(pfnRead, pReader, pSymbols, pHeader->nSymbols * sizeof(BackfillCheckpointRecord));
+
+	int nDone = 0;
+	for (UINT32 i = 0; bValid && i < pHeader->nSymbols; i++)
+	{
+		BackfillCheckpointRecord& record = pSymbols[i];
+		if (record.szTicker[0] == '\0' || record.szTicker[BACKFILL_TICKER_SIZE - 1] != '\0' || record.nState > BACKFILL_FAILED)
+			bValid = FALSE;
+		else if (record.nState == BACKFILL_DONE)
+			nDone++;
+		else
+			record.nState = BACKFILL_PENDING; // Failed last time - try again
+	}
+
+	if (!bValid)
+	{
+		delete[] pSymbols;
+		return NULL;
+	}
+
+	*pnDone = nDone;
+	return pSymbols;
+}
@@ -0,0 +1,77 @@
+// Backfill.h - Request pacing and checkpoint format of the All Symbols backfill
+//
+// No MFC: Plugin.cpp runs the job's threads, writes the checkpoint file and
+// downloads each symbol (see "Backfill Scheduler"); the token bucket that paces
+// the history requests and the checkpoint layout and checks live here, so the
+// Linux test build (tests/) can run the bucket on a simulated clock and feed the
+// loader damaged and truncated checkpoints.
+#ifndef BACKFILL_H
+#define BACKFILL_H
+
+#include "OpenAlgoPortable.h"
+
+// Progress is checkpointed to <database>\OpenAlgoCache\Backfill.chk
+//   BackfillCheckpointHeader                 64 bytes
+//   BackfillCheckpointRecord[nSymbols]       48 bytes each, nState updated in place
+#define BACKFILL_CHECKPOINT_MAGIC        0x4642414F  // "OABF"
+#define BACKFILL_CHECKPOINT_VERSION      1
+#define BACKFILL_TICKER_SIZE             47      // Incl. NUL; longer tickers are skipped
+
+// BackfillCheckpointRecord::nState
+#define BACKFILL_PENDING  0
+#define BACKFILL_DONE     1
+#define BACKFILL_FAILED   2       // Retried when the job resumes
+
+struct BackfillCheckpointHeader {
+	UINT32 nMagic;
+	UINT32 nVersion;
+	INT32 nPeriodicity;
+	INT32 nDays;
+	UINT32 nSymbols;
+	UINT32 aReserved[11];
+};
+
+struct BackfillCheckpointRecord {
+	char szTicker[BACKFILL_TICKER_SIZE];     // NUL-padded
+	BYTE nState;
+};
+
+// Token bucket: fRate requests per second on average, bursts of up to fRate.
+// Time is passed in (GetTickCount() in the plugin), so tests can run it on a
+// simulated clock.
+struct TokenBucket {
+	CRITICAL_SECTION lock;   // Shared by every thread of a job
+	double fTokens;
+	double fRate;
+	DWORD dwLast;            // Time of the last refill (ms)
+};
+
+void InitTokenBucket(TokenBucket* pBucket, double fRate, DWORD dwNow);
+void DeleteTokenBucket(TokenBucket* pBucket);
+
+// Set a new rate and start with one token, so the first request goes out at once
+void ResetTokenBucket(TokenBucket* pBucket, double fRate, DWORD dwNow);
+
+// Take one request token. Returns 0, or how many ms until the next token.
+DWORD TakeToken(TokenBucket* pBucket, DWORD dwNow);
+
+void InitBackfillCheckpointHeader(BackfillCheckpointHeader* pHeader, int nPeriodicity, int nDays, UINT32 nSymbols);
+
+// Fill a PENDING record; FALSE if the ticker is empty or does not fit
+BOOL FillBackfillCheckpointRecord(BackfillCheckpointRecord* pRecord, LPCTSTR pszTicker);
+
+// File offset of a record's nState byte, rewritten as the symbol finishes
+INT64 BackfillStateOffset(int nIndex);
+
+// Reads up to dwBytes at the current position (the start of the file);
+// FALSE or a short read means the file ended
+typedef BOOL (*BackfillReadProc)(void* pReader, void* pBuffer, DWORD dwBytes, DWORD* pdwRead);
+
+// Read and check a checkpoint of nFileSize bytes. Symbols that failed last time
+// are set back to PENDING; *pnDone = symbols already DONE. Returns the records
+// (delete[] them), or NULL if the file is damaged: wrong magic, version,
+// periodicity or size, a short read, an unterminated ticker or an unknown state.
+BackfillCheckpointRecord* ReadBackfillCheckpoint(BackfillReadProc pfnRead, void* pReader, UINT64 nFileSize,
+	BackfillCheckpointHeader* pHeader, int* pnDone);
+
+#endif // BACKFILL_H
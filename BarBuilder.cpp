@@ -0,0 +1,84 @@
+// BarBuilder.cpp - Tick-to-bar aggregation for one symbol
+#include "BarBuilder.h"
+#include "Calendar.h"
+#include "Seqlock.h"
+
+void PublishBarSnapshot(BarBuilder* pBuilder)
+{
+	BarSnapshot snapshot;
+	snapshot.currentBar = pBuilder->currentBar;
+	snapshot.bBarStarted = pBuilder->bBarStarted;
+	snapshot.tickCount = pBuilder->tickCount;
+	snapshot.nBars = pBuilder->bars.GetCount();
+
+	LONG nSeq = SeqlockBeginWrite(&pBuilder->nSnapshotSeq);  // Never waits: the lock holder is the only writer
+	SeqlockStore(&pBuilder->snapshot, &snapshot, sizeof(BarSnapshot));
+	SeqlockEndWrite(&pBuilder->nSnapshotSeq, nSeq);
+}
+
+void ReadBarSnapshot(BarBuilder* pBuilder, BarSnapshot* pSnapshot)
+{
+	for (;;)
+	{
+		LONG nSeq = SeqlockBeginRead(&pBuilder->nSnapshotSeq);
+		SeqlockLoad(pSnapshot, &pBuilder->snapshot, sizeof(BarSnapshot));
+		if (SeqlockEndRead(&pBuilder->nSnapshotSeq, nSeq))
+			return;
+	}
+}
+
+BOOL AddTickToBarBuilder(BarBuilder* pBuilder, float ltp, float lastTradeQty, time_t timestamp)
+{
+	BOOL bBarClosed = FALSE;
+
+	// Determine bar boundary (1-minute intervals)
+	time_t barPeriodStart = (timestamp / 60) * 60;  // Floor to minute boundary
+
+	// Check if we need a new bar
+	if (pBuilder->barStartTime != barPeriodStart)
+	{
+		// Finalize current bar if it exists
+		if (pBuilder->bBarStarted && pBuilder->barStartTime > 0)
+		{
+			// Add current bar to history (the ring drops its oldest bar when full)
+			pBuilder->bars.Add(pBuilder->currentBar);
+			bBarClosed = TRUE;
+		}
+
+		// Start new bar
+		memset(&pBuilder->currentBar, 0, sizeof(struct Quotation));
+		pBuilder->currentBar.Open = ltp;
+		pBuilder->currentBar.High = ltp;
+		pBuilder->currentBar.Low = ltp;
+		pBuilder->currentBar.Price = ltp;  // Price is the Close value in Quotation struct
+		pBuilder->currentBar.Volume = 0;
+		pBuilder->currentBar.OpenInterest = 0;
+
+		// Set normalized timestamp (critical for AmiBroker)
+		ConvertUnixToPackedDate(barPeriodStart, GetExchangeUtcOffsetSeconds(pBuilder->exchange), &pBuilder->currentBar.DateTime);
+		pBuilder->currentBar.DateTime.PackDate.Second = 0;
+		pBuilder->currentBar.DateTime.PackDate.MilliSec = 0;
+		pBuilder->currentBar.DateTime.PackDate.MicroSec = 0;
+
+		pBuilder->barStartTime = barPeriodStart;
+		pBuilder->bBarStarted = TRUE;
+		pBuilder->volumeAccumulator = 0.0f;
+		pBuilder->bFirstTickReceived = TRUE;
+		pBuilder->tickCount = 0;  // Reset tick counter for new bar
+	}
+
+	// Update current bar OHLC
+	if (ltp > pBuilder->currentBar.High)
+		pBuilder->currentBar.High = ltp;
+	if (ltp < pBuilder->currentBar.Low || pBuilder->currentBar.Low == 0.0f)
+		pBuilder->currentBar.Low = ltp;
+	pBuilder->currentBar.Price = ltp;  // Price is the Close value in Quotation struct
+
+	// Accumulate volume
+	pBuilder->volumeAccumulator += lastTradeQty;
+	pBuilder->currentBar.Volume = pBuilder->volumeAccumulator;
+	pBuilder->tickCount++;
+
+	PublishBarSnapshot(pBuilder);
+	return bBarClosed;
+}
@@ -0,0 +1,181 @@
+// BarBuilder.h - Tick-to-bar aggregation for one symbol
+//
+// No MFC: Plugin.cpp keeps one BarBuilder per symbol ID (SymbolState::pBarBuilder),
+// feeds it WebSocket and journaled ticks and reads it from GetQuotesEx(); the
+// builder itself lives here so the Linux test build (tests/) can hammer the
+// per-builder lock and the snapshot seqlock from several threads.
+#ifndef BAR_BUILDER_H
+#define BAR_BUILDER_H
+
+#include <string.h>
+#include <time.h>
+#include "OpenAlgoPortable.h"
+#include "Plugin.h"
+
+// Completed tick-built bars kept per symbol; the oldest bar is dropped at capacity
+#define BAR_BUILDER_MAX_BARS       10000
+#define BAR_BUILDER_EXCHANGE_SIZE  16
+
+// BarRing: fixed-capacity ring of completed bars, oldest first.
+// Storage is allocated once by the constructor. Add() overwrites the oldest bar
+// when the ring is full, so neither append nor eviction moves or allocates
+// anything (the tick path runs under BarBuilder::lock).
+struct BarRing {
+	struct Quotation* pBars;
+	int nCapacity;
+	int nStart;   // Slot of the oldest bar
+	int nCount;
+
+	BarRing(int capacity) : pBars(new struct Quotation[capacity]), nCapacity(capacity), nStart(0), nCount(0) {
+	}
+
+	~BarRing() {
+		delete[] pBars;
+	}
+
+	int GetCount() const {
+		return nCount;
+	}
+
+	void Add(const struct Quotation& bar) {
+		if (nCount < nCapacity)
+		{
+			int nSlot = nStart + nCount;
+			if (nSlot >= nCapacity)
+				nSlot -= nCapacity;
+			pBars[nSlot] = bar;
+			nCount++;
+		}
+		else
+		{
+			// Full - the new bar takes the oldest bar's slot
+			pBars[nStart] = bar;
+			if (++nStart == nCapacity)
+				nStart = 0;
+		}
+	}
+
+	// i = 0 is the oldest bar
+	const struct Quotation& GetAt(int i) const {
+		int nSlot = nStart + i;
+		if (nSlot >= nCapacity)
+			nSlot -= nCapacity;
+		return pBars[nSlot];
+	}
+
+	const struct Quotation& GetLast() const {
+		return GetAt(nCount - 1);
+	}
+
+	// The bars in time order as (at most) two contiguous spans:
+	// *ppFirst[0..*pnFirst-1] followed by *ppSecond[0..*pnSecond-1]
+	void GetSpans(const struct Quotation** ppFirst, int* pnFirst,
+	              const struct Quotation** ppSecond, int* pnSecond) const {
+		int nFirst = min(nCount, nCapacity - nStart);
+		*ppFirst = pBars + nStart;
+		*pnFirst = nFirst;
+		*ppSecond = pBars;
+		*pnSecond = nCount - nFirst;
+	}
+
+	// Copy the newest min(nMax, count) bars into pDest in time order; returns the number copied
+	int CopyTo(struct Quotation* pDest, int nMax) const {
+		const struct Quotation* pFirst;
+		const struct Quotation* pSecond;
+		int nFirst, nSecond;
+		GetSpans(&pFirst, &nFirst, &pSecond, &nSecond);
+
+		int nCopy = min(nCount, max(0, nMax));
+		int nSkip = nCount - nCopy;  // Oldest bars that don't fit
+
+		// Each span's length is taken from GetSpans(), so neither copy can run past it
+		int nSkipFirst = min(nSkip, nFirst);
+		int nSkipSecond = nSkip - nSkipFirst;
+		memcpy(pDest, pFirst + nSkipFirst, (nFirst - nSkipFirst) * sizeof(struct Quotation));
+		memcpy(pDest + (nFirst - nSkipFirst), pSecond + nSkipSecond, (nSecond - nSkipSecond) * sizeof(struct Quotation));
+		return nCopy;
+	}
+
+	void RemoveAll() {
+		nStart = 0;
+		nCount = 0;
+	}
+
+private:
+	BarRing(const BarRing&);             // Not copyable - owns pBars
+	BarRing& operator=(const BarRing&);
+};
+
+// What GetQuotesEx() needs from a BarBuilder, published by the tick path after
+// every tick (see PublishBarSnapshot() / ReadBarSnapshot())
+struct BarSnapshot {
+	struct Quotation currentBar;
+	BOOL bBarStarted;
+	int tickCount;
+	int nBars;               // Completed bars in BarBuilder::bars
+};
+
+// BarBuilder: Per-symbol tick-to-bar aggregation state
+// Every field below is guarded by the builder's own lock, so a chart reading one
+// symbol never blocks ticks for another. Readers outside the tick path use the
+// seqlock-protected snapshot instead of taking the lock at all.
+struct BarBuilder {
+	CRITICAL_SECTION lock;
+
+	// Seqlock (Seqlock.h): odd while the writer is copying into snapshot
+	volatile LONG nSnapshotSeq;
+	volatile BarSnapshot snapshot;
+
+	TCHAR exchange[BAR_BUILDER_EXCHANGE_SIZE];  // Bar times are in this exchange's time zone
+	int periodicity;  // 60 for 1-minute (only 1-minute supported initially)
+
+	// Current bar being built from ticks
+	struct Quotation currentBar;
+	BOOL bBarStarted;
+	time_t barStartTime;
+
+	// Tick accumulation
+	float volumeAccumulator;  // Sum of last_trade_quantity
+	int tickCount;
+
+	// Completed bars (up to BAR_BUILDER_MAX_BARS, oldest dropped first)
+	BarRing bars;
+
+	// Timestamps for backfill management
+	DWORD lastTickTime;      // Last tick received
+	DWORD lastBackfillTime;  // Last HTTP backfill
+
+	// State flags
+	BOOL bBackfillMerged;
+	BOOL bFirstTickReceived;
+
+	// Constructor
+	BarBuilder() : nSnapshotSeq(0), periodicity(60), bBarStarted(FALSE), barStartTime(0),
+	               volumeAccumulator(0.0f), tickCount(0), bars(BAR_BUILDER_MAX_BARS),
+	               lastTickTime(0), lastBackfillTime(0),
+	               bBackfillMerged(FALSE), bFirstTickReceived(FALSE) {
+		InitializeCriticalSection(&lock);
+		exchange[0] = _T('\0');
+		memset((void*)&snapshot, 0, sizeof(snapshot));
+		memset(&currentBar, 0, sizeof(struct Quotation));
+	}
+
+	~BarBuilder() {
+		DeleteCriticalSection(&lock);
+	}
+};
+
+// Copy the bar state readers need into pBuilder->snapshot (seqlock write side).
+// Caller must hold pBuilder->lock, which makes it the only writer.
+void PublishBarSnapshot(BarBuilder* pBuilder);
+
+// Copy a consistent snapshot without taking pBuilder->lock (seqlock read side).
+// Retries if a tick was published during the copy; the writer never waits.
+void ReadBarSnapshot(BarBuilder* pBuilder, BarSnapshot* pSnapshot);
+
+// Fold one tick into the builder's current bar, finalizing the previous bar when
+// the minute changes, and publish the snapshot. Caller must hold pBuilder->lock.
+// Returns TRUE if the tick closed the previous bar.
+BOOL AddTickToBarBuilder(BarBuilder* pBuilder, float ltp, float lastTradeQty, time_t timestamp);
+
+#endif // BAR_BUILDER_H
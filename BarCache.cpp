@@ -0,0 +1,393 @@
+// BarCache.cpp - On-disk format of the memory-mapped bar cache
+#include "BarCache.h"
+#include "Calendar.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef _WIN32
+
+///////////////////////////////
+// File Mapping Backend
+///////////////////////////////
+
+static BOOL OpenBarCacheHandle(LPCTSTR pszPath, BOOL bWrite, BarCacheFile* pCache)
+{
+	pCache->hFile = CreateFile(pszPath, bWrite ? (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ, FILE_SHARE_READ, NULL,
+		bWrite ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (pCache->hFile == INVALID_HANDLE_VALUE)
+		return FALSE;
+
+	LARGE_INTEGER liSize;
+	if (!GetFileSizeEx(pCache->hFile, &liSize))
+	{
+		CloseBarCache(pCache);
+		return FALSE;
+	}
+	pCache->nFileSize = (UINT64)liSize.QuadPart;
+	return TRUE;
+}
+
+// Map nSize bytes of the file (a writable mapping larger than the file extends it)
+static BOOL MapBarCacheFile(BarCacheFile* pCache, BOOL bWrite, UINT64 nSize)
+{
+	pCache->hMapping = CreateFileMapping(pCache->hFile, NULL, bWrite ? PAGE_READWRITE : PAGE_READONLY,
+		(DWORD)(nSize >> 32), (DWORD)nSize, NULL);
+	if (pCache->hMapping == NULL)
+		return FALSE;
+
+	pCache->pView = (BYTE*)MapViewOfFile(pCache->hMapping, bWrite ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, (SIZE_T)nSize);
+	if (pCache->pView == NULL)
+	{
+		CloseHandle(pCache->hMapping);
+		pCache->hMapping = NULL;
+		return FALSE;
+	}
+
+	pCache->nViewSize = nSize;
+	pCache->pHeader = (BarCacheHeader*)pCache->pView;
+	return TRUE;
+}
+
+static void UnmapBarCacheFile(BarCacheFile* pCache)
+{
+	if (pCache->pView != NULL)
+	{
+		UnmapViewOfFile(pCache->pView);
+		pCache->pView = NULL;
+	}
+	if (pCache->hMapping != NULL)
+	{
+		CloseHandle(pCache->hMapping);
+		pCache->hMapping = NULL;
+	}
+	pCache->nViewSize = 0;
+	pCache->pHeader = NULL;
+	pCache->pDates = NULL;
+}
+
+void CloseBarCache(BarCacheFile* pCache)
+{
+	UnmapBarCacheFile(pCache);
+	if (pCache->hFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(pCache->hFile);
+		pCache->hFile = INVALID_HANDLE_VALUE;
+	}
+}
+
+#else // !_WIN32
+
+///////////////////////////////
+// mmap Backend
+///////////////////////////////
+
+static BOOL OpenBarCacheHandle(LPCTSTR pszPath, BOOL bWrite, BarCacheFile* pCache)
+{
+	pCache->nFd = open(pszPath, bWrite ? (O_RDWR | O_CREAT) : O_RDONLY, 0644);
+	if (pCache->nFd < 0)
+		return FALSE;
+
+	struct stat st;
+	if (fstat(pCache->nFd, &st) != 0)
+	{
+		CloseBarCache(pCache);
+		return FALSE;
+	}
+	pCache->nFileSize = (UINT64)st.st_size;
+	return TRUE;
+}
+
+// Map nSize bytes of the file; a writable mapping larger than the file extends it,
+// as CreateFileMapping does
+static BOOL MapBarCacheFile(BarCacheFile* pCache, BOOL bWrite, UINT64 nSize)
+{
+	if (bWrite && nSize > pCache->nFileSize)
+	{
+		if (ftruncate(pCache->nFd, (off_t)nSize) != 0)
+			return FALSE;
+		pCache->nFileSize = nSize;
+	}
+
+	void* pView = mmap(NULL, (size_t)nSize, bWrite ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, pCache->nFd, 0);
+	if (pView == MAP_FAILED)
+		return FALSE;
+
+	pCache->pView = (BYTE*)pView;
+	pCache->nViewSize = nSize;
+	pCache->pHeader = (BarCacheHeader*)pCache->pView;
+	return TRUE;
+}
+
+static void UnmapBarCacheFile(BarCacheFile* pCache)
+{
+	if (pCache->pView != NULL)
+	{
+		munmap(pCache->pView, (size_t)pCache->nViewSize);
+		pCache->pView = NULL;
+	}
+	pCache->nViewSize = 0;
+	pCache->pHeader = NULL;
+	pCache->pDates = NULL;
+}
+
+void CloseBarCache(BarCacheFile* pCache)
+{
+	UnmapBarCacheFile(pCache);
+	if (pCache->nFd >= 0)
+	{
+		close(pCache->nFd);
+		pCache->nFd = -1;
+	}
+}
+
+#endif // _WIN32
+
+///////////////////////////////
+// Layout
+///////////////////////////////
+
+UINT64 BarCacheFileSize(UINT32 nCapacity)
+{
+	return BAR_CACHE_HEADER_SIZE + (UINT64)nCapacity * (sizeof(UINT64) + BAR_CACHE_FLOAT_COLUMNS * sizeof(float));
+}
+
+// Point pDates/pColumns at the column offsets for the current capacity
+static void BarCacheSetColumns(BarCacheFile* pCache)
+{
+	UINT32 nCapacity = pCache->pHeader->nCapacity;
+	BYTE* pFloats = pCache->pView + BAR_CACHE_HEADER_SIZE + (size_t)nCapacity * sizeof(UINT64);
+
+	pCache->pDates = (UINT64*)(pCache->pView + BAR_CACHE_HEADER_SIZE);
+	for (int k = 0; k < BAR_CACHE_FLOAT_COLUMNS; k++)
+	{
+		pCache->pColumns[k] = (float*)(pFloats + (size_t)k * nCapacity * sizeof(float));
+	}
+}
+
+BOOL OpenBarCache(LPCTSTR pszPath, int nPeriodicity, BOOL bWrite, UINT32 nMinCapacity, BarCacheFile* pCache)
+{
+	if (!OpenBarCacheHandle(pszPath, bWrite, pCache))
+		return FALSE;
+
+	UINT64 nFileSize = pCache->nFileSize;
+	BOOL bValid = FALSE;
+	if (nFileSize >= BAR_CACHE_HEADER_SIZE && MapBarCacheFile(pCache, bWrite, nFileSize))
+	{
+		const BarCacheHeader* pHeader = pCache->pHeader;
+		bValid = (pHeader->nMagic == BAR_CACHE_MAGIC &&
+		          pHeader->nVersion == BAR_CACHE_VERSION &&
+		          pHeader->nPeriodicity == (UINT32)nPeriodicity &&
+		          pHeader->nCount <= pHeader->nCapacity &&
+		          BarCacheFileSize(pHeader->nCapacity) <= nFileSize);
+		if (!bValid)
+			UnmapBarCacheFile(pCache);
+	}
+
+	if (!bWrite)
+	{
+		if (!bValid)
+		{
+			CloseBarCache(pCache);
+			return FALSE;
+		}
+		BarCacheSetColumns(pCache);
+		return TRUE;
+	}
+
+	if (!bValid)
+	{
+		// New or unreadable file - start over with an empty cache
+		UINT32 nCapacity = max(nMinCapacity, (UINT32)BAR_CACHE_MIN_CAPACITY);
+		if (!MapBarCacheFile(pCache, TRUE, BarCacheFileSize(nCapacity)))
+		{
+			CloseBarCache(pCache);
+			return FALSE;
+		}
+
+		memset(pCache->pHeader, 0, BAR_CACHE_HEADER_SIZE);
+		pCache->pHeader->nMagic = BAR_CACHE_MAGIC;
+		pCache->pHeader->nVersion = BAR_CACHE_VERSION;
+		pCache->pHeader->nPeriodicity = (UINT32)nPeriodicity;
+		pCache->pHeader->nCapacity = nCapacity;
+	}
+	else if (pCache->pHeader->nCapacity < nMinCapacity)
+	{
+		// Grow: remap at the new size, then move the float columns out to their new offsets.
+		// New offsets are never below the old ones, so moving the last column first never
+		// overwrites a column that has not been moved yet. The Date column stays put.
+		UINT32 nOldCapacity = pCache->pHeader->nCapacity;
+		UINT32 nNewCapacity = max(nMinCapacity, nOldCapacity * 2);
+		size_t nCount = pCache->pHeader->nCount;
+
+		UnmapBarCacheFile(pCache);
+		if (!MapBarCacheFile(pCache, TRUE, BarCacheFileSize(nNewCapacity)))
+		{
+			CloseBarCache(pCache);
+			return FALSE;
+		}
+
+		BYTE* pOldFloats = pCache->pView + BAR_CACHE_HEADER_SIZE + (size_t)nOldCapacity * sizeof(UINT64);
+		BYTE* pNewFloats = pCache->pView + BAR_CACHE_HEADER_SIZE + (size_t)nNewCapacity * sizeof(UINT64);
+		for (int k = BAR_CACHE_FLOAT_COLUMNS - 1; k >= 0; k--)
+		{
+			memmove(pNewFloats + (size_t)k * nNewCapacity * sizeof(float),
+				pOldFloats + (size_t)k * nOldCapacity * sizeof(float),
+				nCount * sizeof(float));
+		}
+		pCache->pHeader->nCapacity = nNewCapacity;
+	}
+
+	BarCacheSetColumns(pCache);
+	return TRUE;
+}
+
+///////////////////////////////
+// Load and Store
+///////////////////////////////
+
+UINT32 GetBarCacheTodayKey(INT64 nNow, int nUtcOffsetSeconds)
+{
+	union AmiDate today;
+	ConvertUnixToPackedDate((time_t)nNow, nUtcOffsetSeconds, &today);
+	return BAR_CACHE_DAY_KEY(today.Date);
+}
+
+int ReadBarCache(LPCTSTR pszPath, int nPeriodicity, int nRoom, struct Quotation* pDest)
+{
+	if (nRoom <= 0)
+		return 0;
+
+	BarCacheFile cache;
+	if (!OpenBarCache(pszPath, nPeriodicity, FALSE, 0, &cache))
+		return 0;
+
+	int nCount = (int)cache.pHeader->nCount;
+	int nFirst = max(0, nCount - nRoom);  // Most recent bars if they don't all fit
+
+	for (int i = nFirst; i < nCount; i++, pDest++)
+	{
+		pDest->DateTime.Date = cache.pDates[i];
+		pDest->Open = cache.pColumns[0][i];
+		pDest->High = cache.pColumns[1][i];
+		pDest->Low = cache.pColumns[2][i];
+		pDest->Price = cache.pColumns[3][i];
+		pDest->Volume = cache.pColumns[4][i];
+		pDest->OpenInterest = cache.pColumns[5][i];
+		pDest->AuxData1 = 0;
+		pDest->AuxData2 = 0;
+	}
+
+	CloseBarCache(&cache);
+	return nCount - nFirst;
+}
+
+// A bar the file keeps: the file's kind, from a completed day
+static inline BOOL IsBarCacheRow(const struct Quotation& bar, BOOL bDaily, UINT32 nTodayKey)
+{
+	BOOL bIsEOD = (bar.DateTime.PackDate.Hour == DATE_EOD_HOURS && bar.DateTime.PackDate.Minute == DATE_EOD_MINUTES);
+	return bIsEOD == bDaily && BAR_CACHE_DAY_KEY(bar.DateTime.Date) < nTodayKey;
+}
+
+int WriteBarCache(LPCTSTR pszPath, int nPeriodicity, UINT32 nTodayKey, int nCount, const struct Quotation* pQuotes)
+{
+	BOOL bDaily = (nPeriodicity == 86400);
+
+	BarCacheFile cache;
+	if (!OpenBarCache(pszPath, nPeriodicity, TRUE, 0, &cache))
+		return -1;
+
+	UINT32 nCached = cache.pHeader->nCount;
+	UINT64 nFirstDate = cache.pHeader->nFirstDate;
+	UINT64 nLastDate = cache.pHeader->nLastDate;
+
+	// pQuotes is sorted: older bars are a prefix, newer bars a suffix
+	int nOlderEnd = 0;
+	int nNewerStart = 0;
+	if (nCached > 0)
+	{
+		nNewerStart = nCount;
+		while (nOlderEnd < nCount && pQuotes[nOlderEnd].DateTime.Date < nFirstDate)
+			nOlderEnd++;
+		while (nNewerStart > nOlderEnd && pQuotes[nNewerStart - 1].DateTime.Date > nLastDate)
+			nNewerStart--;
+	}
+
+	// Count the rows to write: matching kind, completed days only
+	UINT32 nOlder = 0;
+	UINT32 nNewer = 0;
+	for (int i = 0; i < nCount; i++)
+	{
+		if (i == nOlderEnd && i < nNewerStart)
+			i = nNewerStart;  // Skip the span already cached
+		if (i >= nCount)
+			break;
+
+		if (!IsBarCacheRow(pQuotes[i], bDaily, nTodayKey))
+			continue;
+
+		if (i < nOlderEnd)
+			nOlder++;
+		else
+			nNewer++;
+	}
+
+	if (nOlder + nNewer == 0)
+	{
+		CloseBarCache(&cache);
+		return 0;
+	}
+
+	if (nCached + nOlder + nNewer > cache.pHeader->nCapacity)
+	{
+		CloseBarCache(&cache);
+		if (!OpenBarCache(pszPath, nPeriodicity, TRUE, nCached + nOlder + nNewer, &cache))
+			return -1;
+	}
+
+	// Make room at the front for the older rows
+	if (nOlder > 0)
+	{
+		memmove(cache.pDates + nOlder, cache.pDates, nCached * sizeof(UINT64));
+		for (int k = 0; k < BAR_CACHE_FLOAT_COLUMNS; k++)
+		{
+			memmove(cache.pColumns[k] + nOlder, cache.pColumns[k], nCached * sizeof(float));
+		}
+	}
+
+	UINT32 nOlderRow = 0;
+	UINT32 nNewerRow = nOlder + nCached;
+	for (int i = 0; i < nCount; i++)
+	{
+		if (i == nOlderEnd && i < nNewerStart)
+			i = nNewerStart;
+		if (i >= nCount)
+			break;
+
+		const struct Quotation& bar = pQuotes[i];
+		if (!IsBarCacheRow(bar, bDaily, nTodayKey))
+			continue;
+
+		UINT32 nRow = (i < nOlderEnd) ? nOlderRow++ : nNewerRow++;
+		cache.pDates[nRow] = bar.DateTime.Date;
+		cache.pColumns[0][nRow] = bar.Open;
+		cache.pColumns[1][nRow] = bar.High;
+		cache.pColumns[2][nRow] = bar.Low;
+		cache.pColumns[3][nRow] = bar.Price;
+		cache.pColumns[4][nRow] = bar.Volume;
+		cache.pColumns[5][nRow] = bar.OpenInterest;
+	}
+
+	// Update the header index
+	nCached += nOlder + nNewer;
+	cache.pHeader->nFirstDate = cache.pDates[0];
+	cache.pHeader->nLastDate = cache.pDates[nCached - 1];
+	cache.pHeader->nCount = nCached;
+
+	CloseBarCache(&cache);
+	return (int)(nOlder + nNewer);
+}
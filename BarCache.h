@@ -0,0 +1,92 @@
+// BarCache.h - On-disk format of the memory-mapped bar cache
+//
+// No MFC: Plugin.cpp picks the file of a symbol, holds the cache lock and merges
+// what is loaded into AmiBroker's array (see "Bar Cache"); the file layout, the
+// header checks and the load/store/grow/prepend logic live here, so the Linux
+// test build (tests/) can run them against real files. Windows maps the file
+// with CreateFileMapping; other platforms use mmap.
+#ifndef BAR_CACHE_H
+#define BAR_CACHE_H
+
+#include <string.h>
+#include "OpenAlgoPortable.h"
+#include "Plugin.h"
+
+// Completed days of history, one memory-mapped file per symbol and periodicity.
+// File layout (little-endian, fixed width, no padding):
+//   BarCacheHeader                         64 bytes
+//   UINT64 Date[nCapacity]                 AmiDate.Date of each bar, ascending
+//   float  Open[nCapacity], High[nCapacity], Low[nCapacity],
+//          Close[nCapacity], Volume[nCapacity], OpenInterest[nCapacity]
+#define BAR_CACHE_MAGIC          0x4342414F  // "OABC"
+#define BAR_CACHE_VERSION        1
+#define BAR_CACHE_HEADER_SIZE    64
+#define BAR_CACHE_MIN_CAPACITY   4096        // Rows allocated when a file is created
+#define BAR_CACHE_FLOAT_COLUMNS  6           // Open, High, Low, Close, Volume, OpenInterest
+
+// Day part of an AmiDate (Year, Month, Day)
+#define BAR_CACHE_DAY_KEY(date)  ((UINT32)((date) >> 43))
+
+struct BarCacheHeader {
+	UINT32 nMagic;
+	UINT32 nVersion;
+	UINT32 nPeriodicity;     // 60 or 86400
+	UINT32 nCapacity;        // Rows allocated in every column
+	UINT32 nCount;           // Rows in use
+	UINT32 nReserved;
+	UINT64 nFirstDate;       // Date of row 0
+	UINT64 nLastDate;        // Date of row nCount-1
+	UINT64 aReserved[3];     // Pads the header to BAR_CACHE_HEADER_SIZE
+};
+
+// An open, mapped cache file
+struct BarCacheFile {
+#ifdef _WIN32
+	HANDLE hFile;
+	HANDLE hMapping;
+#else
+	int nFd;
+#endif
+	UINT64 nFileSize;        // Size when opened
+	BYTE* pView;
+	UINT64 nViewSize;
+	BarCacheHeader* pHeader;
+	UINT64* pDates;
+	float* pColumns[BAR_CACHE_FLOAT_COLUMNS];
+
+	BarCacheFile() :
+#ifdef _WIN32
+		hFile(INVALID_HANDLE_VALUE), hMapping(NULL),
+#else
+		nFd(-1),
+#endif
+		nFileSize(0), pView(NULL), nViewSize(0), pHeader(NULL), pDates(NULL) {
+		memset(pColumns, 0, sizeof(pColumns));
+	}
+};
+
+// Bytes in a file with nCapacity rows per column
+UINT64 BarCacheFileSize(UINT32 nCapacity);
+
+// Open and map a cache file.
+// For writing, a missing or unreadable file is (re)created empty, and the file
+// is grown so that every column holds at least nMinCapacity rows.
+BOOL OpenBarCache(LPCTSTR pszPath, int nPeriodicity, BOOL bWrite, UINT32 nMinCapacity, BarCacheFile* pCache);
+void CloseBarCache(BarCacheFile* pCache);
+
+// Day key (BAR_CACHE_DAY_KEY) of the exchange's date at nNow (Unix seconds, local
+// time = UTC + nUtcOffsetSeconds). Bars dated that day or later are still changing.
+UINT32 GetBarCacheTodayKey(INT64 nNow, int nUtcOffsetSeconds);
+
+// Copy the newest cached bars (at most nRoom) to pDest in time order.
+// Returns the number copied; 0 if there is no valid file.
+int ReadBarCache(LPCTSTR pszPath, int nPeriodicity, int nRoom, struct Quotation* pDest);
+
+// Write the bars of pQuotes (sorted) of the file's kind (EOD for 86400, intraday
+// for 60) dated before day nTodayKey (BAR_CACHE_DAY_KEY) that the file does not
+// hold yet: bars newer than the last cached bar are appended, bars older than
+// the first cached bar (a manual backfill) are prepended. Returns the number of
+// rows written, or -1 if the file could not be opened or grown.
+int WriteBarCache(LPCTSTR pszPath, int nPeriodicity, UINT32 nTodayKey, int nCount, const struct Quotation* pQuotes);
+
+#endif // BAR_CACHE_H
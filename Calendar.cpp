@@ -0,0 +1,220 @@
+// Calendar.cpp - Unix time to AmiBroker dates in an exchange's local time
+#include "Calendar.h"
+
+///////////////////////////////
+// Calendar Conversion
+///////////////////////////////
+//
+// ConvertUnixToPackedDate() runs for every history candle and every new tick bar
+// (100k+ times on a large backfill). It used localtime(), which is slow, returns
+// a static buffer shared by every thread, and shows bars in this PC's time zone
+// rather than the exchange's. Now the exchange's UTC offset is added explicitly
+// and the date comes from the days-from-civil algorithm (integer arithmetic
+// only); a PackedDateCache remembers the last day converted, so consecutive
+// candles of the same day skip even that.
+//
+// Offsets are fixed per exchange. Every exchange OpenAlgo serves is in India
+// (UTC+05:30, no daylight saving); the registry can override any exchange or add
+// one ("ExchangeUtcOffsets"), and "UtcOffsetMinutes" covers the rest.
+
+struct ExchangeUtcOffset {
+	TCHAR szExchange[CALENDAR_EXCHANGE_NAME_SIZE];
+	BOOL bBuiltIn;                  // FALSE: added by "ExchangeUtcOffsets"
+	int nBuiltInMinutes;            // Restored on settings reload (built-in entries)
+	volatile LONG nOffsetSeconds;
+};
+
+// Entries are appended (name first, then the count) and never removed, so
+// GetExchangeUtcOffsetSeconds() can scan them while settings are reloaded.
+static ExchangeUtcOffset g_aExchangeOffsets[CALENDAR_MAX_EXCHANGES];
+static volatile LONG g_nExchangeOffsets = 0;
+static volatile LONG g_nDefaultOffsetSeconds = CALENDAR_UTC_OFFSET_IST * 60;
+
+static const TCHAR* const s_apszIndianExchanges[] = {
+	_T("NSE"), _T("BSE"), _T("NFO"), _T("BFO"), _T("CDS"), _T("BCD"), _T("MCX"),
+	_T("NSE_INDEX"), _T("BSE_INDEX")
+};
+
+static TCHAR ToUpperAscii(TCHAR c)
+{
+	return (c >= _T('a') && c <= _T('z')) ? (TCHAR)(c - _T('a') + _T('A')) : c;
+}
+
+// nLen characters of pszName against a NUL-terminated table name, ignoring case
+static BOOL ExchangeNameIs(const TCHAR* pszTable, const TCHAR* pszName, int nLen)
+{
+	for (int i = 0; i < nLen; i++)
+	{
+		if (pszTable[i] == _T('\0') || ToUpperAscii(pszName[i]) != pszTable[i])
+			return FALSE;
+	}
+	return pszTable[nLen] == _T('\0');
+}
+
+static ExchangeUtcOffset* FindExchangeOffset(const TCHAR* pszName, int nLen)
+{
+	LONG nCount = g_nExchangeOffsets;
+	MemoryBarrier();  // Pairs with the one before the count is published
+	for (LONG i = 0; i < nCount; i++)
+	{
+		if (ExchangeNameIs(g_aExchangeOffsets[i].szExchange, pszName, nLen))
+			return &g_aExchangeOffsets[i];
+	}
+	return NULL;
+}
+
+// Single writer (Init and settings reload run on AmiBroker's main thread)
+static ExchangeUtcOffset* AddExchangeOffset(const TCHAR* pszName, int nLen, BOOL bBuiltIn, int nMinutes)
+{
+	ExchangeUtcOffset* pEntry = FindExchangeOffset(pszName, nLen);
+	if (pEntry != NULL)
+		return pEntry;
+	if (nLen <= 0 || nLen >= CALENDAR_EXCHANGE_NAME_SIZE || g_nExchangeOffsets >= CALENDAR_MAX_EXCHANGES)
+		return NULL;
+
+	pEntry = &g_aExchangeOffsets[g_nExchangeOffsets];
+	for (int i = 0; i < nLen; i++)
+		pEntry->szExchange[i] = ToUpperAscii(pszName[i]);
+	pEntry->szExchange[nLen] = _T('\0');
+	pEntry->bBuiltIn = bBuiltIn;
+	pEntry->nBuiltInMinutes = nMinutes;
+	pEntry->nOffsetSeconds = nMinutes * 60;
+	MemoryBarrier();
+	InterlockedIncrement(&g_nExchangeOffsets);
+	return pEntry;
+}
+
+static BOOL IsValidOffsetMinutes(int nMinutes)
+{
+	return nMinutes >= -CALENDAR_UTC_OFFSET_MAX && nMinutes <= CALENDAR_UTC_OFFSET_MAX;
+}
+
+void InitCalendarConversion(int nDefaultUtcOffsetMinutes, LPCTSTR pszExchangeOffsets)
+{
+	if (!IsValidOffsetMinutes(nDefaultUtcOffsetMinutes))
+		nDefaultUtcOffsetMinutes = CALENDAR_UTC_OFFSET_IST;
+	InterlockedExchange(&g_nDefaultOffsetSeconds, nDefaultUtcOffsetMinutes * 60);
+
+	// Start from the built-in offsets; exchanges added by an earlier setting fall back to the default
+	for (int i = 0; i < (int)(sizeof(s_apszIndianExchanges) / sizeof(s_apszIndianExchanges[0])); i++)
+	{
+		const TCHAR* pszName = s_apszIndianExchanges[i];
+		AddExchangeOffset(pszName, (int)_tcslen(pszName), TRUE, CALENDAR_UTC_OFFSET_IST);
+	}
+	for (LONG i = 0; i < g_nExchangeOffsets; i++)
+	{
+		ExchangeUtcOffset* pEntry = &g_aExchangeOffsets[i];
+		InterlockedExchange(&pEntry->nOffsetSeconds,
+			(pEntry->bBuiltIn ? pEntry->nBuiltInMinutes : nDefaultUtcOffsetMinutes) * 60);
+	}
+
+	// "EXCHANGE=minutes" pairs separated by ',', ';' or spaces; malformed pairs are skipped
+	const TCHAR* p = (pszExchangeOffsets != NULL) ? pszExchangeOffsets : _T("");
+	while (*p != _T('\0'))
+	{
+		while (*p == _T(',') || *p == _T(';') || *p == _T(' ') || *p == _T('\t'))
+			p++;
+		const TCHAR* pszName = p;
+		while (*p != _T('\0') && *p != _T('=') && *p != _T(',') && *p != _T(';') && *p != _T(' '))
+			p++;
+		int nNameLen = (int)(p - pszName);
+		if (*p != _T('='))
+		{
+			while (*p != _T('\0') && *p != _T(',') && *p != _T(';'))
+				p++;
+			continue;
+		}
+		p++;
+
+		int nSign = 1;
+		if (*p == _T('+') || *p == _T('-'))
+			nSign = (*p++ == _T('-')) ? -1 : 1;
+		int nMinutes = 0;
+		int nDigits = 0;
+		while (*p >= _T('0') && *p <= _T('9') && nDigits < 5)
+		{
+			nMinutes = nMinutes * 10 + (*p++ - _T('0'));
+			nDigits++;
+		}
+		nMinutes *= nSign;
+
+		if (nDigits > 0 && IsValidOffsetMinutes(nMinutes) &&
+			(*p == _T('\0') || *p == _T(',') || *p == _T(';') || *p == _T(' ')))
+		{
+			ExchangeUtcOffset* pEntry = AddExchangeOffset(pszName, nNameLen, FALSE, nMinutes);
+			if (pEntry != NULL)
+				InterlockedExchange(&pEntry->nOffsetSeconds, nMinutes * 60);
+		}
+		while (*p != _T('\0') && *p != _T(',') && *p != _T(';'))
+			p++;
+	}
+}
+
+int GetExchangeUtcOffsetSeconds(LPCTSTR pszExchange)
+{
+	if (pszExchange != NULL)
+	{
+		ExchangeUtcOffset* pEntry = FindExchangeOffset(pszExchange, (int)_tcslen(pszExchange));
+		if (pEntry != NULL)
+			return pEntry->nOffsetSeconds;
+	}
+	return g_nDefaultOffsetSeconds;
+}
+
+// Days since 1970-01-01 of a proleptic Gregorian date (H. Hinnant's days_from_civil)
+INT64 DaysFromCivil(int nYear, int nMonth, int nDay)
+{
+	nYear -= (nMonth <= 2);
+	INT64 nEra = (nYear >= 0 ? nYear : nYear - 399) / 400;
+	int nYearOfEra = (int)(nYear - nEra * 400);                                      // [0, 399]
+	int nDayOfYear = (153 * (nMonth + (nMonth > 2 ? -3 : 9)) + 2) / 5 + nDay - 1;    // [0, 365], from March 1
+	int nDayOfEra = nYearOfEra * 365 + nYearOfEra / 4 - nYearOfEra / 100 + nDayOfYear;
+	return nEra * 146097 + nDayOfEra - 719468;
+}
+
+// Civil date of a day number (days since 1970-01-01), proleptic Gregorian calendar
+void CivilFromDays(INT64 nDays, int* pnYear, int* pnMonth, int* pnDay)
+{
+	nDays += 719468;  // Shift the epoch to 0000-03-01
+	INT64 nEra = (nDays >= 0 ? nDays : nDays - 146096) / 146097;
+	int nDayOfEra = (int)(nDays - nEra * 146097);                                          // [0, 146096]
+	int nYearOfEra = (nDayOfEra - nDayOfEra / 1460 + nDayOfEra / 36524 - nDayOfEra / 146096) / 365;  // [0, 399]
+	int nDayOfYear = nDayOfEra - (365 * nYearOfEra + nYearOfEra / 4 - nYearOfEra / 100);     // [0, 365], from March 1
+	int nMonthIndex = (5 * nDayOfYear + 2) / 153;                                          // [0, 11], March = 0
+
+	*pnDay = nDayOfYear - (153 * nMonthIndex + 2) / 5 + 1;
+	*pnMonth = (nMonthIndex < 10) ? nMonthIndex + 3 : nMonthIndex - 9;
+	*pnYear = (int)(nYearOfEra + nEra * 400) + (*pnMonth <= 2 ? 1 : 0);
+}
+
+// Convert Unix timestamp to AmiBroker date format (exchange local time)
+// Works for all market types including 24x7 markets
+void ConvertUnixToPackedDateCached(time_t unixTime, int nUtcOffsetSeconds, union AmiDate* pAmiDate, PackedDateCache* pCache)
+{
+	INT64 nLocal = (INT64)unixTime + nUtcOffsetSeconds;
+	INT64 nDay = (nLocal >= 0 ? nLocal : nLocal - 86399) / 86400;
+	int nSecondOfDay = (int)(nLocal - nDay * 86400);
+
+	if (nDay != pCache->nDay)
+	{
+		CivilFromDays(nDay, &pCache->nYear, &pCache->nMonth, &pCache->nDayOfMonth);
+		pCache->nDay = nDay;
+	}
+
+	pAmiDate->PackDate.Year = pCache->nYear;
+	pAmiDate->PackDate.Month = pCache->nMonth;
+	pAmiDate->PackDate.Day = pCache->nDayOfMonth;
+	pAmiDate->PackDate.Hour = nSecondOfDay / 3600;
+	pAmiDate->PackDate.Minute = (nSecondOfDay / 60) % 60;
+	pAmiDate->PackDate.Second = nSecondOfDay % 60;
+	pAmiDate->PackDate.MilliSec = 0;
+	pAmiDate->PackDate.MicroSec = 0;
+	pAmiDate->PackDate.Reserved = 0;
+	pAmiDate->PackDate.IsFuturePad = 0;
+}
+
+void ConvertUnixToPackedDate(time_t unixTime, int nUtcOffsetSeconds, union AmiDate* pAmiDate)
+{
+	PackedDateCache cache;
+	ConvertUnixToPackedDateCached(unixTime, nUtcOffsetSeconds, pAmiDate, &cache);
+}
@@ -0,0 +1,44 @@
+// Calendar.h - Unix time to AmiBroker dates in an exchange's local time
+//
+// No MFC and no C runtime time zone calls: history candles, tick bars and the
+// tick journal all convert with a fixed per-exchange UTC offset, and the Linux
+// test build (tests/) checks the result against gmtime().
+#ifndef CALENDAR_H
+#define CALENDAR_H
+
+#include <time.h>
+#include "OpenAlgoPortable.h"
+#include "Plugin.h"
+
+#define CALENDAR_UTC_OFFSET_IST        330   // NSE, BSE, MCX and the other Indian segments
+#define CALENDAR_UTC_OFFSET_MAX        (14 * 60)
+#define CALENDAR_EXCHANGE_NAME_SIZE    16
+#define CALENDAR_MAX_EXCHANGES         32
+
+// Last day converted by ConvertUnixToPackedDateCached()
+struct PackedDateCache {
+	INT64 nDay;              // Local day number (days since 1970-01-01) of nYear/nMonth/nDayOfMonth
+	int nYear;
+	int nMonth;
+	int nDayOfMonth;
+
+	PackedDateCache() : nDay(_I64_MIN), nYear(0), nMonth(0), nDayOfMonth(0) {
+	}
+};
+
+// Day number <-> proleptic Gregorian date
+INT64 DaysFromCivil(int nYear, int nMonth, int nDay);
+void CivilFromDays(INT64 nDays, int* pnYear, int* pnMonth, int* pnDay);
+
+// Offsets for exchanges not in the built-in list (nDefaultUtcOffsetMinutes) and
+// per-exchange overrides such as "MCX=330,NYSE=-300" (Init and settings reload)
+void InitCalendarConversion(int nDefaultUtcOffsetMinutes, LPCTSTR pszExchangeOffsets);
+
+// Seconds to add to UTC for local time on pszExchange ("NSE", "MCX", ...; NULL = default)
+int GetExchangeUtcOffsetSeconds(LPCTSTR pszExchange);
+
+// Unix seconds to AmiDate (seconds resolution, local time = UTC + nUtcOffsetSeconds)
+void ConvertUnixToPackedDateCached(time_t unixTime, int nUtcOffsetSeconds, union AmiDate* pAmiDate, PackedDateCache* pCache);
+void ConvertUnixToPackedDate(time_t unixTime, int nUtcOffsetSeconds, union AmiDate* pAmiDate);
+
+#endif // CALENDAR_H
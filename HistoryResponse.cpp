@@ -0,0 +1,473 @@
+// HistoryResponse.cpp - Streaming parser and merge for /api/v1/history bodies
+#include "HistoryResponse.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+///////////////////////////////
+// History Response Parser
+///////////////////////////////
+//
+// /api/v1/history bodies get large (10 years of daily bars, 30 days of 1-minute
+// bars). Rather than concatenating the whole body into a CString and slicing it,
+// RequestHistoryRange() feeds fixed-size chunks from CHttpFile::Read() into
+// HistoryStreamParser. The parser tracks JSON nesting byte by byte and buffers
+// only the candle object it is currently inside (at most HISTORY_CANDLE_MAX_SIZE
+// bytes). Each completed candle is tokenized and written straight into the
+// Quotation array by AppendHistoryCandle().
+//
+// New candles collect as a pending run right after the existing bars. Both the
+// existing bars and the response are in time order, so MergeHistoryRun() folds
+// the run in with one linear merge instead of a per-candle duplicate scan and a
+// qsort() of the whole array. A binary search finds the first existing bar the
+// run can overlap; everything older is never touched. Bars are matched on
+// HistoryBarKey() (the upper 32 bits of the AmiDate: date, hour and minute), so
+// EOD bars (Hour=31, Minute=63) only ever match EOD bars and intraday bars match
+// on the minute.
+
+// Identity of a bar for duplicate detection: the upper 32 bits of the AmiDate
+// (Year, Month, Day, Hour, Minute). Orders the same way as CompareQuotations().
+// EOD bars all carry Hour=31/Minute=63, so for them this is the date alone.
+UINT32 HistoryBarKey(const struct Quotation* pQuote)
+{
+	return (UINT32)(pQuote->DateTime.Date >> 32);
+}
+
+// Before the first new bar is added: if the array is nearly full, drop the oldest bars
+void MakeHistoryRoom(HistoryMergeContext* pCtx)
+{
+	if (pCtx->bHasExistingData && !pCtx->bRoomChecked)
+	{
+		// CRITICAL: Check if array is near full before adding new data
+		// If array is 95% full, remove oldest 10% to make room for new bars
+		// Done on the first candle so that an empty response leaves the array untouched
+		const int ARRAY_THRESHOLD = (int)(pCtx->nSize * 0.95);  // 95% full
+		const int BARS_TO_REMOVE = (int)(pCtx->nSize * 0.10);   // Remove 10%
+
+		if (pCtx->nLastValid >= ARRAY_THRESHOLD)
+		{
+			// Array is nearly full - shift data to remove oldest bars
+			memmove(pCtx->pQuotes, pCtx->pQuotes + BARS_TO_REMOVE, (pCtx->nLastValid - BARS_TO_REMOVE + 1) * sizeof(struct Quotation));
+			pCtx->nLastValid -= BARS_TO_REMOVE;
+		}
+
+		// Start appending after existing data
+		pCtx->quoteIndex = pCtx->nLastValid + 1;
+		pCtx->nRunStart = pCtx->quoteIndex;
+	}
+	pCtx->bRoomChecked = TRUE;
+}
+
+// Convert one candle and add it to the pending run
+void AppendHistoryCandle(HistoryMergeContext* pCtx, const MarketTick* pCandle)
+{
+	struct Quotation bar;
+	time_t timestamp = (time_t)_atoi64(pCandle->timestamp);
+
+	// Convert to AmiBroker date
+	if (pCtx->nPeriodicity == 86400) // Daily data
+	{
+		// For daily data, set the DAILY_MASK and EOD markers
+		ConvertUnixToPackedDateCached(timestamp, pCtx->nUtcOffsetSeconds, &bar.DateTime, &pCtx->dateCache);
+		bar.DateTime.Date |= DAILY_MASK;
+
+		// Set EOD markers and normalize ALL time fields
+		// CRITICAL: All Daily bars must have identical time fields
+		// to avoid display issues with the last candle
+		bar.DateTime.PackDate.Hour = 31;      // EOD marker
+		bar.DateTime.PackDate.Minute = 63;    // EOD marker
+		bar.DateTime.PackDate.Second = 0;     // Normalize
+		bar.DateTime.PackDate.MilliSec = 0;   // Normalize
+		bar.DateTime.PackDate.MicroSec = 0;   // Normalize
+	}
+	else
+	{
+		// For intraday data
+		ConvertUnixToPackedDateCached(timestamp, pCtx->nUtcOffsetSeconds, &bar.DateTime, &pCtx->dateCache);
+
+		// CRITICAL FIX: Normalize sub-minute time fields for 1-minute bars
+		// This prevents freak candles during live updates when seconds change
+		// Same principle as Daily bars - all bars for the same minute must have
+		// identical time fields to avoid duplicate bar creation
+		if (pCtx->nPeriodicity == 60) // 1-minute data
+		{
+			bar.DateTime.PackDate.Second = 0;     // Normalize
+			bar.DateTime.PackDate.MilliSec = 0;   // Normalize
+			bar.DateTime.PackDate.MicroSec = 0;   // Normalize
+		}
+	}
+
+	// OHLCV
+	bar.Open = pCandle->open;
+	bar.High = pCandle->high;
+	bar.Low = pCandle->low;
+	bar.Price = pCandle->close;
+	bar.Volume = pCandle->volume;
+	bar.OpenInterest = pCandle->oi;
+
+	// Set auxiliary data
+	bar.AuxData1 = 0;
+	bar.AuxData2 = 0;
+
+	// Waiters on a coalesced request get every candle, whatever room this array has
+	if (pCtx->pfnRecordBar != NULL)
+		pCtx->pfnRecordBar(pCtx->pRecordContext, &bar);
+
+	AppendHistoryBar(pCtx, &bar);
+}
+
+// Add one bar to the pending run.
+// A bar for the same minute/day as the one before it replaces it (last write wins);
+// duplicates of existing bars are resolved later by MergeHistoryRun().
+void AppendHistoryBar(HistoryMergeContext* pCtx, const struct Quotation* pBar)
+{
+	struct Quotation* pQuotes = pCtx->pQuotes;
+
+	MakeHistoryRoom(pCtx);
+
+	if (pCtx->quoteIndex >= pCtx->nSize)
+	{
+		// Out of room - merging the pending run frees the slots taken by duplicates
+		MergeHistoryRun(pCtx);
+		if (pCtx->quoteIndex >= pCtx->nSize)
+			return; // Array full - remaining candles are dropped
+	}
+
+	int quoteIndex = pCtx->quoteIndex;
+	pQuotes[quoteIndex] = *pBar;
+
+	// Same bar as the previous candle of this response: last write wins
+	if (quoteIndex > pCtx->nRunStart)
+	{
+		UINT32 key = HistoryBarKey(&pQuotes[quoteIndex]);
+		UINT32 prevKey = HistoryBarKey(&pQuotes[quoteIndex - 1]);
+
+		if (key == prevKey)
+		{
+			pQuotes[quoteIndex - 1] = pQuotes[quoteIndex];
+			pCtx->duplicateCount++;
+			return;
+		}
+
+		if (key < prevKey)
+			pCtx->bRunUnsorted = TRUE;
+	}
+
+	pCtx->quoteIndex++;
+}
+
+// Fold the pending run pQuotes[nRunStart..quoteIndex-1] into the bars before it.
+// Existing bars are in time order and so is the run, so this is one forward merge
+// over the overlapping tail. A candle for an existing bar (same day for EOD, same
+// minute for intraday) updates that bar in place instead of adding a new one.
+void MergeHistoryRun(HistoryMergeContext* pCtx)
+{
+	struct Quotation* pQuotes = pCtx->pQuotes;
+	int nRunStart = pCtx->nRunStart;
+	int nRunEnd = pCtx->quoteIndex;
+
+	if (nRunEnd <= nRunStart)
+		return;
+
+	if (pCtx->bRunUnsorted)
+	{
+		// Candles arrived out of order - insertion sort is stable (response order is kept
+		// for equal bars) and close to linear for a nearly sorted run
+		for (int i = nRunStart + 1; i < nRunEnd; i++)
+		{
+			struct Quotation bar = pQuotes[i];
+			UINT32 key = HistoryBarKey(&bar);
+			int j = i - 1;
+			while (j >= nRunStart && HistoryBarKey(&pQuotes[j]) > key)
+			{
+				pQuotes[j + 1] = pQuotes[j];
+				j--;
+			}
+			pQuotes[j + 1] = bar;
+		}
+
+		// Collapse repeated bars - the last one in the response wins
+		int nOut = nRunStart;
+		for (int i = nRunStart; i < nRunEnd; i++)
+		{
+			if (nOut > nRunStart && HistoryBarKey(&pQuotes[nOut - 1]) == HistoryBarKey(&pQuotes[i]))
+			{
+				pQuotes[nOut - 1] = pQuotes[i];
+				pCtx->duplicateCount++;
+			}
+			else
+			{
+				pQuotes[nOut++] = pQuotes[i];
+			}
+		}
+		nRunEnd = nOut;
+		pCtx->bRunUnsorted = FALSE;
+	}
+
+	// First existing bar at or after the oldest candle - everything before it is left alone
+	UINT32 firstKey = HistoryBarKey(&pQuotes[nRunStart]);
+	int lo = 0;
+	int hi = nRunStart;
+	while (lo < hi)
+	{
+		int mid = lo + (hi - lo) / 2;
+		if (HistoryBarKey(&pQuotes[mid]) < firstKey)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	int nTail = nRunStart - lo;
+	if (nTail == 0)
+	{
+		// Every candle is newer than the existing data - already in place
+		pCtx->uniqueCount += nRunEnd - nRunStart;
+		pCtx->quoteIndex = nRunEnd;
+		pCtx->nRunStart = nRunEnd;
+		return;
+	}
+
+	// Move the overlapping tail aside and merge forward from lo.
+	// The write position never passes the read position in the run,
+	// so the run is read in place.
+	if (nTail > pCtx->nScratchSize)
+	{
+		delete[] pCtx->pScratch;
+		pCtx->pScratch = new struct Quotation[nTail];
+		pCtx->nScratchSize = nTail;
+	}
+	struct Quotation* pTail = pCtx->pScratch;
+	memcpy(pTail, pQuotes + lo, nTail * sizeof(struct Quotation));
+
+	int i = 0;
+	int j = nRunStart;
+	int out = lo;
+	while (i < nTail && j < nRunEnd)
+	{
+		UINT32 tailKey = HistoryBarKey(&pTail[i]);
+		UINT32 runKey = HistoryBarKey(&pQuotes[j]);
+
+		if (tailKey < runKey)
+		{
+			pQuotes[out++] = pTail[i++];
+		}
+		else if (runKey < tailKey)
+		{
+			pQuotes[out++] = pQuotes[j++];
+			pCtx->uniqueCount++;
+		}
+		else if (i + 1 < nTail && HistoryBarKey(&pTail[i + 1]) == tailKey)
+		{
+			// Several existing bars in the same minute - update the newest one
+			pQuotes[out++] = pTail[i++];
+		}
+		else
+		{
+			// Update existing bar with latest data instead of adding new
+			struct Quotation bar = pTail[i++];
+			const struct Quotation latest = pQuotes[j++];
+			bar.Price = latest.Price; // Close
+			bar.High = max(bar.High, latest.High);
+			bar.Low = (bar.Low == 0) ? latest.Low : min(bar.Low, latest.Low);
+			bar.Volume = latest.Volume;
+			bar.OpenInterest = latest.OpenInterest;
+			pQuotes[out++] = bar;
+			pCtx->duplicateCount++;
+		}
+	}
+
+	while (i < nTail)
+	{
+		pQuotes[out++] = pTail[i++];
+	}
+
+	while (j < nRunEnd)
+	{
+		pQuotes[out++] = pQuotes[j++];
+		pCtx->uniqueCount++;
+	}
+
+	pCtx->quoteIndex = out;
+	pCtx->nRunStart = out;
+}
+
+// Merge bars that are already converted, sorted and unique (a background fetch)
+// into pQuotes the same way a history response is merged. Returns the new bar count.
+int MergeHistoryBars(struct Quotation* pQuotes, int nSize, int nPeriodicity, int nLastValid, const struct Quotation* pBars, int nBars)
+{
+	if (nBars <= 0)
+		return nLastValid + 1;
+
+	HistoryMergeContext ctx(pQuotes, nSize, nPeriodicity, nLastValid);
+	MakeHistoryRoom(&ctx);
+
+	int i = 0;
+	while (i < nBars)
+	{
+		if (ctx.quoteIndex >= nSize)
+		{
+			// Out of room - merging frees the slots taken by bars AmiBroker already has
+			MergeHistoryRun(&ctx);
+			if (ctx.quoteIndex >= nSize)
+				break; // Array full - remaining bars are dropped
+		}
+
+		int nCopy = min(nBars - i, nSize - ctx.quoteIndex);
+		memcpy(pQuotes + ctx.quoteIndex, pBars + i, nCopy * sizeof(struct Quotation));
+		ctx.quoteIndex += nCopy;
+		i += nCopy;
+	}
+
+	MergeHistoryRun(&ctx);
+	return ctx.quoteIndex;
+}
+
+static void HistoryCandleAppendChar(HistoryStreamParser* pParser, char c)
+{
+	if (pParser->nCandleLen < HISTORY_CANDLE_MAX_SIZE)
+		pParser->candle[pParser->nCandleLen++] = c;
+	else
+		pParser->bCandleOverflow = TRUE;
+}
+
+// Consume the next nLength bytes of the response body.
+// Candles are emitted as soon as their closing brace arrives.
+void HistoryStreamParserFeed(HistoryStreamParser* pParser, const char* pData, int nLength, HistoryMergeContext* pCtx)
+{
+	for (int i = 0; i < nLength; i++)
+	{
+		char c = pData[i];
+
+		if (pParser->bInString)
+		{
+			if (pParser->bInCandle)
+			{
+				HistoryCandleAppendChar(pParser, c);
+			}
+
+			if (pParser->bEscape)
+			{
+				pParser->bEscape = FALSE;
+			}
+			else if (c == '\\')
+			{
+				pParser->bEscape = TRUE;
+			}
+			else if (c == '"')
+			{
+				pParser->bInString = FALSE;
+
+				if (pParser->nDepth == 1)
+				{
+					pParser->szToken[pParser->nTokenLen] = '\0';
+					if (pParser->bExpectValue)
+					{
+						// Top-level string value
+						if (strcmp(pParser->szKey, "status") == 0)
+							pParser->bStatusSuccess = (strcmp(pParser->szToken, "success") == 0);
+						pParser->bExpectValue = FALSE;
+					}
+				}
+				continue;
+			}
+
+			if (pParser->nDepth == 1 && pParser->nTokenLen < HISTORY_TOKEN_MAX_SIZE - 1)
+			{
+				pParser->szToken[pParser->nTokenLen++] = c;
+			}
+			continue;
+		}
+
+		switch (c)
+		{
+		case '"':
+			pParser->bInString = TRUE;
+			pParser->nTokenLen = 0;
+			if (pParser->bInCandle)
+				HistoryCandleAppendChar(pParser, c);
+			break;
+
+		case ':':
+			if (pParser->nDepth == 1)
+			{
+				memcpy(pParser->szKey, pParser->szToken, HISTORY_TOKEN_MAX_SIZE);
+				pParser->bExpectValue = TRUE;
+			}
+			else if (pParser->bInCandle)
+			{
+				HistoryCandleAppendChar(pParser, c);
+			}
+			break;
+
+		case ',':
+			if (pParser->nDepth == 1)
+				pParser->bExpectValue = FALSE;
+			else if (pParser->bInCandle)
+				HistoryCandleAppendChar(pParser, c);
+			break;
+
+		case '[':
+			pParser->nDepth++;
+			if (pParser->nDepth == 2 && pParser->bExpectValue && strcmp(pParser->szKey, "data") == 0)
+			{
+				pParser->bInData = TRUE;
+			}
+			if (pParser->nDepth == 2)
+				pParser->bExpectValue = FALSE;
+			if (pParser->bInCandle)
+				HistoryCandleAppendChar(pParser, c);
+			break;
+
+		case '{':
+			pParser->nDepth++;
+			if (pParser->nDepth == 2)
+				pParser->bExpectValue = FALSE;
+			if (pParser->bInData && pParser->nDepth == 3)
+			{
+				pParser->bInCandle = TRUE;
+				pParser->bCandleOverflow = FALSE;
+				pParser->nCandleLen = 0;
+			}
+			if (pParser->bInCandle)
+				HistoryCandleAppendChar(pParser, c);
+			break;
+
+		case '}':
+			if (pParser->bInCandle)
+			{
+				HistoryCandleAppendChar(pParser, c);
+				if (pParser->nDepth == 3)
+				{
+					// Candle complete - the market data tokenizer knows the same keys
+					pParser->bInCandle = FALSE;
+					pParser->nCandles++;
+					if (!pParser->bCandleOverflow)
+					{
+						MarketTick candle;
+						ParseMarketDataMessage(pParser->candle, pParser->nCandleLen, &candle);
+						if (candle.nFields & TICK_FIELD_TIMESTAMP)
+						{
+							AppendHistoryCandle(pCtx, &candle);
+						}
+					}
+				}
+			}
+			pParser->nDepth--;
+			break;
+
+		case ']':
+			if (pParser->bInCandle)
+				HistoryCandleAppendChar(pParser, c);
+			if (pParser->bInData && pParser->nDepth == 2)
+				pParser->bInData = FALSE;
+			pParser->nDepth--;
+			break;
+
+		default:
+			if (pParser->bInCandle)
+				HistoryCandleAppendChar(pParser, c);
+			break;
+		}
+	}
+}
+
@@ -0,0 +1,105 @@
+// HistoryResponse.h - Streaming parser and merge for /api/v1/history bodies
+//
+// No MFC: Plugin.cpp owns the HTTP request (RequestHistoryRange()) and feeds the
+// body through HistoryStreamParserFeed() chunk by chunk; candles are converted
+// and merged into AmiBroker's Quotation array here, so the Linux test build
+// (tests/) can check the merge against a reference and the parser against
+// responses split at every byte.
+#ifndef HISTORY_RESPONSE_H
+#define HISTORY_RESPONSE_H
+
+#include "OpenAlgoPortable.h"
+#include "Plugin.h"
+#include "Calendar.h"
+#include "MarketDataParser.h"
+
+#define HISTORY_CANDLE_MAX_SIZE  512    // Larger candle objects are skipped
+#define HISTORY_TOKEN_MAX_SIZE   32     // Top-level keys/values ("data", "status", "success")
+
+// Called with every candle of a response as it is converted (see HistoryMergeContext::pfnRecordBar)
+typedef void (*HistoryBarProc)(void* pContext, const struct Quotation* pBar);
+
+// Merge state for one history response
+struct HistoryMergeContext {
+	struct Quotation* pQuotes;
+	int nSize;
+	int nPeriodicity;
+	int nLastValid;          // Last existing bar (moves down if room has to be made)
+	int quoteIndex;          // Next free slot in pQuotes
+	int nRunStart;           // First candle not yet merged (pending run is nRunStart..quoteIndex-1)
+	BOOL bRunUnsorted;       // A candle in the pending run arrived out of time order
+	BOOL bHasExistingData;
+	BOOL bRoomChecked;       // Near-full check done (on the first candle only)
+	int duplicateCount;
+	int uniqueCount;
+	HistoryBarProc pfnRecordBar;  // Sees every converted candle, whatever room pQuotes has (or NULL)
+	void* pRecordContext;
+	PackedDateCache dateCache;  // Candles of one day share a date computation
+	int nUtcOffsetSeconds;      // Exchange local time (set by RequestHistoryRange())
+	struct Quotation* pScratch; // Overlapping tail of existing bars during MergeHistoryRun(), kept for the next merge
+	int nScratchSize;
+
+	HistoryMergeContext(struct Quotation* quotes, int size, int periodicity, int lastValid)
+		: pQuotes(quotes), nSize(size), nPeriodicity(periodicity), nLastValid(lastValid),
+		  quoteIndex(lastValid + 1), nRunStart(lastValid + 1), bRunUnsorted(FALSE),
+		  bHasExistingData(lastValid >= 0), bRoomChecked(FALSE),
+		  duplicateCount(0), uniqueCount(0), pfnRecordBar(NULL), pRecordContext(NULL),
+		  nUtcOffsetSeconds(GetExchangeUtcOffsetSeconds(NULL)), pScratch(NULL), nScratchSize(0) {
+	}
+
+	~HistoryMergeContext() {
+		delete[] pScratch;
+	}
+
+private:
+	HistoryMergeContext(const HistoryMergeContext&);             // Not copyable - owns pScratch
+	HistoryMergeContext& operator=(const HistoryMergeContext&);
+};
+
+struct HistoryStreamParser {
+	int nDepth;              // Current {/[ nesting depth (root object = 1)
+	BOOL bInString;
+	BOOL bEscape;
+	BOOL bExpectValue;       // A top-level key was read; its value comes next
+	BOOL bInData;            // Inside the top-level "data" array
+	BOOL bInCandle;          // Buffering a candle object
+	BOOL bCandleOverflow;
+	BOOL bStatusSuccess;     // Top-level "status":"success" seen
+	int nCandles;            // Candle objects completed
+	int nTokenLen;
+	int nCandleLen;
+	char szToken[HISTORY_TOKEN_MAX_SIZE];
+	char szKey[HISTORY_TOKEN_MAX_SIZE];
+	char candle[HISTORY_CANDLE_MAX_SIZE];
+
+	HistoryStreamParser() : nDepth(0), bInString(FALSE), bEscape(FALSE), bExpectValue(FALSE),
+	                        bInData(FALSE), bInCandle(FALSE), bCandleOverflow(FALSE),
+	                        bStatusSuccess(FALSE), nCandles(0), nTokenLen(0), nCandleLen(0) {
+		szToken[0] = '\0';
+		szKey[0] = '\0';
+	}
+};
+
+// Identity of a bar for duplicate detection (date, hour and minute)
+UINT32 HistoryBarKey(const struct Quotation* pQuote);
+
+// Before the first new bar is added: if the array is nearly full, drop the oldest bars
+void MakeHistoryRoom(HistoryMergeContext* pCtx);
+
+// Convert one candle and add it to the pending run
+void AppendHistoryCandle(HistoryMergeContext* pCtx, const MarketTick* pCandle);
+
+// Add one converted bar to the pending run (a repeat of the previous one replaces it)
+void AppendHistoryBar(HistoryMergeContext* pCtx, const struct Quotation* pBar);
+
+// Fold the pending run into the existing bars; afterwards pQuotes[0..quoteIndex-1]
+// is in time order with one bar per minute (intraday) or day (EOD)
+void MergeHistoryRun(HistoryMergeContext* pCtx);
+
+// Merge bars that are already converted, sorted and unique. Returns the new bar count.
+int MergeHistoryBars(struct Quotation* pQuotes, int nSize, int nPeriodicity, int nLastValid, const struct Quotation* pBars, int nBars);
+
+// Consume the next nLength bytes of the response body
+void HistoryStreamParserFeed(HistoryStreamParser* pParser, const char* pData, int nLength, HistoryMergeContext* pCtx);
+
+#endif // HISTORY_RESPONSE_H
@@ -0,0 +1,154 @@
+// HttpPool.cpp - Keep-alive connection pool and latency counters for the REST client
+#include "HttpPool.h"
+
+#include <string.h>
+
+void InitHttpConnectionPool(HttpConnectionPool* pPool, HttpPoolOpenProc pfnOpen, HttpPoolCloseProc pfnClose, void* pContext)
+{
+	InitializeCriticalSection(&pPool->lock);
+	pPool->nIdle = 0;
+	pPool->stats = HttpClientStats();
+	pPool->pfnOpen = pfnOpen;
+	pPool->pfnClose = pfnClose;
+	pPool->pContext = pContext;
+}
+
+void DeleteHttpConnectionPool(HttpConnectionPool* pPool)
+{
+	CloseIdleHttpConnections(pPool);
+	DeleteCriticalSection(&pPool->lock);
+}
+
+// Close idle connections to another server/port, idle for too long, or all of them.
+// Caller must hold pPool->lock.
+static void EvictIdleHttpConnections(HttpConnectionPool* pPool, LPCTSTR pszServer, UINT nPort, DWORD dwNow, BOOL bAll)
+{
+	int nKept = 0;
+	for (int i = 0; i < pPool->nIdle; i++)
+	{
+		PooledHttpConnection& entry = pPool->idle[i];
+		if (bAll || entry.nPort != nPort || _tcsicmp(entry.server, pszServer) != 0 ||
+			dwNow - entry.dwLastUsed > HTTP_POOL_IDLE_TIMEOUT_MS)
+		{
+			pPool->pfnClose(pPool->pContext, entry.pConnection);
+			continue;
+		}
+		if (nKept != i)
+			pPool->idle[nKept] = entry;
+		nKept++;
+	}
+	pPool->nIdle = nKept;
+}
+
+void CloseIdleHttpConnections(HttpConnectionPool* pPool)
+{
+	EnterCriticalSection(&pPool->lock);
+	EvictIdleHttpConnections(pPool, _T(""), 0, 0, TRUE);
+	LeaveCriticalSection(&pPool->lock);
+}
+
+void* AcquireHttpConnection(HttpConnectionPool* pPool, LPCTSTR pszServer, UINT nPort, DWORD dwNow, BOOL* pbReused)
+{
+	*pbReused = FALSE;
+	void* pConnection = NULL;
+
+	EnterCriticalSection(&pPool->lock);
+
+	EvictIdleHttpConnections(pPool, pszServer, nPort, dwNow, FALSE);
+
+	if (pPool->nIdle > 0)
+	{
+		pConnection = pPool->idle[--pPool->nIdle].pConnection;
+		pPool->stats.nConnectionsReused++;
+		*pbReused = TRUE;
+	}
+	else
+	{
+		pConnection = pPool->pfnOpen(pPool->pContext, pszServer, nPort);
+		if (pConnection != NULL)
+			pPool->stats.nConnectionsOpened++;
+	}
+
+	LeaveCriticalSection(&pPool->lock);
+
+	return pConnection;
+}
+
+void ReleaseHttpConnection(HttpConnectionPool* pPool, void* pConnection, LPCTSTR pszServer, UINT nPort, DWORD dwNow, BOOL bKeepConnection)
+{
+	if (pConnection == NULL)
+		return;
+
+	size_t nServerLength = _tcslen(pszServer);
+	if (bKeepConnection && nServerLength < HTTP_POOL_SERVER_SIZE)
+	{
+		EnterCriticalSection(&pPool->lock);
+		if (pPool->nIdle < HTTP_POOL_MAX_IDLE)
+		{
+			PooledHttpConnection& entry = pPool->idle[pPool->nIdle++];
+			entry.pConnection = pConnection;
+			memcpy(entry.server, pszServer, (nServerLength + 1) * sizeof(TCHAR));
+			entry.nPort = nPort;
+			entry.dwLastUsed = dwNow;
+			pConnection = NULL;
+		}
+		LeaveCriticalSection(&pPool->lock);
+	}
+
+	if (pConnection != NULL)
+		pPool->pfnClose(pPool->pContext, pConnection);
+}
+
+void* SendOnHttpConnection(HttpConnectionPool* pPool, LPCTSTR pszServer, UINT nPort, DWORD dwNow,
+	HttpPoolSendProc pfnSend, void* pRequest, BOOL* pbReused)
+{
+	for (int nAttempt = 0; nAttempt < 2; nAttempt++)
+	{
+		void* pConnection = AcquireHttpConnection(pPool, pszServer, nPort, dwNow, pbReused);
+		if (pConnection == NULL)
+			return NULL;
+
+		if (pfnSend(pRequest, pConnection))
+			return pConnection;
+
+		// Drop the failed connection instead of pooling it
+		ReleaseHttpConnection(pPool, pConnection, pszServer, nPort, dwNow, FALSE);
+		if (!*pbReused)
+			break;
+
+		// A dead idle connection usually means the server dropped all of them
+		// (restart, idle timeout): the retry goes out on a new one
+		CloseIdleHttpConnections(pPool);
+	}
+	return NULL;
+}
+
+BOOL RecordHttpRequest(HttpConnectionPool* pPool, __int64 nLatencyUs, BOOL bFailed, HttpClientStats* pSummary)
+{
+	BOOL bSummary = FALSE;
+
+	EnterCriticalSection(&pPool->lock);
+	HttpClientStats& stats = pPool->stats;
+	stats.nRequests++;
+	if (bFailed)
+		stats.nFailures++;
+	stats.nTotalLatencyUs += nLatencyUs;
+	stats.nLastLatencyUs = nLatencyUs;
+	if (nLatencyUs > stats.nMaxLatencyUs)
+		stats.nMaxLatencyUs = nLatencyUs;
+	if (stats.nRequests % HTTP_STATS_LOG_INTERVAL == 0)
+	{
+		*pSummary = stats;
+		bSummary = TRUE;
+	}
+	LeaveCriticalSection(&pPool->lock);
+
+	return bSummary;
+}
+
+void GetHttpPoolStats(HttpConnectionPool* pPool, HttpClientStats* pStats)
+{
+	EnterCriticalSection(&pPool->lock);
+	*pStats = pPool->stats;
+	LeaveCriticalSection(&pPool->lock);
+}
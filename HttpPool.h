@@ -0,0 +1,87 @@
+// HttpPool.h - Keep-alive connection pool and latency counters for the REST client
+//
+// No WinInet: Plugin.cpp opens, sends on and closes the CHttpConnection handles
+// (see "OpenAlgo HTTP Client"); which idle connection a request reuses, when one
+// is evicted, the retry-once rule and the latency counters live here, so the
+// Linux test build (tests/) can run them against a local stand-in server.
+#ifndef HTTP_POOL_H
+#define HTTP_POOL_H
+
+#include "OpenAlgoPortable.h"
+
+#define HTTP_POOL_MAX_IDLE         8      // Idle connections kept open at most
+#define HTTP_POOL_IDLE_TIMEOUT_MS  60000  // Close connections idle for longer than this
+#define HTTP_POOL_SERVER_SIZE      256    // Connections to longer host names are not pooled
+#define HTTP_STATS_LOG_INTERVAL    100    // RecordHttpRequest() hands back a summary every N requests
+
+// Open a connection to the server (NULL on failure); called with the pool lock held
+typedef void* (*HttpPoolOpenProc)(void* pContext, LPCTSTR pszServer, UINT nPort);
+
+// Close a connection from HttpPoolOpenProc
+typedef void (*HttpPoolCloseProc)(void* pContext, void* pConnection);
+
+// Send one request on pConnection; FALSE if it failed (after closing any response handle)
+typedef BOOL (*HttpPoolSendProc)(void* pRequest, void* pConnection);
+
+// Per-request latency, measured by the caller from sending to finishing the response
+struct HttpClientStats {
+	LONG nRequests;
+	LONG nFailures;
+	LONG nConnectionsOpened;
+	LONG nConnectionsReused;
+	__int64 nTotalLatencyUs;
+	__int64 nMaxLatencyUs;
+	__int64 nLastLatencyUs;
+
+	HttpClientStats() : nRequests(0), nFailures(0), nConnectionsOpened(0), nConnectionsReused(0),
+	                    nTotalLatencyUs(0), nMaxLatencyUs(0), nLastLatencyUs(0) {
+	}
+};
+
+struct PooledHttpConnection {
+	void* pConnection;
+	TCHAR server[HTTP_POOL_SERVER_SIZE];
+	UINT nPort;
+	DWORD dwLastUsed;        // Tick count when returned to the pool
+};
+
+struct HttpConnectionPool {
+	CRITICAL_SECTION lock;   // Guards the idle list and the stats
+	PooledHttpConnection idle[HTTP_POOL_MAX_IDLE];  // Least recently used first
+	int nIdle;
+	HttpClientStats stats;
+	HttpPoolOpenProc pfnOpen;
+	HttpPoolCloseProc pfnClose;
+	void* pContext;          // Passed to pfnOpen/pfnClose
+};
+
+void InitHttpConnectionPool(HttpConnectionPool* pPool, HttpPoolOpenProc pfnOpen, HttpPoolCloseProc pfnClose, void* pContext);
+
+// Close every idle connection and delete the lock
+void DeleteHttpConnectionPool(HttpConnectionPool* pPool);
+
+// Close every idle connection
+void CloseIdleHttpConnections(HttpConnectionPool* pPool);
+
+// Take the most recently used idle connection to server:port, or open a new one.
+// Idle connections to another server/port or idle for too long are closed first.
+void* AcquireHttpConnection(HttpConnectionPool* pPool, LPCTSTR pszServer, UINT nPort, DWORD dwNow, BOOL* pbReused);
+
+// Return a connection to the idle pool, or close it if it failed or the pool is full
+void ReleaseHttpConnection(HttpConnectionPool* pPool, void* pConnection, LPCTSTR pszServer, UINT nPort, DWORD dwNow, BOOL bKeepConnection);
+
+// Send a request on a pooled connection. The server may have closed an idle
+// connection: a request that fails on a reused one is retried once on a new one.
+// Returns the connection the request went out on (release it when the response
+// is read), or NULL if it failed.
+void* SendOnHttpConnection(HttpConnectionPool* pPool, LPCTSTR pszServer, UINT nPort, DWORD dwNow,
+	HttpPoolSendProc pfnSend, void* pRequest, BOOL* pbReused);
+
+// Count one finished request. Every HTTP_STATS_LOG_INTERVAL requests returns TRUE
+// with a copy of the counters in *pSummary, for the caller to log.
+BOOL RecordHttpRequest(HttpConnectionPool* pPool, __int64 nLatencyUs, BOOL bFailed, HttpClientStats* pSummary);
+
+// Consistent copy of the counters
+void GetHttpPoolStats(HttpConnectionPool* pPool, HttpClientStats* pStats);
+
+#endif // HTTP_POOL_H
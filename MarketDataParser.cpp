@@ -0,0 +1,547 @@
+// MarketDataParser.cpp - Tokenizer and locale-independent number parsing for market data
+#include "MarketDataParser.h"
+#include "Calendar.h"
+
+#include <locale.h>
+#include <stdlib.h>
+#include <string.h>
+
+///////////////////////////////
+// Number Parsing
+///////////////////////////////
+//
+// Prices, volumes and OI arrive as plain JSON numbers ("1424.05", "123456",
+// occasionally "1.5e-05"). atof/_tstof depend on the C runtime locale (a ','
+// decimal separator breaks them) and need a NUL-terminated copy. The parser
+// below reads the digits straight from the buffer into a 64-bit mantissa and a
+// power-of-ten exponent. If both are small enough, the result is exact after one
+// IEEE multiply or divide (Clinger's fast path), which covers every shape
+// OpenAlgo sends. Anything else (more than 19 significant digits, large
+// exponents, inexact digits) falls back to strtod/strtof in the "C" locale, so
+// the result always matches the C library bit for bit.
+
+static const double s_dPow10[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static const float s_fPow10[] = {
+	1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f
+};
+
+// Split a decimal number into sign, mantissa and base-10 exponent.
+// Stops at the first character that cannot continue the number (like atof).
+// Returns FALSE if there are no digits; *pbExact is FALSE if digits were dropped.
+BOOL ScanDecimal(const char* p, int nLen, BOOL* pbNegative, UINT64* pnMantissa, int* pnExp10, BOOL* pbExact)
+{
+	const char* pEnd = p + nLen;
+	UINT64 nMantissa = 0;
+	int nExp10 = 0;
+	int nDigits = 0;        // Significant digits kept in nMantissa
+	BOOL bAnyDigit = FALSE;
+	BOOL bExact = TRUE;
+
+	while (p < pEnd && (*p == ' ' || *p == '\t'))
+		p++;
+
+	BOOL bNegative = FALSE;
+	if (p < pEnd && (*p == '-' || *p == '+'))
+	{
+		bNegative = (*p == '-');
+		p++;
+	}
+
+	// Integer part
+	while (p < pEnd && *p >= '0' && *p <= '9')
+	{
+		bAnyDigit = TRUE;
+		if (nDigits < 19)
+		{
+			if (nMantissa != 0 || *p != '0')
+			{
+				nMantissa = nMantissa * 10 + (UINT64)(*p - '0');
+				nDigits++;
+			}
+		}
+		else
+		{
+			nExp10++;  // Digit dropped, keep the magnitude
+			if (*p != '0')
+				bExact = FALSE;
+		}
+		p++;
+	}
+
+	// Fraction part
+	if (p < pEnd && *p == '.')
+	{
+		p++;
+		while (p < pEnd && *p >= '0' && *p <= '9')
+		{
+			bAnyDigit = TRUE;
+			if (nDigits < 19)
+			{
+				if (nMantissa != 0 || *p != '0')
+					nDigits++;
+				nMantissa = nMantissa * 10 + (UINT64)(*p - '0');
+				nExp10--;
+			}
+			else if (*p != '0')
+			{
+				bExact = FALSE;
+			}
+			p++;
+		}
+	}
+
+	if (!bAnyDigit)
+		return FALSE;
+
+	// Exponent
+	if (p < pEnd && (*p == 'e' || *p == 'E'))
+	{
+		const char* pExp = p + 1;
+		BOOL bExpNegative = FALSE;
+		if (pExp < pEnd && (*pExp == '-' || *pExp == '+'))
+		{
+			bExpNegative = (*pExp == '-');
+			pExp++;
+		}
+		if (pExp < pEnd && *pExp >= '0' && *pExp <= '9')
+		{
+			int nExp = 0;
+			while (pExp < pEnd && *pExp >= '0' && *pExp <= '9')
+			{
+				if (nExp < 10000)
+					nExp = nExp * 10 + (*pExp - '0');
+				pExp++;
+			}
+			nExp10 += bExpNegative ? -nExp : nExp;
+		}
+	}
+
+	*pbNegative = bNegative;
+	*pnMantissa = nMantissa;
+	*pnExp10 = nExp10;
+	*pbExact = bExact;
+	return TRUE;
+}
+
+// The "C" locale for strtod/strtof, whatever locale the calling thread runs in
+#ifdef _WIN32
+#define strtod_l _strtod_l
+#define strtof_l _strtof_l
+static _locale_t GetCLocale(void)
+{
+	static _locale_t s_cLocale = _create_locale(LC_NUMERIC, "C");
+	return s_cLocale;
+}
+#else
+static locale_t GetCLocale(void)
+{
+	static locale_t s_cLocale = newlocale(LC_NUMERIC_MASK, "C", (locale_t)0);
+	return s_cLocale;
+}
+#endif
+
+// Slow path: strtod (or strtof, bFloat) on a NUL-terminated copy. Numbers longer
+// than the stack buffer are copied to the heap - truncating them would change their value.
+static double ParseDecimalFallback(const char* pSrc, int nLen, BOOL bFloat)
+{
+	char buf[64];
+	char* pText = buf;
+	if (nLen >= (int)sizeof(buf))
+	{
+		pText = (char*)malloc(nLen + 1);
+		if (pText == NULL)
+			return 0.0;
+	}
+	memcpy(pText, pSrc, nLen);
+	pText[nLen] = '\0';
+
+	// A float result converts to double exactly, so the caller's cast back is lossless
+	double d = bFloat ? (double)strtof_l(pText, NULL, GetCLocale()) : strtod_l(pText, NULL, GetCLocale());
+
+	if (pText != buf)
+		free(pText);
+	return d;
+}
+
+double ParseDecimalDouble(const char* pSrc, int nLen)
+{
+	BOOL bNegative, bExact;
+	UINT64 nMantissa;
+	int nExp10;
+
+	if (!ScanDecimal(pSrc, nLen, &bNegative, &nMantissa, &nExp10, &bExact))
+		return 0.0;
+
+	if (nMantissa == 0)
+		return bNegative ? -0.0 : 0.0;
+
+	// Mantissa and power of ten are both exact doubles - one correctly rounded operation
+	if (bExact && nMantissa <= ((UINT64)1 << 53) && nExp10 >= -22 && nExp10 <= 22)
+	{
+		double d = (double)nMantissa;
+		d = (nExp10 >= 0) ? d * s_dPow10[nExp10] : d / s_dPow10[-nExp10];
+		return bNegative ? -d : d;
+	}
+
+	return ParseDecimalFallback(pSrc, nLen, FALSE);
+}
+
+float ParseDecimalFloat(const char* pSrc, int nLen)
+{
+	BOOL bNegative, bExact;
+	UINT64 nMantissa;
+	int nExp10;
+
+	if (!ScanDecimal(pSrc, nLen, &bNegative, &nMantissa, &nExp10, &bExact))
+		return 0.0f;
+
+	if (nMantissa == 0)
+		return bNegative ? -0.0f : 0.0f;
+
+	// Same fast path in single precision (exact float mantissa and power of ten)
+	if (bExact && nMantissa <= ((UINT64)1 << 24) && nExp10 >= -10 && nExp10 <= 10)
+	{
+		float f = (float)nMantissa;
+		f = (nExp10 >= 0) ? f * s_fPow10[nExp10] : f / s_fPow10[-nExp10];
+		return bNegative ? -f : f;
+	}
+
+	// Not via ParseDecimalDouble(): rounding to double and then to float can be off by one ulp
+	return (float)ParseDecimalFallback(pSrc, nLen, TRUE);
+}
+
+///////////////////////////////
+// Market Data Tokenizer
+///////////////////////////////
+//
+// One pass over the frame bytes. The keys we use are matched by length + memcmp
+// and copied into the fixed-size MarketTick. Fields are taken only from the
+// top-level object and from its "data" object (OpenAlgo nests the quote there);
+// every other object or array - market depth levels, metadata, candle lists -
+// is skipped as a whole, so a "ltp" or "symbol" nested in it never overwrites
+// the real one. The history parser and the multiquotes loop pass one candle or
+// one result object at a time, which makes that object the top level.
+
+#define TICK_KEY_IS(pKey, nKeyLen, literal) \
+	((nKeyLen) == (int)(sizeof(literal) - 1) && memcmp((pKey), (literal), sizeof(literal) - 1) == 0)
+
+static void CopyTickString(char* pDest, int nDestSize, const char* pSrc, int nLen)
+{
+	if (nLen >= nDestSize)
+		nLen = nDestSize - 1;  // Truncate, never overflow
+	memcpy(pDest, pSrc, nLen);
+	pDest[nLen] = '\0';
+}
+
+// p is at '{' or '['; returns the byte after the matching close (or pEnd)
+static const char* SkipJsonContainer(const char* p, const char* pEnd)
+{
+	int nDepth = 0;
+	while (p < pEnd)
+	{
+		char c = *p++;
+		if (c == '"')
+		{
+			while (p < pEnd && *p != '"')
+			{
+				if (*p == '\\' && p + 1 < pEnd)
+					p++;  // Skip escaped character
+				p++;
+			}
+			if (p < pEnd)
+				p++;  // Closing quote
+		}
+		else if (c == '{' || c == '[')
+		{
+			nDepth++;
+		}
+		else if (c == '}' || c == ']')
+		{
+			if (--nDepth == 0)
+				break;
+		}
+	}
+	return p;
+}
+
+// Returns WS_MSG_MARKET_DATA, WS_MSG_SUBSCRIBE_ACK or WS_MSG_OTHER.
+// pTick is always reset; for market data it holds every recognised field.
+int ParseMarketDataMessage(const char* pData, int nLength, MarketTick* pTick)
+{
+	memset(pTick, 0, sizeof(MarketTick));
+
+	int nMessageType = WS_MSG_OTHER;
+	const char* p = pData;
+	const char* pEnd = pData + nLength;
+	int nDepth = 0;           // Containers open at p
+	BOOL bInData = FALSE;     // Inside the top-level "data" object (depth 2)
+
+	while (p < pEnd)
+	{
+		char c = *p;
+		if (c == '{' || c == '[')
+		{
+			nDepth++;
+			p++;
+			continue;
+		}
+		if (c == '}' || c == ']')
+		{
+			if (nDepth == 2)
+				bInData = FALSE;
+			nDepth--;
+			p++;
+			continue;
+		}
+		if (c != '"')
+		{
+			// Separators, whitespace and bare array values
+			p++;
+			continue;
+		}
+
+		// String token - may be a key or a string value inside an array
+		const char* pKey = ++p;
+		while (p < pEnd && *p != '"')
+		{
+			if (*p == '\\' && p + 1 < pEnd)
+				p++;  // Skip escaped character
+			p++;
+		}
+		int nKeyLen = (int)(p - pKey);
+		if (p < pEnd)
+			p++;  // Closing quote
+
+		while (p < pEnd && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+			p++;
+		if (p >= pEnd || *p != ':')
+			continue;  // Not a key
+		p++;
+		while (p < pEnd && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+			p++;
+		if (p >= pEnd)
+			break;
+
+		if (*p == '{' || *p == '[')
+		{
+			// Descend only into the top-level "data" object
+			if (nDepth == 1 && *p == '{' && TICK_KEY_IS(pKey, nKeyLen, "data"))
+				bInData = TRUE;
+			else
+				p = SkipJsonContainer(p, pEnd);
+			continue;
+		}
+
+		// Scalar value: quoted string or bare number/literal
+		const char* pValue;
+		int nValueLen;
+		if (*p == '"')
+		{
+			pValue = ++p;
+			while (p < pEnd && *p != '"')
+			{
+				if (*p == '\\' && p + 1 < pEnd)
+					p++;
+				p++;
+			}
+			nValueLen = (int)(p - pValue);
+			if (p < pEnd)
+				p++;
+		}
+		else
+		{
+			pValue = p;
+			while (p < pEnd && *p != ',' && *p != '}' && *p != ']' &&
+				*p != ' ' && *p != '\t' && *p != '\r' && *p != '\n')
+				p++;
+			nValueLen = (int)(p - pValue);
+		}
+
+		// Keys of a top-level array's elements (not a shape OpenAlgo sends)
+		if (nDepth != 1 && !bInData)
+			continue;
+
+		// Match the key; most frequent fields first
+		if (TICK_KEY_IS(pKey, nKeyLen, "ltp"))
+		{
+			pTick->ltp = ParseDecimalFloat(pValue, nValueLen);
+			pTick->nFields |= TICK_FIELD_LTP;
+		}
+		else if (TICK_KEY_IS(pKey, nKeyLen, "symbol"))
+		{
+			CopyTickString(pTick->symbol, TICK_SYMBOL_SIZE, pValue, nValueLen);
+			pTick->nFields |= TICK_FIELD_SYMBOL;
+		}
+		else if (TICK_KEY_IS(pKey, nKeyLen, "exchange"))
+		{
+			CopyTickString(pTick->exchange, TICK_EXCHANGE_SIZE, pValue, nValueLen);
+			pTick->nFields |= TICK_FIELD_EXCHANGE;
+		}
+		else if (TICK_KEY_IS(pKey, nKeyLen, "last_trade_quantity"))
+		{
+			pTick->lastTradeQty = ParseDecimalFloat(pValue, nValueLen);
+			pTick->nFields |= TICK_FIELD_LAST_TRADE_QTY;
+		}
+		else if (TICK_KEY_IS(pKey, nKeyLen, "timestamp"))
+		{
+			CopyTickString(pTick->timestamp, TICK_TIMESTAMP_SIZE, pValue, nValueLen);
+			pTick->nFields |= TICK_FIELD_TIMESTAMP;
+		}
+		else if (TICK_KEY_IS(pKey, nKeyLen, "volume"))
+		{
+			pTick->volume = ParseDecimalFloat(pValue, nValueLen);
+			pTick->nFields |= TICK_FIELD_VOLUME;
+		}
+		else if (TICK_KEY_IS(pKey, nKeyLen, "oi"))
+		{
+			pTick->oi = ParseDecimalFloat(pValue, nValueLen);
+			pTick->nFields |= TICK_FIELD_OI;
+		}
+		else if (TICK_KEY_IS(pKey, nKeyLen, "open"))
+		{
+			pTick->open = ParseDecimalFloat(pValue, nValueLen);
+			pTick->nFields |= TICK_FIELD_OPEN;
+		}
+		else if (TICK_KEY_IS(pKey, nKeyLen, "high"))
+		{
+			pTick->high = ParseDecimalFloat(pValue, nValueLen);
+			pTick->nFields |= TICK_FIELD_HIGH;
+		}
+		else if (TICK_KEY_IS(pKey, nKeyLen, "low"))
+		{
+			pTick->low = ParseDecimalFloat(pValue, nValueLen);
+			pTick->nFields |= TICK_FIELD_LOW;
+		}
+		else if (TICK_KEY_IS(pKey, nKeyLen, "close"))
+		{
+			pTick->close = ParseDecimalFloat(pValue, nValueLen);
+			pTick->nFields |= TICK_FIELD_CLOSE;
+		}
+		else if (TICK_KEY_IS(pKey, nKeyLen, "prev_close"))
+		{
+			pTick->prevClose = ParseDecimalFloat(pValue, nValueLen);
+			pTick->nFields |= TICK_FIELD_PREV_CLOSE;
+		}
+		else if (TICK_KEY_IS(pKey, nKeyLen, "bid") || TICK_KEY_IS(pKey, nKeyLen, "bid_price"))
+		{
+			pTick->bid = ParseDecimalFloat(pValue, nValueLen);
+			pTick->nFields |= TICK_FIELD_BID;
+		}
+		else if (TICK_KEY_IS(pKey, nKeyLen, "ask") || TICK_KEY_IS(pKey, nKeyLen, "ask_price"))
+		{
+			pTick->ask = ParseDecimalFloat(pValue, nValueLen);
+			pTick->nFields |= TICK_FIELD_ASK;
+		}
+		else if (TICK_KEY_IS(pKey, nKeyLen, "type") && nDepth == 1)
+		{
+			if (TICK_KEY_IS(pValue, nValueLen, "market_data"))
+				nMessageType = WS_MSG_MARKET_DATA;
+			else if (TICK_KEY_IS(pValue, nValueLen, "subscribe"))
+				nMessageType = WS_MSG_SUBSCRIBE_ACK;
+		}
+	}
+
+	// Servers that omit "type" still send a recognisable quote
+	if (nMessageType == WS_MSG_OTHER &&
+		(pTick->nFields & (TICK_FIELD_SYMBOL | TICK_FIELD_LTP)) == (TICK_FIELD_SYMBOL | TICK_FIELD_LTP))
+	{
+		nMessageType = WS_MSG_MARKET_DATA;
+	}
+
+	return nMessageType;
+}
+
+///////////////////////////////
+// Tick Timestamps
+///////////////////////////////
+//
+// OpenAlgo stamps ticks with Unix milliseconds ("1761157800000"); some feeds
+// send ISO 8601 instead ("2025-05-28T10:30:45.123Z", "...+05:30"). Both are
+// read straight from the char[] in MarketTick. ISO times without a zone
+// designator are taken as UTC, like the numeric form.
+
+// Exactly nCount digits at *pp; advances past them
+static BOOL ReadDigits(const char** pp, int nCount, int* pnValue)
+{
+	const char* p = *pp;
+	int nValue = 0;
+	for (int i = 0; i < nCount; i++)
+	{
+		if (p[i] < '0' || p[i] > '9')
+			return FALSE;
+		nValue = nValue * 10 + (p[i] - '0');
+	}
+	*pp = p + nCount;
+	*pnValue = nValue;
+	return TRUE;
+}
+
+INT64 ParseTickTimestamp(const char* pszTimestamp)
+{
+	const char* p = pszTimestamp;
+	while (*p == ' ' || *p == '\t')
+		p++;
+
+	// Numeric: milliseconds, or seconds if too small to be a millisecond time after 1973
+	const char* pDigits = p;
+	INT64 nNumber = 0;
+	while (*p >= '0' && *p <= '9' && p - pDigits < 18)
+		nNumber = nNumber * 10 + (*p++ - '0');
+	if (p > pDigits && (*p == '\0' || *p == ' ' || *p == '.'))
+		return (nNumber >= 100000000000LL) ? nNumber / 1000 : nNumber;
+
+	// ISO 8601: YYYY-MM-DD[T ]HH:MM:SS[.fraction][Z|+HH:MM|-HH:MM]
+	p = pDigits;
+	int nYear, nMonth, nDay, nHour, nMinute, nSecond;
+	if (!ReadDigits(&p, 4, &nYear) || *p++ != '-' ||
+		!ReadDigits(&p, 2, &nMonth) || *p++ != '-' ||
+		!ReadDigits(&p, 2, &nDay) || (*p != 'T' && *p != ' '))
+	{
+		return -1;
+	}
+	p++;
+	if (!ReadDigits(&p, 2, &nHour) || *p++ != ':' ||
+		!ReadDigits(&p, 2, &nMinute) || *p++ != ':' ||
+		!ReadDigits(&p, 2, &nSecond))
+	{
+		return -1;
+	}
+	if (nMonth < 1 || nMonth > 12 || nDay < 1 || nDay > 31 ||
+		nHour > 23 || nMinute > 59 || nSecond > 60)
+	{
+		return -1;
+	}
+	if (*p == '.')
+	{
+		p++;
+		while (*p >= '0' && *p <= '9')
+			p++;
+	}
+
+	int nOffsetMinutes = 0;
+	if (*p == '+' || *p == '-')
+	{
+		int nSign = (*p++ == '-') ? -1 : 1;
+		int nOffsetHour, nOffsetMinute = 0;
+		if (!ReadDigits(&p, 2, &nOffsetHour))
+			return -1;
+		if (*p == ':')
+			p++;
+		if (*p >= '0' && *p <= '9' && !ReadDigits(&p, 2, &nOffsetMinute))
+			return -1;
+		nOffsetMinutes = nSign * (nOffsetHour * 60 + nOffsetMinute);
+	}
+	else if (*p == 'Z')
+	{
+		p++;
+	}
+	if (*p != '\0')
+		return -1;
+
+	return DaysFromCivil(nYear, nMonth, nDay) * 86400 +
+		nHour * 3600 + nMinute * 60 + nSecond - nOffsetMinutes * 60;
+}
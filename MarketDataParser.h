@@ -0,0 +1,69 @@
+// MarketDataParser.h - Tokenizer and locale-independent number parsing for market data
+//
+// No MFC: Plugin.cpp parses WebSocket ticks and REST responses with these, and
+// the Linux test build (tests/) checks them against the C library.
+#ifndef MARKET_DATA_PARSER_H
+#define MARKET_DATA_PARSER_H
+
+#include "OpenAlgoPortable.h"
+
+// Split a decimal number into sign, mantissa and base-10 exponent (see "Number Parsing")
+BOOL ScanDecimal(const char* p, int nLen, BOOL* pbNegative, UINT64* pnMantissa, int* pnExp10, BOOL* pbExact);
+
+// Parse nLen bytes (no NUL needed) like strtod/strtof in the "C" locale; 0 if there are no digits
+double ParseDecimalDouble(const char* pSrc, int nLen);
+float ParseDecimalFloat(const char* pSrc, int nLen);
+
+// One market_data message, filled by ParseMarketDataMessage() straight from the
+// UTF-8 frame bytes. Fixed-size so that parsing a tick never touches the heap.
+#define TICK_SYMBOL_SIZE    64
+#define TICK_EXCHANGE_SIZE  16
+#define TICK_TIMESTAMP_SIZE 40
+
+// MarketTick::nFields bits - set for every field present in the message
+#define TICK_FIELD_SYMBOL         (1 << 0)
+#define TICK_FIELD_EXCHANGE       (1 << 1)
+#define TICK_FIELD_LTP            (1 << 2)
+#define TICK_FIELD_LAST_TRADE_QTY (1 << 3)
+#define TICK_FIELD_TIMESTAMP      (1 << 4)
+#define TICK_FIELD_VOLUME         (1 << 5)
+#define TICK_FIELD_OI             (1 << 6)
+#define TICK_FIELD_OPEN           (1 << 7)
+#define TICK_FIELD_HIGH           (1 << 8)
+#define TICK_FIELD_LOW            (1 << 9)
+#define TICK_FIELD_CLOSE          (1 << 10)
+#define TICK_FIELD_PREV_CLOSE     (1 << 11)
+#define TICK_FIELD_BID            (1 << 12)
+#define TICK_FIELD_ASK            (1 << 13)
+
+// Results of ParseMarketDataMessage()
+#define WS_MSG_OTHER           0
+#define WS_MSG_MARKET_DATA     1
+#define WS_MSG_SUBSCRIBE_ACK   2
+
+struct MarketTick {
+	char symbol[TICK_SYMBOL_SIZE];
+	char exchange[TICK_EXCHANGE_SIZE];
+	char timestamp[TICK_TIMESTAMP_SIZE];  // Raw text: Unix milliseconds or ISO 8601
+	float ltp;
+	float lastTradeQty;
+	float volume;
+	float oi;
+	float open;
+	float high;
+	float low;
+	float close;
+	float prevClose;
+	float bid;
+	float ask;
+	DWORD nFields;
+};
+
+// Tokenize one JSON object (see "Market Data Tokenizer"); fields come only from
+// the top-level object and its "data" object
+int ParseMarketDataMessage(const char* pData, int nLength, MarketTick* pTick);
+
+// MarketTick::timestamp as Unix seconds (UTC); -1 if it is not a timestamp
+INT64 ParseTickTimestamp(const char* pszTimestamp);
+
+#endif // MARKET_DATA_PARSER_H
@@ -608,10 +608,13 @@ BOOL COpenAlgoConfigDlg::SendWebSocketFrame(SOCKET sock, const CString& message)
 	frameLen += 4;
 	
 	// Masked payload
-	for (int i = 0; i < messageLen; i++)
+	if (frameLen + messageLen > (int)sizeof(frame))
 	{
-		frame[frameLen++] = messageA[i] ^ maskKey[i % 4];
+		return FALSE; // Message too long for the test buffer
 	}
+	memcpy(&frame[frameLen], (LPCSTR)messageA, messageLen);
+	WebSocketMaskPayload(&frame[frameLen], messageLen, maskKey);
+	frameLen += messageLen;
 	
 	// Send the frame
 	int sent = send(sock, (char*)frame, frameLen, 0);
@@ -662,16 +665,10 @@ CString COpenAlgoConfigDlg::DecodeWebSocketFrame(const char* buffer, int length)
 		CStringA payloadA;
 		char* payloadBuffer = payloadA.GetBuffer(payloadLen + 1);
 		
-		for (int i = 0; i < payloadLen; i++)
+		memcpy(payloadBuffer, &buffer[pos], payloadLen);
+		if (masked)
 		{
-			if (masked)
-			{
-				payloadBuffer[i] = buffer[pos + i] ^ maskKey[i % 4];
-			}
-			else
-			{
-				payloadBuffer[i] = buffer[pos + i];
-			}
+			WebSocketMaskPayload((unsigned char*)payloadBuffer, payloadLen, maskKey);
 		}
 		payloadBuffer[payloadLen] = '\0';
 		payloadA.ReleaseBuffer(payloadLen);
@@ -42,6 +42,7 @@ extern const DWORD HTTP_CACHE_LIFETIME_MS;  // How long to cache HTTP responses
 // Global function declarations
 CString GetAvailableSymbols(void);
 CString BuildOpenAlgoURL(const CString& server, int port, const CString& endpoint);
+void WebSocketMaskPayload(unsigned char* pData, int nLength, const unsigned char* maskKey);  // RFC 6455 mask/unmask in place
 // AddToOpenAlgoPortfolio is internal to Plugin.cpp, not needed here
 
 #endif // OPENALGO_GLOBALS_H
\ No newline at end of file
@@ -0,0 +1,144 @@
+// OpenAlgoPortable.h - Win32 names used by the MFC-free parts of the plugin
+//
+// WebSocketFrame.cpp and the other engine files only need a few Win32
+// types, interlocked operations and critical sections. On Windows they come
+// from <windows.h>; the Linux test build (tests/CMakeLists.txt) gets the same
+// names from GCC/Clang builtins and pthreads, so the engine compiles unchanged
+// on both.
+#ifndef OPENALGO_PORTABLE_H
+#define OPENALGO_PORTABLE_H
+
+#ifdef _WIN32
+
+#include <windows.h>
+#include <tchar.h>
+
+#else // !_WIN32
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <pthread.h>
+#include <sched.h>
+#include <type_traits>
+
+#define __int64 long long
+#define __declspec(x)
+#define __stdcall
+
+typedef int BOOL;
+typedef int32_t LONG;
+typedef uint32_t ULONG;
+typedef uint32_t DWORD;
+typedef unsigned int UINT;
+typedef int32_t INT32;
+typedef uint32_t UINT32;
+typedef uint64_t UINT64;
+typedef int64_t INT64;
+typedef intptr_t INT_PTR;
+typedef uintptr_t UINT_PTR;
+typedef unsigned char BYTE;
+typedef char TCHAR;
+typedef unsigned char _TUCHAR;
+typedef const char* LPCTSTR;
+typedef void* PVOID;
+typedef void* HWND;
+typedef DWORD COLORREF;
+typedef int SOCKET;
+
+#define INVALID_SOCKET (-1)
+
+#ifndef TRUE
+#define TRUE 1
+#endif
+#ifndef FALSE
+#define FALSE 0
+#endif
+
+#define _T(x) x
+#define _I64_MIN INT64_MIN
+#define _atoi64(s) atoll(s)
+#define _tcslen strlen
+#define _tcsicmp strcasecmp
+#define _tcscmp strcmp
+
+// <windows.h> has min/max macros; functions here, so the C++ library headers still compile
+template <typename A, typename B>
+static inline typename std::common_type<A, B>::type max(A a, B b)
+{
+	return (a > b) ? a : b;
+}
+
+template <typename A, typename B>
+static inline typename std::common_type<A, B>::type min(A a, B b)
+{
+	return (a < b) ? a : b;
+}
+
+// Interlocked operations are full barriers on Windows; use sequentially consistent builtins
+static inline LONG InterlockedCompareExchange(volatile LONG* pTarget, LONG nExchange, LONG nComparand)
+{
+	__atomic_compare_exchange_n(pTarget, &nComparand, nExchange, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+	return nComparand;
+}
+
+static inline LONG InterlockedExchange(volatile LONG* pTarget, LONG nValue)
+{
+	return __atomic_exchange_n(pTarget, nValue, __ATOMIC_SEQ_CST);
+}
+
+static inline PVOID InterlockedExchangePointer(PVOID volatile* pTarget, PVOID pValue)
+{
+	return __atomic_exchange_n(pTarget, pValue, __ATOMIC_SEQ_CST);
+}
+
+static inline LONG InterlockedIncrement(volatile LONG* pTarget)
+{
+	return __atomic_add_fetch(pTarget, 1, __ATOMIC_SEQ_CST);
+}
+
+static inline LONG InterlockedDecrement(volatile LONG* pTarget)
+{
+	return __atomic_sub_fetch(pTarget, 1, __ATOMIC_SEQ_CST);
+}
+
+static inline LONG InterlockedExchangeAdd(volatile LONG* pTarget, LONG nValue)
+{
+	return __atomic_fetch_add(pTarget, nValue, __ATOMIC_SEQ_CST);
+}
+
+// Critical sections are recursive on Windows, so the mutex is too
+typedef pthread_mutex_t CRITICAL_SECTION;
+
+static inline void InitializeCriticalSection(CRITICAL_SECTION* pSection)
+{
+	pthread_mutexattr_t attr;
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(pSection, &attr);
+	pthread_mutexattr_destroy(&attr);
+}
+
+static inline void DeleteCriticalSection(CRITICAL_SECTION* pSection)
+{
+	pthread_mutex_destroy(pSection);
+}
+
+static inline void EnterCriticalSection(CRITICAL_SECTION* pSection)
+{
+	pthread_mutex_lock(pSection);
+}
+
+static inline void LeaveCriticalSection(CRITICAL_SECTION* pSection)
+{
+	pthread_mutex_unlock(pSection);
+}
+
+#define MemoryBarrier() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define YieldProcessor() sched_yield()
+
+#endif // _WIN32
+
+#endif // OPENALGO_PORTABLE_H
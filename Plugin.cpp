@@ -5,9 +5,24 @@
 #include "Plugin.h"
 #include "Plugin_Legacy.h"
 #include "OpenAlgoConfigDlg.h"
+#include "WebSocketFrame.h"
+#include "WebSocketPoll.h"
+#include "MarketDataParser.h"
+#include "Calendar.h"
+#include "TickJournal.h"
+#include "QuoteTable.h"
+#include "BarBuilder.h"
+#include "BarCache.h"
+#include "Backfill.h"
+#include "HistoryResponse.h"
+#include "HttpPool.h"
+#include "SymbolTable.h"
 #include <math.h>
 #include <time.h>
 #include <stdlib.h>  // For qsort
+#include <process.h> // For _beginthreadex
+#include <shlobj.h>  // For SHGetFolderPath
+#include <limits.h>  // For _I64_MIN
 
 // Plugin identification
 #define PLUGIN_NAME "OpenAlgo Data Plugin"
@@ -20,7 +35,6 @@
 // Timer IDs
 #define TIMER_INIT 198
 #define TIMER_REFRESH 199
-#define TIMER_WEBSOCKET 200  // High-frequency timer for WebSocket data processing
 #define RETRY_COUNT 8
 
 ////////////////////////////////////////
@@ -57,8 +71,6 @@ BOOL g_bBackfillRequested = FALSE;
 
 // Local static variables
 static int g_nRetryCount = RETRY_COUNT;
-static struct RecentInfo* g_aInfos = NULL;
-static int RecentInfoSize = 0;
 static BOOL g_bPluginInitialized = FALSE;
 
 // WebSocket connection management
@@ -66,31 +78,83 @@ static SOCKET g_websocket = INVALID_SOCKET;
 static BOOL g_bWebSocketConnected = FALSE;
 static BOOL g_bWebSocketAuthenticated = FALSE;
 static BOOL g_bWebSocketConnecting = FALSE;
-static DWORD g_dwLastConnectionAttempt = 0;
-static CMap<CString, LPCTSTR, BOOL, BOOL> g_SubscribedSymbols;
+static volatile LONG g_nWebSocketGeneration = 0;  // Bumped on every successful connect
 static CRITICAL_SECTION g_WebSocketCriticalSection;
 static BOOL g_bCriticalSectionInitialized = FALSE;
 
-// Cache for recent quotes
-struct QuoteCache {
-	CString symbol;
-	CString exchange;
-	float ltp;
-	float open;
-	float high;
-	float low;
-	float close;
-	float volume;
-	float oi;
-	DWORD lastUpdate;
-	
-	// Constructor to initialize all values
-	QuoteCache() : ltp(0.0f), open(0.0f), high(0.0f), low(0.0f), 
-	               close(0.0f), volume(0.0f), oi(0.0f), lastUpdate(0) {
+static WebSocketRecvBuffer g_wsRecvBuffer;
+
+// WebSocket I/O thread
+// Owns the socket: connects, reconnects, drains frames and feeds ProcessTick().
+// The UI thread only sends subscribe/unsubscribe frames (serialized by the send lock).
+// g_websocket is only replaced or closed while holding the send lock.
+#define WS_IO_IDLE_WAKE_MS  1000
+
+static HANDLE g_hWebSocketIoThread = NULL;
+static WebSocketPoller g_wsPoller;  // Stop request + socket readiness (see WebSocketPoll.h)
+static CRITICAL_SECTION g_WebSocketSendCriticalSection;
+static BOOL g_bSendCriticalSectionInitialized = FALSE;
+
+// Streaming update notifier (see PostPendingStreamingUpdate())
+// ProcessTick() marks its symbol dirty; the I/O thread posts at most one
+// WM_USER_STREAMING_UPDATE per StreamingUpdateMs (registry), and right away when
+// a tick closes a bar. Everything here is written by the I/O thread only.
+#define STREAMING_UPDATE_MS_DEFAULT  50
+#define STREAMING_UPDATE_MS_MAX      1000
+
+struct StreamingUpdateStats {
+	LONG nTicks;             // Ticks applied to bars
+	LONG nNotifications;     // WM_USER_STREAMING_UPDATE messages posted
+	LONG nBarCloseFlushes;   // Notifications posted before the interval because a bar closed
+	LONG nDirtySymbols;      // Symbol updates folded into those notifications
+
+	StreamingUpdateStats() : nTicks(0), nNotifications(0), nBarCloseFlushes(0), nDirtySymbols(0) {
+	}
+};
+
+static volatile LONG g_nStreamingUpdatePending = 0;  // Set by ProcessTick(), cleared when posted
+static BOOL g_bStreamingBarClosed = FALSE;           // A tick closed a bar - post without waiting
+static int g_nStreamingUpdateMs = STREAMING_UPDATE_MS_DEFAULT;
+static DWORD g_dwLastStreamingUpdate = 0;            // GetTickCount() of the last post
+static CArray<int, int> g_aDirtySymbols;             // IDs with SymbolState::bDirty set
+static int g_nDirtySymbols = 0;                      // Used entries of g_aDirtySymbols (capacity is kept)
+static StreamingUpdateStats g_streamingStats;
+
+// Drain budget for ProcessWebSocketData()
+// Each call stops after a time budget (registry "DrainBudgetUs") or after an adaptive
+// message budget, whichever comes first, so a burst cannot monopolize the I/O thread
+// but throughput is no longer capped at a fixed number of messages per call.
+#define WS_DRAIN_BUDGET_US_DEFAULT  5000   // 5 ms per call
+#define WS_DRAIN_BUDGET_US_MIN      100
+#define WS_DRAIN_BUDGET_US_MAX      100000
+#define WS_DRAIN_MESSAGES_INITIAL   256
+#define WS_DRAIN_MESSAGES_MIN       16
+#define WS_DRAIN_MESSAGES_MAX       65536
+
+struct WebSocketDrainStats {
+	int nMessageBudget;         // Current adaptive message budget
+	int nLastBatchMessages;     // Frames handled by the last call
+	int nBacklogBytes;          // Unparsed bytes (receive buffer + socket) after the last call
+	int nPeakBacklogBytes;      // Highest backlog seen since Init()
+	LONG nTimeBudgetExhausted;  // Calls that ran out of time with data still pending
+	LONG nMessageBudgetExhausted; // Calls that hit the message budget
+	__int64 nTotalMessages;
+
+	WebSocketDrainStats() : nMessageBudget(WS_DRAIN_MESSAGES_INITIAL), nLastBatchMessages(0),
+	                        nBacklogBytes(0), nPeakBacklogBytes(0), nTimeBudgetExhausted(0),
+	                        nMessageBudgetExhausted(0), nTotalMessages(0) {
 	}
 };
 
-static CMap<CString, LPCTSTR, QuoteCache, QuoteCache&> g_QuoteCache;
+static int g_nDrainBudgetUs = WS_DRAIN_BUDGET_US_DEFAULT;
+static WebSocketDrainStats g_wsDrainStats;  // Written by the I/O thread only
+
+// Symbol table (see "Symbol Table")
+// Every ticker ("RELIANCE-NSE") seen in a session gets a dense ID 0, 1, 2, ...
+// IDs are never reused or removed, and all per-symbol state lives in a SymbolState
+// record found by ID (GetSymbolState()). The table itself is in SymbolTable.h.
+
+// QuoteCache and QuoteSlot (one per symbol ID) are in QuoteTable.h
 
 typedef CArray< struct Quotation, struct Quotation > CQuoteArray;
 
@@ -101,64 +165,320 @@ typedef CArray< struct Quotation, struct Quotation > CQuoteArray;
 // Real-time configuration (non-static so they can be accessed from OpenAlgoConfigDlg)
 BOOL g_bRealTimeCandlesEnabled = TRUE;  // Default: enabled
 int g_nBackfillIntervalMs = 5000;       // HTTP backfill every 5 seconds
+static BOOL g_bVerboseTickLog = FALSE;  // Per-tick and per-recv() OutputDebugString trace (registry "VerboseTickLog")
+
+// Background history fetches (see "History Workers")
+// GetQuotesEx() never waits for /api/v1/history. It merges whatever a worker has
+// finished, queues a refresh when the last one is older than the allowed age, and
+// returns at once; a WM_USER_STREAMING_UPDATE brings it back when the refresh lands.
+#define HISTORY_WORKER_THREADS       2     // Downloads in flight at once
+#define HISTORY_FETCH_SEED_BARS      512   // Existing bars handed to a fetch for gap detection (> the 250-bar daily check)
+#define HISTORY_FETCH_1M             0     // HistoryFetchSlot per periodicity
+#define HISTORY_FETCH_DAILY          1
+#define HISTORY_FETCH_PERIODICITIES  2
+
+// HistoryFetchSlot::nState
+#define HISTORY_FETCH_IDLE    0
+#define HISTORY_FETCH_QUEUED  1   // Waiting for or running on a worker
+#define HISTORY_FETCH_READY   2   // pResult holds bars GetQuotesEx() has not merged yet
+
+// One download. The worker runs GetOpenAlgoHistory() on pBars, seeded with the newest
+// bars AmiBroker had when the job was queued, then keeps only the bars the server
+// added or changed (pBars[0..nBars-1]).
+struct HistoryFetchJob {
+	HistoryFetchJob* pNext;      // Queue link
+	int nSymbolId;
+	int nPeriodicity;
+	int nSize;                   // Capacity of pBars (AmiBroker's array size when queued)
+	int nSeed;                   // Bars in pSeed
+	int nBars;
+	struct Quotation* pBars;
+	struct Quotation* pSeed;     // Copy of the seed bars, to tell what the download changed
+
+	HistoryFetchJob() : pNext(NULL), nSymbolId(-1), nPeriodicity(0), nSize(0), nSeed(0), nBars(0),
+	                    pBars(NULL), pSeed(NULL) {
+	}
+
+	~HistoryFetchJob() {
+		delete[] pBars;
+		delete[] pSeed;
+	}
+};
+
+struct HistoryFetchSlot {
+	int nState;
+	BOOL bCompleted;             // A fetch finished at least once
+	DWORD dwCompleted;           // GetTickCount() when the last fetch finished
+	HistoryFetchJob* pResult;    // HISTORY_FETCH_READY only
+	BOOL bCacheUpdated;          // The backfill scheduler wrote to the bar cache - merge it again
+
+	HistoryFetchSlot() : nState(HISTORY_FETCH_IDLE), bCompleted(FALSE), dwCompleted(0), pResult(NULL),
+	                     bCacheUpdated(FALSE) {
+	}
+};
 
-// HTTP response caching (performance optimization)
-// Cache HTTP responses to avoid calling HTTP API on every GetQuotesEx() call
-CMapStringToPtr g_HttpResponseCache;  // Maps "SYMBOL-PERIODICITY" → last HTTP call time (DWORD*)
+// Guards every HistoryFetchSlot and the job queue
 CRITICAL_SECTION g_HttpCacheCriticalSection;
-const DWORD HTTP_CACHE_LIFETIME_MS = 60000;  // Cache HTTP responses for 60 seconds
+const DWORD HTTP_CACHE_LIFETIME_MS = 60000;  // Refresh 1-minute history of tick-built charts every 60 seconds
 static BOOL g_bHttpCacheCriticalSectionInitialized = FALSE;
 
-// BarBuilder: Per-symbol tick-to-bar aggregation state
-struct BarBuilder {
+static HANDLE g_hHistoryWorkerThreads[HISTORY_WORKER_THREADS] = { NULL };
+static HANDLE g_hHistoryStopEvent = NULL;
+static HANDLE g_hHistoryQueueSemaphore = NULL;    // Released once per queued job
+static HistoryFetchJob* g_pHistoryQueueHead = NULL;
+static HistoryFetchJob* g_pHistoryQueueTail = NULL;
+
+// Batched quote refresh (see "Quote Refresher")
+// GetRecentInfo() only reads the quote table. A symbol whose quote is missing or older
+// than QUOTE_STALE_MS is flagged, and one thread fetches every flagged symbol with
+// /api/v1/multiquotes, QUOTE_BATCH_MAX_SYMBOLS per request.
+#define QUOTE_STALE_MS              5000    // Older quotes (no WebSocket tick) are refreshed over HTTP
+#define QUOTE_BATCH_MAX_SYMBOLS     50      // Symbols per /api/v1/multiquotes request
+#define QUOTE_BATCH_TIMEOUT_MS      5000
+#define QUOTE_REFRESH_PAUSE_MS      500     // Minimum time between two refresh passes
+
+static HANDLE g_hQuoteRefreshThread = NULL;
+static HANDLE g_hQuoteRefreshStopEvent = NULL;
+static HANDLE g_hQuoteRefreshWakeEvent = NULL;     // Auto reset; set when a symbol is flagged
+static BOOL g_bMultiQuotesUnsupported = FALSE;     // Server answered 404 - one /api/v1/quotes per symbol
+
+struct BarBuilder;
+
+// Everything kept per symbol ID. Records never move once allocated, so a pointer
+// from GetSymbolState() stays valid for the session.
+struct SymbolState {
+	QuoteSlot quote;                   // Latest quote (seqlock, see "Quote Table")
+	BOOL bSubscribed;                  // WebSocket subscription (g_WebSocketCriticalSection)
+	HistoryFetchSlot aHistory[HISTORY_FETCH_PERIODICITIES];  // Background history fetch (g_HttpCacheCriticalSection)
+	BarBuilder* volatile pBarBuilder;  // Tick-built bars (see g_BarBuilderCriticalSection)
+	BOOL bDirty;                       // Ticked since the last streaming update (I/O thread only)
+	volatile LONG nQuoteWanted;        // 1 = stale quote, waiting for the quote refresher
+	volatile struct RecentInfo recentInfo;  // Kept current by StoreQuote(), under the quote slot's seqlock
+	struct RecentInfo recentInfoShown; // What GetRecentInfo() returns: a copy of recentInfo (UI thread only)
+
+	SymbolState() : bSubscribed(FALSE), pBarBuilder(NULL), bDirty(FALSE), nQuoteWanted(0) {
+		memset((void*)&recentInfo, 0, sizeof(recentInfo));
+		memset(&recentInfoShown, 0, sizeof(recentInfoShown));
+	}
+};
+
+static SymbolTable g_SymbolTable;                                 // Ticker <-> ID
+static SymbolState* volatile g_apSymbolStates[SYMBOL_TABLE_MAX_CHUNKS];  // SYMBOL_CHUNK_SIZE records each, by ID
+static BOOL g_bSymbolTableInitialized = FALSE;
+
+// Shared HTTP client (see "OpenAlgo HTTP Client")
+// One CInternetSession for the plugin's lifetime plus a pool of idle keep-alive
+// connections (HttpPool.h)
+
+// One request in flight, from OpenAlgoHttpBegin() to OpenAlgoHttpEnd()
+struct OpenAlgoHttpRequest {
+	CHttpConnection* pConnection;
+	CHttpFile* pFile;        // Response body - read it between Begin and End
+	DWORD dwStatusCode;
+	CString server;
+	INTERNET_PORT nPort;
+	CString endpoint;
+	BOOL bReusedConnection;  // Connection came from the idle pool
+	LARGE_INTEGER liStart;
+
+	OpenAlgoHttpRequest() : pConnection(NULL), pFile(NULL), dwStatusCode(0), nPort(0),
+	                        bReusedConnection(FALSE) {
+		liStart.QuadPart = 0;
+	}
+};
+
+static CInternetSession* g_pHttpSession = NULL;  // Created on the first request, guarded by g_HttpPool.lock
+static HttpConnectionPool g_HttpPool;             // Idle CHttpConnection handles and the latency counters
+static BOOL g_bHttpPoolInitialized = FALSE;
+
+// On-disk bar cache (see "Bar Cache"; the file format is in BarCache.h)
+static BOOL g_bBarCacheEnabled = TRUE;
+static CString g_oBarCacheDir;  // <database>\OpenAlgoCache - empty until the database is loaded
+static CRITICAL_SECTION g_BarCacheCriticalSection;
+static BOOL g_bBarCacheCriticalSectionInitialized = FALSE;
+
+// BarRing, BarSnapshot and BarBuilder (per-symbol tick-to-bar state) are in BarBuilder.h
+
+// Bar builders live in SymbolState::pBarBuilder (one per symbol ID)
+// A slot is filled once with InterlockedExchangePointer() and read without a lock;
+// g_BarBuilderCriticalSection only serializes creation. Builders are never removed
+// while the plugin runs (CleanupBarBuilders() runs in Release() after the I/O
+// thread has stopped), so a pointer read from a slot stays valid.
+static CRITICAL_SECTION g_BarBuilderCriticalSection;
+static BOOL g_bBarBuilderCriticalSectionInitialized = FALSE;
+
+// Chunked history download (see "Chunked History Download")
+#define HISTORY_CHUNK_DAYS_1M_DEFAULT      30     // Registry "HistoryChunkDays1m"; 0 = never split
+#define HISTORY_CHUNK_DAYS_DAILY_DEFAULT   1825   // Registry "HistoryChunkDaysDaily"; 0 = never split
+#define HISTORY_CHUNK_CONCURRENCY_DEFAULT  4      // Registry "HistoryChunkConcurrency"
+#define HISTORY_CHUNK_CONCURRENCY_MAX      HTTP_POOL_MAX_IDLE
+#define HISTORY_CHUNK_ATTEMPTS             2      // First try plus one retry per chunk
+#define HISTORY_CHUNK_RETRY_MS             1000
+
+// One date range of a chunked download; pBars holds its candles in time order
+struct HistoryChunk {
+	CString startDate;
+	CString endDate;
+	struct Quotation* pBars;
+	int nSize;
+	int nBars;
+	int nAttempts;
+	BOOL bSucceeded;
+
+	HistoryChunk() : pBars(NULL), nSize(0), nBars(0), nAttempts(0), bSucceeded(FALSE) {
+	}
+
+	~HistoryChunk() {
+		delete[] pBars;
+	}
+};
+
+// Shared by the threads of one chunked download; chunks are claimed with nNext
+struct HistoryChunkDownload {
+	HANDLE hStopEvent;           // Optional; once set, no further chunk is requested
+	TokenBucket* pBucket;        // Optional; every request (and retry) takes a token
 	CString symbol;
 	CString exchange;
-	int periodicity;  // 60 for 1-minute (only 1-minute supported initially)
+	CString interval;
+	int nPeriodicity;
+	HistoryChunk* pChunks;
+	int nChunks;
+	volatile LONG nNext;
 
-	// Current bar being built from ticks
-	struct Quotation currentBar;
-	BOOL bBarStarted;
-	time_t barStartTime;
+	HistoryChunkDownload() : hStopEvent(NULL), pBucket(NULL), nPeriodicity(0), pChunks(NULL), nChunks(0), nNext(0) {
+	}
+};
 
-	// Tick accumulation
-	float volumeAccumulator;  // Sum of last_trade_quantity
-	int tickCount;
+// An /api/v1/history request in progress (see "History Request Coalescing").
+// Identical requests (symbol, exchange, interval, dates) wait for it and replay pBars.
+struct HistoryFlight {
+	HistoryFlight* pNext;
+	CString key;
+	HANDLE hDone;                // Manual reset; set when the leader's request is finished
+	LONG nRefs;                  // Leader plus waiters, guarded by g_HistoryFlightCriticalSection
+	BOOL bSucceeded;
+	int nCandles;                // As counted by the parser
+	struct Quotation* pBars;     // Every candle of the response, in response order
+	int nBars;
+	int nCapacity;
+
+	HistoryFlight() : pNext(NULL), hDone(NULL), nRefs(0), bSucceeded(FALSE), nCandles(0),
+	                  pBars(NULL), nBars(0), nCapacity(0) {
+	}
 
-	// Historical bars storage
-	CArray<struct Quotation, struct Quotation> bars;  // Up to 10,000 bars
-	int maxBars;
+	~HistoryFlight() {
+		if (hDone != NULL)
+			CloseHandle(hDone);
+		delete[] pBars;
+	}
+};
 
-	// Timestamps for backfill management
-	DWORD lastTickTime;      // Last tick received
-	DWORD lastBackfillTime;  // Last HTTP backfill
+struct HistoryFlightStats {
+	volatile LONG nFlights;      // Requests that went to the server
+	volatile LONG nCoalesced;    // Requests that shared one of them instead
+};
 
-	// State flags
-	BOOL bBackfillMerged;
-	BOOL bFirstTickReceived;
+static HistoryFlight* g_pHistoryFlights = NULL;
+static HistoryFlightStats g_historyFlightStats = { 0, 0 };
+static CRITICAL_SECTION g_HistoryFlightCriticalSection;
+static BOOL g_bHistoryFlightCriticalSectionInitialized = FALSE;
+
+static int g_nHistoryChunkDays1m = HISTORY_CHUNK_DAYS_1M_DEFAULT;
+static int g_nHistoryChunkDaysDaily = HISTORY_CHUNK_DAYS_DAILY_DEFAULT;
+static int g_nHistoryChunkConcurrency = HISTORY_CHUNK_CONCURRENCY_DEFAULT;
+
+// All Symbols backfill (see "Backfill Scheduler"; the checkpoint format and the
+// token bucket are in Backfill.h)
+#define BACKFILL_CONCURRENCY_DEFAULT     4       // Registry "BackfillConcurrency"
+#define BACKFILL_CONCURRENCY_MAX         16
+#define BACKFILL_RATE_DEFAULT            5       // Registry "BackfillRequestsPerSec"
+#define BACKFILL_RATE_MAX                100
+#define BACKFILL_NOTIFY_MS               1000    // At most one WM_USER_STREAMING_UPDATE per second while running
+
+// The running (or last) backfill job. Guarded by g_BackfillCriticalSection.
+struct BackfillJob {
+	HANDLE hFile;                        // Checkpoint; INVALID_HANDLE_VALUE if it could not be written
+	int nPeriodicity;
+	int nDays;
+	int nSymbols;
+	BackfillCheckpointRecord* pSymbols;
+	int nNext;                           // Next record to look at
+	int nDone;                           // Finished, incl. those finished before a resume
+	int nFailed;
+	int nResumed;                        // Already done when the job was loaded from a checkpoint
+	__int64 nBars;                       // Bars downloaded by this run
+	DWORD dwStart;
+	DWORD dwElapsed;                     // Run time once finished
+	DWORD dwLastNotify;
+	volatile LONG nActiveThreads;
+	BOOL bRunning;
+	TokenBucket bucket;                   // Has its own lock (see Backfill.h)
+
+	BackfillJob() : hFile(INVALID_HANDLE_VALUE), nPeriodicity(0), nDays(0), nSymbols(0), pSymbols(NULL),
+	                nNext(0), nDone(0), nFailed(0), nResumed(0), nBars(0), dwStart(0), dwElapsed(0),
+	                dwLastNotify(0), nActiveThreads(0), bRunning(FALSE) {
+	}
+};
 
-	// Constructor
-	BarBuilder() : periodicity(60), bBarStarted(FALSE), barStartTime(0),
-	               volumeAccumulator(0.0f), tickCount(0), maxBars(10000),
-	               lastTickTime(0), lastBackfillTime(0),
-	               bBackfillMerged(FALSE), bFirstTickReceived(FALSE) {
-		memset(&currentBar, 0, sizeof(struct Quotation));
+static BackfillJob g_backfill;
+static CRITICAL_SECTION g_BackfillCriticalSection;
+static BOOL g_bBackfillCriticalSectionInitialized = FALSE;
+static HANDLE g_hBackfillThreads[BACKFILL_CONCURRENCY_MAX] = { NULL };
+static HANDLE g_hBackfillStopEvent = NULL;
+static int g_nBackfillConcurrency = BACKFILL_CONCURRENCY_DEFAULT;
+static int g_nBackfillRequestsPerSec = BACKFILL_RATE_DEFAULT;
+static CString g_oDatabasePath;          // Folder of the loaded database (symbol enumeration)
+
+// Tick journal (see "Tick Journal")
+// Every tick fed to ProcessTick() is appended to %LOCALAPPDATA%\OpenAlgo\Journal\ticks-YYYYMMDD.bin
+// and replayed by Init() so that today's tick-built bars survive a crash or reload.
+// The record format and the write batching are in TickJournal.h.
+#define TICK_JOURNAL_KEEP_DAYS         5           // Older journal files are deleted on rotation
+
+struct TickJournal {
+	HANDLE hFile;
+	__int64 nDayStart;       // Exchange-local midnight of the open file's day (Unix time)
+	__int64 nRotateAt;       // Next midnight - ticks at or after it go to a new file
+	TickJournalWriter writer;
+
+	TickJournal() : hFile(INVALID_HANDLE_VALUE), nDayStart(0), nRotateAt(0) {
 	}
 };
 
-// Global cache of bar builders (one per symbol)
-static CMap<CString, LPCTSTR, BarBuilder*, BarBuilder*> g_BarBuilders;
-static CRITICAL_SECTION g_BarBuilderCriticalSection;
-static BOOL g_bBarBuilderCriticalSectionInitialized = FALSE;
+static TickJournal g_tickJournal;
+static BOOL g_bTickJournalEnabled = TRUE;
+static int g_nJournalFsyncMs = TICK_JOURNAL_FSYNC_MS_DEFAULT;
+static CRITICAL_SECTION g_TickJournalCriticalSection;
+static BOOL g_bTickJournalCriticalSectionInitialized = FALSE;
 
 // Forward declarations
 VOID CALLBACK OnTimerProc(HWND, UINT, UINT_PTR, DWORD);
 void SetupRetry(void);
 BOOL TestOpenAlgoConnection(void);
 BOOL GetOpenAlgoQuote(LPCTSTR pszTicker, QuoteCache& quote);
-int GetOpenAlgoHistory(LPCTSTR pszTicker, int nPeriodicity, int nLastValid, int nSize, struct Quotation* pQuotes);
+void FillQuoteFromTick(const MarketTick* pFields, LPCTSTR pszExchange, QuoteCache* pQuote);
+int FindSymbolId(LPCTSTR pszTicker);
+int InternSymbol(LPCTSTR pszTicker);
+int InternSymbolPair(const char* pszSymbol, const char* pszExchange);
+LPCTSTR GetSymbolTicker(int nSymbolId);
+SymbolState* GetSymbolState(int nSymbolId);
+void CleanupSymbolTable(void);
+void StoreQuote(int nSymbolId, const QuoteCache& quote);
+void UpdateRecentInfo(struct RecentInfo* pInfo, LPCTSTR pszTicker, const QuoteCache& quote);
+BOOL LoadQuote(int nSymbolId, QuoteCache* pQuote);
+BOOL LoadRecentInfo(int nSymbolId, struct RecentInfo* pInfo);
+void ClearQuotes(void);
+int GetOpenAlgoHistory(LPCTSTR pszTicker, int nPeriodicity, int nLastValid, int nSize, struct Quotation* pQuotes, int nBackfillDays, BOOL* pbSucceeded, HANDLE hStopEvent, TokenBucket* pBucket);
 CString GetExchangeFromTicker(LPCTSTR pszTicker);
 CString GetIntervalString(int nPeriodicity);
-void ConvertUnixToPackedDate(time_t unixTime, union AmiDate* pAmiDate);
+
+// Shared HTTP client
+BOOL OpenAlgoHttpBegin(OpenAlgoHttpRequest* pRequest, int nVerb, LPCTSTR pszEndpoint, const CString* pBody, DWORD dwTimeoutMs);
+void OpenAlgoHttpEnd(OpenAlgoHttpRequest* pRequest, BOOL bKeepConnection);
+void CloseHttpConnection(CHttpConnection* pConnection);
+__int64 HttpElapsedUs(const LARGE_INTEGER& liStart);
+void CleanupHttpClient(void);
+void GetHttpClientStats(HttpClientStats* pStats);
 
 // WebSocket functions
 BOOL InitializeWebSocket(void);
@@ -166,25 +486,303 @@ void CleanupWebSocket(void);
 BOOL ConnectWebSocket(void);
 BOOL AuthenticateWebSocket(void);
 BOOL SendWebSocketFrame(const CString& message);
-CString DecodeWebSocketFrame(const char* buffer, int length);
+BOOL SendWebSocketControlFrame(unsigned char opcode, const char* payload, int payloadLen);
 BOOL SubscribeToSymbol(LPCTSTR pszTicker);
 BOOL UnsubscribeFromSymbol(LPCTSTR pszTicker);
 BOOL ProcessWebSocketData(void);
 void GenerateWebSocketMaskKey(unsigned char* maskKey);
 void SubscribePendingSymbols(void);
+void CloseWebSocketConnection(void);
+void SetWebSocketHandle(SOCKET s);
+
+// WebSocket I/O thread
+BOOL StartWebSocketIoThread(void);
+void StopWebSocketIoThread(void);
+int WebSocketIoWait(LONG* pnSelectedGeneration, DWORD dwTimeoutMs);
+unsigned __stdcall WebSocketIoThreadProc(void* pParam);
+void MarkStreamingUpdate(int nSymbolId, BOOL bBarClosed);
+DWORD PostPendingStreamingUpdate(BOOL bFlush);
+void UpdateWebSocketDrainStats(int nMessages, BOOL bTimeExhausted, BOOL bMessageExhausted, __int64 nElapsedUs);
+int ClampDrainBudgetUs(int nBudgetUs);
+
+// Market data tokenizer
 
 // Real-time candle building functions
-BOOL ProcessTick(const CString& symbol, const CString& exchange, float ltp, float lastTradeQty, time_t timestamp);
-time_t ParseISO8601Timestamp(const CString& isoTimestamp);
-BarBuilder* GetOrCreateBarBuilder(const CString& ticker);
+BOOL ApplyTickToBarBuilder(BarBuilder* pBuilder, float ltp, float lastTradeQty, time_t timestamp, BOOL bVerbose);
+BOOL ProcessTick(int nSymbolId, float ltp, float lastTradeQty, time_t timestamp);
+BarBuilder* GetOrCreateBarBuilder(int nSymbolId);
+BarBuilder* FindBarBuilder(int nSymbolId);
 void CleanupBarBuilders(void);
 
+// Tick journal
+BOOL OpenTickJournal(__int64 nTime, BOOL bReplay);
+void AppendTickJournal(int nSymbolId, float ltp, float lastTradeQty, time_t timestamp);
+void FlushTickJournal(BOOL bSync);
+void CloseTickJournal(void);
+__int64 ReplayTickJournal(HANDLE hFile);
+
 // Helper function for mixed EOD/Intraday data
 int FindLastBarOfMatchingType(int nPeriodicity, int nLastValid, struct Quotation* pQuotes);
 
 // Helper function to compare two quotations for sorting by timestamp
 int CompareQuotations(const void* a, const void* b);
 
+// History workers
+BOOL StartHistoryWorkers(void);
+void StopHistoryWorkers(void);
+unsigned __stdcall HistoryWorkerThreadProc(void* pParam);
+void QueueHistoryFetch(int nSymbolId, int nPeriodicity, int nLastValid, int nSize, const struct Quotation* pQuotes);
+void RunHistoryFetch(HistoryFetchJob* pJob);
+DWORD GetHistoryRefreshMs(void);
+int GetOpenAlgoHistoryAsync(LPCTSTR pszTicker, int nPeriodicity, int nLastValid, int nSize, struct Quotation* pQuotes, DWORD dwMaxAgeMs, BOOL* pbMerged);
+
+// Quote refresher
+BOOL StartQuoteRefresher(void);
+void StopQuoteRefresher(void);
+void RequestQuoteRefresh(int nSymbolId);
+int RefreshQuoteBatch(const int* pSymbolIds, int nSymbols);
+unsigned __stdcall QuoteRefreshThreadProc(void* pParam);
+
+// Chunked history download
+BOOL RequestHistoryRange(const CString& symbol, const CString& exchange, const CString& interval, const CString& startDate, const CString& endDate, HistoryMergeContext* pCtx, int* pnCandles, TokenBucket* pBucket, HANDLE hStopEvent);
+int GetOpenAlgoHistoryChunked(LPCTSTR pszTicker, const CString& symbol, const CString& exchange, const CString& interval, int nPeriodicity, CTime startTime, int nRangeDays, int nChunkDays, int nConcurrency, int nLastValid, int nSize, struct Quotation* pQuotes, BOOL* pbSucceeded, HANDLE hStopEvent, TokenBucket* pBucket);
+BOOL WaitForHistoryStop(HANDLE hStopEvent, DWORD dwWaitMs);
+BOOL WaitForHistoryToken(TokenBucket* pBucket, HANDLE hStopEvent);
+void RunHistoryChunks(HistoryChunkDownload* pDownload);
+unsigned __stdcall HistoryChunkThreadProc(void* pParam);
+
+// History request coalescing
+HistoryFlight* JoinHistoryFlight(const CString& key, BOOL* pbLeader);
+void RecordHistoryFlightBar(HistoryFlight* pFlight, const struct Quotation* pBar);
+void LandHistoryFlight(HistoryFlight* pFlight, BOOL bSucceeded, int nCandles);
+void ReleaseHistoryFlight(HistoryFlight* pFlight);
+
+// Backfill scheduler
+CString GetBackfillCheckpointPath(void);
+int EnumerateDatabaseSymbols(void);
+BOOL StartBackfillJob(int nPeriodicity, int nDays);
+BOOL ResumeBackfillJob(void);
+BOOL BeginBackfillJob(HANDLE hFile, int nPeriodicity, int nDays, BackfillCheckpointRecord* pSymbols, int nSymbols, int nDone);
+BOOL StopBackfillJob(BOOL bDiscard);
+void FinishBackfillJob(void);
+unsigned __stdcall BackfillThreadProc(void* pParam);
+void WriteBackfillState(int nIndex);
+int FormatBackfillStatus(char* pszBuffer, int nSize);
+
+// On-disk bar cache
+CString GetBarCachePath(LPCTSTR pszTicker, int nPeriodicity);
+int LoadBarCache(LPCTSTR pszTicker, int nPeriodicity, int nLastValid, int nSize, struct Quotation* pQuotes);
+void StoreBarCache(LPCTSTR pszTicker, int nPeriodicity, int nCount, const struct Quotation* pQuotes);
+
+///////////////////////////////
+// Symbol Table
+///////////////////////////////
+//
+// Maps a ticker to a dense ID (SymbolTable.cpp: one hash and a short linear
+// probe, lookups take no lock, inserts are serialized by the table's own lock).
+// The table calls NewSymbolStateChunk() before handing out the first ID of each
+// SYMBOL_CHUNK_SIZE block, so a SymbolState record exists before any thread can
+// find its ID. Records never move, so IDs and state pointers stay valid until
+// CleanupSymbolTable() in Release().
+
+// SymbolChunkProc: allocate the SymbolState records for the next block of IDs
+static void NewSymbolStateChunk(void* pContext, int nChunk)
+{
+	InterlockedExchangePointer((PVOID volatile*)&g_apSymbolStates[nChunk], new SymbolState[SYMBOL_CHUNK_SIZE]);
+}
+
+SymbolState* GetSymbolState(int nSymbolId)
+{
+	return &g_apSymbolStates[nSymbolId / SYMBOL_CHUNK_SIZE][nSymbolId % SYMBOL_CHUNK_SIZE];
+}
+
+// ID of a ticker seen before, or -1
+int FindSymbolId(LPCTSTR pszTicker)
+{
+	if (!g_bSymbolTableInitialized)
+		return -1;
+
+	return SymbolTableFind(&g_SymbolTable, pszTicker);
+}
+
+// ID of a ticker, assigning the next free one on first sight.
+// Returns -1 if the ticker is too long or the table is full.
+int InternSymbol(LPCTSTR pszTicker)
+{
+	if (!g_bSymbolTableInitialized)
+		return -1;
+
+	int nId = SymbolTableIntern(&g_SymbolTable, pszTicker);
+	if (nId < 0 && g_SymbolTable.nCount >= SYMBOL_TABLE_MAX_SYMBOLS)
+		OutputDebugString(_T("OpenAlgo: Symbol table full - ticker not cached"));
+	return nId;
+}
+
+// ID of "SYMBOL-EXCHANGE" given the two parts as parsed from a WebSocket frame
+int InternSymbolPair(const char* pszSymbol, const char* pszExchange)
+{
+	if (!g_bSymbolTableInitialized)
+		return -1;
+
+	int nId = SymbolTableInternPair(&g_SymbolTable, pszSymbol, pszExchange);
+	if (nId < 0 && g_SymbolTable.nCount >= SYMBOL_TABLE_MAX_SYMBOLS)
+		OutputDebugString(_T("OpenAlgo: Symbol table full - ticker not cached"));
+	return nId;
+}
+
+// Ticker for an ID returned by InternSymbol(); valid for the whole session
+LPCTSTR GetSymbolTicker(int nSymbolId)
+{
+	return SymbolTableTicker(&g_SymbolTable, nSymbolId);
+}
+
+// Free the table and every SymbolState record (Release(), after all users have stopped)
+void CleanupSymbolTable(void)
+{
+	if (!g_bSymbolTableInitialized)
+		return;
+
+	DeleteSymbolTable(&g_SymbolTable);
+	for (int i = 0; i < SYMBOL_TABLE_MAX_CHUNKS; i++)
+	{
+		delete[] g_apSymbolStates[i];
+		g_apSymbolStates[i] = NULL;
+	}
+	g_bSymbolTableInitialized = FALSE;
+}
+
+///////////////////////////////
+// Quote Table
+///////////////////////////////
+//
+// One QuoteSlot per symbol ID (in its SymbolState), published with a per-slot
+// seqlock (QuoteTable.h, Seqlock.h). There are two writers, the I/O thread and
+// the quote refresher thread; BeginQuoteWrite() lets one in at a time. Readers
+// copy the quote and retry if a write overlapped. Nothing allocates and no one
+// locks.
+//
+// While it holds the slot, the writer also updates the symbol's RecentInfo
+// record. GetRecentInfo() copies it out under the same seqlock into a second
+// record only the UI thread touches and hands AmiBroker that one, so AmiBroker
+// never reads a record the I/O thread is rewriting. Like the quote, recentInfo
+// is only read and written through SeqlockLoad()/SeqlockStore().
+
+void StoreQuote(int nSymbolId, const QuoteCache& quote)
+{
+	SymbolState* pState = GetSymbolState(nSymbolId);
+	QuoteSlot* pSlot = &pState->quote;
+	LONG nSeq = BeginQuoteWrite(pSlot);
+
+	WriteQuoteSlot(pSlot, &quote);
+
+	// The slot serializes the two writers of the RecentInfo record too, so the
+	// copy read here is current; readers may be copying it out meanwhile
+	struct RecentInfo info;
+	SeqlockLoad(&info, &pState->recentInfo, sizeof(struct RecentInfo));
+	UpdateRecentInfo(&info, GetSymbolTicker(nSymbolId), quote);
+	SeqlockStore(&pState->recentInfo, &info, sizeof(struct RecentInfo));
+
+	EndQuoteWrite(pSlot, nSeq);
+}
+
+// Fold a new quote into a RecentInfo record (Real-Time Quote window)
+void UpdateRecentInfo(struct RecentInfo* pInfo, LPCTSTR pszTicker, const QuoteCache& quote)
+{
+	SYSTEMTIME st;
+	GetLocalTime(&st);
+	int nDate = st.wYear * 10000 + st.wMonth * 100 + st.wDay;
+	int nTime = st.wHour * 10000 + st.wMinute * 100 + st.wSecond;
+
+	BOOL bFirst = (pInfo->nStructSize == 0);
+	if (bFirst)
+	{
+		// Fields that never change for a symbol
+		pInfo->nStructSize = sizeof(struct RecentInfo);
+		_tcsncpy_s(pInfo->Name, sizeof(pInfo->Name) / sizeof(TCHAR), pszTicker, _TRUNCATE);
+		_tcsncpy_s(pInfo->Exchange, sizeof(pInfo->Exchange) / sizeof(TCHAR), quote.exchange, _TRUNCATE);
+		pInfo->nStatus = RI_STATUS_UPDATE | RI_STATUS_TRADE | RI_STATUS_BARSREADY;
+		pInfo->nBitmap = RI_LAST | RI_OPEN | RI_HIGHLOW | RI_TRADEVOL | RI_OPENINT;
+	}
+
+	if (bFirst || quote.ltp != pInfo->fLast)
+	{
+		pInfo->nDateChange = nDate;
+		pInfo->nTimeChange = nTime;
+	}
+
+	// Trade volume: how much the day's cumulative volume grew since the last quote
+	// (unchanged means no trade since then, a lower total means a new session)
+	if (!bFirst && quote.volume > pInfo->fTotalVol)
+		pInfo->fTradeVol = quote.volume - pInfo->fTotalVol;
+	else
+		pInfo->fTradeVol = 0;
+
+	pInfo->fLast = quote.ltp;
+	pInfo->fOpen = quote.open;
+	pInfo->fHigh = quote.high;
+	pInfo->fLow = quote.low;
+	pInfo->fPrev = quote.close;
+	pInfo->fChange = quote.ltp - quote.close;
+	pInfo->fTotalVol = quote.volume;
+	pInfo->iTotalVol = (int)quote.volume;
+	pInfo->iTradeVol = (int)pInfo->fTradeVol;
+	pInfo->fOpenInt = quote.oi;
+
+	// Bid/ask only arrive with WebSocket ticks that carry them - keep the last ones otherwise
+	if (quote.bid > 0 || quote.ask > 0)
+	{
+		pInfo->nStatus |= RI_STATUS_BIDASK;
+		pInfo->nBitmap |= RI_BID | RI_ASK;
+		pInfo->fBid = quote.bid;
+		pInfo->fAsk = quote.ask;
+	}
+
+	pInfo->nDateUpdate = nDate;
+	pInfo->nTimeUpdate = nTime;
+}
+
+// Copy the latest quote for a symbol ID; FALSE if none was stored yet
+BOOL LoadQuote(int nSymbolId, QuoteCache* pQuote)
+{
+	return LoadQuoteSlot(&GetSymbolState(nSymbolId)->quote, pQuote);
+}
+
+// Copy a symbol's RecentInfo record; FALSE if no quote was stored yet
+BOOL LoadRecentInfo(int nSymbolId, struct RecentInfo* pInfo)
+{
+	SymbolState* pState = GetSymbolState(nSymbolId);
+	QuoteSlot* pSlot = &pState->quote;
+	for (;;)
+	{
+		LONG nSeq = SeqlockBeginRead(&pSlot->nSeq);
+
+		BOOL bValid;
+		SeqlockLoad(&bValid, &pSlot->bValid, sizeof(BOOL));
+		SeqlockLoad(pInfo, &pState->recentInfo, sizeof(struct RecentInfo));
+
+		if (SeqlockEndRead(&pSlot->nSeq, nSeq))
+			return bValid;
+	}
+}
+
+// Forget every stored quote and RecentInfo record (symbol IDs stay assigned)
+void ClearQuotes(void)
+{
+	int nCount = g_SymbolTable.nCount;
+	for (int i = 0; i < nCount; i++)
+	{
+		SymbolState* pState = GetSymbolState(i);
+		QuoteSlot* pSlot = &pState->quote;
+		struct RecentInfo empty;
+		memset(&empty, 0, sizeof(empty));
+
+		LONG nSeq = BeginQuoteWrite(pSlot);
+		WriteQuoteSlot(pSlot, NULL);
+		SeqlockStore(&pState->recentInfo, &empty, sizeof(struct RecentInfo));  // Next quote starts a fresh record
+		EndQuoteWrite(pSlot, nSeq);
+	}
+}
+
 ///////////////////////////////
 // Helper Functions
 ///////////////////////////////
@@ -298,211 +896,467 @@ CString GetIntervalString(int nPeriodicity)
 		return _T("D");  // Default to daily for all other timeframes
 }
 
-// Convert Unix timestamp to AmiBroker date format
-// Works for all market types including 24x7 markets
-void ConvertUnixToPackedDate(time_t unixTime, union AmiDate* pAmiDate)
+///////////////////////////////
+// OpenAlgo HTTP Client
+///////////////////////////////
+//
+// Every REST call (quotes, history, ping, symbols, watchlist) goes through
+// OpenAlgoHttpBegin()/OpenAlgoHttpEnd(). One CInternetSession is shared for the
+// life of the plugin instead of being created per call, and connection handles
+// are parked in an idle pool between requests. Requests carry
+// INTERNET_FLAG_KEEP_CONNECTION so WinInet keeps the HTTP/1.1 socket to the
+// server open and the next call skips the TCP handshake.
+//
+// WinInet does not pipeline requests on one connection, so concurrent callers
+// each take their own pooled connection. Idle connections are closed after
+// HTTP_POOL_IDLE_TIMEOUT_MS, or as soon as the server/port setting changes.
+// The pool itself (HttpPool.cpp) only sees opaque handles; the WinInet calls
+// are the three callbacks below.
+
+// Microseconds since liStart
+__int64 HttpElapsedUs(const LARGE_INTEGER& liStart)
 {
-	struct tm* timeinfo = localtime(&unixTime);
+	static LONGLONG s_llPerfFrequency = 0;
+	if (s_llPerfFrequency == 0)
+	{
+		LARGE_INTEGER liFreq;
+		QueryPerformanceFrequency(&liFreq);
+		s_llPerfFrequency = liFreq.QuadPart;
+	}
 
-	pAmiDate->PackDate.Year = timeinfo->tm_year + 1900;
-	pAmiDate->PackDate.Month = timeinfo->tm_mon + 1;
-	pAmiDate->PackDate.Day = timeinfo->tm_mday;
-	pAmiDate->PackDate.Hour = timeinfo->tm_hour;
-	pAmiDate->PackDate.Minute = timeinfo->tm_min;
-	pAmiDate->PackDate.Second = timeinfo->tm_sec;
-	pAmiDate->PackDate.MilliSec = 0;
-	pAmiDate->PackDate.MicroSec = 0;
-	pAmiDate->PackDate.Reserved = 0;
-	pAmiDate->PackDate.IsFuturePad = 0;
+	LARGE_INTEGER liNow;
+	QueryPerformanceCounter(&liNow);
+	return ((liNow.QuadPart - liStart.QuadPart) * 1000000) / s_llPerfFrequency;
 }
 
-// Fetch real-time quote from OpenAlgo
-// WARNING: This is ONLY for Level 1 quotes in Real-time Quote Window
-// NEVER use this data for creating OHLC bars or historical charts
-BOOL GetOpenAlgoQuote(LPCTSTR pszTicker, QuoteCache& quote)
+void CloseHttpConnection(CHttpConnection* pConnection)
 {
-	AFX_MANAGE_STATE(AfxGetStaticModuleState());
-
-	if (g_oApiKey.IsEmpty())
-		return FALSE;
-
-	BOOL bSuccess = FALSE;
+	if (pConnection == NULL)
+		return;
 
 	try
 	{
-		CString oURL = BuildOpenAlgoURL(g_oServer, g_nPortNumber, _T("/api/v1/quotes"));
+		pConnection->Close();
+	}
+	catch (CInternetException* e)
+	{
+		e->Delete();
+	}
+	delete pConnection;
+}
 
-		// Prepare POST data
-		CString symbol = GetCleanSymbol(pszTicker);
-		CString exchange = GetExchangeFromTicker(pszTicker);
+// HttpPoolOpenProc: a connection handle on the shared session (pool lock held)
+static void* OpenPooledHttpConnection(void* pContext, LPCTSTR pszServer, UINT nPort)
+{
+	try
+	{
+		if (g_pHttpSession == NULL)
+		{
+			g_pHttpSession = new CInternetSession(AGENT_NAME, 1, INTERNET_OPEN_TYPE_DIRECT, NULL, NULL,
+				INTERNET_FLAG_DONT_CACHE);
+		}
 
-		CString oPostData;
-		oPostData.Format(_T("{\"apikey\":\"%s\",\"symbol\":\"%s\",\"exchange\":\"%s\"}"),
-			(LPCTSTR)g_oApiKey, (LPCTSTR)symbol, (LPCTSTR)exchange);
+		return g_pHttpSession->GetHttpConnection(pszServer, (INTERNET_PORT)nPort);
+	}
+	catch (CInternetException* e)
+	{
+		e->Delete();
+	}
+	return NULL;
+}
 
-		CInternetSession oSession(AGENT_NAME, 1, INTERNET_OPEN_TYPE_DIRECT, NULL, NULL,
-			INTERNET_FLAG_DONT_CACHE);
-		oSession.SetOption(INTERNET_OPTION_CONNECT_TIMEOUT, 3000);
-		oSession.SetOption(INTERNET_OPTION_RECEIVE_TIMEOUT, 3000);
+// HttpPoolCloseProc
+static void ClosePooledHttpConnection(void* pContext, void* pConnection)
+{
+	CloseHttpConnection((CHttpConnection*)pConnection);
+}
 
-		CHttpConnection* pConnection = NULL;
-		CHttpFile* pFile = NULL;
+// What SendOpenAlgoHttpRequest() sends
+struct OpenAlgoHttpSend {
+	OpenAlgoHttpRequest* pRequest;
+	int nVerb;
+	LPCTSTR pszEndpoint;
+	const CStringA* pBodyA;  // NULL for a bodyless request
+	DWORD dwTimeoutMs;
+};
 
-		// Parse server
-		INTERNET_PORT nPort = (INTERNET_PORT)g_nPortNumber;
-		CString oServer = g_oServer;
-		oServer.Replace(_T("http://"), _T(""));
-		oServer.Replace(_T("https://"), _T(""));
+// HttpPoolSendProc: open the request on pConnection and send it
+static BOOL SendOpenAlgoHttpRequest(void* pContext, void* pConnection)
+{
+	OpenAlgoHttpSend* pSend = (OpenAlgoHttpSend*)pContext;
+	OpenAlgoHttpRequest* pRequest = pSend->pRequest;
 
-		pConnection = oSession.GetHttpConnection(oServer, nPort);
+	try
+	{
+		pRequest->pFile = ((CHttpConnection*)pConnection)->OpenRequest(
+			pSend->nVerb,
+			pSend->pszEndpoint,
+			NULL, 1, NULL, NULL,
+			INTERNET_FLAG_RELOAD | INTERNET_FLAG_DONT_CACHE | INTERNET_FLAG_KEEP_CONNECTION);
 
-		if (pConnection)
+		if (pRequest->pFile)
 		{
-			pFile = pConnection->OpenRequest(
-				CHttpConnection::HTTP_VERB_POST,
-				_T("/api/v1/quotes"),
-				NULL, 1, NULL, NULL,
-				INTERNET_FLAG_RELOAD | INTERNET_FLAG_DONT_CACHE);
+			pRequest->pFile->SetOption(INTERNET_OPTION_CONNECT_TIMEOUT, pSend->dwTimeoutMs);
+			pRequest->pFile->SetOption(INTERNET_OPTION_SEND_TIMEOUT, pSend->dwTimeoutMs);
+			pRequest->pFile->SetOption(INTERNET_OPTION_RECEIVE_TIMEOUT, pSend->dwTimeoutMs);
 
-			if (pFile)
+			BOOL bSent;
+			if (pSend->pBodyA != NULL)
 			{
 				CString oHeaders = _T("Content-Type: application/json\r\n");
-				CStringA oPostDataA(oPostData);
-
-				if (pFile->SendRequest(oHeaders, (LPVOID)(LPCSTR)oPostDataA, oPostDataA.GetLength()))
-				{
-					DWORD dwStatusCode = 0;
-					pFile->QueryInfoStatusCode(dwStatusCode);
-
-					if (dwStatusCode == 200)
-					{
-						CString oResponse;
-						CString oLine;
-						while (pFile->ReadString(oLine))
-						{
-							oResponse += oLine;
-						}
+				bSent = pRequest->pFile->SendRequest(oHeaders, (LPVOID)(LPCSTR)*pSend->pBodyA, pSend->pBodyA->GetLength());
+			}
+			else
+			{
+				bSent = pRequest->pFile->SendRequest();
+			}
 
-						// Parse JSON response (simple parsing)
-						if (oResponse.Find(_T("\"status\":\"success\"")) >= 0)
-						{
-							// Extract values using simple string parsing
-							int pos;
+			if (bSent)
+			{
+				pRequest->pFile->QueryInfoStatusCode(pRequest->dwStatusCode);
+				return TRUE;
+			}
+		}
+	}
+	catch (CInternetException* e)
+	{
+		e->Delete();
+	}
 
-							// Parse LTP
-							pos = oResponse.Find(_T("\"ltp\":"));
-							if (pos >= 0)
-							{
-								pos += 6;
-								int endPos = oResponse.Find(_T(","), pos);
-								if (endPos < 0) endPos = oResponse.Find(_T("}"), pos);
-								CString val = oResponse.Mid(pos, endPos - pos);
-								quote.ltp = (float)_tstof(val);
-							}
+	if (pRequest->pFile)
+	{
+		try
+		{
+			pRequest->pFile->Close();
+		}
+		catch (CInternetException* e)
+		{
+			e->Delete();
+		}
+		delete pRequest->pFile;
+		pRequest->pFile = NULL;
+	}
+	return FALSE;
+}
 
-							// Parse Open
-							pos = oResponse.Find(_T("\"open\":"));
-							if (pos >= 0)
-							{
-								pos += 7;
-								int endPos = oResponse.Find(_T(","), pos);
-								if (endPos < 0) endPos = oResponse.Find(_T("}"), pos);
-								CString val = oResponse.Mid(pos, endPos - pos);
-								quote.open = (float)_tstof(val);
-							}
+// Send a request to the OpenAlgo server on a pooled connection.
+// pBody != NULL sends it as a JSON body; NULL sends a bodyless request (GET).
+// On TRUE, pRequest->dwStatusCode is set and the body can be read from pRequest->pFile.
+// OpenAlgoHttpEnd() must be called in every case, including after a CInternetException
+// thrown while reading the body.
+BOOL OpenAlgoHttpBegin(OpenAlgoHttpRequest* pRequest, int nVerb, LPCTSTR pszEndpoint, const CString* pBody, DWORD dwTimeoutMs)
+{
+	pRequest->server = g_oServer;
+	pRequest->server.Replace(_T("http://"), _T(""));
+	pRequest->server.Replace(_T("https://"), _T(""));
+	pRequest->nPort = (INTERNET_PORT)g_nPortNumber;
+	pRequest->endpoint = pszEndpoint;
+	pRequest->dwStatusCode = 0;
+	QueryPerformanceCounter(&pRequest->liStart);
+
+	CStringA oBodyA;
+	if (pBody != NULL)
+	{
+		oBodyA = CStringA(*pBody);
+	}
 
-							// Parse High
-							pos = oResponse.Find(_T("\"high\":"));
-							if (pos >= 0)
-							{
-								pos += 7;
-								int endPos = oResponse.Find(_T(","), pos);
-								if (endPos < 0) endPos = oResponse.Find(_T("}"), pos);
-								CString val = oResponse.Mid(pos, endPos - pos);
-								quote.high = (float)_tstof(val);
-							}
+	if (g_bHttpPoolInitialized)
+	{
+		OpenAlgoHttpSend send = { pRequest, nVerb, pszEndpoint, (pBody != NULL) ? &oBodyA : NULL, dwTimeoutMs };
+		pRequest->pConnection = (CHttpConnection*)SendOnHttpConnection(&g_HttpPool, pRequest->server, pRequest->nPort,
+			GetTickCount(), SendOpenAlgoHttpRequest, &send, &pRequest->bReusedConnection);
+		if (pRequest->pConnection != NULL)
+			return TRUE;
+	}
 
-							// Parse Low
-							pos = oResponse.Find(_T("\"low\":"));
-							if (pos >= 0)
-							{
-								pos += 6;
-								int endPos = oResponse.Find(_T(","), pos);
-								if (endPos < 0) endPos = oResponse.Find(_T("}"), pos);
-								CString val = oResponse.Mid(pos, endPos - pos);
-								quote.low = (float)_tstof(val);
-							}
+	OpenAlgoHttpEnd(pRequest, FALSE);
+	return FALSE;
+}
 
-							// Parse Volume
-							pos = oResponse.Find(_T("\"volume\":"));
-							if (pos >= 0)
-							{
-								pos += 9;
-								int endPos = oResponse.Find(_T(","), pos);
-								if (endPos < 0) endPos = oResponse.Find(_T("}"), pos);
-								CString val = oResponse.Mid(pos, endPos - pos);
-								quote.volume = (float)_tstof(val);
-							}
+// Finish a request: close the response, pool or close the connection, record latency.
+// bKeepConnection = FALSE if the response could not be read cleanly.
+// Safe to call more than once.
+void OpenAlgoHttpEnd(OpenAlgoHttpRequest* pRequest, BOOL bKeepConnection)
+{
+	if (pRequest->liStart.QuadPart == 0)
+		return;
 
-							// Parse OI
-							pos = oResponse.Find(_T("\"oi\":"));
-							if (pos >= 0)
-							{
-								pos += 5;
-								int endPos = oResponse.Find(_T(","), pos);
-								if (endPos < 0) endPos = oResponse.Find(_T("}"), pos);
-								CString val = oResponse.Mid(pos, endPos - pos);
-								quote.oi = (float)_tstof(val);
-							}
+	if (pRequest->pFile)
+	{
+		try
+		{
+			pRequest->pFile->Close();
+		}
+		catch (CInternetException* e)
+		{
+			e->Delete();
+			bKeepConnection = FALSE;
+		}
+		delete pRequest->pFile;
+		pRequest->pFile = NULL;
+	}
 
-							// Parse Previous Close
-							pos = oResponse.Find(_T("\"prev_close\":"));
-							if (pos >= 0)
-							{
-								pos += 13;
-								int endPos = oResponse.Find(_T(","), pos);
-								if (endPos < 0) endPos = oResponse.Find(_T("}"), pos);
-								CString val = oResponse.Mid(pos, endPos - pos);
-								quote.close = (float)_tstof(val);
-							}
+	if (pRequest->pConnection != NULL && g_bHttpPoolInitialized)
+	{
+		ReleaseHttpConnection(&g_HttpPool, pRequest->pConnection, pRequest->server, pRequest->nPort, GetTickCount(), bKeepConnection);
+	}
+	else
+	{
+		CloseHttpConnection(pRequest->pConnection);
+	}
+	pRequest->pConnection = NULL;
 
-							quote.symbol = symbol;
-							quote.exchange = exchange;
-							quote.lastUpdate = (DWORD)GetTickCount64();
+	__int64 nLatencyUs = HttpElapsedUs(pRequest->liStart);
+	pRequest->liStart.QuadPart = 0;
 
-							bSuccess = TRUE;
-						}
-					}
-				}
+	BOOL bFailed = (!bKeepConnection || pRequest->dwStatusCode != 200);
+	BOOL bLogSummary = FALSE;
+	HttpClientStats stats;
 
-				pFile->Close();
-				delete pFile;
-			}
+	if (g_bHttpPoolInitialized)
+	{
+		bLogSummary = RecordHttpRequest(&g_HttpPool, nLatencyUs, bFailed, &stats);
+	}
 
-			pConnection->Close();
-			delete pConnection;
-		}
+	if (bFailed)
+	{
+		CString failMsg;
+		failMsg.Format(_T("OpenAlgo: HTTP %s failed (status %lu) after %.1f ms on %s connection"),
+			(LPCTSTR)pRequest->endpoint, pRequest->dwStatusCode, nLatencyUs / 1000.0,
+			pRequest->bReusedConnection ? _T("a reused") : _T("a new"));
+		OutputDebugString(failMsg);
+	}
 
-		oSession.Close();
+	if (bLogSummary)
+	{
+		CString statsMsg;
+		statsMsg.Format(_T("OpenAlgo: HTTP stats - %ld requests, %ld failed, avg %.1f ms, max %.1f ms, last %.1f ms, connections %ld new / %ld reused"),
+			stats.nRequests, stats.nFailures, stats.nTotalLatencyUs / 1000.0 / stats.nRequests,
+			stats.nMaxLatencyUs / 1000.0, stats.nLastLatencyUs / 1000.0,
+			stats.nConnectionsOpened, stats.nConnectionsReused);
+		OutputDebugString(statsMsg);
 	}
-	catch (CInternetException* e)
+}
+
+// Consistent copy of the latency counters (for GetStatus)
+void GetHttpClientStats(HttpClientStats* pStats)
+{
+	if (!g_bHttpPoolInitialized)
 	{
-		e->Delete();
+		*pStats = HttpClientStats();
+		return;
 	}
 
-	return bSuccess;
+	GetHttpPoolStats(&g_HttpPool, pStats);
 }
 
-// Fetch historical data from OpenAlgo with intelligent backfill strategy
-// COMPLETELY EXCHANGE-AGNOSTIC - Works with ANY exchange and ANY trading hours
-//
-// OPTIMAL GAP-FREE BACKFILL STRATEGY (DATE-BASED):
-// - First load: 30 days (1m) or 10 years (daily) of historical data
-// - Subsequent refreshes: Smart gap detection from last bar's date
-// - Automatically fills data gaps (user absences, network outages, etc.)
-// - Safety limits: Max 30 days for 1m, max 730 days (2 years) for daily
-// - Zero data holes within safety limits
-//
+// Close every pooled connection and the shared session (Release)
+void CleanupHttpClient(void)
+{
+	if (!g_bHttpPoolInitialized)
+		return;
+
+	EnterCriticalSection(&g_HttpPool.lock);
+
+	CloseIdleHttpConnections(&g_HttpPool);
+
+	if (g_pHttpSession != NULL)
+	{
+		try
+		{
+			g_pHttpSession->Close();
+		}
+		catch (CInternetException* e)
+		{
+			e->Delete();
+		}
+		delete g_pHttpSession;
+		g_pHttpSession = NULL;
+	}
+
+	LeaveCriticalSection(&g_HttpPool.lock);
+}
+
+// Fetch real-time quote from OpenAlgo
+// WARNING: This is ONLY for Level 1 quotes in Real-time Quote Window
+// NEVER use this data for creating OHLC bars or historical charts
+BOOL GetOpenAlgoQuote(LPCTSTR pszTicker, QuoteCache& quote)
+{
+	AFX_MANAGE_STATE(AfxGetStaticModuleState());
+
+	if (g_oApiKey.IsEmpty())
+		return FALSE;
+
+	BOOL bSuccess = FALSE;
+	OpenAlgoHttpRequest request;
+
+	try
+	{
+		// Prepare POST data
+		CString symbol = GetCleanSymbol(pszTicker);
+		CString exchange = GetExchangeFromTicker(pszTicker);
+
+		CString oPostData;
+		oPostData.Format(_T("{\"apikey\":\"%s\",\"symbol\":\"%s\",\"exchange\":\"%s\"}"),
+			(LPCTSTR)g_oApiKey, (LPCTSTR)symbol, (LPCTSTR)exchange);
+
+		if (OpenAlgoHttpBegin(&request, CHttpConnection::HTTP_VERB_POST, _T("/api/v1/quotes"), &oPostData, 3000) &&
+			request.dwStatusCode == 200)
+		{
+			CString oResponse;
+			CString oLine;
+			while (request.pFile->ReadString(oLine))
+			{
+				oResponse += oLine;
+			}
+
+			// Parse JSON response (simple parsing)
+			if (oResponse.Find(_T("\"status\":\"success\"")) >= 0)
+			{
+				// Extract values with the market data tokenizer (same field names as the WebSocket quote)
+				CStringA oResponseA(oResponse);
+				MarketTick fields;
+				ParseMarketDataMessage(oResponseA, oResponseA.GetLength(), &fields);
+				FillQuoteFromTick(&fields, exchange, &quote);
+
+				bSuccess = TRUE;
+			}
+		}
+
+		OpenAlgoHttpEnd(&request, TRUE);
+	}
+	catch (CInternetException* e)
+	{
+		e->Delete();
+		OpenAlgoHttpEnd(&request, FALSE);
+	}
+
+	return bSuccess;
+}
+
+// Copy a parsed /api/v1/quotes or /api/v1/multiquotes entry into a QuoteCache
+void FillQuoteFromTick(const MarketTick* pFields, LPCTSTR pszExchange, QuoteCache* pQuote)
+{
+	pQuote->ltp = pFields->ltp;
+	pQuote->open = pFields->open;
+	pQuote->high = pFields->high;
+	pQuote->low = pFields->low;
+	pQuote->volume = pFields->volume;
+	pQuote->oi = pFields->oi;
+	pQuote->close = pFields->prevClose;  // Previous Close
+	pQuote->bid = pFields->bid;
+	pQuote->ask = pFields->ask;
+
+	_tcsncpy_s(pQuote->exchange, QUOTE_EXCHANGE_SIZE, pszExchange, _TRUNCATE);
+	pQuote->lastUpdate = (DWORD)GetTickCount64();
+}
+
+///////////////////////////////
+// History Response Parser
+///////////////////////////////
+//
+// Streaming parser and merge of /api/v1/history bodies: see HistoryResponse.h.
+// RequestHistoryRange() feeds it HISTORY_READ_CHUNK_SIZE bytes at a time.
+
+#define HISTORY_READ_CHUNK_SIZE  16384  // Bytes per CHttpFile::Read()
+
+// Waiters on a coalesced request get every candle (HistoryMergeContext::pfnRecordBar)
+static void RecordHistoryFlightCandle(void* pContext, const struct Quotation* pBar)
+{
+	RecordHistoryFlightBar((HistoryFlight*)pContext, pBar);
+}
+
+///////////////////////////////
+// Bar Cache
+///////////////////////////////
+//
+// Past days never change, so completed days of history are kept on disk and
+// only the days after the last cached bar are requested from the server.
+// Each symbol/periodicity pair has one file under <database>\OpenAlgoCache,
+// stored column by column (see BarCache.h for the layout) and accessed
+// through a file mapping. Only bars before today are written; today's bars are
+// still changing and always come from OpenAlgo.
+
+CString GetBarCachePath(LPCTSTR pszTicker, int nPeriodicity)
+{
+	// Tickers may contain characters that are not allowed in file names
+	CString name = pszTicker;
+	LPCTSTR pszInvalid = _T("\\/:*?\"<>|");
+	for (int i = 0; pszInvalid[i] != 0; i++)
+	{
+		name.Replace(pszInvalid[i], _T('_'));
+	}
+
+	CString path;
+	path.Format(_T("%s\\%s_%d.bars"), (LPCTSTR)g_oBarCacheDir, (LPCTSTR)name, nPeriodicity);
+	return path;
+}
+
+// Copy cached bars into pQuotes after nLastValid and merge them in time order with
+// the bars already there (bars of the other kind in a mixed EOD/intraday array).
+// Returns the new nLastValid.
+int LoadBarCache(LPCTSTR pszTicker, int nPeriodicity, int nLastValid, int nSize, struct Quotation* pQuotes)
+{
+	if (!g_bBarCacheEnabled || g_oBarCacheDir.IsEmpty() || !g_bBarCacheCriticalSectionInitialized)
+		return nLastValid;
+
+	int nRoom = nSize - (nLastValid + 1);
+	if (nRoom <= 0)
+		return nLastValid;
+
+	CString path = GetBarCachePath(pszTicker, nPeriodicity);
+
+	EnterCriticalSection(&g_BarCacheCriticalSection);
+	int nLoaded = ReadBarCache(path, nPeriodicity, nRoom, pQuotes + nLastValid + 1);
+	LeaveCriticalSection(&g_BarCacheCriticalSection);
+
+	if (nLoaded == 0)
+		return nLastValid;
+
+	// Cached rows are sorted and unique - merge them like a history response
+	HistoryMergeContext ctx(pQuotes, nSize, nPeriodicity, nLastValid);
+	ctx.quoteIndex = nLastValid + 1 + nLoaded;
+	MergeHistoryRun(&ctx);
+
+	CString loadMsg;
+	loadMsg.Format(_T("OpenAlgo: Loaded %d cached bars for %s (periodicity %d)"), nLoaded, pszTicker, nPeriodicity);
+	OutputDebugString(loadMsg);
+
+	return ctx.quoteIndex - 1;
+}
+
+// Write completed days (before today on the exchange) of the requested kind that the cache does not
+// hold yet (WriteBarCache())
+void StoreBarCache(LPCTSTR pszTicker, int nPeriodicity, int nCount, const struct Quotation* pQuotes)
+{
+	if (!g_bBarCacheEnabled || g_oBarCacheDir.IsEmpty() || !g_bBarCacheCriticalSectionInitialized)
+		return;
+
+	if ((nPeriodicity != 60 && nPeriodicity != 86400) || nCount <= 0 || pQuotes == NULL)
+		return;
+
+	// Bars from today on are still changing. Bars are dated in exchange time, which
+	// can be a day ahead of or behind this machine's local date.
+	CString exchange = GetExchangeFromTicker(pszTicker);
+	UINT32 nTodayKey = GetBarCacheTodayKey(_time64(NULL), GetExchangeUtcOffsetSeconds(exchange));
+
+	CString path = GetBarCachePath(pszTicker, nPeriodicity);
+
+	EnterCriticalSection(&g_BarCacheCriticalSection);
+	WriteBarCache(path, nPeriodicity, nTodayKey, nCount, pQuotes);
+	LeaveCriticalSection(&g_BarCacheCriticalSection);
+}
+
+// Fetch historical data from OpenAlgo with intelligent backfill strategy
+// COMPLETELY EXCHANGE-AGNOSTIC - Works with ANY exchange and ANY trading hours
+//
+// OPTIMAL GAP-FREE BACKFILL STRATEGY (DATE-BASED):
+// - First load: 30 days (1m) or 10 years (daily) of historical data
+// - Subsequent refreshes: Smart gap detection from last bar's date
+// - Automatically fills data gaps (user absences, network outages, etc.)
+// - Safety limits: Max 30 days for 1m, max 730 days (2 years) for daily
+// - Zero data holes within safety limits
+//
 // HOW IT WORKS:
 // 1. Extract last bar's DATE (not time) from existing data
 // 2. Calculate gap in days between last bar and today
@@ -517,18 +1371,24 @@ BOOL GetOpenAlgoQuote(LPCTSTR pszTicker, QuoteCache& quote)
 // - Crypto: 24x7 including weekends
 // - Any future sessions that exchanges may introduce
 //
+// nBackfillDays > 0 skips all of the above and requests exactly that many days
+// (All Symbols backfill). *pbSucceeded (optional) = TRUE if the server answered
+// with "status":"success", even without candles. hStopEvent (optional) ends a
+// chunked download after the requests in progress.
+//
 // Currently supports 1m and D (daily) intervals
-int GetOpenAlgoHistory(LPCTSTR pszTicker, int nPeriodicity, int nLastValid, int nSize, struct Quotation* pQuotes)
+int GetOpenAlgoHistory(LPCTSTR pszTicker, int nPeriodicity, int nLastValid, int nSize, struct Quotation* pQuotes, int nBackfillDays, BOOL* pbSucceeded, HANDLE hStopEvent, TokenBucket* pBucket)
 {
 	AFX_MANAGE_STATE(AfxGetStaticModuleState());
 
+	if (pbSucceeded != NULL)
+		*pbSucceeded = FALSE;
+
 	if (g_oApiKey.IsEmpty())
 		return nLastValid + 1;
 
 	try
 	{
-		CString oURL = BuildOpenAlgoURL(g_oServer, g_nPortNumber, _T("/api/v1/history"));
-
 		// Prepare POST data
 		CString symbol = GetCleanSymbol(pszTicker);
 		CString exchange = GetExchangeFromTicker(pszTicker);
@@ -541,6 +1401,13 @@ int GetOpenAlgoHistory(LPCTSTR pszTicker, int nPeriodicity, int nLastValid, int
 		CTime startTime;
 		CTime endTime = todayDate;  // Request up to today for both Daily and Intraday
 
+		// Explicit range from the backfill scheduler
+		if (nBackfillDays > 0)
+		{
+			startTime = todayDate - CTimeSpan((LONG)nBackfillDays, 0, 0, 0);
+			goto skip_gap_detection;
+		}
+
 		// Check if manual backfill was requested - override normal logic
 		if (g_bBackfillRequested && g_nBackfillPeriodicity == nPeriodicity && g_nBackfillDays > 0)
 		{
@@ -550,6 +1417,14 @@ int GetOpenAlgoHistory(LPCTSTR pszTicker, int nPeriodicity, int nLastValid, int
 			goto skip_gap_detection;
 		}
 
+		// Nothing of this periodicity loaded yet (e.g. after a restart): serve completed days
+		// from the on-disk bar cache. The gap detection below then only requests the days
+		// after the last cached bar.
+		if (pQuotes != NULL && FindLastBarOfMatchingType(nPeriodicity, nLastValid, pQuotes) < 0)
+		{
+			nLastValid = LoadBarCache(pszTicker, nPeriodicity, nLastValid, nSize, pQuotes);
+		}
+
 		// SMART GAP-FREE BACKFILL LOGIC WITH MIXED EOD/INTRADAY SUPPORT
 		if (nLastValid >= 0 && pQuotes != NULL)
 		{
@@ -708,366 +1583,53 @@ skip_gap_detection:
 		//	(LPCTSTR)symbol, (LPCTSTR)exchange, (LPCTSTR)interval, (LPCTSTR)startDate, (LPCTSTR)endDate);
 		//OutputDebugString(apiDebugMsg);
 
-		CString oPostData;
-		oPostData.Format(_T("{\"apikey\":\"%s\",\"symbol\":\"%s\",\"exchange\":\"%s\",\"interval\":\"%s\",\"start_date\":\"%s\",\"end_date\":\"%s\"}"),
-			(LPCTSTR)g_oApiKey, (LPCTSTR)symbol, (LPCTSTR)exchange, (LPCTSTR)interval, (LPCTSTR)startDate, (LPCTSTR)endDate);
-
-		CInternetSession oSession(AGENT_NAME, 1, INTERNET_OPEN_TYPE_DIRECT, NULL, NULL,
-			INTERNET_FLAG_DONT_CACHE);
-		oSession.SetOption(INTERNET_OPTION_CONNECT_TIMEOUT, 10000);
-		oSession.SetOption(INTERNET_OPTION_RECEIVE_TIMEOUT, 10000);
-
-		CHttpConnection* pConnection = NULL;
-		CHttpFile* pFile = NULL;
+		// Deep ranges (manual backfills) as date chunks in parallel - see "Chunked History Download"
+		// (the 30-day 1-minute first load spans exactly 30 days and stays one request)
+		int nChunkDays = (nPeriodicity == 86400) ? g_nHistoryChunkDaysDaily : g_nHistoryChunkDays1m;
+		int nSpanDays = (int)(endTime - startTime).GetDays();
+		if (nChunkDays > 0 && nSpanDays > nChunkDays)
+		{
+			// The backfill scheduler already downloads several symbols at once
+			int nConcurrency = (nBackfillDays > 0) ? 1 : g_nHistoryChunkConcurrency;
+			return GetOpenAlgoHistoryChunked(pszTicker, symbol, exchange, interval, nPeriodicity, startTime,
+				nSpanDays + 1, nChunkDays, nConcurrency, nLastValid, nSize, pQuotes, pbSucceeded, hStopEvent, pBucket);
+		}
 
-		// Parse server
-		INTERNET_PORT nPort = (INTERNET_PORT)g_nPortNumber;
-		CString oServer = g_oServer;
-		oServer.Replace(_T("http://"), _T(""));
-		oServer.Replace(_T("https://"), _T(""));
+		// Stream the body through the parser - candles land directly in pQuotes
+		// Memory use is one read chunk plus one candle, whatever the response size
+		HistoryMergeContext ctx(pQuotes, nSize, nPeriodicity, nLastValid);
+		int nCandles = 0;
+		BOOL bStatusSuccess = RequestHistoryRange(symbol, exchange, interval, startDate, endDate, &ctx, &nCandles, pBucket, hStopEvent);
 
-		pConnection = oSession.GetHttpConnection(oServer, nPort);
+		if (pbSucceeded != NULL)
+			*pbSucceeded = bStatusSuccess;
 
-		if (pConnection)
+		// Parse JSON response
+		if (bStatusSuccess && nCandles > 0)
 		{
-			pFile = pConnection->OpenRequest(
-				CHttpConnection::HTTP_VERB_POST,
-				_T("/api/v1/history"),
-				NULL, 1, NULL, NULL,
-				INTERNET_FLAG_RELOAD | INTERNET_FLAG_DONT_CACHE);
-
-			if (pFile)
-			{
-				CString oHeaders = _T("Content-Type: application/json\r\n");
-				CStringA oPostDataA(oPostData);
-
-				if (pFile->SendRequest(oHeaders, (LPVOID)(LPCSTR)oPostDataA, oPostDataA.GetLength()))
-				{
-					DWORD dwStatusCode = 0;
-					pFile->QueryInfoStatusCode(dwStatusCode);
+			// CRITICAL: Keep quotes sorted by timestamp (oldest to newest)
+			// The merge places new candles in chronological order among the existing bars
+			MergeHistoryRun(&ctx);
+			int quoteIndex = ctx.quoteIndex;  // Never past nSize - candles that do not fit are dropped
 
-					if (dwStatusCode == 200)
-					{
-						CString oResponse;
-						CString oLine;
-						while (pFile->ReadString(oLine))
-						{
-							oResponse += oLine;
-						}
+			// DO NOT mix quote data with historical interval data
+			// Quote data is for real-time window only, not for OHLC bars
+			// Historical data from OpenAlgo is already complete and accurate
 
-						// Parse JSON response
-						if (oResponse.Find(_T("\"status\":\"success\"")) >= 0)
-						{
-							// Find data array
-							int dataStart = oResponse.Find(_T("\"data\":["));
-							if (dataStart >= 0)
-							{
-								dataStart += 8;
-								int dataEnd = oResponse.Find(_T("]"), dataStart);
-								if (dataEnd < 0) dataEnd = oResponse.GetLength();
-								CString dataArray = oResponse.Mid(dataStart, dataEnd - dataStart);
-
-								// DEBUG: Log data received
-								//CString dataDebugMsg;
-								//dataDebugMsg.Format(_T("API RESPONSE - DataLength: %d bytes"), dataArray.GetLength());
-								//OutputDebugString(dataDebugMsg);
-
-								// Debug: Check if we have meaningful data
-								if (dataArray.GetLength() < 10)
-								{
-									// Very little data, might be an issue
-									//OutputDebugString(_T("WARNING: Very little data received from API"));
-									return nLastValid + 1;
-								}
-
-								// Parse each candle and merge with existing data
-								int quoteIndex = 0;
-								int pos = 0;
-								int originalLastValid = nLastValid;  // Save for accurate counting
-
-								// If we have existing data, we'll need to merge properly
-								BOOL bHasExistingData = (nLastValid >= 0);
-								if (bHasExistingData)
-								{
-									// CRITICAL: Check if array is near full before adding new data
-									// If array is 95% full, remove oldest 10% to make room for new bars
-									const int ARRAY_THRESHOLD = (int)(nSize * 0.95);  // 95% full
-									const int BARS_TO_REMOVE = (int)(nSize * 0.10);   // Remove 10%
-
-									if (nLastValid >= ARRAY_THRESHOLD)
-									{
-										// Array is nearly full - shift data to remove oldest bars
-										memmove(pQuotes, pQuotes + BARS_TO_REMOVE, (nLastValid - BARS_TO_REMOVE + 1) * sizeof(struct Quotation));
-										nLastValid -= BARS_TO_REMOVE;
-
-										// DEBUG: Log array cleanup
-										//CString cleanupMsg;
-										//cleanupMsg.Format(_T("ARRAY CLEANUP - Removed %d oldest bars, New nLastValid: %d"), BARS_TO_REMOVE, nLastValid);
-										//OutputDebugString(cleanupMsg);
-									}
-
-									// Start appending after existing data
-									quoteIndex = nLastValid + 1;
-								}
-
-								// Count duplicates for debugging
-								int duplicateCount = 0;
-								int uniqueCount = 0;
-
-								while (pos < dataArray.GetLength() && quoteIndex < nSize)
-								{
-									int candleStart = dataArray.Find(_T("{"), pos);
-									if (candleStart < 0) break;
-
-									int candleEnd = dataArray.Find(_T("}"), candleStart);
-									if (candleEnd < 0) break;
-
-									CString candle = dataArray.Mid(candleStart, candleEnd - candleStart + 1);
-
-									// Parse timestamp
-									int tsPos = candle.Find(_T("\"timestamp\":"));
-									if (tsPos >= 0)
-									{
-										tsPos += 12;
-										int tsEnd = candle.Find(_T(","), tsPos);
-										if (tsEnd < 0) tsEnd = candle.Find(_T("}"), tsPos);
-										CString tsStr = candle.Mid(tsPos, tsEnd - tsPos);
-										time_t timestamp = (time_t)_tstoi64(tsStr);
-
-										// Convert to AmiBroker date
-									if (nPeriodicity == 86400) // Daily data
-									{
-										// For daily data, set the DAILY_MASK and EOD markers
-										ConvertUnixToPackedDate(timestamp, &pQuotes[quoteIndex].DateTime);
-										pQuotes[quoteIndex].DateTime.Date |= DAILY_MASK;
-
-										// Set EOD markers and normalize ALL time fields
-										// CRITICAL: All Daily bars must have identical time fields
-										// to avoid display issues with the last candle
-										pQuotes[quoteIndex].DateTime.PackDate.Hour = 31;      // EOD marker
-										pQuotes[quoteIndex].DateTime.PackDate.Minute = 63;    // EOD marker
-										pQuotes[quoteIndex].DateTime.PackDate.Second = 0;     // Normalize
-										pQuotes[quoteIndex].DateTime.PackDate.MilliSec = 0;   // Normalize
-										pQuotes[quoteIndex].DateTime.PackDate.MicroSec = 0;   // Normalize
-									}
-									else
-									{
-										// For intraday data
-										ConvertUnixToPackedDate(timestamp, &pQuotes[quoteIndex].DateTime);
-
-										// CRITICAL FIX: Normalize sub-minute time fields for 1-minute bars
-										// This prevents freak candles during live updates when seconds change
-										// Same principle as Daily bars - all bars for the same minute must have
-										// identical time fields to avoid duplicate bar creation
-										if (nPeriodicity == 60) // 1-minute data
-										{
-											pQuotes[quoteIndex].DateTime.PackDate.Second = 0;     // Normalize
-											pQuotes[quoteIndex].DateTime.PackDate.MilliSec = 0;   // Normalize
-											pQuotes[quoteIndex].DateTime.PackDate.MicroSec = 0;   // Normalize
-										}
-									}
-
-										// Parse OHLCV
-										int oPos = candle.Find(_T("\"open\":"));
-										if (oPos >= 0)
-										{
-											oPos += 7;
-											int oEnd = candle.Find(_T(","), oPos);
-											CString val = candle.Mid(oPos, oEnd - oPos);
-											pQuotes[quoteIndex].Open = (float)_tstof(val);
-										}
-
-										int hPos = candle.Find(_T("\"high\":"));
-										if (hPos >= 0)
-										{
-											hPos += 7;
-											int hEnd = candle.Find(_T(","), hPos);
-											CString val = candle.Mid(hPos, hEnd - hPos);
-											pQuotes[quoteIndex].High = (float)_tstof(val);
-										}
-
-										int lPos = candle.Find(_T("\"low\":"));
-										if (lPos >= 0)
-										{
-											lPos += 6;
-											int lEnd = candle.Find(_T(","), lPos);
-											CString val = candle.Mid(lPos, lEnd - lPos);
-											pQuotes[quoteIndex].Low = (float)_tstof(val);
-										}
-
-										int cPos = candle.Find(_T("\"close\":"));
-										if (cPos >= 0)
-										{
-											cPos += 8;
-											int cEnd = candle.Find(_T(","), cPos);
-											if (cEnd < 0) cEnd = candle.Find(_T("}"), cPos);
-											CString val = candle.Mid(cPos, cEnd - cPos);
-											pQuotes[quoteIndex].Price = (float)_tstof(val);
-										}
-
-										int vPos = candle.Find(_T("\"volume\":"));
-										if (vPos >= 0)
-										{
-											vPos += 9;
-											int vEnd = candle.Find(_T(","), vPos);
-											if (vEnd < 0) vEnd = candle.Find(_T("}"), vPos);
-											CString val = candle.Mid(vPos, vEnd - vPos);
-											pQuotes[quoteIndex].Volume = (float)_tstof(val);
-										}
-
-										int oiPos = candle.Find(_T("\"oi\":"));
-										if (oiPos >= 0)
-										{
-											oiPos += 5;
-											int oiEnd = candle.Find(_T(","), oiPos);
-											if (oiEnd < 0) oiEnd = candle.Find(_T("}"), oiPos);
-											CString val = candle.Mid(oiPos, oiEnd - oiPos);
-											pQuotes[quoteIndex].OpenInterest = (float)_tstof(val);
-										}
-
-										// Set auxiliary data
-										pQuotes[quoteIndex].AuxData1 = 0;
-										pQuotes[quoteIndex].AuxData2 = 0;
-
-										// Check for duplicate timestamps against existing data
-										// FIXED: Properly handle mixed EOD/Intraday data without mktime() corruption
-										BOOL bIsDuplicate = FALSE;
-										if (bHasExistingData)
-										{
-											// Get new bar's properties
-											BOOL bNewBarIsEOD = (pQuotes[quoteIndex].DateTime.PackDate.Hour == DATE_EOD_HOURS &&
-											                     pQuotes[quoteIndex].DateTime.PackDate.Minute == DATE_EOD_MINUTES);
-
-											// Check against ALL existing bars for same-day duplicates
-											// CRITICAL: After sorting, today's bars are scattered throughout array
-											// Must check entire array, not just "last N bars by index"
-											// Optimization: array is sorted, so stop when date changes
-											unsigned int newBarYear = pQuotes[quoteIndex].DateTime.PackDate.Year;
-											unsigned int newBarMonth = pQuotes[quoteIndex].DateTime.PackDate.Month;
-											unsigned int newBarDay = pQuotes[quoteIndex].DateTime.PackDate.Day;
-
-											for (int i = nLastValid; i >= 0; i--)
-											{
-												// SOLUTION 2: Filter by periodicity - Never compare across interval types
-												BOOL bExistingBarIsEOD = (pQuotes[i].DateTime.PackDate.Hour == DATE_EOD_HOURS &&
-												                          pQuotes[i].DateTime.PackDate.Minute == DATE_EOD_MINUTES);
-
-												// Skip if different interval types (EOD vs Intraday)
-												if (bNewBarIsEOD != bExistingBarIsEOD)
-													continue;
-
-												// Optimization: Since sorted by time, if existing bar is older than new bar's date, stop searching
-												if (pQuotes[i].DateTime.PackDate.Year < newBarYear ||
-												    (pQuotes[i].DateTime.PackDate.Year == newBarYear && pQuotes[i].DateTime.PackDate.Month < newBarMonth) ||
-												    (pQuotes[i].DateTime.PackDate.Year == newBarYear && pQuotes[i].DateTime.PackDate.Month == newBarMonth && pQuotes[i].DateTime.PackDate.Day < newBarDay))
-												{
-													break;  // No more bars from same day
-												}
-
-												// SOLUTION 3: Direct PackDate comparison instead of mktime()
-												BOOL bSameBar = FALSE;
-
-												if (bNewBarIsEOD)
-												{
-													// For EOD bars: Compare DATE ONLY (Year, Month, Day)
-													// Ignore time components since Hour=31, Minute=63 are markers, not actual time
-													bSameBar = (pQuotes[quoteIndex].DateTime.PackDate.Year == pQuotes[i].DateTime.PackDate.Year &&
-													           pQuotes[quoteIndex].DateTime.PackDate.Month == pQuotes[i].DateTime.PackDate.Month &&
-													           pQuotes[quoteIndex].DateTime.PackDate.Day == pQuotes[i].DateTime.PackDate.Day);
-												}
-												else
-												{
-													// For Intraday bars: Compare full timestamp (Year, Month, Day, Hour, Minute)
-													// Allow same minute to be considered duplicate
-													bSameBar = (pQuotes[quoteIndex].DateTime.PackDate.Year == pQuotes[i].DateTime.PackDate.Year &&
-													           pQuotes[quoteIndex].DateTime.PackDate.Month == pQuotes[i].DateTime.PackDate.Month &&
-													           pQuotes[quoteIndex].DateTime.PackDate.Day == pQuotes[i].DateTime.PackDate.Day &&
-													           pQuotes[quoteIndex].DateTime.PackDate.Hour == pQuotes[i].DateTime.PackDate.Hour &&
-													           pQuotes[quoteIndex].DateTime.PackDate.Minute == pQuotes[i].DateTime.PackDate.Minute);
-												}
-
-												if (bSameBar)
-												{
-													bIsDuplicate = TRUE;
-													// Update existing bar with latest data instead of adding new
-													pQuotes[i].Price = pQuotes[quoteIndex].Price; // Close
-													pQuotes[i].High = max(pQuotes[i].High, pQuotes[quoteIndex].High);
-													pQuotes[i].Low = (pQuotes[i].Low == 0) ? pQuotes[quoteIndex].Low : min(pQuotes[i].Low, pQuotes[quoteIndex].Low);
-													pQuotes[i].Volume = pQuotes[quoteIndex].Volume;
-													pQuotes[i].OpenInterest = pQuotes[quoteIndex].OpenInterest;
-													break;
-												}
-											}
-										}
-
-										// Only add new bar if it's not a duplicate
-										if (!bIsDuplicate)
-										{
-											quoteIndex++;
-											uniqueCount++;
-										}
-										else
-										{
-											duplicateCount++;
-										}
-									}
-
-									pos = candleEnd + 1;
-								}
-
-								// DO NOT mix quote data with historical interval data
-								// Quote data is for real-time window only, not for OHLC bars
-								// Historical data from OpenAlgo is already complete and accurate
-
-								pFile->Close();
-								delete pFile;
-								pConnection->Close();
-								delete pConnection;
-								oSession.Close();
-
-								// CRITICAL: Sort quotes by timestamp (oldest to newest)
-								// This ensures proper chronological order after merging new data with existing data
-								// Without sorting, timestamps can be mixed up when filling gaps or adding historical data
-								if (quoteIndex > 0)
-								{
-									qsort(pQuotes, quoteIndex, sizeof(struct Quotation), CompareQuotations);
-								}
-
-								// If we have more data than the array can hold, keep the most recent data
-								if (quoteIndex > nSize)
-								{
-									int excessBars = quoteIndex - nSize;
-									memmove(pQuotes, pQuotes + excessBars, nSize * sizeof(struct Quotation));
-									quoteIndex = nSize;
-								}
-
-								// DEBUG: Log final result
-								//CString resultDebugMsg;
-								//resultDebugMsg.Format(_T("BACKFILL COMPLETE - Total: %d, Original: %d, Unique: %d, Duplicates: %d"),
-								//	quoteIndex, originalLastValid + 1, uniqueCount, duplicateCount);
-								//OutputDebugString(resultDebugMsg);
-
-								return quoteIndex;
-							}
-						}
-					}
-				}
+			// Keep completed days on disk for the next start
+			StoreBarCache(pszTicker, nPeriodicity, quoteIndex, pQuotes);
 
-				if (pFile)
-				{
-					pFile->Close();
-					delete pFile;
-				}
-			}
+			// DEBUG: Log final result
+			//CString resultDebugMsg;
+			//resultDebugMsg.Format(_T("BACKFILL COMPLETE - Total: %d, Original: %d, Unique: %d, Duplicates: %d"),
+			//	quoteIndex, nLastValid + 1, ctx.uniqueCount, ctx.duplicateCount);
+			//OutputDebugString(resultDebugMsg);
 
-			if (pConnection)
-			{
-				pConnection->Close();
-				delete pConnection;
-			}
+			return quoteIndex;
 		}
 
-		oSession.Close();
+		// Existing bars may have moved down to make room before the request failed
+		return ctx.nLastValid + 1;
 	}
 	catch (CInternetException* e)
 	{
@@ -1082,18 +1644,15 @@ BOOL AddToOpenAlgoPortfolio(LPCTSTR pszTicker)
 	AFX_MANAGE_STATE(AfxGetStaticModuleState());
 
 	BOOL bOK = FALSE;
+	OpenAlgoHttpRequest request;
 	try
 	{
 		CString endpoint;
 		endpoint.Format(_T("/api/v1/watchlist/add?symbol=%s"), pszTicker);
-		CString oURL = BuildOpenAlgoURL(g_oServer, g_nPortNumber, endpoint);
-
-		CInternetSession oSession(AGENT_NAME, 1, INTERNET_OPEN_TYPE_DIRECT, NULL, NULL, INTERNET_FLAG_DONT_CACHE);
-
-		CStdioFile* poFile = oSession.OpenURL(oURL, 1, INTERNET_FLAG_TRANSFER_ASCII | INTERNET_FLAG_RELOAD | INTERNET_FLAG_DONT_CACHE);
 
 		CString oLine;
-		if (poFile && poFile->ReadString(oLine))
+		if (OpenAlgoHttpBegin(&request, CHttpConnection::HTTP_VERB_GET, endpoint, NULL, 5000) &&
+			request.pFile->ReadString(oLine))
 		{
 			if (oLine.Find(_T("OK")) >= 0 || oLine.Find(_T("success")) >= 0)
 			{
@@ -1101,16 +1660,12 @@ BOOL AddToOpenAlgoPortfolio(LPCTSTR pszTicker)
 			}
 		}
 
-		if (poFile)
-		{
-			poFile->Close();
-			delete poFile;
-		}
-		oSession.Close();
+		OpenAlgoHttpEnd(&request, TRUE);
 	}
 	catch (CInternetException* e)
 	{
 		e->Delete();
+		OpenAlgoHttpEnd(&request, FALSE);
 		g_nStatus = STATUS_DISCONNECTED;
 	}
 	return bOK;
@@ -1149,46 +1704,100 @@ PLUGINAPI int Init(void)
 		// Real-time candle building settings
 		g_bRealTimeCandlesEnabled = AfxGetApp()->GetProfileInt(_T("OpenAlgo"), _T("EnableRealTimeCandles"), 1);  // Default: enabled
 		g_nBackfillIntervalMs = AfxGetApp()->GetProfileInt(_T("OpenAlgo"), _T("BackfillIntervalMs"), 5000);  // Default: 5 seconds
+		g_nDrainBudgetUs = ClampDrainBudgetUs(AfxGetApp()->GetProfileInt(_T("OpenAlgo"), _T("DrainBudgetUs"), WS_DRAIN_BUDGET_US_DEFAULT));
+		g_bBarCacheEnabled = AfxGetApp()->GetProfileInt(_T("OpenAlgo"), _T("EnableBarCache"), 1);  // Default: enabled
+		g_bTickJournalEnabled = AfxGetApp()->GetProfileInt(_T("OpenAlgo"), _T("EnableTickJournal"), 1);  // Default: enabled
+		g_bVerboseTickLog = AfxGetApp()->GetProfileInt(_T("OpenAlgo"), _T("VerboseTickLog"), 0);  // Default: off
+		g_nJournalFsyncMs = max(0, AfxGetApp()->GetProfileInt(_T("OpenAlgo"), _T("JournalFsyncMs"), TICK_JOURNAL_FSYNC_MS_DEFAULT));
+		g_nStreamingUpdateMs = min(STREAMING_UPDATE_MS_MAX, max(0, AfxGetApp()->GetProfileInt(_T("OpenAlgo"), _T("StreamingUpdateMs"), STREAMING_UPDATE_MS_DEFAULT)));
+		g_nBackfillConcurrency = min(BACKFILL_CONCURRENCY_MAX, max(1, AfxGetApp()->GetProfileInt(_T("OpenAlgo"), _T("BackfillConcurrency"), BACKFILL_CONCURRENCY_DEFAULT)));
+		g_nBackfillRequestsPerSec = min(BACKFILL_RATE_MAX, max(1, AfxGetApp()->GetProfileInt(_T("OpenAlgo"), _T("BackfillRequestsPerSec"), BACKFILL_RATE_DEFAULT)));
+		g_nHistoryChunkDays1m = max(0, AfxGetApp()->GetProfileInt(_T("OpenAlgo"), _T("HistoryChunkDays1m"), HISTORY_CHUNK_DAYS_1M_DEFAULT));
+		g_nHistoryChunkDaysDaily = max(0, AfxGetApp()->GetProfileInt(_T("OpenAlgo"), _T("HistoryChunkDaysDaily"), HISTORY_CHUNK_DAYS_DAILY_DEFAULT));
+		g_nHistoryChunkConcurrency = min(HISTORY_CHUNK_CONCURRENCY_MAX, max(1, AfxGetApp()->GetProfileInt(_T("OpenAlgo"), _T("HistoryChunkConcurrency"), HISTORY_CHUNK_CONCURRENCY_DEFAULT)));
+		InitCalendarConversion((int)AfxGetApp()->GetProfileInt(_T("OpenAlgo"), _T("UtcOffsetMinutes"), CALENDAR_UTC_OFFSET_IST),
+			AfxGetApp()->GetProfileString(_T("OpenAlgo"), _T("ExchangeUtcOffsets"), _T("")));
 
 		g_nStatus = STATUS_WAIT;
 		g_bPluginInitialized = TRUE;
 
-		// Initialize quote cache
-		g_QuoteCache.InitHashTable(997); // Prime number for better hash distribution
+		// Symbol IDs index the quote table (lookups are lock-free, inserts serialized)
+		if (!g_bSymbolTableInitialized)
+		{
+			InitSymbolTable(&g_SymbolTable, NewSymbolStateChunk, NULL);
+			g_bSymbolTableInitialized = TRUE;
+		}
 
 		// Initialize critical section for WebSocket operations
 		InitializeCriticalSection(&g_WebSocketCriticalSection);
 		g_bCriticalSectionInitialized = TRUE;
 
-		// Initialize critical section for BarBuilder operations
+		// Serializes frames written by the I/O thread (PING/PONG) and the UI thread (subscribe)
+		InitializeCriticalSection(&g_WebSocketSendCriticalSection);
+		g_bSendCriticalSectionInitialized = TRUE;
+
+		// Initialize critical section for the BarBuilders map (each builder has its own lock)
 		InitializeCriticalSection(&g_BarBuilderCriticalSection);
 		g_bBarBuilderCriticalSectionInitialized = TRUE;
 
-		// Initialize BarBuilders hash table
-		g_BarBuilders.InitHashTable(503);  // Prime number for better distribution
-
-		// Initialize critical section for HTTP cache operations
+		// Background history fetches: slots and job queue
 		InitializeCriticalSection(&g_HttpCacheCriticalSection);
 		g_bHttpCacheCriticalSectionInitialized = TRUE;
 
-		// Initialize HTTP response cache hash table
-		g_HttpResponseCache.InitHashTable(127);  // Prime number for better distribution
+		// Shared HTTP session and keep-alive connection pool (session is created on first request)
+		InitHttpConnectionPool(&g_HttpPool, OpenPooledHttpConnection, ClosePooledHttpConnection, NULL);
+		g_bHttpPoolInitialized = TRUE;
+
+		// History requests in flight, shared by identical concurrent requests
+		InitializeCriticalSection(&g_HistoryFlightCriticalSection);
+		g_bHistoryFlightCriticalSectionInitialized = TRUE;
+
+		// Serializes access to the on-disk bar cache files
+		InitializeCriticalSection(&g_BarCacheCriticalSection);
+		g_bBarCacheCriticalSectionInitialized = TRUE;
+
+		// All Symbols backfill job and its checkpoint
+		InitializeCriticalSection(&g_BackfillCriticalSection);
+		InitTokenBucket(&g_backfill.bucket, (double)g_nBackfillRequestsPerSec, GetTickCount());
+		g_bBackfillCriticalSectionInitialized = TRUE;
+
+		// Tick journal: rebuild today's tick-built bars, then keep appending
+		InitializeCriticalSection(&g_TickJournalCriticalSection);
+		g_bTickJournalCriticalSectionInitialized = TRUE;
+		if (g_bTickJournalEnabled)
+		{
+			EnterCriticalSection(&g_TickJournalCriticalSection);
+			if (!OpenTickJournal(_time64(NULL), TRUE))
+			{
+				OutputDebugString(_T("OpenAlgo: Init() - Tick journal unavailable, ticks will not be journaled"));
+			}
+			LeaveCriticalSection(&g_TickJournalCriticalSection);
+		}
 
 		// Log real-time settings
 		CString rtMsg;
-		rtMsg.Format(_T("OpenAlgo: Real-Time Candles Enabled = %d, Backfill Interval = %d ms"),
-			g_bRealTimeCandlesEnabled, g_nBackfillIntervalMs);
+		rtMsg.Format(_T("OpenAlgo: Real-Time Candles Enabled = %d, Backfill Interval = %d ms, Drain Budget = %d us, Streaming Update = %d ms"),
+			g_bRealTimeCandlesEnabled, g_nBackfillIntervalMs, g_nDrainBudgetUs, g_nStreamingUpdateMs);
 		OutputDebugString(rtMsg);
 
-		// Initialize WebSocket connection early (don't wait for GetRecentInfo)
-		OutputDebugString(_T("OpenAlgo: Init() - Initializing WebSocket connection..."));
-		if (InitializeWebSocket())
+		// History downloads run on worker threads so GetQuotesEx() never waits for the server
+		if (!StartHistoryWorkers())
 		{
-			OutputDebugString(_T("OpenAlgo: Init() - WebSocket initialized successfully"));
+			OutputDebugString(_T("OpenAlgo: Init() - Failed to start history workers, history will be fetched inline"));
 		}
-		else
+
+		// Stale quotes for the Real-Time Quote window are fetched in batches off the UI thread
+		if (!StartQuoteRefresher())
 		{
-			OutputDebugString(_T("OpenAlgo: Init() - WebSocket initialization failed (will retry later)"));
+			OutputDebugString(_T("OpenAlgo: Init() - Failed to start quote refresher, quotes will be fetched inline"));
+		}
+
+		// Start the WebSocket I/O thread early (don't wait for GetRecentInfo)
+		// The thread connects in the background so Init() no longer blocks on the handshake
+		OutputDebugString(_T("OpenAlgo: Init() - Starting WebSocket I/O thread..."));
+		if (!StartWebSocketIoThread())
+		{
+			OutputDebugString(_T("OpenAlgo: Init() - Failed to start WebSocket I/O thread"));
 		}
 	}
 
@@ -1200,15 +1809,30 @@ PLUGINAPI int Release(void)
 {
 	AFX_MANAGE_STATE(AfxGetStaticModuleState());
 
+	// Stop the I/O thread before tearing down the socket it owns
+	StopWebSocketIoThread();
+
+	// No history download may outlive the HTTP client and the symbol table
+	// (an unfinished backfill keeps its checkpoint and resumes on the next start)
+	StopBackfillJob(FALSE);
+	StopHistoryWorkers();
+	StopQuoteRefresher();
+
+	// Write out and close the tick journal (no more ticks after the I/O thread is gone)
+	CloseTickJournal();
+
 	// Clean up WebSocket connections
 	CleanupWebSocket();
 
 	// Clear cache
-	g_QuoteCache.RemoveAll();
+	ClearQuotes();
 
 	// Clean up BarBuilders
 	CleanupBarBuilders();
 
+	// Close pooled HTTP connections and the shared session
+	CleanupHttpClient();
+
 	// Clean up critical sections
 	if (g_bCriticalSectionInitialized)
 	{
@@ -1216,6 +1840,12 @@ PLUGINAPI int Release(void)
 		g_bCriticalSectionInitialized = FALSE;
 	}
 
+	if (g_bSendCriticalSectionInitialized)
+	{
+		DeleteCriticalSection(&g_WebSocketSendCriticalSection);
+		g_bSendCriticalSectionInitialized = FALSE;
+	}
+
 	if (g_bBarBuilderCriticalSectionInitialized)
 	{
 		DeleteCriticalSection(&g_BarBuilderCriticalSection);
@@ -1224,24 +1854,44 @@ PLUGINAPI int Release(void)
 
 	if (g_bHttpCacheCriticalSectionInitialized)
 	{
-		// Clean up HTTP cache - free allocated memory
-		POSITION pos = g_HttpResponseCache.GetStartPosition();
-		while (pos != NULL)
-		{
-			CString key;
-			void* pValue;
-			g_HttpResponseCache.GetNextAssoc(pos, key, pValue);
-			if (pValue != NULL)
-			{
-				delete (DWORD*)pValue;
-			}
-		}
-		g_HttpResponseCache.RemoveAll();
-
 		DeleteCriticalSection(&g_HttpCacheCriticalSection);
 		g_bHttpCacheCriticalSectionInitialized = FALSE;
 	}
 
+	if (g_bHttpPoolInitialized)
+	{
+		DeleteHttpConnectionPool(&g_HttpPool);
+		g_bHttpPoolInitialized = FALSE;
+	}
+
+	if (g_bHistoryFlightCriticalSectionInitialized)
+	{
+		DeleteCriticalSection(&g_HistoryFlightCriticalSection);
+		g_bHistoryFlightCriticalSectionInitialized = FALSE;
+	}
+
+	if (g_bBarCacheCriticalSectionInitialized)
+	{
+		DeleteCriticalSection(&g_BarCacheCriticalSection);
+		g_bBarCacheCriticalSectionInitialized = FALSE;
+	}
+
+	if (g_bTickJournalCriticalSectionInitialized)
+	{
+		DeleteCriticalSection(&g_TickJournalCriticalSection);
+		g_bTickJournalCriticalSectionInitialized = FALSE;
+	}
+
+	if (g_bBackfillCriticalSectionInitialized)
+	{
+		DeleteTokenBucket(&g_backfill.bucket);
+		DeleteCriticalSection(&g_BackfillCriticalSection);
+		g_bBackfillCriticalSectionInitialized = FALSE;
+	}
+
+	// Last - every subsystem above keeps its per-symbol state in the symbol table
+	CleanupSymbolTable();
+
 	return 1;
 }
 
@@ -1310,7 +1960,52 @@ PLUGINAPI int GetStatus(struct PluginStatus* status)
 	case STATUS_CONNECTED:
 		status->nStatusCode = 0x00000000; // OK
 		strcpy_s(status->szShortMessage, 32, "OK");
-		strcpy_s(status->szLongMessage, 256, "OpenAlgo: Connected");
+		{
+			// REST latency: average and worst request time, share of requests on a pooled connection
+			HttpClientStats httpStats;
+			GetHttpClientStats(&httpStats);
+			// and identical history requests that shared one download
+			char szHttp[128] = "";
+			if (httpStats.nRequests > 0)
+			{
+				sprintf_s(szHttp, sizeof(szHttp), "HTTP avg %.0f ms, max %.0f ms, %ld%% reused, %ld history coalesced",
+					httpStats.nTotalLatencyUs / 1000.0 / httpStats.nRequests, httpStats.nMaxLatencyUs / 1000.0,
+					(httpStats.nConnectionsReused * 100) / max(1L, httpStats.nConnectionsOpened + httpStats.nConnectionsReused),
+					g_historyFlightStats.nCoalesced);
+			}
+
+			// All Symbols backfill progress and throughput
+			char szBackfill[96];
+			int nBackfillPercent = FormatBackfillStatus(szBackfill, sizeof(szBackfill));
+			if (nBackfillPercent >= 0)
+			{
+				sprintf_s(status->szShortMessage, 32, "BF %d%%", nBackfillPercent);
+			}
+
+			// Backfill first - the long message is cut at 256 characters
+			char szDetail[200];
+			_snprintf_s(szDetail, sizeof(szDetail), _TRUNCATE, "%s%s%s",
+				szBackfill, (szBackfill[0] && szHttp[0]) ? "; " : "", szHttp);
+
+			if (g_bWebSocketConnected)
+			{
+				// Surface drain pressure: a growing backlog means ticks arrive faster than we parse them.
+				// Ticks vs. updates shows how much the streaming notifier coalesces.
+				_snprintf_s(status->szLongMessage, 256, _TRUNCATE,
+					"OpenAlgo: Connected (WebSocket backlog %d KB, peak %d KB, budget exhausted %ld times; %ld ticks -> %ld updates%s%s)",
+					g_wsDrainStats.nBacklogBytes / 1024, g_wsDrainStats.nPeakBacklogBytes / 1024,
+					g_wsDrainStats.nTimeBudgetExhausted, g_streamingStats.nTicks, g_streamingStats.nNotifications,
+					szDetail[0] ? "; " : "", szDetail);
+			}
+			else if (szDetail[0])
+			{
+				_snprintf_s(status->szLongMessage, 256, _TRUNCATE, "OpenAlgo: Connected (%s)", szDetail);
+			}
+			else
+			{
+				strcpy_s(status->szLongMessage, 256, "OpenAlgo: Connected");
+			}
+		}
 		status->clrStatusColor = RGB(0, 255, 0); // Green
 		break;
 
@@ -1344,39 +2039,31 @@ CString GetAvailableSymbols(void)
 	AFX_MANAGE_STATE(AfxGetStaticModuleState());
 
 	CString oResult;
+	OpenAlgoHttpRequest request;
 	try
 	{
-		CString oURL = BuildOpenAlgoURL(g_oServer, g_nPortNumber, _T("/api/v1/symbols"));
-
-		CInternetSession oSession(AGENT_NAME, 1, INTERNET_OPEN_TYPE_DIRECT, NULL, NULL, INTERNET_FLAG_DONT_CACHE);
-		oSession.SetOption(INTERNET_OPTION_CONNECT_TIMEOUT, 5000);
-		oSession.SetOption(INTERNET_OPTION_RECEIVE_TIMEOUT, 5000);
-
-		CStdioFile* poFile = oSession.OpenURL(oURL, 1,
-			INTERNET_FLAG_TRANSFER_ASCII | INTERNET_FLAG_RELOAD | INTERNET_FLAG_DONT_CACHE);
-
-		if (poFile)
+		if (OpenAlgoHttpBegin(&request, CHttpConnection::HTTP_VERB_GET, _T("/api/v1/symbols"), NULL, 5000))
 		{
 			CString oLine;
-			if (poFile->ReadString(oLine))
+			if (request.pFile->ReadString(oLine))
 			{
 				if (oLine.Left(2) == _T("OK"))
 				{
-					poFile->ReadString(oResult);
+					request.pFile->ReadString(oResult);
 				}
 				else
 				{
 					oResult = oLine;
 				}
 			}
-			poFile->Close();
-			delete poFile;
 		}
-		oSession.Close();
+
+		OpenAlgoHttpEnd(&request, TRUE);
 	}
 	catch (CInternetException* e)
 	{
 		e->Delete();
+		OpenAlgoHttpEnd(&request, FALSE);
 		g_nStatus = STATUS_DISCONNECTED;
 	}
 	return oResult;
@@ -1393,96 +2080,42 @@ BOOL TestOpenAlgoConnection(void)
 	}
 
 	BOOL bConnected = FALSE;
+	OpenAlgoHttpRequest request;
 
 	try
 	{
-		CString oURL = BuildOpenAlgoURL(g_oServer, g_nPortNumber, _T("/api/v1/ping"));
-
-		CInternetSession oSession(AGENT_NAME, 1, INTERNET_OPEN_TYPE_DIRECT, NULL, NULL,
-			INTERNET_FLAG_DONT_CACHE);
-		oSession.SetOption(INTERNET_OPTION_CONNECT_TIMEOUT, 2000);
-		oSession.SetOption(INTERNET_OPTION_RECEIVE_TIMEOUT, 2000);
-
 		// Prepare POST data with API key
 		CString oPostData;
 		oPostData.Format(_T("{\"apikey\":\"%s\"}"), (LPCTSTR)g_oApiKey);
 
-		CHttpConnection* pConnection = NULL;
-		CHttpFile* pFile = NULL;
-
-		// Parse server and port
-		INTERNET_PORT nPort = (INTERNET_PORT)g_nPortNumber;
-		CString oServer = g_oServer;
-
-		// Remove http:// or https:// if present
-		oServer.Replace(_T("http://"), _T(""));
-		oServer.Replace(_T("https://"), _T(""));
-
-		pConnection = oSession.GetHttpConnection(oServer, nPort);
-
-		if (pConnection)
+		if (OpenAlgoHttpBegin(&request, CHttpConnection::HTTP_VERB_POST, _T("/api/v1/ping"), &oPostData, 2000) &&
+			request.dwStatusCode == 200)
 		{
-			// Create POST request
-			pFile = pConnection->OpenRequest(
-				CHttpConnection::HTTP_VERB_POST,
-				_T("/api/v1/ping"),
-				NULL,
-				1,
-				NULL,
-				NULL,
-				INTERNET_FLAG_RELOAD | INTERNET_FLAG_DONT_CACHE);
-
-			if (pFile)
+			// Read response to verify it's valid
+			CString oResponse;
+			CString oLine;
+			while (request.pFile->ReadString(oLine))
 			{
-				// Set headers
-				CString oHeaders = _T("Content-Type: application/json\r\n");
-
-				// Convert string to UTF-8 for sending
-				CStringA oPostDataA(oPostData);
-
-				// Send the request
-				BOOL bResult = pFile->SendRequest(oHeaders, (LPVOID)(LPCSTR)oPostDataA, oPostDataA.GetLength());
-
-				if (bResult)
-				{
-					DWORD dwStatusCode = 0;
-					pFile->QueryInfoStatusCode(dwStatusCode);
-
-					if (dwStatusCode == 200)
-					{
-						// Read response to verify it's valid
-						CString oResponse;
-						CString oLine;
-						while (pFile->ReadString(oLine))
-						{
-							oResponse += oLine;
-							if (oResponse.GetLength() > 500) break; // Limit response size
-						}
-
-						// Check if response contains "success" and "pong"
-						if ((oResponse.Find(_T("\"status\":\"success\"")) >= 0 ||
-							 oResponse.Find(_T("\"status\": \"success\"")) >= 0) &&
-							(oResponse.Find(_T("\"message\":\"pong\"")) >= 0 ||
-							 oResponse.Find(_T("\"message\": \"pong\"")) >= 0))
-						{
-							bConnected = TRUE;
-						}
-					}
-				}
-
-				pFile->Close();
-				delete pFile;
+				oResponse += oLine;
+				if (oResponse.GetLength() > 500) break; // Limit response size
 			}
 
-			pConnection->Close();
-			delete pConnection;
+			// Check if response contains "success" and "pong"
+			if ((oResponse.Find(_T("\"status\":\"success\"")) >= 0 ||
+				 oResponse.Find(_T("\"status\": \"success\"")) >= 0) &&
+				(oResponse.Find(_T("\"message\":\"pong\"")) >= 0 ||
+				 oResponse.Find(_T("\"message\": \"pong\"")) >= 0))
+			{
+				bConnected = TRUE;
+			}
 		}
 
-		oSession.Close();
+		OpenAlgoHttpEnd(&request, TRUE);
 	}
 	catch (CInternetException* e)
 	{
 		e->Delete();
+		OpenAlgoHttpEnd(&request, FALSE);
 		bConnected = FALSE;
 	}
 
@@ -1514,19 +2147,6 @@ VOID CALLBACK OnTimerProc(HWND hwnd, UINT uMsg, UINT_PTR idEvent, DWORD dwTime)
 {
 	AFX_MANAGE_STATE(AfxGetStaticModuleState());
 
-	// High-frequency WebSocket data processing timer (every 100ms)
-	if (idEvent == TIMER_WEBSOCKET)
-	{
-		// ALWAYS call ProcessWebSocketData() if real-time candles are enabled
-		// ProcessWebSocketData() has its own auto-reconnect logic when disconnected
-		// DO NOT check g_bWebSocketConnected here, or auto-reconnect will never run!
-		if (g_bRealTimeCandlesEnabled)
-		{
-			ProcessWebSocketData();
-		}
-		return;
-	}
-
 	if (idEvent == TIMER_INIT || idEvent == TIMER_REFRESH)
 	{
 		if (!TestOpenAlgoConnection())
@@ -1572,23 +2192,46 @@ PLUGINAPI int Notify(struct PluginNotification* pn)
 		g_oWebSocketUrl = AfxGetApp()->GetProfileString(_T("OpenAlgo"), _T("WebSocketUrl"), _T("ws://127.0.0.1:8765"));  // Load WebSocket URL
 		g_nPortNumber = AfxGetApp()->GetProfileInt(_T("OpenAlgo"), _T("Port"), 5000);
 		g_nRefreshInterval = AfxGetApp()->GetProfileInt(_T("OpenAlgo"), _T("RefreshInterval"), 5);
+		g_nDrainBudgetUs = ClampDrainBudgetUs(AfxGetApp()->GetProfileInt(_T("OpenAlgo"), _T("DrainBudgetUs"), WS_DRAIN_BUDGET_US_DEFAULT));
+		g_bBarCacheEnabled = AfxGetApp()->GetProfileInt(_T("OpenAlgo"), _T("EnableBarCache"), 1);
+		g_bVerboseTickLog = AfxGetApp()->GetProfileInt(_T("OpenAlgo"), _T("VerboseTickLog"), 0);
+		g_nJournalFsyncMs = max(0, AfxGetApp()->GetProfileInt(_T("OpenAlgo"), _T("JournalFsyncMs"), TICK_JOURNAL_FSYNC_MS_DEFAULT));
+		g_nStreamingUpdateMs = min(STREAMING_UPDATE_MS_MAX, max(0, AfxGetApp()->GetProfileInt(_T("OpenAlgo"), _T("StreamingUpdateMs"), STREAMING_UPDATE_MS_DEFAULT)));
+		g_nBackfillConcurrency = min(BACKFILL_CONCURRENCY_MAX, max(1, AfxGetApp()->GetProfileInt(_T("OpenAlgo"), _T("BackfillConcurrency"), BACKFILL_CONCURRENCY_DEFAULT)));
+		g_nBackfillRequestsPerSec = min(BACKFILL_RATE_MAX, max(1, AfxGetApp()->GetProfileInt(_T("OpenAlgo"), _T("BackfillRequestsPerSec"), BACKFILL_RATE_DEFAULT)));
+		g_nHistoryChunkDays1m = max(0, AfxGetApp()->GetProfileInt(_T("OpenAlgo"), _T("HistoryChunkDays1m"), HISTORY_CHUNK_DAYS_1M_DEFAULT));
+		g_nHistoryChunkDaysDaily = max(0, AfxGetApp()->GetProfileInt(_T("OpenAlgo"), _T("HistoryChunkDaysDaily"), HISTORY_CHUNK_DAYS_DAILY_DEFAULT));
+		g_nHistoryChunkConcurrency = min(HISTORY_CHUNK_CONCURRENCY_MAX, max(1, AfxGetApp()->GetProfileInt(_T("OpenAlgo"), _T("HistoryChunkConcurrency"), HISTORY_CHUNK_CONCURRENCY_DEFAULT)));
+		InitCalendarConversion((int)AfxGetApp()->GetProfileInt(_T("OpenAlgo"), _T("UtcOffsetMinutes"), CALENDAR_UTC_OFFSET_IST),
+			AfxGetApp()->GetProfileString(_T("OpenAlgo"), _T("ExchangeUtcOffsets"), _T("")));
+
+		// Bar cache files live next to the database
+		g_oBarCacheDir.Empty();
+		g_oDatabasePath.Empty();
+		if (pn->pszDatabasePath != NULL && pn->pszDatabasePath[0] != 0)
+		{
+			g_oDatabasePath = pn->pszDatabasePath;
+			g_oDatabasePath.TrimRight(_T('\\'));
+			g_oBarCacheDir = g_oDatabasePath + _T("\\OpenAlgoCache");
+			CreateDirectory(g_oBarCacheDir, NULL);
+		}
 
 		g_nStatus = STATUS_WAIT;
 		g_nRetryCount = RETRY_COUNT;
 
+		// WebSocket data is read continuously by the I/O thread, not just when GetQuotesEx() is called
+		StartWebSocketIoThread();
+		StartHistoryWorkers();
+		StartQuoteRefresher();
+
+		// Pick up an All Symbols backfill that was interrupted last time
+		ResumeBackfillJob();
+
 		// Start connection timer
 		if (g_hAmiBrokerWnd != NULL)
 		{
 			SetTimer(g_hAmiBrokerWnd, TIMER_INIT, 1000, (TIMERPROC)OnTimerProc);
 
-			// Start high-frequency WebSocket timer (100ms) for continuous tick processing
-			// This ensures we read WebSocket data continuously, not just when GetQuotesEx() is called
-			if (g_bRealTimeCandlesEnabled)
-			{
-				SetTimer(g_hAmiBrokerWnd, TIMER_WEBSOCKET, 100, (TIMERPROC)OnTimerProc);
-				OutputDebugString(_T("OpenAlgo: Started TIMER_WEBSOCKET (100ms) for continuous tick processing"));
-			}
-
 			// Force immediate status update
 			::PostMessage(g_hAmiBrokerWnd, WM_USER_STREAMING_UPDATE, 0, 0);
 		}
@@ -1601,17 +2244,18 @@ PLUGINAPI int Notify(struct PluginNotification* pn)
 		{
 			KillTimer(g_hAmiBrokerWnd, TIMER_INIT);
 			KillTimer(g_hAmiBrokerWnd, TIMER_REFRESH);
-			KillTimer(g_hAmiBrokerWnd, TIMER_WEBSOCKET);
 		}
+		StopWebSocketIoThread();
+		StopBackfillJob(FALSE);
+		StopHistoryWorkers();
+		StopQuoteRefresher();
 		g_hAmiBrokerWnd = NULL;
 		g_nStatus = STATUS_SHUTDOWN;
-
-		free(g_aInfos);
-		g_aInfos = NULL;
-		RecentInfoSize = 0;
+		g_oBarCacheDir.Empty();
+		g_oDatabasePath.Empty();
 
 		// Clear cache
-		g_QuoteCache.RemoveAll();
+		ClearQuotes();
 	}
 
 	// Right-click on status area - show menu
@@ -1655,6 +2299,10 @@ PLUGINAPI int Notify(struct PluginNotification* pn)
 			// Add submenus to main menu
 			AppendMenu(hMenu, MF_POPUP | MF_ENABLED, (UINT_PTR)hBackfill1M, _T("Backfill 1-Minute Data"));
 			AppendMenu(hMenu, MF_POPUP | MF_ENABLED, (UINT_PTR)hBackfillDaily, _T("Backfill Daily Data"));
+			if (g_backfill.bRunning)
+			{
+				AppendMenu(hMenu, MF_STRING | MF_ENABLED, 300, _T("Stop All Symbols Backfill"));
+			}
 
 			AppendMenu(hMenu, MF_SEPARATOR, 0, NULL);
 			AppendMenu(hMenu, MF_STRING | MF_ENABLED, 3, _T("Configure..."));
@@ -1694,10 +2342,7 @@ PLUGINAPI int Notify(struct PluginNotification* pn)
 				::PostMessage(g_hAmiBrokerWnd, WM_USER_STREAMING_UPDATE, 0, 0);
 				break;
 			case 106: // 3 Months - All Symbols
-				g_nBackfillDays = 90;
-				g_nBackfillPeriodicity = 60;
-				g_bBackfillRequested = TRUE;
-				::PostMessage(g_hAmiBrokerWnd, WM_USER_STREAMING_UPDATE, 0, 0);
+				StartBackfillJob(60, 90);
 				break;
 			case 107: // 6 Months - Current Symbol
 				g_nBackfillDays = 180;
@@ -1706,10 +2351,7 @@ PLUGINAPI int Notify(struct PluginNotification* pn)
 				::PostMessage(g_hAmiBrokerWnd, WM_USER_STREAMING_UPDATE, 0, 0);
 				break;
 			case 108: // 6 Months - All Symbols
-				g_nBackfillDays = 180;
-				g_nBackfillPeriodicity = 60;
-				g_bBackfillRequested = TRUE;
-				::PostMessage(g_hAmiBrokerWnd, WM_USER_STREAMING_UPDATE, 0, 0);
+				StartBackfillJob(60, 180);
 				break;
 			case 109: // 1 Year - Current Symbol
 				g_nBackfillDays = 365;
@@ -1718,10 +2360,7 @@ PLUGINAPI int Notify(struct PluginNotification* pn)
 				::PostMessage(g_hAmiBrokerWnd, WM_USER_STREAMING_UPDATE, 0, 0);
 				break;
 			case 110: // 1 Year - All Symbols
-				g_nBackfillDays = 365;
-				g_nBackfillPeriodicity = 60;
-				g_bBackfillRequested = TRUE;
-				::PostMessage(g_hAmiBrokerWnd, WM_USER_STREAMING_UPDATE, 0, 0);
+				StartBackfillJob(60, 365);
 				break;
 
 			// Daily backfill options
@@ -1732,10 +2371,7 @@ PLUGINAPI int Notify(struct PluginNotification* pn)
 				::PostMessage(g_hAmiBrokerWnd, WM_USER_STREAMING_UPDATE, 0, 0);
 				break;
 			case 202: // 5 Years - All Symbols
-				g_nBackfillDays = 1825;
-				g_nBackfillPeriodicity = 86400;
-				g_bBackfillRequested = TRUE;
-				::PostMessage(g_hAmiBrokerWnd, WM_USER_STREAMING_UPDATE, 0, 0);
+				StartBackfillJob(86400, 1825);
 				break;
 			case 203: // 10 Years - Current Symbol
 				g_nBackfillDays = 3650;  // 10 * 365
@@ -1744,10 +2380,7 @@ PLUGINAPI int Notify(struct PluginNotification* pn)
 				::PostMessage(g_hAmiBrokerWnd, WM_USER_STREAMING_UPDATE, 0, 0);
 				break;
 			case 204: // 10 Years - All Symbols
-				g_nBackfillDays = 3650;
-				g_nBackfillPeriodicity = 86400;
-				g_bBackfillRequested = TRUE;
-				::PostMessage(g_hAmiBrokerWnd, WM_USER_STREAMING_UPDATE, 0, 0);
+				StartBackfillJob(86400, 3650);
 				break;
 			case 205: // 25 Years - Current Symbol
 				g_nBackfillDays = 9125;  // 25 * 365
@@ -1756,10 +2389,11 @@ PLUGINAPI int Notify(struct PluginNotification* pn)
 				::PostMessage(g_hAmiBrokerWnd, WM_USER_STREAMING_UPDATE, 0, 0);
 				break;
 			case 206: // 25 Years - All Symbols
-				g_nBackfillDays = 9125;
-				g_nBackfillPeriodicity = 86400;
-				g_bBackfillRequested = TRUE;
-				::PostMessage(g_hAmiBrokerWnd, WM_USER_STREAMING_UPDATE, 0, 0);
+				StartBackfillJob(86400, 9125);
+				break;
+
+			case 300: // Stop All Symbols Backfill
+				StopBackfillJob(TRUE);
 				break;
 			}
 
@@ -1815,7 +2449,8 @@ PLUGINAPI int GetQuotesEx(LPCTSTR pszTicker, int nPeriodicity, int nLastValid, i
 	{
 		// For daily data, only use historical data from OpenAlgo
 		// Do NOT mix with quote data as it's for real-time window only
-		int nQty = GetOpenAlgoHistory(pszTicker, nPeriodicity, nLastValid, nSize, pQuotes);
+		// The download runs in the background; this returns what is already here
+		int nQty = GetOpenAlgoHistoryAsync(pszTicker, nPeriodicity, nLastValid, nSize, pQuotes, GetHistoryRefreshMs(), NULL);
 		return nQty;
 	}
 	// Handle intraday data (1-minute only for now)
@@ -1843,13 +2478,13 @@ PLUGINAPI int GetQuotesEx(LPCTSTR pszTicker, int nPeriodicity, int nLastValid, i
 		{
 			// No Daily data found - Fetch Daily data FIRST (chronologically oldest)
 			// This puts 10 years of Daily bars at the beginning of the array
-			nQty = GetOpenAlgoHistory(pszTicker, 86400, nLastValid, nSize, pQuotes);
+			nQty = GetOpenAlgoHistoryAsync(pszTicker, 86400, nLastValid, nSize, pQuotes, GetHistoryRefreshMs(), NULL);
 		}
 		else if (lastDailyBarIndex < 250)
 		{
 			// Found some Daily data but < 250 bars (~1 year)
 			// Insufficient for technical analysis - fetch full 10 years FIRST
-			nQty = GetOpenAlgoHistory(pszTicker, 86400, nLastValid, nSize, pQuotes);
+			nQty = GetOpenAlgoHistoryAsync(pszTicker, 86400, nLastValid, nSize, pQuotes, GetHistoryRefreshMs(), NULL);
 		}
 		// else: Daily data exists and is sufficient (>= 250 bars)
 
@@ -1867,118 +2502,63 @@ PLUGINAPI int GetQuotesEx(LPCTSTR pszTicker, int nPeriodicity, int nLastValid, i
 				s_gqeCallCount, pszTicker, nPeriodicity);
 			OutputDebugString(gqeLog);
 
-			// NOTE: WebSocket data is now processed by TIMER_WEBSOCKET (every 100ms)
+			// NOTE: WebSocket data is processed by the WebSocket I/O thread as soon as it arrives
 			// No need to call ProcessWebSocketData() here - it runs continuously in background
 			// This ensures ticks are processed immediately when they arrive, not just when GetQuotesEx() is called
 
-			CString ticker(pszTicker);
+			// Subscriptions, tick bars and the HTTP cache are all indexed by symbol ID
+			// (-1 only if the symbol table is full - then this is a pure HTTP chart)
+			int nSymbolId = InternSymbol(pszTicker);
 			BarBuilder* pBuilder = NULL;
 
 			// CRITICAL: Subscribe to symbol if not already subscribed
 			// This ensures chart-only symbols (without quote window) also get ticks
-			BOOL bSubscribed = FALSE;
+			// The subscription is claimed under the lock and the frame is sent after it:
+			// the I/O thread takes g_WebSocketCriticalSection too and must never wait on a send
+			BOOL bSubscribeNow = FALSE;
 			EnterCriticalSection(&g_WebSocketCriticalSection);
-			if (!g_SubscribedSymbols.Lookup(ticker, bSubscribed))
+			if (nSymbolId >= 0 && !GetSymbolState(nSymbolId)->bSubscribed && g_bWebSocketConnected)
+			{
+				GetSymbolState(nSymbolId)->bSubscribed = TRUE;
+				bSubscribeNow = TRUE;
+			}
+			LeaveCriticalSection(&g_WebSocketCriticalSection);
+
+			if (bSubscribeNow)
 			{
 				OutputDebugString(_T("OpenAlgo: GetQuotesEx - Symbol NOT subscribed, subscribing now..."));
-				if (g_bWebSocketConnected && SubscribeToSymbol(pszTicker))
+				if (SubscribeToSymbol(pszTicker))
 				{
-					g_SubscribedSymbols.SetAt(ticker, TRUE);
 					OutputDebugString(_T("OpenAlgo: GetQuotesEx - Successfully subscribed to symbol"));
 				}
 				else
 				{
 					OutputDebugString(_T("OpenAlgo: GetQuotesEx - WARNING: Failed to subscribe to symbol"));
+					EnterCriticalSection(&g_WebSocketCriticalSection);
+					GetSymbolState(nSymbolId)->bSubscribed = FALSE;
+					LeaveCriticalSection(&g_WebSocketCriticalSection);
 				}
 			}
-			LeaveCriticalSection(&g_WebSocketCriticalSection);
 
 			// Check if we have a BarBuilder for this symbol
-			if (g_BarBuilders.Lookup(ticker, pBuilder) && pBuilder != NULL)
+			if (nSymbolId >= 0)
+				pBuilder = FindBarBuilder(nSymbolId);
+			if (pBuilder != NULL)
 			{
-				OutputDebugString(_T("OpenAlgo: GetQuotesEx - BarBuilder found, entering critical section"));
-				EnterCriticalSection(&g_BarBuilderCriticalSection);
-
-				// PERFORMANCE FIX: Use HTTP response caching to avoid calling HTTP API on every GetQuotesEx() call
-				// Check if we have a recent HTTP response cached (within last 60 seconds)
-				// For real-time updates, rely on WebSocket ticks (processed every 100ms by timer)
-				// Only fetch HTTP for initial load or periodic validation (every 60 seconds)
-
-				CString cacheKey;
-				cacheKey.Format(_T("%s-%d"), pszTicker, 60);  // "RELIANCE-NSE-60"
-
-				DWORD currentTime = (DWORD)GetTickCount64();
-				BOOL bShouldCallHttp = TRUE;  // Default: call HTTP
-				int httpLastValid = nQty - 1;  // Start with existing bar count
-
-				// Check cache
-				EnterCriticalSection(&g_HttpCacheCriticalSection);
-				void* pCacheValue = NULL;
-				if (g_HttpResponseCache.Lookup(cacheKey, pCacheValue) && pCacheValue != NULL)
-				{
-					DWORD lastHttpCallTime = *(DWORD*)pCacheValue;
-					DWORD timeSinceLastCall = currentTime - lastHttpCallTime;
-
-					if (timeSinceLastCall < HTTP_CACHE_LIFETIME_MS)
-					{
-						// Cache is FRESH - SKIP HTTP call, use tick bars only
-						bShouldCallHttp = FALSE;
-
-						CString cacheLog;
-						cacheLog.Format(_T("OpenAlgo: GetQuotesEx - HTTP cache HIT (%.1f seconds old), skipping HTTP call"),
-							timeSinceLastCall / 1000.0f);
-						OutputDebugString(cacheLog);
-					}
-					else
-					{
-						// Cache is STALE - need to refresh
-						CString cacheLog;
-						cacheLog.Format(_T("OpenAlgo: GetQuotesEx - HTTP cache STALE (%.1f seconds old), calling HTTP"),
-							timeSinceLastCall / 1000.0f);
-						OutputDebugString(cacheLog);
-					}
-				}
-				else
-				{
-					// No cache entry - first call for this symbol
-					OutputDebugString(_T("OpenAlgo: GetQuotesEx - HTTP cache MISS (first call), calling HTTP"));
-				}
-				LeaveCriticalSection(&g_HttpCacheCriticalSection);
-
-				// Call HTTP API if needed
-				if (bShouldCallHttp)
-				{
-					OutputDebugString(_T("OpenAlgo: GetQuotesEx - Fetching HTTP backfill..."));
-
-					// Fetch HTTP backfill data (source of truth for completed bars)
-					httpLastValid = GetOpenAlgoHistory(pszTicker, 60, nQty - 1, nSize, pQuotes);
+				// No builder lock here: the tick bar is read from the builder's seqlock snapshot
+				OutputDebugString(_T("OpenAlgo: GetQuotesEx - BarBuilder found"));
 
-					// Update cache with current time
-					EnterCriticalSection(&g_HttpCacheCriticalSection);
-					if (pCacheValue != NULL)
-					{
-						// Update existing cache entry
-						*(DWORD*)pCacheValue = currentTime;
-					}
-					else
-					{
-						// Create new cache entry
-						DWORD* pNewTime = new DWORD;
-						*pNewTime = currentTime;
-						g_HttpResponseCache.SetAt(cacheKey, pNewTime);
-					}
-					LeaveCriticalSection(&g_HttpCacheCriticalSection);
-				}
-				else
-				{
-					// Skip HTTP call - will use existing bars + tick bars
-					httpLastValid = nQty - 1;
-				}
+				// PERFORMANCE FIX: Don't download history on every GetQuotesEx() call
+				// For real-time updates, rely on WebSocket ticks (processed by the WebSocket I/O thread)
+				// 1-minute history is refreshed in the background every HTTP_CACHE_LIFETIME_MS;
+				// bars from a finished refresh are merged here (bHttpMerged = TRUE)
+				BOOL bHttpMerged = FALSE;
+				int httpLastValid = GetOpenAlgoHistoryAsync(pszTicker, 60, nQty - 1, nSize, pQuotes, HTTP_CACHE_LIFETIME_MS, &bHttpMerged);
 
-				// Only process HTTP response if we actually called HTTP
+				// Only process HTTP response if refreshed bars were merged
 				int cleanedBarCount = httpLastValid;
 
-				if (bShouldCallHttp)
+				if (bHttpMerged)
 				{
 					CString httpLog;
 					httpLog.Format(_T("OpenAlgo: ===== HTTP API RESPONSE ====="));
@@ -2113,25 +2693,29 @@ PLUGINAPI int GetQuotesEx(LPCTSTR pszTicker, int nPeriodicity, int nLastValid, i
 				}
 				// End of HTTP response processing
 
+				// Copy the in-progress tick bar without blocking the tick path
+				BarSnapshot tickBar;
+				ReadBarSnapshot(pBuilder, &tickBar);
+
 				// Log tick bar data for debugging
-				if (pBuilder->bBarStarted)
+				if (tickBar.bBarStarted)
 				{
-					AmiDate tickDate = pBuilder->currentBar.DateTime;
+					AmiDate tickDate = tickBar.currentBar.DateTime;
 					CString tickLog;
 					tickLog.Format(_T("OpenAlgo: ===== TICK BAR DATA ====="));
 					OutputDebugString(tickLog);
 					tickLog.Format(_T("OpenAlgo: Tick Bar: %04d-%02d-%02d %02d:%02d O=%.2f H=%.2f L=%.2f C=%.2f V=%.0f TickCnt=%d"),
 						tickDate.PackDate.Year, tickDate.PackDate.Month, tickDate.PackDate.Day,
 						tickDate.PackDate.Hour, tickDate.PackDate.Minute,
-						pBuilder->currentBar.Open, pBuilder->currentBar.High,
-						pBuilder->currentBar.Low, pBuilder->currentBar.Price,
-						pBuilder->currentBar.Volume, pBuilder->tickCount);
+						tickBar.currentBar.Open, tickBar.currentBar.High,
+						tickBar.currentBar.Low, tickBar.currentBar.Price,
+						tickBar.currentBar.Volume, tickBar.tickCount);
 					OutputDebugString(tickLog);
 				}
 
 				// CRITICAL FIX: Check if last HTTP bar has same timestamp as tick bar
 				// If yes, REPLACE it (don't append) to avoid duplicate timestamps
-				if (httpLastValid > 0 && pBuilder->bBarStarted)
+				if (httpLastValid > 0 && tickBar.bBarStarted)
 				{
 					BOOL bReplacedLastBar = FALSE;
 					int tickBarIndex = httpLastValid;  // Default: append after HTTP bars
@@ -2140,7 +2724,7 @@ PLUGINAPI int GetQuotesEx(LPCTSTR pszTicker, int nPeriodicity, int nLastValid, i
 					if (httpLastValid > 0)
 					{
 						AmiDate lastHttpDate = pQuotes[httpLastValid - 1].DateTime;
-						AmiDate tickBarDate = pBuilder->currentBar.DateTime;
+						AmiDate tickBarDate = tickBar.currentBar.DateTime;
 
 						// Compare timestamps (date + time components)
 						if (lastHttpDate.PackDate.Year == tickBarDate.PackDate.Year &&
@@ -2158,7 +2742,7 @@ PLUGINAPI int GetQuotesEx(LPCTSTR pszTicker, int nPeriodicity, int nLastValid, i
 					// Set the tick bar (either replace last or append new)
 					if (tickBarIndex < nSize)
 					{
-						pQuotes[tickBarIndex] = pBuilder->currentBar;
+						pQuotes[tickBarIndex] = tickBar.currentBar;
 						nQty = bReplacedLastBar ? httpLastValid : (httpLastValid + 1);
 
 						CString mergeLog;
@@ -2168,9 +2752,9 @@ PLUGINAPI int GetQuotesEx(LPCTSTR pszTicker, int nPeriodicity, int nLastValid, i
 							bReplacedLastBar ? _T("REPLACED") : _T("APPENDED"), tickBarIndex);
 						OutputDebugString(mergeLog);
 						mergeLog.Format(_T("OpenAlgo: Final bar: O=%.2f H=%.2f L=%.2f C=%.2f V=%.0f TickCnt=%d"),
-							pBuilder->currentBar.Open, pBuilder->currentBar.High,
-							pBuilder->currentBar.Low, pBuilder->currentBar.Price,
-							pBuilder->currentBar.Volume, pBuilder->tickCount);
+							tickBar.currentBar.Open, tickBar.currentBar.High,
+							tickBar.currentBar.Low, tickBar.currentBar.Price,
+							tickBar.currentBar.Volume, tickBar.tickCount);
 						OutputDebugString(mergeLog);
 					}
 					else
@@ -2190,15 +2774,13 @@ PLUGINAPI int GetQuotesEx(LPCTSTR pszTicker, int nPeriodicity, int nLastValid, i
 				OutputDebugString(finalLog);
 				finalLog.Format(_T("OpenAlgo: Returning %d total bars (HTTP + tick) for %s"), nQty, pszTicker);
 				OutputDebugString(finalLog);
-
-				LeaveCriticalSection(&g_BarBuilderCriticalSection);
 			}
 			else
 			{
 				OutputDebugString(_T("OpenAlgo: GetQuotesEx - No BarBuilder found, using pure HTTP backfill"));
 
 				// No BarBuilder yet - use pure HTTP backfill
-				nQty = GetOpenAlgoHistory(pszTicker, 60, nQty - 1, nSize, pQuotes);
+				nQty = GetOpenAlgoHistoryAsync(pszTicker, 60, nQty - 1, nSize, pQuotes, GetHistoryRefreshMs(), NULL);
 
 				CString httpLog;
 				httpLog.Format(_T("OpenAlgo: GetQuotesEx - Pure HTTP returned %d bars"), nQty);
@@ -2208,7 +2790,7 @@ PLUGINAPI int GetQuotesEx(LPCTSTR pszTicker, int nPeriodicity, int nLastValid, i
 		else
 		{
 			// Real-time disabled - use pure HTTP backfill (original behavior)
-			nQty = GetOpenAlgoHistory(pszTicker, 60, nQty - 1, nSize, pQuotes);
+			nQty = GetOpenAlgoHistoryAsync(pszTicker, 60, nQty - 1, nSize, pQuotes, GetHistoryRefreshMs(), NULL);
 		}
 
 		return nQty;
@@ -2223,6 +2805,7 @@ PLUGINAPI int GetQuotesEx(LPCTSTR pszTicker, int nPeriodicity, int nLastValid, i
 // GetRecentInfo is ONLY for Real-time Quote Window display
 // This function provides Level 1 quotes for the quote window
 // It should NEVER be used for chart data or OHLC bars
+// Returns a copy of the symbol's RecentInfo record, which StoreQuote() keeps current
 PLUGINAPI struct RecentInfo* GetRecentInfo(LPCTSTR pszTicker)
 {
 	AFX_MANAGE_STATE(AfxGetStaticModuleState());
@@ -2231,108 +2814,383 @@ PLUGINAPI struct RecentInfo* GetRecentInfo(LPCTSTR pszTicker)
 	if (g_nStatus != STATUS_CONNECTED || g_oApiKey.IsEmpty())
 		return NULL;
 
-	static struct RecentInfo ri;
-	memset(&ri, 0, sizeof(ri));
-	ri.nStructSize = sizeof(struct RecentInfo);
-
-	CString ticker(pszTicker);
-	
-	// Initialize WebSocket connection if needed (but don't block if connection is in progress)
-	// Also add a delay between connection attempts to avoid hammering the server
-	DWORD dwNow = (DWORD)GetTickCount64();
-	if (!g_bWebSocketConnected && !g_bWebSocketConnecting && 
-		(dwNow - g_dwLastConnectionAttempt) > 10000) // Wait 10 seconds between attempts
-	{
-		g_dwLastConnectionAttempt = dwNow;
-		InitializeWebSocket();
-	}
+	// The WebSocket I/O thread connects and reconnects on its own - never block the UI here
 
 	// Critical section should already be initialized in Init()
 
 	// Check if this symbol is already subscribed via WebSocket
-	BOOL bSubscribed = FALSE;
-	EnterCriticalSection(&g_WebSocketCriticalSection);
-	
-	if (!g_SubscribedSymbols.Lookup(ticker, bSubscribed))
+	// The subscription is claimed under the lock and sent after it - the I/O thread
+	// takes g_WebSocketCriticalSection too and must never wait on a send or Sleep()
+	// (checked without the lock first - almost every call is for a subscribed symbol)
+	int nSymbolId = InternSymbol(pszTicker);
+	BOOL bSubscribeNow = FALSE;
+	if (nSymbolId >= 0 && !GetSymbolState(nSymbolId)->bSubscribed && g_bWebSocketConnected)
 	{
-		// Symbol not subscribed yet, subscribe to it
-		if (g_bWebSocketConnected)
+		EnterCriticalSection(&g_WebSocketCriticalSection);
+		if (!GetSymbolState(nSymbolId)->bSubscribed && g_bWebSocketConnected)
+		{
+			GetSymbolState(nSymbolId)->bSubscribed = TRUE;
+			bSubscribeNow = TRUE;
+		}
+		LeaveCriticalSection(&g_WebSocketCriticalSection);
+	}
+
+	if (bSubscribeNow)
+	{
+		// Give authentication a moment to complete if it's still processing
+		if (!g_bWebSocketAuthenticated)
+		{
+			Sleep(100);
+		}
+		
+		// Try to subscribe - authentication will be handled automatically
+		if (SubscribeToSymbol(pszTicker))
 		{
-			// Give authentication a moment to complete if it's still processing
+			// Mark as authenticated since we successfully sent a subscribe request
+			// (this handles cases where auth response parsing failed but server accepted subscription)
 			if (!g_bWebSocketAuthenticated)
 			{
-				Sleep(100);
-			}
-			
-			// Try to subscribe - authentication will be handled automatically
-			if (SubscribeToSymbol(pszTicker))
-			{
-				g_SubscribedSymbols.SetAt(ticker, TRUE);
-				
-				// Mark as authenticated since we successfully sent a subscribe request
-				// (this handles cases where auth response parsing failed but server accepted subscription)
-				if (!g_bWebSocketAuthenticated)
-				{
-					g_bWebSocketAuthenticated = TRUE;
-				}
+				g_bWebSocketAuthenticated = TRUE;
 			}
 		}
+		else
+		{
+			EnterCriticalSection(&g_WebSocketCriticalSection);
+			GetSymbolState(nSymbolId)->bSubscribed = FALSE;
+			LeaveCriticalSection(&g_WebSocketCriticalSection);
+		}
 	}
-	
-	LeaveCriticalSection(&g_WebSocketCriticalSection);
 
-	// Process any pending WebSocket data
-	ProcessWebSocketData();
+	// Pending WebSocket data is drained by the I/O thread
 
 	// Check cache for WebSocket data first
 	QuoteCache cachedQuote;
 	BOOL bCached = FALSE;
+	BOOL bFresh = FALSE;
 
-	if (g_QuoteCache.Lookup(ticker, cachedQuote))
+	if (nSymbolId >= 0 && LoadQuote(nSymbolId, &cachedQuote))
 	{
-		// Use cached data if it's less than 5 seconds old
+		bCached = TRUE;
+
+		// Fresh if it's less than 5 seconds old
 		DWORD dwNow = (DWORD)GetTickCount64();
-		if ((dwNow - cachedQuote.lastUpdate) < 5000)
+		if ((dwNow - cachedQuote.lastUpdate) < QUOTE_STALE_MS)
 		{
-			bCached = TRUE;
+			bFresh = TRUE;
 		}
 	}
 
-	// Fallback to HTTP API if WebSocket data not available
-	if (!bCached)
+	// Stale or missing: the quote refresher fetches it with the other stale symbols and
+	// posts WM_USER_STREAMING_UPDATE; until then show what we have (or nothing)
+	if (!bFresh && nSymbolId >= 0 && g_hQuoteRefreshThread != NULL)
+	{
+		RequestQuoteRefresh(nSymbolId);
+		if (!bCached)
+			return NULL;
+	}
+	else if (!bFresh)
 	{
+		// No refresher or no symbol ID (ticker too long) - fetch inline as before
 		if (!GetOpenAlgoQuote(pszTicker, cachedQuote))
 			return NULL;
 
-		// Store in cache
-		g_QuoteCache.SetAt(ticker, cachedQuote);
+		if (nSymbolId < 0)
+		{
+			// Not in the symbol table - build the record from scratch
+			static struct RecentInfo ri;
+			memset(&ri, 0, sizeof(ri));
+			UpdateRecentInfo(&ri, pszTicker, cachedQuote);
+			return &ri;
+		}
+
+		StoreQuote(nSymbolId, cachedQuote);
+	}
+
+	// Copied under the slot's seqlock: the I/O thread may be rewriting recentInfo right now
+	struct RecentInfo* pShown = &GetSymbolState(nSymbolId)->recentInfoShown;
+	if (!LoadRecentInfo(nSymbolId, pShown))
+		return NULL;
+	return pShown;
+}
+
+///////////////////////////////
+// Quote Refresher
+///////////////////////////////
+//
+// When a symbol had no WebSocket tick for 5 seconds, GetRecentInfo() used to call
+// GetOpenAlgoQuote() inline, so a 200-row Real-Time Quote window fired 200 blocking
+// HTTP requests on AmiBroker's UI thread. Now GetRecentInfo() only flags the symbol
+// (SymbolState::nQuoteWanted) and returns the quote it has. The refresher thread
+// collects every flagged symbol and fetches them with /api/v1/multiquotes,
+// QUOTE_BATCH_MAX_SYMBOLS per request over the pooled connection, stores the quotes
+// in the quote table and posts one WM_USER_STREAMING_UPDATE per pass. A server
+// without /api/v1/multiquotes (404) gets one /api/v1/quotes request per symbol, still
+// off the UI thread.
+
+BOOL StartQuoteRefresher(void)
+{
+	if (g_hQuoteRefreshThread != NULL)
+		return TRUE; // Already running
+
+	g_hQuoteRefreshStopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);   // Manual reset
+	g_hQuoteRefreshWakeEvent = CreateEvent(NULL, FALSE, FALSE, NULL);  // Auto reset
+	if (g_hQuoteRefreshStopEvent == NULL || g_hQuoteRefreshWakeEvent == NULL)
+	{
+		OutputDebugString(_T("OpenAlgo: StartQuoteRefresher - Failed to create events"));
+		StopQuoteRefresher();
+		return FALSE;
+	}
+
+	g_hQuoteRefreshThread = (HANDLE)_beginthreadex(NULL, 0, QuoteRefreshThreadProc, NULL, 0, NULL);
+	if (g_hQuoteRefreshThread == NULL)
+	{
+		OutputDebugString(_T("OpenAlgo: StartQuoteRefresher - _beginthreadex FAILED"));
+		StopQuoteRefresher();
+		return FALSE;
+	}
+
+	OutputDebugString(_T("OpenAlgo: Quote refresher started"));
+	return TRUE;
+}
+
+void StopQuoteRefresher(void)
+{
+	if (g_hQuoteRefreshThread != NULL)
+	{
+		SetEvent(g_hQuoteRefreshStopEvent);
+
+		// A batch in progress can take up to its receive timeout
+		if (WaitForSingleObject(g_hQuoteRefreshThread, 15000) != WAIT_OBJECT_0)
+		{
+			// Leave the events alive - the thread may still be waiting on them
+			OutputDebugString(_T("OpenAlgo: WARNING - Quote refresher did not stop within 15 seconds"));
+			CloseHandle(g_hQuoteRefreshThread);
+			g_hQuoteRefreshThread = NULL;
+			return;
+		}
+
+		CloseHandle(g_hQuoteRefreshThread);
+		g_hQuoteRefreshThread = NULL;
+	}
+
+	if (g_hQuoteRefreshStopEvent != NULL)
+	{
+		CloseHandle(g_hQuoteRefreshStopEvent);
+		g_hQuoteRefreshStopEvent = NULL;
+	}
+
+	if (g_hQuoteRefreshWakeEvent != NULL)
+	{
+		CloseHandle(g_hQuoteRefreshWakeEvent);
+		g_hQuoteRefreshWakeEvent = NULL;
+	}
+
+	// The next server may support /api/v1/multiquotes
+	g_bMultiQuotesUnsupported = FALSE;
+}
+
+// Flag a symbol for the next refresh pass (UI thread, from GetRecentInfo())
+void RequestQuoteRefresh(int nSymbolId)
+{
+	if (InterlockedExchange(&GetSymbolState(nSymbolId)->nQuoteWanted, 1) == 0)
+		SetEvent(g_hQuoteRefreshWakeEvent);
+}
+
+// Fetch quotes for up to QUOTE_BATCH_MAX_SYMBOLS symbols with one /api/v1/multiquotes
+// request and store them. Returns the number of quotes stored, or -1 if the server
+// does not know the endpoint.
+int RefreshQuoteBatch(const int* pSymbolIds, int nSymbols)
+{
+	CString symbols[QUOTE_BATCH_MAX_SYMBOLS];
+	CString exchanges[QUOTE_BATCH_MAX_SYMBOLS];
+	CStringA symbolsA[QUOTE_BATCH_MAX_SYMBOLS];
+	CStringA exchangesA[QUOTE_BATCH_MAX_SYMBOLS];
+
+	CString oPostData;
+	oPostData.Format(_T("{\"apikey\":\"%s\",\"symbols\":["), (LPCTSTR)g_oApiKey);
+	for (int i = 0; i < nSymbols; i++)
+	{
+		LPCTSTR pszTicker = GetSymbolTicker(pSymbolIds[i]);
+		symbols[i] = GetCleanSymbol(pszTicker);
+		exchanges[i] = GetExchangeFromTicker(pszTicker);
+		symbolsA[i] = CStringA(symbols[i]);
+		exchangesA[i] = CStringA(exchanges[i]);
+
+		CString entry;
+		entry.Format(_T("%s{\"symbol\":\"%s\",\"exchange\":\"%s\"}"), i > 0 ? _T(",") : _T(""),
+			(LPCTSTR)symbols[i], (LPCTSTR)exchanges[i]);
+		oPostData += entry;
+	}
+	oPostData += _T("]}");
+
+	int nStored = 0;
+	OpenAlgoHttpRequest request;
+	try
+	{
+		if (OpenAlgoHttpBegin(&request, CHttpConnection::HTTP_VERB_POST, _T("/api/v1/multiquotes"), &oPostData, QUOTE_BATCH_TIMEOUT_MS))
+		{
+			if (request.dwStatusCode == 404)
+			{
+				nStored = -1;
+			}
+			else if (request.dwStatusCode == 200)
+			{
+				CStringA oResponse;
+				char readBuffer[4096];
+				UINT nRead;
+				while ((nRead = request.pFile->Read(readBuffer, sizeof(readBuffer))) > 0)
+				{
+					oResponse.Append(readBuffer, (int)nRead);
+				}
+
+				// {"status":"success","results":[{"symbol":..,"exchange":..,"data":{..}}, ...]}
+				const char* pData = oResponse;
+				const char* pResults = (oResponse.Find("\"status\":\"success\"") >= 0) ? strstr(pData, "\"results\"") : NULL;
+				const char* p = (pResults != NULL) ? strchr(pResults, '[') : NULL;
+				const char* pEnd = pData + oResponse.GetLength();
+
+				// Hand each top-level object of the array to the market data tokenizer
+				int nDepth = 0;
+				BOOL bInString = FALSE;
+				const char* pObject = NULL;
+				for (p = (p != NULL) ? p + 1 : pEnd; p < pEnd; p++)
+				{
+					char c = *p;
+					if (bInString)
+					{
+						if (c == '\\')
+							p++;
+						else if (c == '"')
+							bInString = FALSE;
+						continue;
+					}
+
+					if (c == '"')
+						bInString = TRUE;
+					else if (c == '{' && nDepth++ == 0)
+						pObject = p;
+					else if (c == '}' && nDepth > 0 && --nDepth == 0)
+					{
+						MarketTick fields;
+						ParseMarketDataMessage(pObject, (int)(p + 1 - pObject), &fields);
+						if (!(fields.nFields & TICK_FIELD_LTP))
+							continue; // Symbol the broker could not quote
+
+						for (int i = 0; i < nSymbols; i++)
+						{
+							if (symbolsA[i].CompareNoCase(fields.symbol) == 0 &&
+								(!(fields.nFields & TICK_FIELD_EXCHANGE) || exchangesA[i].CompareNoCase(fields.exchange) == 0))
+							{
+								QuoteCache quote;
+								FillQuoteFromTick(&fields, exchanges[i], &quote);
+								StoreQuote(pSymbolIds[i], quote);
+								nStored++;
+								break;
+							}
+						}
+					}
+					else if (c == ']' && nDepth == 0)
+						break;
+				}
+			}
+		}
+
+		OpenAlgoHttpEnd(&request, TRUE);
+	}
+	catch (CInternetException* e)
+	{
+		e->Delete();
+		OpenAlgoHttpEnd(&request, FALSE);
 	}
 
-	// Fill RecentInfo structure
-	_tcsncpy_s(ri.Name, sizeof(ri.Name) / sizeof(TCHAR), pszTicker, _TRUNCATE);
-	_tcsncpy_s(ri.Exchange, sizeof(ri.Exchange) / sizeof(TCHAR), cachedQuote.exchange, _TRUNCATE);
+	return nStored;
+}
+
+unsigned __stdcall QuoteRefreshThreadProc(void* pParam)
+{
+	AFX_MANAGE_STATE(AfxGetStaticModuleState());
+
+	HANDLE handles[2] = { g_hQuoteRefreshStopEvent, g_hQuoteRefreshWakeEvent };
+	CArray<int, int> aSymbolIds;
+
+	while (WaitForMultipleObjects(2, handles, FALSE, INFINITE) == WAIT_OBJECT_0 + 1)
+	{
+		DWORD dwStart = GetTickCount();
+
+		// Collect every flagged symbol; one flagged while we fetch is picked up next pass
+		int nWanted = 0;
+		int nCount = g_SymbolTable.nCount;
+		for (int i = 0; i < nCount; i++)
+		{
+			SymbolState* pState = GetSymbolState(i);
+			if (pState->nQuoteWanted && InterlockedExchange(&pState->nQuoteWanted, 0))
+				aSymbolIds.SetAtGrow(nWanted++, i);
+		}
+
+		int nStored = 0;
+		int nRequests = 0;
+		BOOL bStop = FALSE;
+		for (int nFirst = 0; nFirst < nWanted && !bStop; nFirst += QUOTE_BATCH_MAX_SYMBOLS)
+		{
+			int nBatch = min(QUOTE_BATCH_MAX_SYMBOLS, nWanted - nFirst);
+
+			int nBatchStored = -1;
+			if (!g_bMultiQuotesUnsupported)
+			{
+				nRequests++;
+				nBatchStored = RefreshQuoteBatch(aSymbolIds.GetData() + nFirst, nBatch);
+				if (nBatchStored < 0)
+				{
+					OutputDebugString(_T("OpenAlgo: /api/v1/multiquotes not available, refreshing quotes one symbol at a time"));
+					g_bMultiQuotesUnsupported = TRUE;
+				}
+			}
+
+			if (nBatchStored < 0)
+			{
+				// Older server - one /api/v1/quotes request per symbol
+				nBatchStored = 0;
+				for (int i = nFirst; i < nFirst + nBatch; i++)
+				{
+					if (WaitForSingleObject(g_hQuoteRefreshStopEvent, 0) == WAIT_OBJECT_0)
+					{
+						bStop = TRUE;
+						break;
+					}
+
+					QuoteCache quote;
+					nRequests++;
+					if (GetOpenAlgoQuote(GetSymbolTicker(aSymbolIds[i]), quote))
+					{
+						StoreQuote(aSymbolIds[i], quote);
+						nBatchStored++;
+					}
+				}
+			}
+			nStored += nBatchStored;
+		}
 
-	ri.nStatus = RI_STATUS_UPDATE | RI_STATUS_TRADE | RI_STATUS_BARSREADY;
-	ri.nBitmap = RI_LAST | RI_OPEN | RI_HIGHLOW | RI_TRADEVOL | RI_OPENINT;
+		if (nWanted > 0)
+		{
+			CString doneLog;
+			doneLog.Format(_T("OpenAlgo: Quote refresh - %d of %d stale symbols in %d requests, %lu ms"),
+				nStored, nWanted, nRequests, GetTickCount() - dwStart);
+			OutputDebugString(doneLog);
+		}
 
-	ri.fLast = cachedQuote.ltp;
-	ri.fOpen = cachedQuote.open;
-	ri.fHigh = cachedQuote.high;
-	ri.fLow = cachedQuote.low;
-	ri.fPrev = cachedQuote.close;
-	ri.fChange = cachedQuote.ltp - cachedQuote.close;
-	ri.fTradeVol = cachedQuote.volume;
-	ri.fTotalVol = cachedQuote.volume;
-	ri.fOpenInt = cachedQuote.oi;
+		// Have the Real-Time Quote window call GetRecentInfo() again
+		HWND hWnd = g_hAmiBrokerWnd;
+		if (nStored > 0 && hWnd != NULL)
+		{
+			::PostMessage(hWnd, WM_USER_STREAMING_UPDATE, 0, 0);
+		}
 
-	// Set update times
-	CTime now = CTime::GetCurrentTime();
-	ri.nDateUpdate = now.GetYear() * 10000 + now.GetMonth() * 100 + now.GetDay();
-	ri.nTimeUpdate = now.GetHour() * 10000 + now.GetMinute() * 100 + now.GetSecond();
-	ri.nDateChange = ri.nDateUpdate;
-	ri.nTimeChange = ri.nTimeUpdate;
+		// A window full of stale symbols re-flags them on every repaint - pace the passes
+		if (bStop || WaitForSingleObject(g_hQuoteRefreshStopEvent, QUOTE_REFRESH_PAUSE_MS) == WAIT_OBJECT_0)
+			break;
+	}
 
-	return &ri;
+	return 0;
 }
 
 ///////////////////////////////
@@ -2351,15 +3209,25 @@ void GenerateWebSocketMaskKey(unsigned char* maskKey)
 
 BOOL SendWebSocketFrame(const CString& message)
 {
-	if (g_websocket == INVALID_SOCKET)
-		return FALSE;
-
 	// Convert message to UTF-8
 	CStringA messageA(message);
 	int messageLen = messageA.GetLength();
 	
-	// Create WebSocket frame
-	unsigned char frame[1024];
+	if (messageLen >= 65536)
+	{
+		return FALSE; // Message too long
+	}
+
+	// Create WebSocket frame (header is at most 2 + 2 + 4 bytes)
+	// Large subscribe batches don't fit the stack buffer - use the heap for those
+	unsigned char frameStack[1024];
+	unsigned char* frame = frameStack;
+	if (messageLen + 8 > (int)sizeof(frameStack))
+	{
+		frame = (unsigned char*)malloc(messageLen + 8);
+		if (frame == NULL)
+			return FALSE;
+	}
 	int frameLen = 0;
 	
 	// First byte: FIN=1, OpCode=1 (text frame)
@@ -2370,16 +3238,12 @@ BOOL SendWebSocketFrame(const CString& message)
 	{
 		frame[frameLen++] = 0x80 | messageLen;
 	}
-	else if (messageLen < 65536)
+	else
 	{
 		frame[frameLen++] = 0x80 | 126;
 		frame[frameLen++] = (messageLen >> 8) & 0xFF;
 		frame[frameLen++] = messageLen & 0xFF;
 	}
-	else
-	{
-		return FALSE; // Message too long
-	}
 	
 	// Generate masking key
 	unsigned char maskKey[4];
@@ -2388,191 +3252,76 @@ BOOL SendWebSocketFrame(const CString& message)
 	frameLen += 4;
 	
 	// Masked payload
-	for (int i = 0; i < messageLen; i++)
+	memcpy(&frame[frameLen], (LPCSTR)messageA, messageLen);
+	WebSocketMaskPayload(&frame[frameLen], messageLen, maskKey);
+	frameLen += messageLen;
+	
+	// Send the frame (the I/O thread may be writing a PING/PONG, or closing the socket,
+	// at the same time - g_websocket is only read under the lock)
+	int sent = SOCKET_ERROR;
+	EnterCriticalSection(&g_WebSocketSendCriticalSection);
+	if (g_websocket != INVALID_SOCKET)
+		sent = send(g_websocket, (char*)frame, frameLen, 0);
+	LeaveCriticalSection(&g_WebSocketSendCriticalSection);
+
+	if (frame != frameStack)
 	{
-		frame[frameLen++] = messageA[i] ^ maskKey[i % 4];
+		free(frame);
 	}
-	
-	// Send the frame
-	int sent = send(g_websocket, (char*)frame, frameLen, 0);
 	return (sent == frameLen);
 }
 
-CString DecodeWebSocketFrame(const char* buffer, int length)
+// Send a control frame (PING/PONG/CLOSE). Payload must be <= 125 bytes (RFC 6455 Section 5.5)
+BOOL SendWebSocketControlFrame(unsigned char opcode, const char* payload, int payloadLen)
 {
-	CString result;
-	
-	if (length < 2) return result;
-	
-	int pos = 0;
-	unsigned char firstByte = (unsigned char)buffer[pos++];
-	unsigned char secondByte = (unsigned char)buffer[pos++];
-	
-	// Check frame type
-	unsigned char opcode = firstByte & 0x0F;
-	
-	// Extract payload info (needed for all frame types)
-	BOOL masked = (secondByte & 0x80) != 0;
-	int payloadLen = secondByte & 0x7F;
-
-	// Handle different frame types
-	if (opcode == 0x08) // Close frame
-	{
-		// Extract close status code and reason from payload
-		CString closeInfo = _T("CLOSE_FRAME");
-
-		// Handle extended payload length for close frames
-		int closePos = pos;
-		if (payloadLen == 126)
-		{
-			if (closePos + 2 > length) return closeInfo;
-			payloadLen = ((unsigned char)buffer[closePos] << 8) | (unsigned char)buffer[closePos + 1];
-			closePos += 2;
-		}
-
-		// Extract masking key if present
-		unsigned char closeMaskKey[4] = {0};
-		if (masked)
-		{
-			if (closePos + 4 > length) return closeInfo;
-			memcpy(closeMaskKey, &buffer[closePos], 4);
-			closePos += 4;
-		}
+	if (payloadLen < 0 || payloadLen > 125)
+		return FALSE;
 
-		// Extract status code (first 2 bytes of payload)
-		if (payloadLen >= 2 && closePos + 2 <= length)
-		{
-			unsigned char byte1 = masked ? (buffer[closePos] ^ closeMaskKey[0]) : buffer[closePos];
-			unsigned char byte2 = masked ? (buffer[closePos + 1] ^ closeMaskKey[1]) : buffer[closePos + 1];
-			int statusCode = (byte1 << 8) | byte2;
+	unsigned char frame[2 + 4 + 125];
+	int frameLen = 0;
 
-			// Extract reason text if present
-			CString reason;
-			if (payloadLen > 2 && closePos + payloadLen <= length)
-			{
-				CStringA reasonA;
-				char* reasonBuf = reasonA.GetBuffer(payloadLen - 2 + 1);
-				for (int i = 2; i < payloadLen && (closePos + i) < length; i++)
-				{
-					reasonBuf[i - 2] = masked ? (buffer[closePos + i] ^ closeMaskKey[i % 4]) : buffer[closePos + i];
-				}
-				reasonBuf[payloadLen - 2] = '\0';
-				reasonA.ReleaseBuffer();
-				reason = CString(reasonA);
-			}
+	frame[frameLen++] = 0x80 | (opcode & 0x0F);          // FIN + opcode
+	frame[frameLen++] = 0x80 | (unsigned char)payloadLen; // MASK bit + payload length
 
-			if (reason.IsEmpty())
-			{
-				closeInfo.Format(_T("CLOSE_FRAME (Status Code: %d)"), statusCode);
-			}
-			else
-			{
-				closeInfo.Format(_T("CLOSE_FRAME (Status Code: %d, Reason: %s)"), statusCode, reason);
-			}
-		}
+	unsigned char maskKey[4];
+	GenerateWebSocketMaskKey(maskKey);
+	memcpy(&frame[frameLen], maskKey, 4);
+	frameLen += 4;
 
-		return closeInfo;
-	}
-	else if (opcode == 0x09) // Ping frame
+	if (payloadLen > 0)
 	{
-		// Extract PING payload to echo back in PONG (RFC 6455 Section 5.5.3 requirement)
-		// The Python websockets library sends PING with a 4-byte payload and expects
-		// the PONG to echo it back exactly. If we send empty PONG, server closes with code 1011.
-		CString pingResult = _T("PING_FRAME");
+		memcpy(&frame[frameLen], payload, payloadLen);
+		WebSocketMaskPayload(&frame[frameLen], payloadLen, maskKey);
+		frameLen += payloadLen;
+	}
 
-		// Handle extended payload length
-		int pingPos = pos;
-		if (payloadLen == 126)
-		{
-			if (pingPos + 2 > length) return pingResult;
-			payloadLen = ((unsigned char)buffer[pingPos] << 8) | (unsigned char)buffer[pingPos + 1];
-			pingPos += 2;
-		}
+	int sent = SOCKET_ERROR;
+	EnterCriticalSection(&g_WebSocketSendCriticalSection);
+	if (g_websocket != INVALID_SOCKET)
+		sent = send(g_websocket, (char*)frame, frameLen, 0);
+	LeaveCriticalSection(&g_WebSocketSendCriticalSection);
+	return (sent == frameLen);
+}
 
-		// Extract masking key if present
-		unsigned char pingMaskKey[4] = {0};
-		if (masked)
-		{
-			if (pingPos + 4 > length) return pingResult;
-			memcpy(pingMaskKey, &buffer[pingPos], 4);
-			pingPos += 4;
-		}
-
-		// Extract payload (usually 4 bytes from Python websockets library)
-		if (payloadLen > 0 && payloadLen <= 125 && pingPos + payloadLen <= length)
-		{
-			CStringA hexPayload;
-			for (int i = 0; i < payloadLen; i++)
-			{
-				unsigned char byte = masked ? (buffer[pingPos + i] ^ pingMaskKey[i % 4]) : buffer[pingPos + i];
-				CStringA hexByte;
-				hexByte.Format("%02X", byte);
-				hexPayload += hexByte;
-			}
-
-			// Return "PING_FRAME:XXXXXXXX" where X is hex-encoded payload
-			pingResult = _T("PING_FRAME:") + CString(hexPayload);
-		}
+// Replace the socket under the send lock, so a UI thread subscribe never sends on
+// a handle that is being closed (or has already been reused by another socket)
+void SetWebSocketHandle(SOCKET s)
+{
+	EnterCriticalSection(&g_WebSocketSendCriticalSection);
+	SOCKET old = g_websocket;
+	g_websocket = s;
+	if (old != INVALID_SOCKET && old != s)
+		closesocket(old);
+	LeaveCriticalSection(&g_WebSocketSendCriticalSection);
+}
 
-		return pingResult;
-	}
-	else if (opcode == 0x0A) // Pong frame
-	{
-		return _T("PONG_FRAME");
-	}
-	else if (opcode != 0x01) // Not a text frame
-	{
-		return result;
-	}
-	
-	// Handle extended payload length
-	if (payloadLen == 126)
-	{
-		if (pos + 2 > length) return result;
-		payloadLen = ((unsigned char)buffer[pos] << 8) | (unsigned char)buffer[pos + 1];
-		pos += 2;
-	}
-	else if (payloadLen == 127)
-	{
-		return result; // 64-bit length not supported
-	}
-	
-	// Validate payload length doesn't exceed buffer (increased to support larger frames)
-	if (payloadLen <= 0 || payloadLen > 16000) return result;
-	
-	// Handle masking key
-	unsigned char maskKey[4] = {0};
-	if (masked)
-	{
-		if (pos + 4 > length) return result;
-		memcpy(maskKey, &buffer[pos], 4);
-		pos += 4;
-	}
-	
-	// Validate we have enough data for the payload
-	if (pos + payloadLen > length) return result;
-	
-	// Extract and unmask payload
-	CStringA payloadA;
-	char* payloadBuffer = payloadA.GetBuffer(payloadLen + 1);
-	
-	for (int i = 0; i < payloadLen; i++)
-	{
-		if (masked)
-		{
-			payloadBuffer[i] = buffer[pos + i] ^ maskKey[i % 4];
-		}
-		else
-		{
-			payloadBuffer[i] = buffer[pos + i];
-		}
-	}
-	payloadBuffer[payloadLen] = '\0';
-	payloadA.ReleaseBuffer(payloadLen);
-	
-	result = CString(payloadA);
-	
-	return result;
+// Mark the connection as closed and discard any partially received frame
+void CloseWebSocketConnection(void)
+{
+	g_bWebSocketConnected = FALSE;
+	g_bWebSocketAuthenticated = FALSE;
+	SetWebSocketHandle(INVALID_SOCKET);
+	WsRecvBufferReset(&g_wsRecvBuffer);
 }
 
 BOOL InitializeWebSocket(void)
@@ -2665,9 +3414,10 @@ BOOL ConnectWebSocket(void)
 	}
 	
 	// Create socket
-	g_websocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-	if (g_websocket == INVALID_SOCKET)
+	SOCKET s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (s == INVALID_SOCKET)
 		return FALSE;
+	SetWebSocketHandle(s);
 	
 	// Set socket timeouts (blocking mode initially)
 	int timeout = 5000; // 5 seconds
@@ -2687,8 +3437,7 @@ BOOL ConnectWebSocket(void)
 	
 	if (getaddrinfo(hostA, portStrA, &hints, &result) != 0)
 	{
-		closesocket(g_websocket);
-		g_websocket = INVALID_SOCKET;
+		SetWebSocketHandle(INVALID_SOCKET);
 		return FALSE;
 	}
 	
@@ -2696,8 +3445,7 @@ BOOL ConnectWebSocket(void)
 	if (connect(g_websocket, result->ai_addr, (int)result->ai_addrlen) == SOCKET_ERROR)
 	{
 		freeaddrinfo(result);
-		closesocket(g_websocket);
-		g_websocket = INVALID_SOCKET;
+		SetWebSocketHandle(INVALID_SOCKET);
 		return FALSE;
 	}
 	
@@ -2718,8 +3466,7 @@ BOOL ConnectWebSocket(void)
 	CStringA requestA(upgradeRequest);
 	if (send(g_websocket, requestA, requestA.GetLength(), 0) == SOCKET_ERROR)
 	{
-		closesocket(g_websocket);
-		g_websocket = INVALID_SOCKET;
+		SetWebSocketHandle(INVALID_SOCKET);
 		return FALSE;
 	}
 	
@@ -2734,6 +3481,27 @@ BOOL ConnectWebSocket(void)
 		if (response.Find(_T("101")) > 0 && response.Find(_T("Switching Protocols")) > 0)
 		{
 			g_bWebSocketConnected = TRUE;
+			InterlockedIncrement(&g_nWebSocketGeneration);  // I/O thread re-arms its read event
+
+			// Start with an empty receive buffer. If the server already sent frame
+			// bytes after the HTTP headers, keep them - they are the start of the stream.
+			WsRecvBufferReset(&g_wsRecvBuffer);
+			char* headerEnd = strstr(buffer, "\r\n\r\n");
+			if (headerEnd != NULL)
+			{
+				int headerLen = (int)(headerEnd - buffer) + 4;
+				int extraLen = received - headerLen;
+				if (extraLen > 0)
+				{
+					int nFreeSpace = 0;
+					char* pWrite = WsRecvBufferPrepare(&g_wsRecvBuffer, &nFreeSpace);
+					if (pWrite != NULL && extraLen <= nFreeSpace)
+					{
+						memcpy(pWrite, buffer + headerLen, extraLen);
+						WsRecvBufferCommit(&g_wsRecvBuffer, extraLen);
+					}
+				}
+			}
 			
 			// Small delay to allow WebSocket connection to stabilize
 			Sleep(200);
@@ -2747,8 +3515,7 @@ BOOL ConnectWebSocket(void)
 		}
 	}
 	
-	closesocket(g_websocket);
-	g_websocket = INVALID_SOCKET;
+	SetWebSocketHandle(INVALID_SOCKET);
 	return FALSE;
 }
 
@@ -2781,68 +3548,113 @@ BOOL AuthenticateWebSocket(void)
 	if (SendWebSocketFrame(authMsg))
 	{
 		OutputDebugString(_T("OpenAlgo: AuthenticateWebSocket - Sent auth message, waiting for response..."));
-		// Wait for authentication response with select (for non-blocking socket)
-		fd_set readfds;
-		FD_ZERO(&readfds);
-		FD_SET(g_websocket, &readfds);
-		
-		struct timeval timeout;
-		timeout.tv_sec = 5;  // Increased timeout to 5 seconds
-		timeout.tv_usec = 0;
-		
-		if (select(0, &readfds, NULL, NULL, &timeout) > 0)
+		// Wait for the authentication reply (up to 5 seconds). It may arrive split
+		// across reads or coalesced with other frames - anything after it stays in
+		// the receive buffer for ProcessWebSocketData().
+		CString authResponse;
+		BOOL bGotReply = FALSE;
+		BOOL bServerClosed = FALSE;
+		DWORD dwAuthStart = (DWORD)GetTickCount64();
+
+		while (!bGotReply && !bServerClosed)
 		{
-			OutputDebugString(_T("OpenAlgo: AuthenticateWebSocket - Response received from server"));
-			char authBuffer[1024];
-			int received = recv(g_websocket, authBuffer, sizeof(authBuffer) - 1, 0);
+			WebSocketFrame frame;
+			int nResult = WsRecvBufferExtractFrame(&g_wsRecvBuffer, &frame);
+			if (nResult == WS_FRAME_COMPLETE)
+			{
+				if (frame.opcode == 0x01)  // Text frame
+				{
+					authResponse = CString(CStringA(frame.pPayload, frame.nPayloadLen));
+					bGotReply = TRUE;
+				}
+				else if (frame.opcode == 0x08)  // Close frame
+				{
+					bServerClosed = TRUE;
+				}
+				continue;
+			}
+			if (nResult == WS_FRAME_ERROR)
+			{
+				OutputDebugString(_T("OpenAlgo: AuthenticateWebSocket - Malformed frame from server"));
+				break;
+			}
+
+			DWORD dwElapsed = (DWORD)GetTickCount64() - dwAuthStart;
+			if (dwElapsed >= 5000)
+				break;
+
+			fd_set readfds;
+			FD_ZERO(&readfds);
+			FD_SET(g_websocket, &readfds);
+
+			struct timeval timeout;
+			timeout.tv_sec = (5000 - dwElapsed) / 1000;
+			timeout.tv_usec = ((5000 - dwElapsed) % 1000) * 1000;
+
+			if (select(0, &readfds, NULL, NULL, &timeout) <= 0)
+				break;
+
+			int nFreeSpace = 0;
+			char* pWrite = WsRecvBufferPrepare(&g_wsRecvBuffer, &nFreeSpace);
+			if (pWrite == NULL)
+				break;
+
+			int received = recv(g_websocket, pWrite, nFreeSpace, 0);
 
 			CString recvLog;
 			recvLog.Format(_T("OpenAlgo: AuthenticateWebSocket - recv() returned %d bytes"), received);
 			OutputDebugString(recvLog);
 
 			if (received > 0)
-			{
-				authBuffer[received] = '\0';
-				CString authResponse = DecodeWebSocketFrame(authBuffer, received);
+				WsRecvBufferCommit(&g_wsRecvBuffer, received);
+			else if (received == 0)
+				bServerClosed = TRUE;
+			else
+				break;
+		}
+
+		if (bServerClosed)
+		{
+			OutputDebugString(_T("OpenAlgo: AuthenticateWebSocket - SERVER CLOSED CONNECTION during auth!"));
+			CloseWebSocketConnection();
+			return FALSE;
+		}
 
-				CString respLog;
-				respLog.Format(_T("OpenAlgo: AuthenticateWebSocket - Decoded response: %s"), authResponse);
-				OutputDebugString(respLog);
+		if (bGotReply)
+		{
+			OutputDebugString(_T("OpenAlgo: AuthenticateWebSocket - Response received from server"));
 
-				// Check for success status in authentication response
-				// Look for various success indicators that OpenAlgo might send
-				if (authResponse.Find(_T("success")) >= 0 ||
-					authResponse.Find(_T("authenticated")) >= 0 ||
-					authResponse.Find(_T("\"status\":\"ok\"")) >= 0 ||
-					authResponse.Find(_T("\"status\":\"success\"")) >= 0)
-				{
-					OutputDebugString(_T("OpenAlgo: AuthenticateWebSocket - Authentication SUCCESSFUL!"));
-					g_bWebSocketAuthenticated = TRUE;
-					// Small delay to ensure server has processed authentication
-					Sleep(200);
-
-					// Trigger any pending subscriptions now that we're authenticated
-					SubscribePendingSymbols();
-					return TRUE;
-				}
-				else if (authResponse.Find(_T("error")) >= 0 || authResponse.Find(_T("failed")) >= 0)
-				{
-					// Explicit authentication failure
-					OutputDebugString(_T("OpenAlgo: AuthenticateWebSocket - Authentication FAILED (error in response)"));
-					OutputDebugString(authResponse);
-					return FALSE;
-				}
-				else
-				{
-					OutputDebugString(_T("OpenAlgo: AuthenticateWebSocket - Received response but no clear success/failure indicator"));
-				}
+			CString respLog;
+			respLog.Format(_T("OpenAlgo: AuthenticateWebSocket - Decoded response: %s"), authResponse);
+			OutputDebugString(respLog);
+
+			// Check for success status in authentication response
+			// Look for various success indicators that OpenAlgo might send
+			if (authResponse.Find(_T("success")) >= 0 ||
+				authResponse.Find(_T("authenticated")) >= 0 ||
+				authResponse.Find(_T("\"status\":\"ok\"")) >= 0 ||
+				authResponse.Find(_T("\"status\":\"success\"")) >= 0)
+			{
+				OutputDebugString(_T("OpenAlgo: AuthenticateWebSocket - Authentication SUCCESSFUL!"));
+				g_bWebSocketAuthenticated = TRUE;
+				// Small delay to ensure server has processed authentication
+				Sleep(200);
+
+				// Trigger any pending subscriptions now that we're authenticated
+				SubscribePendingSymbols();
+				return TRUE;
 			}
-			else if (received == 0)
+			else if (authResponse.Find(_T("error")) >= 0 || authResponse.Find(_T("failed")) >= 0)
 			{
-				OutputDebugString(_T("OpenAlgo: AuthenticateWebSocket - SERVER CLOSED CONNECTION during auth!"));
-				g_bWebSocketConnected = FALSE;
+				// Explicit authentication failure
+				OutputDebugString(_T("OpenAlgo: AuthenticateWebSocket - Authentication FAILED (error in response)"));
+				OutputDebugString(authResponse);
 				return FALSE;
 			}
+			else
+			{
+				OutputDebugString(_T("OpenAlgo: AuthenticateWebSocket - Received response but no clear success/failure indicator"));
+			}
 		}
 		else
 		{
@@ -2939,12 +3751,80 @@ void SubscribePendingSymbols(void)
 	LeaveCriticalSection(&g_WebSocketCriticalSection);
 }
 
+///////////////////////////////
+// WebSocket Drain Budget
+///////////////////////////////
+
+int ClampDrainBudgetUs(int nBudgetUs)
+{
+	if (nBudgetUs < WS_DRAIN_BUDGET_US_MIN) return WS_DRAIN_BUDGET_US_MIN;
+	if (nBudgetUs > WS_DRAIN_BUDGET_US_MAX) return WS_DRAIN_BUDGET_US_MAX;
+	return nBudgetUs;
+}
+
+// Record the outcome of one ProcessWebSocketData() call and adapt the message budget.
+// - Out of time: frames are expensive right now, so only ask for what fitted in the slice.
+// - Out of messages with more than half the time left: frames are cheap, double the budget.
+void UpdateWebSocketDrainStats(int nMessages, BOOL bTimeExhausted, BOOL bMessageExhausted, __int64 nElapsedUs)
+{
+	WebSocketDrainStats& stats = g_wsDrainStats;
+
+	stats.nLastBatchMessages = nMessages;
+	stats.nTotalMessages += nMessages;
+
+	if (bTimeExhausted)
+	{
+		InterlockedIncrement(&stats.nTimeBudgetExhausted);
+		stats.nMessageBudget = max(WS_DRAIN_MESSAGES_MIN, nMessages);
+	}
+	else if (bMessageExhausted)
+	{
+		InterlockedIncrement(&stats.nMessageBudgetExhausted);
+		if (nElapsedUs < g_nDrainBudgetUs / 2)
+		{
+			stats.nMessageBudget = min(WS_DRAIN_MESSAGES_MAX, stats.nMessageBudget * 2);
+		}
+	}
+
+	// Backlog = bytes we hold but have not parsed + bytes still queued in the socket
+	int nBacklog = 0;
+	if (g_websocket != INVALID_SOCKET)
+	{
+		u_long nSocketPending = 0;
+		if (ioctlsocket(g_websocket, FIONREAD, &nSocketPending) == 0)
+		{
+			nBacklog = (int)nSocketPending;
+		}
+		nBacklog += g_wsRecvBuffer.nWritePos - g_wsRecvBuffer.nReadPos;
+	}
+	stats.nBacklogBytes = nBacklog;
+	if (nBacklog > stats.nPeakBacklogBytes)
+	{
+		stats.nPeakBacklogBytes = nBacklog;
+	}
+
+	if (bTimeExhausted || bMessageExhausted)
+	{
+		static DWORD s_dwLastLog = 0;
+		DWORD dwNow = (DWORD)GetTickCount64();
+		if ((dwNow - s_dwLastLog) > 5000)  // At most one log line every 5 seconds
+		{
+			s_dwLastLog = dwNow;
+			CString budgetLog;
+			budgetLog.Format(_T("OpenAlgo: Drain budget exhausted (%s) - %d msgs in %lld us, backlog %d bytes, next budget %d msgs, time/msg exhausted %ld/%ld"),
+				bTimeExhausted ? _T("time") : _T("messages"), nMessages, nElapsedUs, nBacklog,
+				stats.nMessageBudget, stats.nTimeBudgetExhausted, stats.nMessageBudgetExhausted);
+			OutputDebugString(budgetLog);
+		}
+	}
+}
+
 BOOL ProcessWebSocketData(void)
 {
-	// ALWAYS log that this function is called (every time)
+	// The I/O thread calls this once per drain: trace it only when per-tick logging is on
 	static int s_callCount = 0;
 	s_callCount++;
-	if (s_callCount <= 5 || s_callCount % 100 == 0)  // Log first 5 calls and every 100th
+	if (g_bVerboseTickLog && (s_callCount <= 5 || s_callCount % 100 == 0))  // Log first 5 calls and every 100th
 	{
 		CString callMsg;
 		callMsg.Format(_T("OpenAlgo: ProcessWebSocketData() call #%d - Connected=%d Socket=%d"),
@@ -2991,10 +3871,8 @@ BOOL ProcessWebSocketData(void)
 
 	if ((currentTime - lastPingTime) > 30000) // Ping every 30 seconds
 	{
-		// Send WebSocket ping frame (opcode 0x09)
-		unsigned char pingFrame[6] = {0x89, 0x84, 0x00, 0x00, 0x00, 0x00}; // Ping with 4-byte mask
-		GenerateWebSocketMaskKey(&pingFrame[2]);
-		send(g_websocket, (char*)pingFrame, 6, 0);
+		// Send WebSocket ping frame (opcode 0x09, empty payload)
+		SendWebSocketControlFrame(0x09, NULL, 0);
 		lastPingTime = currentTime;
 		OutputDebugString(_T("OpenAlgo: Sent WebSocket ping"));
 	}
@@ -3002,26 +3880,107 @@ BOOL ProcessWebSocketData(void)
 	// CRITICAL: Read ALL pending data in a loop
 	// The server sends subscription ACKs and market data continuously
 	// We must drain the receive buffer or the server will close the connection!
+	// Frames already sitting in g_wsRecvBuffer are delivered first; recv() is only
+	// called when the buffer holds no complete frame.
+	// The loop is bounded by a time budget and an adaptive message budget; the I/O
+	// thread calls again immediately while there is more to read.
+	static LONGLONG s_llPerfFrequency = 0;
+	if (s_llPerfFrequency == 0)
+	{
+		LARGE_INTEGER liFreq;
+		QueryPerformanceFrequency(&liFreq);
+		s_llPerfFrequency = liFreq.QuadPart;
+	}
+
+	LARGE_INTEGER liStart, liNow;
+	QueryPerformanceCounter(&liStart);
+	const LONGLONG llBudgetTicks = (s_llPerfFrequency * g_nDrainBudgetUs) / 1000000;
+	const int nMessageBudget = g_wsDrainStats.nMessageBudget;
+
+	// A reconnect during the previous drain replaced the socket before
+	// WebSocketIoWait() could select it
+	if (g_wsPoller.socket != g_websocket)
+		WsPollerSelect(&g_wsPoller, g_websocket);
+
 	int messagesProcessed = 0;
-	const int MAX_MESSAGES_PER_CALL = 100; // Prevent infinite loop
+	BOOL bTimeBudgetExhausted = FALSE;
 
-	while (messagesProcessed < MAX_MESSAGES_PER_CALL)
+	while (messagesProcessed < nMessageBudget)
 	{
-		// Check for incoming data (non-blocking)
-		fd_set readfds;
-		FD_ZERO(&readfds);
-		FD_SET(g_websocket, &readfds);
+		if (messagesProcessed > 0)
+		{
+			QueryPerformanceCounter(&liNow);
+			if (liNow.QuadPart - liStart.QuadPart >= llBudgetTicks)
+			{
+				bTimeBudgetExhausted = TRUE;
+				break;
+			}
+		}
+
+		// Frames already buffered come first; recv() only while the poller reports the
+		// socket readable (see WebSocketPoll.h)
+		WebSocketFrame frame;
+		int nReceived = 0;
+		int nFrameResult = WsPollerReadFrame(&g_wsPoller, &g_wsRecvBuffer, &frame, &nReceived);
+
+		if (nReceived > 0 && g_bVerboseTickLog)
+		{
+			CString recvMsg;
+			recvMsg.Format(_T("OpenAlgo: recv() returned %d bytes"), nReceived);
+			OutputDebugString(recvMsg);
+		}
+
+		if (nFrameResult == WS_FRAME_ERROR)
+		{
+			// Stream is out of sync (bad header or oversized frame) - reconnect
+			OutputDebugString(_T("OpenAlgo: Malformed WebSocket frame - closing connection"));
+			CloseWebSocketConnection();
+			break;
+		}
+
+		if (nFrameResult == WS_FRAME_BUFFER_FULL)
+		{
+			OutputDebugString(_T("OpenAlgo: WebSocket receive buffer exhausted - closing connection"));
+			CloseWebSocketConnection();
+			break;
+		}
+
+		if (nFrameResult == WS_FRAME_CLOSED)
+		{
+			// Connection closed by server (graceful close)
+			OutputDebugString(_T("OpenAlgo: ========== CRITICAL: SERVER CLOSED CONNECTION =========="));
+			OutputDebugString(_T("OpenAlgo: recv() returned 0 - server sent FIN packet (connection closed gracefully)"));
+			OutputDebugString(_T("OpenAlgo: Server closed after ~1 minute - will attempt auto-reconnect"));
+			OutputDebugString(_T("OpenAlgo: ========================================================"));
+
+			// Mark as disconnected
+			CloseWebSocketConnection();
+
+			// Clear subscriptions so they'll be re-subscribed on reconnect
+			EnterCriticalSection(&g_WebSocketCriticalSection);
+			int nSymbols = g_SymbolTable.nCount;
+			for (int i = 0; i < nSymbols; i++)
+				GetSymbolState(i)->bSubscribed = FALSE;
+			LeaveCriticalSection(&g_WebSocketCriticalSection);
 
-		struct timeval timeout;
-		timeout.tv_sec = 0;
-		timeout.tv_usec = 0; // Non-blocking
+			// Attempt immediate reconnection
+			OutputDebugString(_T("OpenAlgo: Attempting WebSocket reconnection..."));
+			if (InitializeWebSocket())
+			{
+				OutputDebugString(_T("OpenAlgo: *** RECONNECTED SUCCESSFULLY! ***"));
+			}
+			else
+			{
+				OutputDebugString(_T("OpenAlgo: *** RECONNECTION FAILED - will retry on next call ***"));
+			}
 
-		int selectResult = select(0, &readfds, NULL, NULL, &timeout);
+			break; // Exit loop after reconnect attempt
+		}
 
-		if (selectResult <= 0)
+		if (nFrameResult == WS_FRAME_INCOMPLETE)
 		{
 			// No more data available
-			if (messagesProcessed > 0)
+			if (messagesProcessed > 0 && g_bVerboseTickLog)
 			{
 				CString doneMsg;
 				doneMsg.Format(_T("OpenAlgo: Processed %d messages this call"), messagesProcessed);
@@ -3032,355 +3991,331 @@ BOOL ProcessWebSocketData(void)
 
 		messagesProcessed++;
 
-		if (selectResult > 0)
-	{
-		// Increased buffer size to 16KB to handle large WebSocket frames without fragmentation
-		// This prevents misinterpreting partial frames as CLOSE frames
-		char buffer[16384];
-		int received = recv(g_websocket, buffer, sizeof(buffer) - 1, 0);
-
-		CString recvMsg;
-		recvMsg.Format(_T("OpenAlgo: recv() returned %d bytes"), received);
-		OutputDebugString(recvMsg);
-		
-		if (received > 0)
+		// Handle WebSocket control frames
+		if (frame.opcode == 0x09)  // PING
 		{
-			CString data = DecodeWebSocketFrame(buffer, received);
+			// RFC 6455 Section 5.5.3: PONG must echo the PING's payload exactly
+			// The Python websockets library closes with code 1011 if the PONG is empty
+			SendWebSocketControlFrame(0x0A, frame.pPayload, frame.nPayloadLen);
 
-			// CRITICAL: Log decoded result FIRST (including control frames for debugging)
-			CString decodeLog;
-			if (data.IsEmpty())
-			{
-				decodeLog = _T("OpenAlgo: DecodeWebSocketFrame returned EMPTY STRING");
-			}
-			else if (data == _T("PING_FRAME"))
-			{
-				decodeLog = _T("OpenAlgo: DecodeWebSocketFrame returned: PING_FRAME");
-			}
-			else if (data == _T("PONG_FRAME"))
-			{
-				decodeLog = _T("OpenAlgo: DecodeWebSocketFrame returned: PONG_FRAME");
-			}
-			else if (data.Find(_T("CLOSE_FRAME")) == 0)  // Starts with "CLOSE_FRAME"
+			CString pongLog;
+			pongLog.Format(_T("OpenAlgo: Received PING with %d-byte payload, sent PONG with echoed payload"), frame.nPayloadLen);
+			OutputDebugString(pongLog);
+
+			continue; // Continue processing more messages
+		}
+		else if (frame.opcode == 0x08)  // CLOSE
+		{
+			// Connection closed by server - log the status code and reason
+			CString closeLog;
+			if (frame.nPayloadLen >= 2)
 			{
-				decodeLog.Format(_T("OpenAlgo: DecodeWebSocketFrame returned: %s"), data);
+				int statusCode = ((unsigned char)frame.pPayload[0] << 8) | (unsigned char)frame.pPayload[1];
+				CString reason(CStringA(frame.pPayload + 2, frame.nPayloadLen - 2));
+				closeLog.Format(_T("OpenAlgo: Received CLOSE_FRAME (Status Code: %d, Reason: %s) from server - closing connection"),
+					statusCode, (LPCTSTR)reason);
 			}
 			else
 			{
-				if (data.GetLength() > 200)
-				{
-					decodeLog.Format(_T("OpenAlgo: DecodeWebSocketFrame returned: %s... [%d chars]"),
-						data.Left(200), data.GetLength());
-				}
-				else
-				{
-					decodeLog.Format(_T("OpenAlgo: DecodeWebSocketFrame returned: %s"), data);
-				}
+				closeLog = _T("OpenAlgo: Received CLOSE_FRAME from server - closing connection");
 			}
-			OutputDebugString(decodeLog);
-
-			// Handle WebSocket control frames
-			if (data.Find(_T("PING_FRAME")) == 0)  // Starts with "PING_FRAME"
-			{
-				// RFC 6455 Section 5.5.3: PONG must echo the PING's payload exactly
-				// Extract payload from "PING_FRAME:XXXXXXXX" format (hex-encoded)
-				CString payload;
-				int colonPos = data.Find(':');
-				if (colonPos > 0)
-				{
-					payload = data.Mid(colonPos + 1);
-				}
-
-				// Convert hex payload back to bytes
-				int payloadLen = payload.GetLength() / 2;
-				unsigned char payloadBytes[125] = {0};  // Max control frame payload size
-				for (int i = 0; i < payloadLen && i < 125; i++)
-				{
-					CString hexByte = payload.Mid(i * 2, 2);
-					payloadBytes[i] = (unsigned char)_tcstoul(hexByte, NULL, 16);
-				}
-
-				// Build PONG frame with echoed payload
-				unsigned char pongFrame[256];
-				int frameLen = 0;
-
-				pongFrame[frameLen++] = 0x8A;  // FIN + opcode 0x0A (PONG)
-				pongFrame[frameLen++] = 0x80 | payloadLen;  // MASK bit + payload length
+			OutputDebugString(closeLog);
+			CloseWebSocketConnection();
+			break; // Exit loop
+		}
+		else if (frame.opcode == 0x0A)  // PONG
+		{
+			// Pong received, connection is alive
+			continue; // Continue processing more messages
+		}
+		else if (frame.opcode != 0x01)
+		{
+			// Binary and continuation frames are not used by the OpenAlgo quote stream
+			CString skipLog;
+			skipLog.Format(_T("OpenAlgo: Skipping WebSocket frame with opcode 0x%02X (%d bytes)"),
+				frame.opcode, frame.nPayloadLen);
+			OutputDebugString(skipLog);
+			continue;
+		}
 
-				// Generate and add masking key
-				unsigned char maskKey[4];
-				GenerateWebSocketMaskKey(maskKey);
-				memcpy(&pongFrame[frameLen], maskKey, 4);
-				frameLen += 4;
+		// Tokenize the frame bytes in place - no CString unless the message is logged
+		MarketTick tick;
+		int nMessageType = ParseMarketDataMessage(frame.pPayload, frame.nPayloadLen, &tick);
 
-				// Add masked payload (echo back the PING payload)
-				for (int i = 0; i < payloadLen; i++)
-				{
-					pongFrame[frameLen++] = payloadBytes[i] ^ maskKey[i % 4];
-				}
+		// Handle subscription acknowledgment
+		if (nMessageType == WS_MSG_SUBSCRIBE_ACK)
+		{
+			OutputDebugString(_T("OpenAlgo: Received subscription ACK"));
+			// Subscription ACK received - just log and continue
+			// The actual subscription tracking is done when we send the subscribe message
+			continue; // Continue processing more messages
+		}
 
-				// Send PONG with echoed payload
-				send(g_websocket, (char*)pongFrame, frameLen, 0);
+		// Market data fields were extracted by the tokenizer - update cache
+		if (nMessageType == WS_MSG_MARKET_DATA)
+		{
+			float ltp = tick.ltp;
+			float lastTradeQty = tick.lastTradeQty;  // For real-time candle building
 
-				CString pongLog;
-				pongLog.Format(_T("OpenAlgo: Received PING with %d-byte payload, sent PONG with echoed payload"), payloadLen);
-				OutputDebugString(pongLog);
+			// Prefer an explicit previous close; quote mode sends it as "close"
+			float prevClose = (tick.nFields & TICK_FIELD_PREV_CLOSE) ? tick.prevClose : tick.close;
 
-				continue; // Continue processing more messages
-			}
-			else if (data.Find(_T("CLOSE_FRAME")) == 0)  // Starts with "CLOSE_FRAME"
+			// Per-tick trace only when asked for: formatting costs more than the tick itself
+			if (g_bVerboseTickLog)
 			{
-				// Connection closed by server - log the reason
-				CString closeLog;
-				closeLog.Format(_T("OpenAlgo: Received %s from server - closing connection"), data);
-				OutputDebugString(closeLog);
-				g_bWebSocketConnected = FALSE;
-				g_bWebSocketAuthenticated = FALSE;
-				closesocket(g_websocket);
-				g_websocket = INVALID_SOCKET;
-				break; // Exit loop
-			}
-			else if (data == _T("PONG_FRAME"))
-			{
-				// Pong received, connection is alive
-				continue; // Continue processing more messages
+				CString debugMsg;
+				debugMsg.Format(_T("OpenAlgo: WS Tick: %hs-%hs LTP=%.2f Qty=%.0f O=%.2f H=%.2f L=%.2f C=%.2f V=%.0f OI=%.0f Bid=%.2f Ask=%.2f TS=%lld"),
+					tick.symbol, tick.exchange, ltp, lastTradeQty, tick.open, tick.high, tick.low, prevClose,
+					tick.volume, tick.oi, tick.bid, tick.ask, ParseTickTimestamp(tick.timestamp));
+				OutputDebugString(debugMsg);
 			}
 
-			// Handle subscription acknowledgment
-			if (!data.IsEmpty() && data.Find(_T("\"type\":\"subscribe\"")) >= 0)
-			{
-				OutputDebugString(_T("OpenAlgo: Received subscription ACK"));
-				// Subscription ACK received - just log and continue
-				// The actual subscription tracking is done when we send the subscribe message
-				continue; // Continue processing more messages
-			}
+			// Resolve the symbol ID straight from the parsed fields (no CString keys)
+			int nSymbolId = -1;
+			if (tick.symbol[0] != '\0' && tick.exchange[0] != '\0')
+				nSymbolId = InternSymbolPair(tick.symbol, tick.exchange);
 
-			// Parse market data JSON and update cache
-			if (!data.IsEmpty() && data.Find(_T("market_data")) >= 0)
+			// Update cache (for GetRecentInfo() compatibility)
+			if (nSymbolId >= 0)
 			{
-				// Simple JSON parsing to extract quote data
-				CString symbol, exchange, timestamp;
-				float ltp = 0, open = 0, high = 0, low = 0, close = 0, volume = 0, oi = 0;
-				float lastTradeQty = 0;  // NEW: For real-time candle building
-
-				// Extract symbol (handle JSON with or without spaces after colon)
-				int symbolPos = data.Find(_T("\"symbol\":"));
-				if (symbolPos >= 0)
+				QuoteCache quote;
+				for (int i = 0; i < QUOTE_EXCHANGE_SIZE; i++)
 				{
-					symbolPos += 9;  // Skip "symbol":
-					// Skip optional whitespace
-					while (symbolPos < data.GetLength() && (data[symbolPos] == ' ' || data[symbolPos] == '\t'))
-						symbolPos++;
-					// Skip opening quote
-					if (symbolPos < data.GetLength() && data[symbolPos] == '\"')
-						symbolPos++;
-					int endPos = data.Find(_T("\""), symbolPos);
-					if (endPos > symbolPos)
-						symbol = data.Mid(symbolPos, endPos - symbolPos);
+					quote.exchange[i] = (TCHAR)(unsigned char)tick.exchange[i];
+					if (tick.exchange[i] == '\0')
+						break;
 				}
-
-				// Extract exchange (handle JSON with or without spaces after colon)
-				int exchangePos = data.Find(_T("\"exchange\":"));
-				if (exchangePos >= 0)
+				quote.exchange[QUOTE_EXCHANGE_SIZE - 1] = _T('\0');
+				quote.ltp = ltp;
+				quote.open = tick.open;
+				quote.high = tick.high;
+				quote.low = tick.low;
+				quote.close = prevClose;
+				quote.volume = tick.volume;
+				quote.oi = tick.oi;
+				quote.bid = tick.bid;
+				quote.ask = tick.ask;
+				quote.lastUpdate = (DWORD)GetTickCount64();
+
+				StoreQuote(nSymbolId, quote);
+
+				// NEW: Process tick for real-time candle building
+				if (g_bRealTimeCandlesEnabled && ltp > 0)
 				{
-					exchangePos += 11;  // Skip "exchange":
-					// Skip optional whitespace
-					while (exchangePos < data.GetLength() && (data[exchangePos] == ' ' || data[exchangePos] == '\t'))
-						exchangePos++;
-					// Skip opening quote
-					if (exchangePos < data.GetLength() && data[exchangePos] == '\"')
-						exchangePos++;
-					int endPos = data.Find(_T("\""), exchangePos);
-					if (endPos > exchangePos)
-						exchange = data.Mid(exchangePos, endPos - exchangePos);
-				}
+					// If last_trade_quantity is missing or zero, use 1 as default
+					// This ensures ticks are still processed even without quantity info
+					if (lastTradeQty <= 0)
+					{
+						lastTradeQty = 1.0f;  // Default quantity
+					}
 
-				// Extract LTP
-				int ltpPos = data.Find(_T("\"ltp\":"));
-				if (ltpPos >= 0)
-				{
-					ltpPos += 6;
-					int endPos = data.Find(_T(","), ltpPos);
-					if (endPos < 0) endPos = data.Find(_T("}"), ltpPos);
-					CString val = data.Mid(ltpPos, endPos - ltpPos);
-					ltp = (float)_tstof(val);
-				}
+					// TEMPORARY FIX: Always use current system time instead of server timestamp
+					// Server is sending incorrect/fixed timestamps (May 28 instead of current date)
+					// This ensures bars appear at the correct current time. The server time
+					// is still in the verbose trace above (TS=, Unix seconds).
+					time_t tickTimestamp = time(NULL);
 
-				// NEW: Extract last_trade_quantity
-				int lastTradeQtyPos = data.Find(_T("\"last_trade_quantity\":"));
-				if (lastTradeQtyPos >= 0)
-				{
-					lastTradeQtyPos += 22;
-					int endPos = data.Find(_T(","), lastTradeQtyPos);
-					if (endPos < 0) endPos = data.Find(_T("}"), lastTradeQtyPos);
-					CString val = data.Mid(lastTradeQtyPos, endPos - lastTradeQtyPos);
-					lastTradeQty = (float)_tstof(val);
+					// Process tick and build real-time bars
+					ProcessTick(nSymbolId, ltp, lastTradeQty, tickTimestamp);
 				}
+			}
 
-				// NEW: Extract timestamp (supports both Unix milliseconds and ISO 8601 string)
-				// Server sends: "timestamp":1761157800000 (Unix milliseconds, no quotes)
-				// OR: "timestamp":"2025-05-28T10:30:45.123Z" (ISO 8601 string)
-				int timestampPos = data.Find(_T("\"timestamp\":"));
-				if (timestampPos >= 0)
-				{
-					timestampPos += 12;  // Skip "timestamp":
+			continue; // Continue processing more messages
+		}
+		else
+		{
+			// Unknown message type - just log and continue
+			CString data(CStringA(frame.pPayload, min(frame.nPayloadLen, 200)));
+			CString unknownLog;
+			unknownLog.Format(_T("OpenAlgo: Received unknown/unhandled message: %s"), (LPCTSTR)data);
+			OutputDebugString(unknownLog);
+			continue;
+		}
+	} // End of while loop for processing messages
 
-					// Check if it's a string (starts with quote) or number
-					CString nextChar = data.Mid(timestampPos, 1);
-					if (nextChar == _T("\""))
-					{
-						// ISO 8601 string format: "timestamp":"2025-05-28..."
-						timestampPos += 1;  // Skip opening quote
-						int endPos = data.Find(_T("\""), timestampPos);
-						timestamp = data.Mid(timestampPos, endPos - timestampPos);
-					}
-					else
-					{
-						// Unix milliseconds format: "timestamp":1761157800000
-						int endPos = data.Find(_T(","), timestampPos);
-						if (endPos < 0) endPos = data.Find(_T("}"), timestampPos);
-						timestamp = data.Mid(timestampPos, endPos - timestampPos);
-						timestamp.Trim();  // Remove whitespace
-					}
-				}
+	QueryPerformanceCounter(&liNow);
+	UpdateWebSocketDrainStats(messagesProcessed, bTimeBudgetExhausted,
+		!bTimeBudgetExhausted && messagesProcessed >= nMessageBudget,
+		((liNow.QuadPart - liStart.QuadPart) * 1000000) / s_llPerfFrequency);
 
-				// ALWAYS log WebSocket data (for debugging)
-				static int s_wsCounter = 0;
-				s_wsCounter++;
-				CString debugMsg;
-				debugMsg.Format(_T("OpenAlgo: ===== WEBSOCKET TICK #%d ====="), s_wsCounter);
-				OutputDebugString(debugMsg);
-				debugMsg.Format(_T("OpenAlgo: WS Tick: Symbol=%s-%s LTP=%.2f Qty=%.0f TS=%s"),
-					symbol, exchange, ltp, lastTradeQty, timestamp);
-				OutputDebugString(debugMsg);
-				debugMsg.Format(_T("OpenAlgo: WS Data: O=%.2f H=%.2f L=%.2f C=%.2f V=%.0f OI=%.0f"),
-					open, high, low, close, volume, oi);
-				OutputDebugString(debugMsg);
-				debugMsg.Format(_T("OpenAlgo: RT Enabled=%d"), g_bRealTimeCandlesEnabled);
-				OutputDebugString(debugMsg);
+	return (messagesProcessed > 0); // Return TRUE if we processed any messages
+}
 
-				// Extract other fields similarly...
-				// (Simplified implementation - you could add more fields)
+///////////////////////////////
+// WebSocket I/O Thread
+///////////////////////////////
+//
+// Ticks used to be drained only when a 100 ms SetTimer() callback fired on
+// AmiBroker's UI thread, adding up to 100 ms of latency per tick and stalling
+// the UI during bursts. The I/O thread blocks until the socket is readable,
+// decodes and parses the frames, and feeds ProcessTick() immediately. The UI
+// thread receives at most one WM_USER_STREAMING_UPDATE per StreamingUpdateMs
+// (see MarkStreamingUpdate() / PostPendingStreamingUpdate()).
+//
+// WebSocketIoWait() is the only place that waits for readiness. It hands the
+// current socket to a WebSocketPoller (WSAEventSelect on Windows, epoll in the
+// Linux test build - see WebSocketPoll.cpp); the rest of the loop is plain
+// ProcessWebSocketData() calls, which read through the same poller with
+// WsPollerReadFrame() and never wait.
 
-				// Update cache (for GetRecentInfo() compatibility)
-				if (!symbol.IsEmpty() && !exchange.IsEmpty())
-				{
-					QuoteCache quote;
-					quote.symbol = symbol;
-					quote.exchange = exchange;
-					quote.ltp = ltp;
-					quote.open = open;
-					quote.high = high;
-					quote.low = low;
-					quote.close = close;
-					quote.volume = volume;
-					quote.oi = oi;
-					quote.lastUpdate = (DWORD)GetTickCount64();
-
-					CString ticker = symbol + _T("-") + exchange;
-					g_QuoteCache.SetAt(ticker, quote);
-
-					// NEW: Process tick for real-time candle building
-					if (g_bRealTimeCandlesEnabled && ltp > 0)
-					{
-						// If last_trade_quantity is missing or zero, use 1 as default
-						// This ensures ticks are still processed even without quantity info
-						if (lastTradeQty <= 0)
-						{
-							lastTradeQty = 1.0f;  // Default quantity
-						}
+BOOL StartWebSocketIoThread(void)
+{
+	if (g_hWebSocketIoThread != NULL)
+		return TRUE; // Already running
 
-						// TEMPORARY FIX: Always use current system time instead of server timestamp
-						// Server is sending incorrect/fixed timestamps (May 28 instead of current date)
-						// This ensures bars appear at the correct current time
-						time_t tickTimestamp = time(NULL);
+	if (!WsPollerOpen(&g_wsPoller))
+	{
+		OutputDebugString(_T("OpenAlgo: StartWebSocketIoThread - Failed to create events"));
+		StopWebSocketIoThread();
+		return FALSE;
+	}
 
-						// Debug: Log both server time and system time
-						CString timeLog;
-						if (!timestamp.IsEmpty())
-						{
-							time_t serverTime = ParseISO8601Timestamp(timestamp);
-
-							// Convert timestamps to readable format
-							struct tm serverTm, systemTm;
-							localtime_s(&serverTm, &serverTime);
-							localtime_s(&systemTm, &tickTimestamp);
-
-							CString serverTimeStr, systemTimeStr;
-							serverTimeStr.Format(_T("%04d-%02d-%02d %02d:%02d:%02d"),
-								serverTm.tm_year + 1900, serverTm.tm_mon + 1, serverTm.tm_mday,
-								serverTm.tm_hour, serverTm.tm_min, serverTm.tm_sec);
-							systemTimeStr.Format(_T("%04d-%02d-%02d %02d:%02d:%02d"),
-								systemTm.tm_year + 1900, systemTm.tm_mon + 1, systemTm.tm_mday,
-								systemTm.tm_hour, systemTm.tm_min, systemTm.tm_sec);
-
-							timeLog.Format(_T("OpenAlgo: Timestamp - Server=%s System=%s (using System)"),
-								serverTimeStr, systemTimeStr);
-							OutputDebugString(timeLog);
-						}
+	g_hWebSocketIoThread = (HANDLE)_beginthreadex(NULL, 0, WebSocketIoThreadProc, NULL, 0, NULL);
+	if (g_hWebSocketIoThread == NULL)
+	{
+		OutputDebugString(_T("OpenAlgo: StartWebSocketIoThread - _beginthreadex FAILED"));
+		StopWebSocketIoThread();
+		return FALSE;
+	}
 
-						// Process tick and build real-time bars
-						OutputDebugString(_T("OpenAlgo: About to call ProcessTick..."));
-						BOOL result = ProcessTick(symbol, exchange, ltp, lastTradeQty, tickTimestamp);
+	OutputDebugString(_T("OpenAlgo: WebSocket I/O thread started"));
+	return TRUE;
+}
 
-						CString resultMsg;
-						resultMsg.Format(_T("OpenAlgo: ProcessTick result = %s"), result ? _T("SUCCESS") : _T("FAILED"));
-						OutputDebugString(resultMsg);
-					}
-					else
-					{
-						CString reason;
-						reason.Format(_T("OpenAlgo: ProcessTick SKIPPED - RT_Enabled=%d LTP=%.2f"),
-							g_bRealTimeCandlesEnabled, ltp);
-						OutputDebugString(reason);
-					}
-				}
+void StopWebSocketIoThread(void)
+{
+	if (g_hWebSocketIoThread != NULL)
+	{
+		WsPollerSignalStop(&g_wsPoller);
 
-				continue; // Continue processing more messages
-			}
-			else
-			{
-				// Unknown message type - just continue
-				OutputDebugString(_T("OpenAlgo: Received unknown/unhandled message type"));
-				continue;
-			}
+		// A connect/authenticate in progress can take several seconds to time out
+		if (WaitForSingleObject(g_hWebSocketIoThread, 15000) != WAIT_OBJECT_0)
+		{
+			// Leave the events alive - the thread may still be waiting on them
+			OutputDebugString(_T("OpenAlgo: WARNING - WebSocket I/O thread did not stop within 15 seconds"));
+			CloseHandle(g_hWebSocketIoThread);
+			g_hWebSocketIoThread = NULL;
+			return;
 		}
-		else if (received == 0)
+
+		CloseHandle(g_hWebSocketIoThread);
+		g_hWebSocketIoThread = NULL;
+		OutputDebugString(_T("OpenAlgo: WebSocket I/O thread stopped"));
+	}
+
+	WsPollerClose(&g_wsPoller);
+}
+
+// Block until the socket is readable, the thread is asked to stop, or dwTimeoutMs elapses.
+// Returns WS_IO_WAKE_READABLE, WS_IO_WAKE_STOP or WS_IO_WAKE_TIMEOUT.
+int WebSocketIoWait(LONG* pnSelectedGeneration, DWORD dwTimeoutMs)
+{
+	// A reconnect replaced the socket - watch the new one. After a disconnect only
+	// a stop request or the reconnect interval can wake us.
+	LONG nGeneration = g_nWebSocketGeneration;
+	BOOL bConnected = (g_bWebSocketConnected && g_websocket != INVALID_SOCKET);
+	if (bConnected && nGeneration != *pnSelectedGeneration)
+	{
+		if (!WsPollerSelect(&g_wsPoller, g_websocket))
 		{
-			// Connection closed by server (graceful close)
-			OutputDebugString(_T("OpenAlgo: ========== CRITICAL: SERVER CLOSED CONNECTION =========="));
-			OutputDebugString(_T("OpenAlgo: recv() returned 0 - server sent FIN packet (connection closed gracefully)"));
-			OutputDebugString(_T("OpenAlgo: Server closed after ~1 minute - will attempt auto-reconnect"));
-			OutputDebugString(_T("OpenAlgo: ========================================================"));
+			CString errMsg;
+			errMsg.Format(_T("OpenAlgo: WsPollerSelect FAILED (error %d)"), WSAGetLastError());
+			OutputDebugString(errMsg);
+		}
+		*pnSelectedGeneration = nGeneration;
+	}
+	else if (!bConnected && g_wsPoller.socket != INVALID_SOCKET)
+	{
+		WsPollerSelect(&g_wsPoller, INVALID_SOCKET);
+		*pnSelectedGeneration = -1;
+	}
 
-			// Mark as disconnected
-			g_bWebSocketConnected = FALSE;
-			g_bWebSocketAuthenticated = FALSE;
-			closesocket(g_websocket);
-			g_websocket = INVALID_SOCKET;
+	return WsPollerWait(&g_wsPoller, dwTimeoutMs);
+}
 
-			// Clear subscriptions so they'll be re-subscribed on reconnect
-			EnterCriticalSection(&g_WebSocketCriticalSection);
-			g_SubscribedSymbols.RemoveAll();
-			LeaveCriticalSection(&g_WebSocketCriticalSection);
+// Record that a symbol ticked (I/O thread, from ProcessTick())
+void MarkStreamingUpdate(int nSymbolId, BOOL bBarClosed)
+{
+	g_streamingStats.nTicks++;
 
-			// Attempt immediate reconnection
-			OutputDebugString(_T("OpenAlgo: Attempting WebSocket reconnection..."));
-			if (InitializeWebSocket())
-			{
-				OutputDebugString(_T("OpenAlgo: *** RECONNECTED SUCCESSFULLY! ***"));
-			}
-			else
-			{
-				OutputDebugString(_T("OpenAlgo: *** RECONNECTION FAILED - will retry on next call ***"));
-			}
+	SymbolState* pState = GetSymbolState(nSymbolId);
+	if (!pState->bDirty)
+	{
+		pState->bDirty = TRUE;
+		g_aDirtySymbols.SetAtGrow(g_nDirtySymbols++, nSymbolId);
+	}
 
-			break; // Exit loop after reconnect attempt
+	if (bBarClosed)
+		g_bStreamingBarClosed = TRUE;
+	g_nStreamingUpdatePending = 1;
+}
+
+// Post a single WM_USER_STREAMING_UPDATE for every symbol that ticked since the last
+// one - once StreamingUpdateMs has passed, right away if a bar closed, or if bFlush.
+// Returns how long the I/O thread may wait before it has to call again.
+DWORD PostPendingStreamingUpdate(BOOL bFlush)
+{
+	if (!g_nStreamingUpdatePending)
+		return WS_IO_IDLE_WAKE_MS;
+
+	DWORD dwNow = GetTickCount();
+	DWORD dwElapsed = dwNow - g_dwLastStreamingUpdate;
+	BOOL bIntervalPassed = (dwElapsed >= (DWORD)g_nStreamingUpdateMs);
+	if (!bFlush && !g_bStreamingBarClosed && !bIntervalPassed)
+		return (DWORD)g_nStreamingUpdateMs - dwElapsed;
+
+	for (int i = 0; i < g_nDirtySymbols; i++)
+		GetSymbolState(g_aDirtySymbols[i])->bDirty = FALSE;
+
+	g_streamingStats.nNotifications++;
+	g_streamingStats.nDirtySymbols += g_nDirtySymbols;
+	if (g_bStreamingBarClosed && !bIntervalPassed)
+		g_streamingStats.nBarCloseFlushes++;
+
+	g_nDirtySymbols = 0;
+	g_bStreamingBarClosed = FALSE;
+	g_nStreamingUpdatePending = 0;
+	g_dwLastStreamingUpdate = dwNow;
+
+	HWND hWnd = g_hAmiBrokerWnd;
+	if (hWnd != NULL)
+	{
+		::PostMessage(hWnd, WM_USER_STREAMING_UPDATE, 0, 0);
+	}
+
+	return WS_IO_IDLE_WAKE_MS;
+}
+
+unsigned __stdcall WebSocketIoThreadProc(void* pParam)
+{
+	LONG nSelectedGeneration = -1;
+	DWORD dwWaitMs = WS_IO_IDLE_WAKE_MS;
+
+	while (TRUE)
+	{
+		// Wake at least once a second so the keep-alive PING and auto-reconnect still run,
+		// and sooner if a coalesced streaming update is due
+		int nWake = WebSocketIoWait(&nSelectedGeneration, dwWaitMs);
+		if (nWake == WS_IO_WAKE_STOP)
+			break;
+
+		// Drain everything that is available. Each call is bounded by the drain budget;
+		// AmiBroker hears about the ticks at most once per StreamingUpdateMs
+		while (ProcessWebSocketData())
+		{
+			PostPendingStreamingUpdate(FALSE);
+			if (WsPollerStopRequested(&g_wsPoller))
+				break;
 		}
+		dwWaitMs = PostPendingStreamingUpdate(FALSE);
+
+		// One journal write per drained batch; fsync at most every JournalFsyncMs
+		FlushTickJournal(FALSE);
 	}
-	} // End of while loop for processing messages
 
-	return (messagesProcessed > 0); // Return TRUE if we processed any messages
+	PostPendingStreamingUpdate(TRUE);
+	FlushTickJournal(TRUE);
+	return 0;
 }
 
 void CleanupWebSocket(void)
@@ -3390,28 +4325,28 @@ void CleanupWebSocket(void)
 		EnterCriticalSection(&g_WebSocketCriticalSection);
 		
 		// Unsubscribe from all symbols
-		POSITION pos = g_SubscribedSymbols.GetStartPosition();
-		while (pos != NULL)
+		int nSymbols = g_SymbolTable.nCount;
+		for (int i = 0; i < nSymbols; i++)
 		{
-			CString symbol;
-			BOOL subscribed;
-			g_SubscribedSymbols.GetNextAssoc(pos, symbol, subscribed);
-			
-			if (subscribed)
+			SymbolState* pState = GetSymbolState(i);
+			if (pState->bSubscribed)
 			{
-				UnsubscribeFromSymbol(symbol);
+				UnsubscribeFromSymbol(GetSymbolTicker(i));
+				pState->bSubscribed = FALSE;
 			}
 		}
 		
-		g_SubscribedSymbols.RemoveAll();
-		
 		LeaveCriticalSection(&g_WebSocketCriticalSection);
 		DeleteCriticalSection(&g_WebSocketCriticalSection);
 		g_bCriticalSectionInitialized = FALSE;
 	}
 	
 	// Close WebSocket connection
-	if (g_websocket != INVALID_SOCKET)
+	if (g_bSendCriticalSectionInitialized)
+	{
+		SetWebSocketHandle(INVALID_SOCKET);
+	}
+	else if (g_websocket != INVALID_SOCKET)
 	{
 		closesocket(g_websocket);
 		g_websocket = INVALID_SOCKET;
@@ -3420,6 +4355,9 @@ void CleanupWebSocket(void)
 	g_bWebSocketConnected = FALSE;
 	g_bWebSocketAuthenticated = FALSE;
 	g_bWebSocketConnecting = FALSE;
+
+	// Release the receive buffer (reallocated on next connect)
+	WsRecvBufferFree(&g_wsRecvBuffer);
 	
 	WSACleanup();
 }
@@ -3428,249 +4366,1603 @@ void CleanupWebSocket(void)
 // Real-Time Candle Building Functions
 ///////////////////////////////
 
-// Parse ISO 8601 timestamp (e.g., "2025-05-28T10:30:45.123Z")
-time_t ParseISO8601Timestamp(const CString& isoTimestamp)
+// Get or create BarBuilder for a symbol ID
+// The returned builder stays valid until CleanupBarBuilders(); lock it with its own lock.
+BarBuilder* GetOrCreateBarBuilder(int nSymbolId)
+{
+	SymbolState* pState = GetSymbolState(nSymbolId);
+	BarBuilder* pBuilder = pState->pBarBuilder;
+	if (pBuilder != NULL)
+		return pBuilder;
+
+	EnterCriticalSection(&g_BarBuilderCriticalSection);
+
+	pBuilder = pState->pBarBuilder;
+	if (pBuilder == NULL)
+	{
+		// Create new BarBuilder
+		pBuilder = new BarBuilder();
+		CString ticker(GetSymbolTicker(nSymbolId));
+
+		// Extract the exchange from the ticker (e.g., "RELIANCE-NSE")
+		int dashPos = ticker.ReverseFind('-');
+		_tcsncpy_s(pBuilder->exchange, BAR_BUILDER_EXCHANGE_SIZE,
+			(dashPos > 0) ? (LPCTSTR)ticker.Mid(dashPos + 1) : _T("NSE"), _TRUNCATE);  // Default exchange
+
+		InterlockedExchangePointer((PVOID volatile*)&pState->pBarBuilder, pBuilder);  // Publish
+	}
+
+	LeaveCriticalSection(&g_BarBuilderCriticalSection);
+
+	return pBuilder;
+}
+
+// Get the BarBuilder for a symbol ID, or NULL if no tick has been seen for it
+BarBuilder* FindBarBuilder(int nSymbolId)
 {
-	if (isoTimestamp.IsEmpty())
-		return time(NULL);
+	return GetSymbolState(nSymbolId)->pBarBuilder;
+}
 
-	// Check if it's a Unix timestamp (all digits, possibly with whitespace)
-	// Example: "1761157800000" (milliseconds since epoch)
-	CString trimmed = isoTimestamp;
-	trimmed.Trim();
+// Fold one tick into a builder (AddTickToBarBuilder()). Caller must hold pBuilder->lock.
+// bVerbose is g_bVerboseTickLog for live ticks (off by default) and FALSE for journal
+// replay, which runs millions of ticks without logging.
+// Returns TRUE if the tick closed the previous bar.
+BOOL ApplyTickToBarBuilder(BarBuilder* pBuilder, float ltp, float lastTradeQty, time_t timestamp, BOOL bVerbose)
+{
+	BOOL bBarClosed = AddTickToBarBuilder(pBuilder, ltp, lastTradeQty, timestamp);
 
-	BOOL isNumeric = TRUE;
-	for (int i = 0; i < trimmed.GetLength(); i++)
+	if (bVerbose)
 	{
-		if (!_istdigit(trimmed[i]))
+		CString tickLog;
+		if (bBarClosed)
 		{
-			isNumeric = FALSE;
-			break;
+			const struct Quotation& closed = pBuilder->bars.GetLast();
+			tickLog.Format(_T("OpenAlgo: ProcessTick - Finalized bar: O=%.2f H=%.2f L=%.2f C=%.2f V=%.0f"),
+				closed.Open, closed.High, closed.Low, closed.Price, closed.Volume);
+			OutputDebugString(tickLog);
 		}
+		tickLog.Format(_T("OpenAlgo: ProcessTick - Bar UPDATED: Start=%lld O=%.2f H=%.2f L=%.2f C=%.2f V=%.0f Ticks=%d"),
+			(__int64)pBuilder->barStartTime, pBuilder->currentBar.Open, pBuilder->currentBar.High,
+			pBuilder->currentBar.Low, pBuilder->currentBar.Price, pBuilder->currentBar.Volume, pBuilder->tickCount);
+		OutputDebugString(tickLog);
 	}
 
-	if (isNumeric)
-	{
-		// Parse as Unix timestamp in MILLISECONDS
-		__int64 milliseconds = _tstoi64(trimmed);
+	return bBarClosed;
+}
 
-		// Convert milliseconds to seconds
-		time_t timestamp = (time_t)(milliseconds / 1000);
+// Process a tick and update bars
+BOOL ProcessTick(int nSymbolId, float ltp, float lastTradeQty, time_t timestamp)
+{
+	if (!g_bRealTimeCandlesEnabled)
+		return FALSE;
 
-		return timestamp;
+	// Get or create BarBuilder
+	BarBuilder* pBuilder = GetOrCreateBarBuilder(nSymbolId);
+	if (!pBuilder)
+	{
+		OutputDebugString(_T("OpenAlgo: ProcessTick - FAILED to get/create BarBuilder"));
+		return FALSE;
 	}
 
-	// Otherwise, try to parse as ISO 8601: YYYY-MM-DDTHH:MM:SS.sssZ
-	struct tm timeinfo = { 0 };
-	int year, month, day, hour, minute, second;
+	EnterCriticalSection(&pBuilder->lock);
+
+	BOOL bBarClosed = ApplyTickToBarBuilder(pBuilder, ltp, lastTradeQty, timestamp, g_bVerboseTickLog);
+
+	// Update last tick time
+	pBuilder->lastTickTime = (DWORD)GetTickCount64();
+
+	LeaveCriticalSection(&pBuilder->lock);
+
+	// Journal the tick so the bar can be rebuilt after a crash or plugin reload
+	AppendTickJournal(nSymbolId, ltp, lastTradeQty, timestamp);
 
-	int count = _stscanf_s(isoTimestamp, _T("%d-%d-%dT%d:%d:%d"),
-		&year, &month, &day, &hour, &minute, &second);
+	// Notify AmiBroker of update - coalesced by the I/O thread into one
+	// WM_USER_STREAMING_UPDATE per StreamingUpdateMs (sooner if a bar just closed)
+	MarkStreamingUpdate(nSymbolId, bBarClosed);
 
-	if (count == 6)
+	return TRUE;
+}
+
+// Cleanup all BarBuilders
+void CleanupBarBuilders(void)
+{
+	if (g_bBarBuilderCriticalSectionInitialized)
 	{
-		timeinfo.tm_year = year - 1900;
-		timeinfo.tm_mon = month - 1;
-		timeinfo.tm_mday = day;
-		timeinfo.tm_hour = hour;
-		timeinfo.tm_min = minute;
-		timeinfo.tm_sec = second;
-		timeinfo.tm_isdst = -1;
+		EnterCriticalSection(&g_BarBuilderCriticalSection);
 
-		// Convert to Unix timestamp
-		time_t timestamp = mktime(&timeinfo);
+		// Delete all BarBuilder objects
+		int nSymbols = g_SymbolTable.nCount;
+		for (int i = 0; i < nSymbols; i++)
+		{
+			SymbolState* pState = GetSymbolState(i);
+			BarBuilder* pBuilder = pState->pBarBuilder;
+			if (pBuilder)
+			{
+				pState->pBarBuilder = NULL;
+				delete pBuilder;
+			}
+		}
 
-		// Note: This assumes local time. For UTC, we'd need _mkgmtime or adjust for timezone
-		// For simplicity, using local time which matches server time in most cases
-		return timestamp;
+		LeaveCriticalSection(&g_BarBuilderCriticalSection);
 	}
+}
+
+///////////////////////////////
+// Tick Journal
+///////////////////////////////
+//
+// Bars built from WebSocket ticks only live in memory (BarBuilder::currentBar and
+// BarBuilder::bars), so a crash or plugin reload used to lose them. ProcessTick()
+// now also appends every tick to a journal file, one file per day in the
+// default exchange time zone ("UtcOffsetMinutes", see "Calendar Conversion").
+// Records collect in g_tickJournal.writer (TickJournalWriter) and go out with one
+// WriteFile() per 1024 ticks or per drained WebSocket batch (FlushTickJournal() on
+// the I/O thread). FlushFileBuffers() runs at most once every JournalFsyncMs.
+//
+// Init() replays today's file through ApplyTickToBarBuilder(), which rebuilds
+// the bars exactly as they were first built. If a crash interrupted a write,
+// the last record fails its checksum and is cut off.
+
+static BOOL WriteTickJournalFile(void* pWriter, const void* pBuffer, DWORD dwBytes)
+{
+	DWORD dwWritten = 0;
+	if (WriteFile((HANDLE)pWriter, pBuffer, dwBytes, &dwWritten, NULL) && dwWritten == dwBytes)
+		return TRUE;
 
-	// If all parsing fails, return current time as fallback
-	return time(NULL);
+	CString errorMsg;
+	errorMsg.Format(_T("OpenAlgo: Tick journal write failed (error %lu) - %d ticks not journaled"),
+		GetLastError(), (int)(dwBytes / sizeof(TickJournalRecord)));
+	OutputDebugString(errorMsg);
+	return FALSE;
 }
 
-// Get or create BarBuilder for a ticker
-BarBuilder* GetOrCreateBarBuilder(const CString& ticker)
+static void SyncTickJournalFile(void* pWriter)
 {
-	BarBuilder* pBuilder = NULL;
+	FlushFileBuffers((HANDLE)pWriter);
+}
 
-	EnterCriticalSection(&g_BarBuilderCriticalSection);
+// Delete journal files older than TICK_JOURNAL_KEEP_DAYS before nDayStart
+void DeleteOldTickJournals(const CString& dir, __int64 nDayStart)
+{
+	__int64 nCutoffStart, nCutoffEnd;
+	int nCutoffDate;
+	GetTickJournalDay(nDayStart - (__int64)TICK_JOURNAL_KEEP_DAYS * 86400, GetExchangeUtcOffsetSeconds(NULL),
+		&nCutoffStart, &nCutoffEnd, &nCutoffDate);
+
+	CString cutoffName;
+	cutoffName.Format(_T("ticks-%08d.bin"), nCutoffDate);
+
+	WIN32_FIND_DATA findData;
+	HANDLE hFind = FindFirstFile(dir + _T("\\ticks-*.bin"), &findData);
+	if (hFind == INVALID_HANDLE_VALUE)
+		return;
 
-	if (!g_BarBuilders.Lookup(ticker, pBuilder))
+	do
 	{
-		// Create new BarBuilder
-		pBuilder = new BarBuilder();
+		// ticks-YYYYMMDD.bin names sort by date
+		if (_tcslen(findData.cFileName) == (size_t)cutoffName.GetLength() &&
+			_tcscmp(findData.cFileName, cutoffName) < 0)
+		{
+			DeleteFile(dir + _T("\\") + findData.cFileName);
+		}
+	} while (FindNextFile(hFind, &findData));
 
-		// Extract symbol and exchange from ticker (e.g., "RELIANCE-NSE")
-		int dashPos = ticker.ReverseFind('-');
-		if (dashPos > 0)
+	FindClose(hFind);
+}
+
+// Open (or create) the journal file for the day containing nTime.
+// bReplay = TRUE replays its records into the BarBuilders first (Init).
+// Caller must hold g_TickJournalCriticalSection.
+BOOL OpenTickJournal(__int64 nTime, BOOL bReplay)
+{
+	TCHAR szAppData[MAX_PATH];
+	if (FAILED(SHGetFolderPath(NULL, CSIDL_LOCAL_APPDATA, NULL, 0, szAppData)))
+		return FALSE;
+
+	CString dir = szAppData;
+	dir += _T("\\OpenAlgo");
+	CreateDirectory(dir, NULL);
+	dir += _T("\\Journal");
+	CreateDirectory(dir, NULL);
+
+	// Day boundaries in exchange time, the same days the bars are dated with
+	__int64 nDayStart, nRotateAt;
+	int nDate;
+	GetTickJournalDay(nTime, GetExchangeUtcOffsetSeconds(NULL), &nDayStart, &nRotateAt, &nDate);
+
+	CString path;
+	path.Format(_T("%s\\ticks-%08d.bin"), (LPCTSTR)dir, nDate);
+
+	HANDLE hFile = CreateFile(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL,
+		OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+	{
+		CString errorMsg;
+		errorMsg.Format(_T("OpenAlgo: Cannot open tick journal %s (error %lu)"), (LPCTSTR)path, GetLastError());
+		OutputDebugString(errorMsg);
+		return FALSE;
+	}
+
+	TickJournalFileHeader header;
+	DWORD dwRead = 0;
+	BOOL bValid = (ReadFile(hFile, &header, sizeof(header), &dwRead, NULL) && dwRead == sizeof(header) &&
+	               IsTickJournalHeaderValid(&header));
+
+	LARGE_INTEGER liEnd;
+	if (bValid)
+	{
+		// Keep every intact record; anything after the first bad one is cut off
+		__int64 nRecords;
+		if (bReplay && g_bRealTimeCandlesEnabled)
 		{
-			pBuilder->symbol = ticker.Left(dashPos);
-			pBuilder->exchange = ticker.Mid(dashPos + 1);
+			nRecords = ReplayTickJournal(hFile);
 		}
 		else
 		{
-			pBuilder->symbol = ticker;
-			pBuilder->exchange = _T("NSE");  // Default exchange
+			LARGE_INTEGER liSize;
+			GetFileSizeEx(hFile, &liSize);
+			nRecords = (liSize.QuadPart - TICK_JOURNAL_HEADER_SIZE) / sizeof(TickJournalRecord);
 		}
-
-		g_BarBuilders.SetAt(ticker, pBuilder);
+		liEnd.QuadPart = TICK_JOURNAL_HEADER_SIZE + nRecords * sizeof(TickJournalRecord);
+	}
+	else
+	{
+		// New or unreadable file - start it over
+		InitTickJournalHeader(&header);
+
+		DWORD dwWritten = 0;
+		LARGE_INTEGER liZero;
+		liZero.QuadPart = 0;
+		SetFilePointerEx(hFile, liZero, NULL, FILE_BEGIN);
+		WriteFile(hFile, &header, sizeof(header), &dwWritten, NULL);
+		liEnd.QuadPart = TICK_JOURNAL_HEADER_SIZE;
 	}
 
-	LeaveCriticalSection(&g_BarBuilderCriticalSection);
+	SetFilePointerEx(hFile, liEnd, NULL, FILE_BEGIN);
+	SetEndOfFile(hFile);
 
-	return pBuilder;
+	g_tickJournal.hFile = hFile;
+	g_tickJournal.nDayStart = nDayStart;
+	g_tickJournal.nRotateAt = nRotateAt;
+	OpenTickJournalWriter(&g_tickJournal.writer, WriteTickJournalFile, SyncTickJournalFile, hFile, GetTickCount());
+
+	DeleteOldTickJournals(dir, nDayStart);
+	return TRUE;
 }
 
-// Process a tick and update bars
-BOOL ProcessTick(const CString& symbol, const CString& exchange, float ltp, float lastTradeQty, time_t timestamp)
+// Consecutive ticks are often for the same symbol - replay keeps that builder
+// locked and skips the symbol lookup until the ticker changes
+struct TickJournalReplay {
+	BarBuilder* pBuilder;
+	char szLastTicker[TICK_JOURNAL_TICKER_SIZE];
+};
+
+static BOOL ReadTickJournalFile(void* pReader, void* pBuffer, DWORD dwBytes, DWORD* pdwRead)
 {
-	static int s_tickCallCount = 0;
-	s_tickCallCount++;
+	return ReadFile((HANDLE)pReader, pBuffer, dwBytes, pdwRead, NULL);
+}
 
-	if (!g_bRealTimeCandlesEnabled)
+static void ApplyJournaledTick(void* pContext, const TickJournalRecord* pRecord)
+{
+	TickJournalReplay* pReplay = (TickJournalReplay*)pContext;
+	if (pReplay->pBuilder == NULL || strcmp(pRecord->szTicker, pReplay->szLastTicker) != 0)
 	{
-		OutputDebugString(_T("OpenAlgo: ProcessTick - Real-time candles DISABLED, exiting"));
-		return FALSE;
+		if (pReplay->pBuilder != NULL)
+			LeaveCriticalSection(&pReplay->pBuilder->lock);
+
+		int nSymbolId = InternSymbol(CString(pRecord->szTicker));
+		pReplay->pBuilder = (nSymbolId >= 0) ? GetOrCreateBarBuilder(nSymbolId) : NULL;
+		memcpy(pReplay->szLastTicker, pRecord->szTicker, TICK_JOURNAL_TICKER_SIZE);
+
+		if (pReplay->pBuilder != NULL)
+			EnterCriticalSection(&pReplay->pBuilder->lock);
 	}
 
-	// Create ticker key
-	CString ticker = symbol + _T("-") + exchange;
+	if (pReplay->pBuilder != NULL)
+		ApplyTickToBarBuilder(pReplay->pBuilder, pRecord->fLtp, pRecord->fLastTradeQty, (time_t)pRecord->nTimestamp, FALSE);
+}
 
-	CString tickLog;
-	tickLog.Format(_T("OpenAlgo: ProcessTick #%d START: %s LTP=%.2f Qty=%.0f TS=%lld"),
-		s_tickCallCount, ticker, ltp, lastTradeQty, (__int64)timestamp);
-	OutputDebugString(tickLog);
+// Feed every intact record after the header into the BarBuilders.
+// Returns the number of intact records.
+__int64 ReplayTickJournal(HANDLE hFile)
+{
+	LARGE_INTEGER liStart;
+	QueryPerformanceCounter(&liStart);
 
-	// Get or create BarBuilder
-	BarBuilder* pBuilder = GetOrCreateBarBuilder(ticker);
-	if (!pBuilder)
-	{
-		OutputDebugString(_T("OpenAlgo: ProcessTick - FAILED to get/create BarBuilder"));
-		return FALSE;
-	}
+	TickJournalReplay replay;
+	replay.pBuilder = NULL;
+	replay.szLastTicker[0] = '\0';
 
-	EnterCriticalSection(&g_BarBuilderCriticalSection);
+	BOOL bTorn = FALSE;
+	__int64 nGood = ReplayTickJournalRecords(ReadTickJournalFile, hFile, ApplyJournaledTick, &replay, &bTorn);
+
+	if (replay.pBuilder != NULL)
+		LeaveCriticalSection(&replay.pBuilder->lock);
+
+	CString replayMsg;
+	replayMsg.Format(_T("OpenAlgo: Replayed %lld journaled ticks in %.1f ms%s"),
+		nGood, HttpElapsedUs(liStart) / 1000.0, bTorn ? _T(" (damaged tail cut off)") : _T(""));
+	OutputDebugString(replayMsg);
+
+	return nGood;
+}
+
+// Journal one tick (called by ProcessTick() after the bar was updated)
+void AppendTickJournal(int nSymbolId, float ltp, float lastTradeQty, time_t timestamp)
+{
+	if (!g_bTickJournalEnabled || !g_bTickJournalCriticalSectionInitialized)
+		return;
 
-	// Determine bar boundary (1-minute intervals)
-	time_t barPeriodStart = (timestamp / 60) * 60;  // Floor to minute boundary
+	LPCTSTR pszTicker = GetSymbolTicker(nSymbolId);
+	if (_tcslen(pszTicker) >= TICK_JOURNAL_TICKER_SIZE)
+		return;  // Does not fit a record - the bar falls back to HTTP after a restart
 
-	CString barLog;
-	barLog.Format(_T("OpenAlgo: ProcessTick - BarPeriodStart=%lld CurrentBarStart=%lld NewBar=%d"),
-		(__int64)barPeriodStart, (__int64)pBuilder->barStartTime,
-		(pBuilder->barStartTime != barPeriodStart) ? 1 : 0);
-	OutputDebugString(barLog);
+	EnterCriticalSection(&g_TickJournalCriticalSection);
 
-	// Check if we need a new bar
-	if (pBuilder->barStartTime != barPeriodStart)
+	if (g_tickJournal.hFile != INVALID_HANDLE_VALUE && (__int64)timestamp >= g_tickJournal.nRotateAt)
 	{
-		// Finalize current bar if it exists
-		if (pBuilder->bBarStarted && pBuilder->barStartTime > 0)
-		{
-			CString finalizeLog;
-			finalizeLog.Format(_T("OpenAlgo: ProcessTick - Finalizing bar: O=%.2f H=%.2f L=%.2f C=%.2f V=%.0f Ticks=%d"),
-				pBuilder->currentBar.Open, pBuilder->currentBar.High, pBuilder->currentBar.Low,
-				pBuilder->currentBar.Price, pBuilder->currentBar.Volume, pBuilder->tickCount);
-			OutputDebugString(finalizeLog);
+		// First tick of a new day - finish the old file and start the next one
+		CloseTickJournalWriter(&g_tickJournal.writer);
+		CloseHandle(g_tickJournal.hFile);
+		g_tickJournal.hFile = INVALID_HANDLE_VALUE;
 
-			// Add current bar to history
-			pBuilder->bars.Add(pBuilder->currentBar);
+		OpenTickJournal((__int64)timestamp, FALSE);
+	}
 
-			// Check if we need to remove old bars (rolling window)
-			if (pBuilder->bars.GetCount() >= pBuilder->maxBars)
-			{
-				// Remove oldest 10% to make room
-				int removeCount = pBuilder->maxBars / 10;
-				pBuilder->bars.RemoveAt(0, removeCount);
-				OutputDebugString(_T("OpenAlgo: ProcessTick - Removed old bars (rolling window)"));
-			}
-		}
+	if (g_tickJournal.hFile != INVALID_HANDLE_VALUE)
+		AppendTickJournalRecord(&g_tickJournal.writer, (__int64)timestamp, ltp, lastTradeQty, pszTicker);
 
-		OutputDebugString(_T("OpenAlgo: ProcessTick - Starting NEW BAR"));
+	LeaveCriticalSection(&g_TickJournalCriticalSection);
+}
 
-		// Start new bar
-		memset(&pBuilder->currentBar, 0, sizeof(struct Quotation));
-		pBuilder->currentBar.Open = ltp;
-		pBuilder->currentBar.High = ltp;
-		pBuilder->currentBar.Low = ltp;
-		pBuilder->currentBar.Price = ltp;  // Price is the Close value in Quotation struct
-		pBuilder->currentBar.Volume = 0;
-		pBuilder->currentBar.OpenInterest = 0;
+// Write buffered ticks; sync to disk if bSync or JournalFsyncMs has passed.
+// Called by the I/O thread after each drained batch.
+void FlushTickJournal(BOOL bSync)
+{
+	if (!g_bTickJournalCriticalSectionInitialized)
+		return;
 
-		// Set normalized timestamp (critical for AmiBroker)
-		ConvertUnixToPackedDate(barPeriodStart, &pBuilder->currentBar.DateTime);
-		pBuilder->currentBar.DateTime.PackDate.Second = 0;
-		pBuilder->currentBar.DateTime.PackDate.MilliSec = 0;
-		pBuilder->currentBar.DateTime.PackDate.MicroSec = 0;
+	EnterCriticalSection(&g_TickJournalCriticalSection);
 
-		pBuilder->barStartTime = barPeriodStart;
-		pBuilder->bBarStarted = TRUE;
-		pBuilder->volumeAccumulator = 0.0f;
-		pBuilder->bFirstTickReceived = TRUE;
-		pBuilder->tickCount = 0;  // Reset tick counter for new bar
-	}
+	if (g_tickJournal.hFile != INVALID_HANDLE_VALUE)
+		FlushTickJournalWriter(&g_tickJournal.writer, bSync, GetTickCount(), (DWORD)g_nJournalFsyncMs);
 
-	// Update current bar OHLC
-	if (ltp > pBuilder->currentBar.High)
-		pBuilder->currentBar.High = ltp;
-	if (ltp < pBuilder->currentBar.Low || pBuilder->currentBar.Low == 0.0f)
-		pBuilder->currentBar.Low = ltp;
-	pBuilder->currentBar.Price = ltp;  // Price is the Close value in Quotation struct
+	LeaveCriticalSection(&g_TickJournalCriticalSection);
+}
 
-	// Accumulate volume
-	pBuilder->volumeAccumulator += lastTradeQty;
-	pBuilder->currentBar.Volume = pBuilder->volumeAccumulator;
-	pBuilder->tickCount++;
+void CloseTickJournal(void)
+{
+	if (!g_bTickJournalCriticalSectionInitialized)
+		return;
 
-	CString updateLog;
-	updateLog.Format(_T("OpenAlgo: ProcessTick - Bar UPDATED: O=%.2f H=%.2f L=%.2f C=%.2f V=%.0f Ticks=%d"),
-		pBuilder->currentBar.Open, pBuilder->currentBar.High, pBuilder->currentBar.Low,
-		pBuilder->currentBar.Price, pBuilder->currentBar.Volume, pBuilder->tickCount);
-	OutputDebugString(updateLog);
+	EnterCriticalSection(&g_TickJournalCriticalSection);
 
-	// Update last tick time
-	pBuilder->lastTickTime = (DWORD)GetTickCount64();
+	if (g_tickJournal.hFile != INVALID_HANDLE_VALUE)
+	{
+		CloseTickJournalWriter(&g_tickJournal.writer);
+		CloseHandle(g_tickJournal.hFile);
+		g_tickJournal.hFile = INVALID_HANDLE_VALUE;
+	}
 
-	LeaveCriticalSection(&g_BarBuilderCriticalSection);
+	LeaveCriticalSection(&g_TickJournalCriticalSection);
+}
 
-	// Notify AmiBroker of update (non-blocking)
-	if (g_hAmiBrokerWnd != NULL)
+///////////////////////////////
+// History Workers
+///////////////////////////////
+//
+// GetQuotesEx() runs on AmiBroker's UI thread and used to call GetOpenAlgoHistory()
+// inline, so a slow server (10 s receive timeout) froze the whole program. Now it
+// calls GetOpenAlgoHistoryAsync(), which only copies memory: it merges a finished
+// fetch if there is one, queues a new fetch when the last one is too old, and
+// returns the bars AmiBroker already has (plus the bar cache on first load).
+//
+// A fixed pool of workers takes jobs from a FIFO. Each job carries the newest bars
+// of the requested kind, so GetOpenAlgoHistory()'s gap detection asks for the same
+// date range as before. When the download is done, the worker keeps only the bars
+// the server added or changed; AmiBroker may have newer tick data for the rest.
+// The result waits in the symbol's HistoryFetchSlot and a WM_USER_STREAMING_UPDATE
+// makes AmiBroker call GetQuotesEx() again to pick it up.
+//
+// There is at most one fetch per symbol and periodicity, queued or finished.
+
+BOOL StartHistoryWorkers(void)
+{
+	if (g_hHistoryWorkerThreads[0] != NULL)
+		return TRUE; // Already running
+
+	g_hHistoryStopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);  // Manual reset
+	g_hHistoryQueueSemaphore = CreateSemaphore(NULL, 0, MAXLONG, NULL);
+	if (g_hHistoryStopEvent == NULL || g_hHistoryQueueSemaphore == NULL)
 	{
-		PostMessage(g_hAmiBrokerWnd, WM_USER_STREAMING_UPDATE, 0, 0);
-		OutputDebugString(_T("OpenAlgo: ProcessTick - Sent WM_USER_STREAMING_UPDATE to AmiBroker"));
+		OutputDebugString(_T("OpenAlgo: StartHistoryWorkers - Failed to create events"));
+		StopHistoryWorkers();
+		return FALSE;
 	}
-	else
+
+	for (int i = 0; i < HISTORY_WORKER_THREADS; i++)
 	{
-		OutputDebugString(_T("OpenAlgo: ProcessTick - WARNING: g_hAmiBrokerWnd is NULL, cannot send update"));
+		g_hHistoryWorkerThreads[i] = (HANDLE)_beginthreadex(NULL, 0, HistoryWorkerThreadProc, NULL, 0, NULL);
+		if (g_hHistoryWorkerThreads[i] == NULL)
+		{
+			OutputDebugString(_T("OpenAlgo: StartHistoryWorkers - _beginthreadex FAILED"));
+			StopHistoryWorkers();
+			return FALSE;
+		}
 	}
 
-	OutputDebugString(_T("OpenAlgo: ProcessTick - SUCCESS, returning TRUE"));
+	OutputDebugString(_T("OpenAlgo: History workers started"));
 	return TRUE;
 }
 
-// Cleanup all BarBuilders
-void CleanupBarBuilders(void)
+// Stop the workers and drop queued jobs and unmerged results
+void StopHistoryWorkers(void)
 {
-	if (g_bBarBuilderCriticalSectionInitialized)
+	BOOL bStopped = TRUE;
+
+	if (g_hHistoryStopEvent != NULL)
+		SetEvent(g_hHistoryStopEvent);
+
+	for (int i = 0; i < HISTORY_WORKER_THREADS; i++)
 	{
-		EnterCriticalSection(&g_BarBuilderCriticalSection);
+		if (g_hHistoryWorkerThreads[i] == NULL)
+			continue;
 
-		// Delete all BarBuilder objects
-		POSITION pos = g_BarBuilders.GetStartPosition();
-		while (pos != NULL)
+		// A download in progress can take up to its 10 second receive timeout
+		if (WaitForSingleObject(g_hHistoryWorkerThreads[i], 15000) != WAIT_OBJECT_0)
 		{
-			CString ticker;
-			BarBuilder* pBuilder;
-			g_BarBuilders.GetNextAssoc(pos, ticker, pBuilder);
-
-			if (pBuilder)
-			{
-				delete pBuilder;
-			}
+			OutputDebugString(_T("OpenAlgo: WARNING - History worker did not stop within 15 seconds"));
+			bStopped = FALSE;
 		}
+		CloseHandle(g_hHistoryWorkerThreads[i]);
+		g_hHistoryWorkerThreads[i] = NULL;
+	}
 
-		g_BarBuilders.RemoveAll();
+	if (!bStopped)
+		return; // Leave the events and jobs alive - a worker may still be using them
 
-		LeaveCriticalSection(&g_BarBuilderCriticalSection);
+	if (g_hHistoryStopEvent != NULL)
+	{
+		CloseHandle(g_hHistoryStopEvent);
+		g_hHistoryStopEvent = NULL;
+	}
+
+	if (g_hHistoryQueueSemaphore != NULL)
+	{
+		CloseHandle(g_hHistoryQueueSemaphore);
+		g_hHistoryQueueSemaphore = NULL;
 	}
+
+	if (!g_bHttpCacheCriticalSectionInitialized)
+		return;
+
+	EnterCriticalSection(&g_HttpCacheCriticalSection);
+
+	while (g_pHistoryQueueHead != NULL)
+	{
+		HistoryFetchJob* pJob = g_pHistoryQueueHead;
+		g_pHistoryQueueHead = pJob->pNext;
+		delete pJob;
+	}
+	g_pHistoryQueueTail = NULL;
+
+	int nSymbols = g_SymbolTable.nCount;
+	for (int i = 0; i < nSymbols; i++)
+	{
+		SymbolState* pState = GetSymbolState(i);
+		for (int k = 0; k < HISTORY_FETCH_PERIODICITIES; k++)
+		{
+			HistoryFetchSlot* pSlot = &pState->aHistory[k];
+			delete pSlot->pResult;
+			pSlot->pResult = NULL;
+			pSlot->nState = HISTORY_FETCH_IDLE;
+			pSlot->bCompleted = FALSE;
+		}
+	}
+
+	LeaveCriticalSection(&g_HttpCacheCriticalSection);
+}
+
+// Hand a fetch for nSymbolId to the workers, seeded with the newest bars of the
+// requested kind from pQuotes[0..nLastValid]. The slot must already be HISTORY_FETCH_QUEUED.
+void QueueHistoryFetch(int nSymbolId, int nPeriodicity, int nLastValid, int nSize, const struct Quotation* pQuotes)
+{
+	HistoryFetchJob* pJob = new HistoryFetchJob;
+	pJob->nSymbolId = nSymbolId;
+	pJob->nPeriodicity = nPeriodicity;
+	pJob->nSize = max(nSize, HISTORY_FETCH_SEED_BARS);
+	pJob->pBars = new struct Quotation[pJob->nSize];
+	pJob->pSeed = new struct Quotation[HISTORY_FETCH_SEED_BARS];
+
+	// Newest bars first, skipping the other kind in a mixed EOD/intraday array
+	BOOL bDaily = (nPeriodicity == 86400);
+	int nSeed = 0;
+	for (int i = nLastValid; i >= 0 && nSeed < HISTORY_FETCH_SEED_BARS; i--)
+	{
+		const union AmiDate& date = pQuotes[i].DateTime;
+		BOOL bIsEOD = (date.PackDate.Hour == DATE_EOD_HOURS && date.PackDate.Minute == DATE_EOD_MINUTES);
+		if (bIsEOD == bDaily)
+			pJob->pSeed[HISTORY_FETCH_SEED_BARS - 1 - nSeed++] = pQuotes[i];
+	}
+	memmove(pJob->pSeed, pJob->pSeed + HISTORY_FETCH_SEED_BARS - nSeed, nSeed * sizeof(struct Quotation));
+	memcpy(pJob->pBars, pJob->pSeed, nSeed * sizeof(struct Quotation));
+	pJob->nSeed = nSeed;
+
+	EnterCriticalSection(&g_HttpCacheCriticalSection);
+	if (g_pHistoryQueueTail != NULL)
+		g_pHistoryQueueTail->pNext = pJob;
+	else
+		g_pHistoryQueueHead = pJob;
+	g_pHistoryQueueTail = pJob;
+	LeaveCriticalSection(&g_HttpCacheCriticalSection);
+
+	ReleaseSemaphore(g_hHistoryQueueSemaphore, 1, NULL);
+
+	CString queueLog;
+	queueLog.Format(_T("OpenAlgo: Queued history refresh for %s (periodicity %d, %d seed bars)"),
+		GetSymbolTicker(nSymbolId), nPeriodicity, nSeed);
+	OutputDebugString(queueLog);
+}
+
+// Download on a worker, then keep only bars that are new or differ from the seed
+void RunHistoryFetch(HistoryFetchJob* pJob)
+{
+	int nCount = GetOpenAlgoHistory(GetSymbolTicker(pJob->nSymbolId), pJob->nPeriodicity,
+		pJob->nSeed - 1, pJob->nSize, pJob->pBars, 0, NULL, g_hHistoryStopEvent, NULL);
+
+	// Both arrays are in time order - one forward pass
+	int nOut = 0;
+	int s = 0;
+	for (int i = 0; i < nCount; i++)
+	{
+		UINT32 key = HistoryBarKey(&pJob->pBars[i]);
+		while (s < pJob->nSeed && HistoryBarKey(&pJob->pSeed[s]) < key)
+			s++;
+
+		if (s < pJob->nSeed && HistoryBarKey(&pJob->pSeed[s]) == key &&
+			memcmp(&pJob->pSeed[s], &pJob->pBars[i], sizeof(struct Quotation)) == 0)
+		{
+			s++;
+			continue; // AmiBroker has this bar already (and maybe newer tick data for it)
+		}
+
+		pJob->pBars[nOut++] = pJob->pBars[i];
+	}
+	pJob->nBars = nOut;
+
+	// The result may wait a while for GetQuotesEx() - don't hold on to AmiBroker's array size
+	delete[] pJob->pSeed;
+	pJob->pSeed = NULL;
+	if (nOut < pJob->nSize)
+	{
+		struct Quotation* pBars = new struct Quotation[max(nOut, 1)];
+		memcpy(pBars, pJob->pBars, nOut * sizeof(struct Quotation));
+		delete[] pJob->pBars;
+		pJob->pBars = pBars;
+		pJob->nSize = max(nOut, 1);
+	}
+}
+
+unsigned __stdcall HistoryWorkerThreadProc(void* pParam)
+{
+	HANDLE handles[2] = { g_hHistoryStopEvent, g_hHistoryQueueSemaphore };
+
+	while (WaitForMultipleObjects(2, handles, FALSE, INFINITE) == WAIT_OBJECT_0 + 1)
+	{
+		EnterCriticalSection(&g_HttpCacheCriticalSection);
+		HistoryFetchJob* pJob = g_pHistoryQueueHead;
+		if (pJob != NULL)
+		{
+			g_pHistoryQueueHead = pJob->pNext;
+			if (g_pHistoryQueueHead == NULL)
+				g_pHistoryQueueTail = NULL;
+			pJob->pNext = NULL;
+		}
+		LeaveCriticalSection(&g_HttpCacheCriticalSection);
+
+		if (pJob == NULL)
+			continue;
+
+		RunHistoryFetch(pJob);
+
+		CString doneLog;
+		doneLog.Format(_T("OpenAlgo: History refresh for %s (periodicity %d) returned %d new or changed bars"),
+			GetSymbolTicker(pJob->nSymbolId), pJob->nPeriodicity, pJob->nBars);
+		OutputDebugString(doneLog);
+
+		BOOL bNotify = (pJob->nBars > 0);
+
+		EnterCriticalSection(&g_HttpCacheCriticalSection);
+		HistoryFetchSlot* pSlot = &GetSymbolState(pJob->nSymbolId)->aHistory[
+			pJob->nPeriodicity == 86400 ? HISTORY_FETCH_DAILY : HISTORY_FETCH_1M];
+		pSlot->bCompleted = TRUE;
+		pSlot->dwCompleted = GetTickCount();
+		if (bNotify)
+		{
+			pSlot->pResult = pJob;
+			pSlot->nState = HISTORY_FETCH_READY;
+			pJob = NULL;
+		}
+		else
+		{
+			pSlot->nState = HISTORY_FETCH_IDLE;
+		}
+		LeaveCriticalSection(&g_HttpCacheCriticalSection);
+
+		delete pJob;
+
+		// Have AmiBroker call GetQuotesEx() again to merge the new bars
+		HWND hWnd = g_hAmiBrokerWnd;
+		if (bNotify && hWnd != NULL)
+		{
+			::PostMessage(hWnd, WM_USER_STREAMING_UPDATE, 0, 0);
+		}
+	}
+
+	return 0;
+}
+
+// How old history may get before GetQuotesEx() queues a refresh (the RefreshInterval setting)
+DWORD GetHistoryRefreshMs(void)
+{
+	return (DWORD)max(1, g_nRefreshInterval) * 1000;
+}
+
+// GetQuotesEx()'s replacement for GetOpenAlgoHistory(): merge a finished fetch into
+// pQuotes and queue a new one if the last finished more than dwMaxAgeMs ago (or a
+// manual backfill of this periodicity is pending). Never waits for the network.
+// Returns the new bar count; *pbMerged (optional) = TRUE if fetched bars were merged.
+int GetOpenAlgoHistoryAsync(LPCTSTR pszTicker, int nPeriodicity, int nLastValid, int nSize, struct Quotation* pQuotes, DWORD dwMaxAgeMs, BOOL* pbMerged)
+{
+	if (pbMerged != NULL)
+		*pbMerged = FALSE;
+
+	if (g_oApiKey.IsEmpty())
+		return nLastValid + 1;
+
+	// No workers or no symbol ID (table full) - fetch inline as before
+	int nSymbolId = InternSymbol(pszTicker);
+	if (nSymbolId < 0 || g_hHistoryWorkerThreads[0] == NULL)
+		return GetOpenAlgoHistory(pszTicker, nPeriodicity, nLastValid, nSize, pQuotes, 0, NULL, NULL, NULL);
+
+	BOOL bBackfill = (g_bBackfillRequested && g_nBackfillPeriodicity == nPeriodicity);
+	HistoryFetchJob* pResult = NULL;
+	BOOL bQueue = FALSE;
+	BOOL bCacheUpdated = FALSE;
+
+	EnterCriticalSection(&g_HttpCacheCriticalSection);
+	HistoryFetchSlot* pSlot = &GetSymbolState(nSymbolId)->aHistory[
+		nPeriodicity == 86400 ? HISTORY_FETCH_DAILY : HISTORY_FETCH_1M];
+	if (pSlot->nState == HISTORY_FETCH_READY)
+	{
+		pResult = pSlot->pResult;
+		pSlot->pResult = NULL;
+		pSlot->nState = HISTORY_FETCH_IDLE;
+	}
+	bCacheUpdated = pSlot->bCacheUpdated;
+	pSlot->bCacheUpdated = FALSE;
+	if (pSlot->nState == HISTORY_FETCH_IDLE &&
+		(!pSlot->bCompleted || bBackfill || GetTickCount() - pSlot->dwCompleted >= dwMaxAgeMs))
+	{
+		pSlot->nState = HISTORY_FETCH_QUEUED;
+		bQueue = TRUE;
+	}
+	LeaveCriticalSection(&g_HttpCacheCriticalSection);
+
+	// Nothing of this periodicity loaded yet (e.g. after a restart): show the completed
+	// days from the on-disk bar cache while the download runs. An All Symbols backfill
+	// also hands its bars over through the cache.
+	if (bCacheUpdated || FindLastBarOfMatchingType(nPeriodicity, nLastValid, pQuotes) < 0)
+	{
+		nLastValid = LoadBarCache(pszTicker, nPeriodicity, nLastValid, nSize, pQuotes);
+		if (bCacheUpdated && pbMerged != NULL)
+			*pbMerged = TRUE;
+	}
+
+	if (pResult != NULL)
+	{
+		nLastValid = MergeHistoryBars(pQuotes, nSize, nPeriodicity, nLastValid, pResult->pBars, pResult->nBars) - 1;
+		delete pResult;
+		if (pbMerged != NULL)
+			*pbMerged = TRUE;
+	}
+
+	// Seed the next fetch with what AmiBroker has now, including the bars just merged
+	if (bQueue)
+	{
+		QueueHistoryFetch(nSymbolId, nPeriodicity, nLastValid, nSize, pQuotes);
+	}
+
+	return nLastValid + 1;
+}
+
+///////////////////////////////
+// Backfill Scheduler
+///////////////////////////////
+//
+// The "All Symbols" backfill menu items start a job that downloads the chosen
+// range for every symbol of the database into the bar cache. AmiBroker only asks
+// for the symbols it displays, so the job does not go through GetQuotesEx(): each
+// finished symbol flags its HistoryFetchSlot, and the next GetQuotesEx() for that
+// symbol merges the bar cache into AmiBroker's array.
+//
+// BackfillConcurrency threads download in parallel; a token bucket shared by all of
+// them keeps the server at BackfillRequestsPerSec. A symbol's range is split into
+// date chunks (see "Chunked History Download"), so the token is taken per HTTP
+// request - every chunk and every retry - not per symbol. While the plugin is not
+// connected the threads wait instead of counting every symbol as failed.
+//
+// Progress is checkpointed: the symbol list is written when the job starts and one
+// state byte per symbol is rewritten as it finishes. A job stopped by closing the
+// database (or AmiBroker) resumes on the next DATABASE_LOADED; symbols that failed
+// are retried then. The checkpoint is deleted once every symbol is done. A crash
+// may lose the last few state bytes, which only means those symbols download again.
+//
+// To try it without a broker, run tests/mock_openalgo_server.py and point Server/Port
+// at it; --delay-ms and --fail-every exercise stop, resume and chunk retries.
+
+CString GetBackfillCheckpointPath(void)
+{
+	return g_oBarCacheDir + _T("\\Backfill.chk");
+}
+
+// AmiBroker keeps one file per symbol in a folder named after its first character
+// (<database>\a\AAPL-NSE, <database>\_\...). InfoSite cannot list symbols, so the
+// files are the symbol list. Every ticker found is interned; returns the count.
+int EnumerateDatabaseSymbols(void)
+{
+	if (g_oDatabasePath.IsEmpty())
+		return 0;
+
+	int nFound = 0;
+
+	WIN32_FIND_DATA dirData;
+	HANDLE hDirs = FindFirstFile(g_oDatabasePath + _T("\\*"), &dirData);
+	if (hDirs == INVALID_HANDLE_VALUE)
+		return 0;
+
+	do
+	{
+		if (!(dirData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) ||
+			dirData.cFileName[0] == _T('.') || dirData.cFileName[1] != _T('\0'))
+			continue; // Not a symbol folder (OpenAlgoCache, Layers, ...)
+
+		CString dir = g_oDatabasePath + _T("\\") + dirData.cFileName;
+		WIN32_FIND_DATA fileData;
+		HANDLE hFiles = FindFirstFile(dir + _T("\\*"), &fileData);
+		if (hFiles == INVALID_HANDLE_VALUE)
+			continue;
+
+		do
+		{
+			if (!(fileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && InternSymbol(fileData.cFileName) >= 0)
+				nFound++;
+		} while (FindNextFile(hFiles, &fileData));
+
+		FindClose(hFiles);
+	} while (FindNextFile(hDirs, &dirData));
+
+	FindClose(hDirs);
+	return nFound;
+}
+
+// Start a new job for every known symbol (database files plus tickers seen this
+// session), replacing a job that is still running. g_backfill, its stop event and
+// nActiveThreads belong to one job at a time: if a thread of the old job is still
+// finishing its request, the new job is refused rather than sharing them with it.
+BOOL StartBackfillJob(int nPeriodicity, int nDays)
+{
+	if (!g_bBarCacheEnabled || g_oBarCacheDir.IsEmpty() || !g_bBackfillCriticalSectionInitialized)
+	{
+		OutputDebugString(_T("OpenAlgo: All Symbols backfill needs the bar cache (EnableBarCache) and a loaded database"));
+		return FALSE;
+	}
+
+	if (!StopBackfillJob(TRUE))
+	{
+		OutputDebugString(_T("OpenAlgo: All Symbols backfill not started - the previous job is still stopping, try again shortly"));
+		return FALSE;
+	}
+
+	int nFiles = EnumerateDatabaseSymbols();
+
+	int nCount = g_SymbolTable.nCount;
+	BackfillCheckpointRecord* pSymbols = new BackfillCheckpointRecord[max(nCount, 1)];
+	int nSymbols = 0;
+	for (int i = 0; i < nCount; i++)
+	{
+		if (FillBackfillCheckpointRecord(&pSymbols[nSymbols], GetSymbolTicker(i)))
+			nSymbols++;
+	}
+
+	if (nSymbols == 0)
+	{
+		OutputDebugString(_T("OpenAlgo: All Symbols backfill - no symbols found"));
+		delete[] pSymbols;
+		return FALSE;
+	}
+
+	BackfillCheckpointHeader header;
+	InitBackfillCheckpointHeader(&header, nPeriodicity, nDays, nSymbols);
+
+	CString path = GetBackfillCheckpointPath();
+	HANDLE hFile = CreateFile(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL,
+		CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile != INVALID_HANDLE_VALUE)
+	{
+		DWORD dwRecords = nSymbols * sizeof(BackfillCheckpointRecord);
+		DWORD dwWritten = 0;
+		if (!WriteFile(hFile, &header, sizeof(header), &dwWritten, NULL) || dwWritten != sizeof(header) ||
+			!WriteFile(hFile, pSymbols, dwRecords, &dwWritten, NULL) || dwWritten != dwRecords)
+		{
+			CloseHandle(hFile);
+			DeleteFile(path);
+			hFile = INVALID_HANDLE_VALUE;
+		}
+	}
+
+	if (hFile == INVALID_HANDLE_VALUE)
+	{
+		CString errorMsg;
+		errorMsg.Format(_T("OpenAlgo: Cannot write %s (error %lu) - the backfill will not resume if interrupted"),
+			(LPCTSTR)path, GetLastError());
+		OutputDebugString(errorMsg);
+	}
+
+	CString startMsg;
+	startMsg.Format(_T("OpenAlgo: All Symbols backfill started - %d symbols (%d database files), periodicity %d, %d days, %d threads, %d history requests/s across all threads"),
+		nSymbols, nFiles, nPeriodicity, nDays, g_nBackfillConcurrency, g_nBackfillRequestsPerSec);
+	OutputDebugString(startMsg);
+
+	return BeginBackfillJob(hFile, nPeriodicity, nDays, pSymbols, nSymbols, 0);
+}
+
+static BOOL ReadBackfillCheckpointFile(void* pReader, void* pBuffer, DWORD dwBytes, DWORD* pdwRead)
+{
+	return ReadFile((HANDLE)pReader, pBuffer, dwBytes, pdwRead, NULL);
+}
+
+// Continue the job in the database's checkpoint, if there is an unfinished one
+BOOL ResumeBackfillJob(void)
+{
+	if (!g_bBarCacheEnabled || g_oBarCacheDir.IsEmpty() || !g_bBackfillCriticalSectionInitialized)
+		return FALSE;
+
+	if (!StopBackfillJob(FALSE))
+	{
+		OutputDebugString(_T("OpenAlgo: Backfill not resumed - the previous job is still stopping"));
+		return FALSE;
+	}
+
+	CString path = GetBackfillCheckpointPath();
+	HANDLE hFile = CreateFile(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return FALSE; // No interrupted job
+
+	BackfillCheckpointHeader header;
+	LARGE_INTEGER liSize;
+	int nDone = 0;
+	BackfillCheckpointRecord* pSymbols = NULL;
+	if (GetFileSizeEx(hFile, &liSize))
+		pSymbols = ReadBackfillCheckpoint(ReadBackfillCheckpointFile, hFile, (UINT64)liSize.QuadPart, &header, &nDone);
+	BOOL bValid = (pSymbols != NULL);
+
+	if (!bValid || nDone == (int)header.nSymbols)
+	{
+		if (!bValid)
+			OutputDebugString(_T("OpenAlgo: Backfill checkpoint is damaged - discarded"));
+		delete[] pSymbols;
+		CloseHandle(hFile);
+		DeleteFile(path);
+		return FALSE;
+	}
+
+	CString resumeMsg;
+	resumeMsg.Format(_T("OpenAlgo: Resuming All Symbols backfill - %d of %u symbols done, periodicity %d, %d days"),
+		nDone, header.nSymbols, header.nPeriodicity, header.nDays);
+	OutputDebugString(resumeMsg);
+
+	return BeginBackfillJob(hFile, header.nPeriodicity, header.nDays, pSymbols, (int)header.nSymbols, nDone);
+}
+
+// Install the job (takes ownership of hFile and pSymbols) and start its threads
+BOOL BeginBackfillJob(HANDLE hFile, int nPeriodicity, int nDays, BackfillCheckpointRecord* pSymbols, int nSymbols, int nDone)
+{
+	g_hBackfillStopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);  // Manual reset
+
+	int nThreads = min(g_nBackfillConcurrency, nSymbols - nDone);
+
+	EnterCriticalSection(&g_BackfillCriticalSection);
+	g_backfill.hFile = hFile;
+	g_backfill.nPeriodicity = nPeriodicity;
+	g_backfill.nDays = nDays;
+	g_backfill.nSymbols = nSymbols;
+	g_backfill.pSymbols = pSymbols;
+	g_backfill.nNext = 0;
+	g_backfill.nDone = nDone;
+	g_backfill.nFailed = 0;
+	g_backfill.nResumed = nDone;
+	g_backfill.nBars = 0;
+	g_backfill.dwStart = GetTickCount();
+	g_backfill.dwElapsed = 0;
+	g_backfill.dwLastNotify = g_backfill.dwStart;
+	g_backfill.nActiveThreads = nThreads;
+	g_backfill.bRunning = TRUE;
+	ResetTokenBucket(&g_backfill.bucket, (double)g_nBackfillRequestsPerSec, g_backfill.dwStart);
+	LeaveCriticalSection(&g_BackfillCriticalSection);
+
+	if (g_hBackfillStopEvent == NULL)
+	{
+		OutputDebugString(_T("OpenAlgo: BeginBackfillJob - Failed to create events"));
+		StopBackfillJob(FALSE);
+		return FALSE;
+	}
+
+	for (int i = 0; i < nThreads; i++)
+	{
+		g_hBackfillThreads[i] = (HANDLE)_beginthreadex(NULL, 0, BackfillThreadProc, NULL, 0, NULL);
+		if (g_hBackfillThreads[i] == NULL)
+		{
+			OutputDebugString(_T("OpenAlgo: BeginBackfillJob - _beginthreadex FAILED"));
+			if (i == 0)
+			{
+				StopBackfillJob(FALSE);
+				return FALSE;
+			}
+
+			// Carry on with the threads that did start
+			for (int k = i; k < nThreads; k++)
+			{
+				if (InterlockedDecrement(&g_backfill.nActiveThreads) == 0)
+					FinishBackfillJob();
+			}
+			break;
+		}
+	}
+
+	return TRUE;
+}
+
+// Stop the job's threads. bDiscard deletes the checkpoint (the user cancelled or
+// replaced the job); otherwise it is kept so the job resumes with the database.
+// Returns FALSE if a thread is still running: the job, its stop event and the thread
+// handles are then left in place, and no new job may start until a later call
+// succeeds (the threads only ever use the one job, see StartBackfillJob()).
+BOOL StopBackfillJob(BOOL bDiscard)
+{
+	if (g_hBackfillStopEvent != NULL)
+		SetEvent(g_hBackfillStopEvent);
+
+	HANDLE hThreads[BACKFILL_CONCURRENCY_MAX];
+	int nThreads = 0;
+	for (int i = 0; i < BACKFILL_CONCURRENCY_MAX; i++)
+	{
+		if (g_hBackfillThreads[i] != NULL)
+			hThreads[nThreads++] = g_hBackfillThreads[i];
+	}
+
+	// Each thread finishes the request it is in (chunked downloads stop between
+	// chunks), which is bounded by the 10 second receive timeout
+	if (nThreads > 0)
+	{
+		DWORD dwResult = WaitForMultipleObjects(nThreads, hThreads, TRUE, 15000);
+		if (dwResult == WAIT_TIMEOUT || dwResult == WAIT_FAILED)
+		{
+			OutputDebugString(_T("OpenAlgo: WARNING - Backfill threads did not stop within 15 seconds"));
+			return FALSE;
+		}
+	}
+
+	for (int i = 0; i < BACKFILL_CONCURRENCY_MAX; i++)
+	{
+		if (g_hBackfillThreads[i] != NULL)
+		{
+			CloseHandle(g_hBackfillThreads[i]);
+			g_hBackfillThreads[i] = NULL;
+		}
+	}
+
+	if (g_hBackfillStopEvent != NULL)
+	{
+		CloseHandle(g_hBackfillStopEvent);
+		g_hBackfillStopEvent = NULL;
+	}
+
+	if (!g_bBackfillCriticalSectionInitialized)
+		return TRUE;
+
+	EnterCriticalSection(&g_BackfillCriticalSection);
+
+	if (g_backfill.bRunning)
+	{
+		CString stopMsg;
+		stopMsg.Format(_T("OpenAlgo: All Symbols backfill stopped at %d of %d symbols%s"),
+			g_backfill.nDone, g_backfill.nSymbols, bDiscard ? _T("") : _T(" - it resumes when the database is loaded"));
+		OutputDebugString(stopMsg);
+	}
+
+	if (g_backfill.hFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(g_backfill.hFile);
+		g_backfill.hFile = INVALID_HANDLE_VALUE;
+		if (bDiscard)
+			DeleteFile(GetBackfillCheckpointPath());
+	}
+
+	delete[] g_backfill.pSymbols;
+	g_backfill.pSymbols = NULL;
+	g_backfill.bRunning = FALSE;
+
+	LeaveCriticalSection(&g_BackfillCriticalSection);
+	return TRUE;
+}
+
+// Called by the last thread once every symbol was tried
+void FinishBackfillJob(void)
+{
+	EnterCriticalSection(&g_BackfillCriticalSection);
+
+	g_backfill.bRunning = FALSE;
+	g_backfill.dwElapsed = GetTickCount() - g_backfill.dwStart;
+
+	// Keep the checkpoint if anything failed - those symbols are retried on the next load
+	if (g_backfill.hFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(g_backfill.hFile);
+		g_backfill.hFile = INVALID_HANDLE_VALUE;
+		if (g_backfill.nFailed == 0)
+			DeleteFile(GetBackfillCheckpointPath());
+	}
+
+	delete[] g_backfill.pSymbols;
+	g_backfill.pSymbols = NULL;
+
+	CString doneMsg;
+	doneMsg.Format(_T("OpenAlgo: All Symbols backfill finished - %d symbols done, %d failed, %I64d bars in %lu s"),
+		g_backfill.nDone, g_backfill.nFailed, g_backfill.nBars, g_backfill.dwElapsed / 1000);
+	OutputDebugString(doneMsg);
+
+	LeaveCriticalSection(&g_BackfillCriticalSection);
+
+	HWND hWnd = g_hAmiBrokerWnd;
+	if (hWnd != NULL)
+	{
+		::PostMessage(hWnd, WM_USER_STREAMING_UPDATE, 0, 0);
+	}
+}
+
+// Record a symbol's state in the checkpoint. Caller holds g_BackfillCriticalSection.
+void WriteBackfillState(int nIndex)
+{
+	if (g_backfill.hFile == INVALID_HANDLE_VALUE)
+		return;
+
+	LARGE_INTEGER liPos;
+	liPos.QuadPart = BackfillStateOffset(nIndex);
+
+	DWORD dwWritten = 0;
+	if (!SetFilePointerEx(g_backfill.hFile, liPos, NULL, FILE_BEGIN) ||
+		!WriteFile(g_backfill.hFile, &g_backfill.pSymbols[nIndex].nState, 1, &dwWritten, NULL))
+	{
+		OutputDebugString(_T("OpenAlgo: Cannot update the backfill checkpoint"));
+	}
+}
+
+unsigned __stdcall BackfillThreadProc(void* pParam)
+{
+	struct Quotation* pBars = NULL;
+	int nBarsSize = 0;
+	BOOL bStopped = FALSE;
+
+	for (;;)
+	{
+		// Don't burn through the list while the server is unreachable
+		if (g_nStatus != STATUS_CONNECTED || g_oApiKey.IsEmpty())
+		{
+			if (WaitForSingleObject(g_hBackfillStopEvent, 1000) == WAIT_OBJECT_0)
+			{
+				bStopped = TRUE;
+				break;
+			}
+			continue;
+		}
+
+		if (WaitForSingleObject(g_hBackfillStopEvent, 0) == WAIT_OBJECT_0)
+		{
+			bStopped = TRUE;
+			break;
+		}
+
+		int nIndex = -1;
+		char szTicker[BACKFILL_TICKER_SIZE];
+
+		EnterCriticalSection(&g_BackfillCriticalSection);
+		while (g_backfill.nNext < g_backfill.nSymbols && g_backfill.pSymbols[g_backfill.nNext].nState == BACKFILL_DONE)
+			g_backfill.nNext++;
+		if (g_backfill.nNext < g_backfill.nSymbols)
+		{
+			nIndex = g_backfill.nNext++;
+			memcpy(szTicker, g_backfill.pSymbols[nIndex].szTicker, BACKFILL_TICKER_SIZE);
+		}
+		int nPeriodicity = g_backfill.nPeriodicity;
+		int nDays = g_backfill.nDays;
+		LeaveCriticalSection(&g_BackfillCriticalSection);
+
+		if (nIndex < 0)
+			break; // Every symbol has been handed out
+
+		// Room for the whole range: every minute of every day, or every calendar day
+		int nNeeded = (nPeriodicity == 86400) ? nDays + 16 : nDays * 1440;
+		if (nNeeded > nBarsSize)
+		{
+			delete[] pBars;
+			pBars = new struct Quotation[nNeeded];
+			nBarsSize = nNeeded;
+		}
+
+		// Downloads the range and stores its completed days in the bar cache; every
+		// request it sends takes a token from the job's bucket
+		CString ticker(szTicker);
+		BOOL bSucceeded = FALSE;
+		int nCount = GetOpenAlgoHistory(ticker, nPeriodicity, -1, nBarsSize, pBars, nDays, &bSucceeded, g_hBackfillStopEvent, &g_backfill.bucket);
+
+		EnterCriticalSection(&g_BackfillCriticalSection);
+		g_backfill.pSymbols[nIndex].nState = bSucceeded ? BACKFILL_DONE : BACKFILL_FAILED;
+		if (bSucceeded)
+		{
+			g_backfill.nDone++;
+			g_backfill.nBars += nCount;
+		}
+		else
+		{
+			g_backfill.nFailed++;
+		}
+		WriteBackfillState(nIndex);
+
+		DWORD dwNow = GetTickCount();
+		BOOL bNotify = (dwNow - g_backfill.dwLastNotify >= BACKFILL_NOTIFY_MS);
+		if (bNotify)
+			g_backfill.dwLastNotify = dwNow;
+		LeaveCriticalSection(&g_BackfillCriticalSection);
+
+		if (!bSucceeded)
+		{
+			CString failMsg;
+			failMsg.Format(_T("OpenAlgo: Backfill of %s failed - retried when the job resumes"), (LPCTSTR)ticker);
+			OutputDebugString(failMsg);
+		}
+		else if (nCount > 0)
+		{
+			// Have the next GetQuotesEx() for this symbol merge the bar cache
+			int nSymbolId = InternSymbol(ticker);
+			if (nSymbolId >= 0)
+			{
+				EnterCriticalSection(&g_HttpCacheCriticalSection);
+				GetSymbolState(nSymbolId)->aHistory[
+					nPeriodicity == 86400 ? HISTORY_FETCH_DAILY : HISTORY_FETCH_1M].bCacheUpdated = TRUE;
+				LeaveCriticalSection(&g_HttpCacheCriticalSection);
+			}
+		}
+
+		// Refresh the status bar (progress) and the charts of finished symbols
+		HWND hWnd = g_hAmiBrokerWnd;
+		if (bNotify && hWnd != NULL)
+		{
+			::PostMessage(hWnd, WM_USER_STREAMING_UPDATE, 0, 0);
+		}
+	}
+
+	delete[] pBars;
+
+	if (InterlockedDecrement(&g_backfill.nActiveThreads) == 0 && !bStopped)
+		FinishBackfillJob();
+
+	return 0;
+}
+
+// Progress for GetStatus(): "backfill 120/500 symbols, 3.2 sym/s, 1 failed".
+// Returns the percentage done, or -1 (and an empty string) when no job is running.
+int FormatBackfillStatus(char* pszBuffer, int nSize)
+{
+	pszBuffer[0] = '\0';
+
+	if (!g_bBackfillCriticalSectionInitialized)
+		return -1;
+
+	int nPercent = -1;
+
+	EnterCriticalSection(&g_BackfillCriticalSection);
+	if (g_backfill.bRunning && g_backfill.nSymbols > 0)
+	{
+		DWORD dwElapsed = max(1UL, GetTickCount() - g_backfill.dwStart);
+		int nTried = g_backfill.nDone - g_backfill.nResumed + g_backfill.nFailed;
+		nPercent = (int)((__int64)g_backfill.nDone * 100 / g_backfill.nSymbols);
+		_snprintf_s(pszBuffer, nSize, _TRUNCATE, "backfill %d/%d symbols, %.1f sym/s, %d failed",
+			g_backfill.nDone, g_backfill.nSymbols, nTried * 1000.0 / dwElapsed, g_backfill.nFailed);
+	}
+	LeaveCriticalSection(&g_BackfillCriticalSection);
+
+	return nPercent;
+}
+
+///////////////////////////////
+// Chunked History Download
+///////////////////////////////
+//
+// A 25-year daily or 1-year 1-minute backfill used to be one /api/v1/history POST.
+// With a 10 second receive timeout that often failed, and a failure lost the whole
+// range. GetOpenAlgoHistory() now splits ranges longer than HistoryChunkDays1m /
+// HistoryChunkDaysDaily into equal date chunks (no longer than the setting). Up to
+// HistoryChunkConcurrency threads - the caller plus helpers - claim chunks in turn,
+// each over its own pooled connection, and stream them into per-chunk buffers. A
+// failed chunk is retried once on its own. The chunks are then concatenated in date
+// order and merged into pQuotes in one pass; whatever arrived is kept even if a chunk
+// failed for good, and *pbSucceeded reports the failure so the backfill scheduler
+// tries the symbol again. The backfill and history workers pass their stop event:
+// once it is set no further chunk (or retry) is requested, so stopping waits for at
+// most the requests already in progress.
+
+// POST one /api/v1/history request and stream its candles into pCtx (the pending run
+// is left for the caller to merge). Returns TRUE if the server answered
+// "status":"success"; *pnCandles = candles received. With pBucket the POST waits for
+// a token first (a request that joins a flight sends nothing and takes none), and is
+// not sent if hStopEvent is set meanwhile.
+BOOL RequestHistoryRange(const CString& symbol, const CString& exchange, const CString& interval,
+	const CString& startDate, const CString& endDate, HistoryMergeContext* pCtx, int* pnCandles,
+	TokenBucket* pBucket, HANDLE hStopEvent)
+{
+	*pnCandles = 0;
+	pCtx->nUtcOffsetSeconds = GetExchangeUtcOffsetSeconds(exchange);
+
+	// An identical request already in flight: wait for it and replay its candles
+	CString key;
+	key.Format(_T("%s|%s|%s|%s|%s"), (LPCTSTR)symbol, (LPCTSTR)exchange, (LPCTSTR)interval,
+		(LPCTSTR)startDate, (LPCTSTR)endDate);
+	BOOL bLeader = FALSE;
+	HistoryFlight* pFlight = JoinHistoryFlight(key, &bLeader);
+	if (pFlight != NULL && !bLeader)
+	{
+		WaitForSingleObject(pFlight->hDone, INFINITE);
+
+		for (int i = 0; i < pFlight->nBars; i++)
+			AppendHistoryBar(pCtx, &pFlight->pBars[i]);
+		*pnCandles = pFlight->nCandles;
+		BOOL bSucceeded = pFlight->bSucceeded;
+
+		ReleaseHistoryFlight(pFlight);
+		return bSucceeded;
+	}
+	if (pFlight != NULL)
+	{
+		pCtx->pfnRecordBar = RecordHistoryFlightCandle;
+		pCtx->pRecordContext = pFlight;
+	}
+
+	CString oPostData;
+	oPostData.Format(_T("{\"apikey\":\"%s\",\"symbol\":\"%s\",\"exchange\":\"%s\",\"interval\":\"%s\",\"start_date\":\"%s\",\"end_date\":\"%s\"}"),
+		(LPCTSTR)g_oApiKey, (LPCTSTR)symbol, (LPCTSTR)exchange, (LPCTSTR)interval, (LPCTSTR)startDate, (LPCTSTR)endDate);
+
+	OpenAlgoHttpRequest request;
+	BOOL bSuccess = FALSE;
+	try
+	{
+		if (WaitForHistoryToken(pBucket, hStopEvent) &&
+			OpenAlgoHttpBegin(&request, CHttpConnection::HTTP_VERB_POST, _T("/api/v1/history"), &oPostData, 10000) &&
+			request.dwStatusCode == 200)
+		{
+			HistoryStreamParser parser;
+			char readBuffer[HISTORY_READ_CHUNK_SIZE];
+			UINT nRead;
+			while ((nRead = request.pFile->Read(readBuffer, sizeof(readBuffer))) > 0)
+			{
+				HistoryStreamParserFeed(&parser, readBuffer, (int)nRead, pCtx);
+			}
+
+			bSuccess = parser.bStatusSuccess;
+			*pnCandles = parser.nCandles;
+		}
+
+		OpenAlgoHttpEnd(&request, TRUE);
+	}
+	catch (CInternetException* e)
+	{
+		e->Delete();
+		OpenAlgoHttpEnd(&request, FALSE);
+	}
+
+	pCtx->pfnRecordBar = NULL;
+	pCtx->pRecordContext = NULL;
+	if (pFlight != NULL)
+		LandHistoryFlight(pFlight, bSuccess, *pnCandles);
+
+	return bSuccess;
+}
+
+// Download [startTime, startTime + nRangeDays) in chunks and merge it into pQuotes.
+// Returns the new bar count, like GetOpenAlgoHistory().
+int GetOpenAlgoHistoryChunked(LPCTSTR pszTicker, const CString& symbol, const CString& exchange, const CString& interval,
+	int nPeriodicity, CTime startTime, int nRangeDays, int nChunkDays, int nConcurrency,
+	int nLastValid, int nSize, struct Quotation* pQuotes, BOOL* pbSucceeded, HANDLE hStopEvent, TokenBucket* pBucket)
+{
+	DWORD dwStart = GetTickCount();
+
+	HistoryChunkDownload download;
+	download.hStopEvent = hStopEvent;
+	download.pBucket = pBucket;
+	download.symbol = symbol;
+	download.exchange = exchange;
+	download.interval = interval;
+	download.nPeriodicity = nPeriodicity;
+	download.nChunks = (nRangeDays + nChunkDays - 1) / nChunkDays;
+	download.pChunks = new HistoryChunk[download.nChunks];
+
+	// Equal chunks; chunk i covers days [i * nRangeDays / nChunks, (i + 1) * nRangeDays / nChunks)
+	for (int i = 0; i < download.nChunks; i++)
+	{
+		int nFirstDay = (int)((__int64)i * nRangeDays / download.nChunks);
+		int nEndDay = (int)((__int64)(i + 1) * nRangeDays / download.nChunks);
+
+		HistoryChunk* pChunk = &download.pChunks[i];
+		pChunk->startDate = (startTime + CTimeSpan((LONG)nFirstDay, 0, 0, 0)).Format(_T("%Y-%m-%d"));
+		pChunk->endDate = (startTime + CTimeSpan((LONG)(nEndDay - 1), 0, 0, 0)).Format(_T("%Y-%m-%d"));
+		pChunk->nSize = (nPeriodicity == 86400) ? (nEndDay - nFirstDay) + 16 : (nEndDay - nFirstDay) * 1440;
+	}
+
+	// The calling thread works through chunks too
+	HANDLE hThreads[HISTORY_CHUNK_CONCURRENCY_MAX];
+	int nThreads = 0;
+	int nHelpers = min(nConcurrency, download.nChunks) - 1;
+	for (int i = 0; i < nHelpers; i++)
+	{
+		HANDLE hThread = (HANDLE)_beginthreadex(NULL, 0, HistoryChunkThreadProc, &download, 0, NULL);
+		if (hThread == NULL)
+			break; // Fewer threads - the chunks still all get fetched
+		hThreads[nThreads++] = hThread;
+	}
+
+	RunHistoryChunks(&download);
+
+	if (nThreads > 0)
+	{
+		WaitForMultipleObjects(nThreads, hThreads, TRUE, INFINITE);
+		for (int i = 0; i < nThreads; i++)
+			CloseHandle(hThreads[i]);
+	}
+
+	// Concatenate in date order; a bar the server repeated at a chunk boundary is kept once
+	int nTotal = 0;
+	int nFailed = 0;
+	for (int i = 0; i < download.nChunks; i++)
+	{
+		nTotal += download.pChunks[i].nBars;
+		if (!download.pChunks[i].bSucceeded)
+			nFailed++;
+	}
+
+	struct Quotation* pAll = new struct Quotation[max(nTotal, 1)];
+	int nAll = 0;
+	for (int i = 0; i < download.nChunks; i++)
+	{
+		const HistoryChunk* pChunk = &download.pChunks[i];
+		for (int b = 0; b < pChunk->nBars; b++)
+		{
+			if (nAll > 0 && HistoryBarKey(&pChunk->pBars[b]) <= HistoryBarKey(&pAll[nAll - 1]))
+				continue;
+			pAll[nAll++] = pChunk->pBars[b];
+		}
+	}
+
+	int nCount = MergeHistoryBars(pQuotes, nSize, nPeriodicity, nLastValid, pAll, nAll);
+	delete[] pAll;
+
+	CString doneLog;
+	doneLog.Format(_T("OpenAlgo: Chunked history for %s (periodicity %d): %d days in %d chunks, %d failed, %d bars in %lu ms"),
+		pszTicker, nPeriodicity, nRangeDays, download.nChunks, nFailed, nAll, GetTickCount() - dwStart);
+	OutputDebugString(doneLog);
+
+	delete[] download.pChunks;
+
+	if (pbSucceeded != NULL)
+		*pbSucceeded = (nFailed == 0);
+
+	// Keep completed days on disk for the next start
+	if (nAll > 0)
+		StoreBarCache(pszTicker, nPeriodicity, nCount, pQuotes);
+
+	return nCount;
+}
+
+// Wait dwWaitMs, or less if hStopEvent (may be NULL) is set. Returns TRUE once it is set.
+BOOL WaitForHistoryStop(HANDLE hStopEvent, DWORD dwWaitMs)
+{
+	if (hStopEvent == NULL)
+	{
+		if (dwWaitMs > 0)
+			Sleep(dwWaitMs);
+		return FALSE;
+	}
+	return (WaitForSingleObject(hStopEvent, dwWaitMs) == WAIT_OBJECT_0);
+}
+
+// Take a request token from pBucket (NULL: requests are not paced), waiting as long
+// as it takes. Returns FALSE if hStopEvent is set first.
+BOOL WaitForHistoryToken(TokenBucket* pBucket, HANDLE hStopEvent)
+{
+	if (pBucket == NULL)
+		return TRUE;
+
+	DWORD dwWait;
+	while ((dwWait = TakeToken(pBucket, GetTickCount())) > 0)
+	{
+		if (WaitForHistoryStop(hStopEvent, dwWait))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+// Claim chunks until none are left or the download is stopped; each gets
+// HISTORY_CHUNK_ATTEMPTS tries. Chunks never requested count as failed.
+void RunHistoryChunks(HistoryChunkDownload* pDownload)
+{
+	for (;;)
+	{
+		if (WaitForHistoryStop(pDownload->hStopEvent, 0))
+			break;
+
+		int i = (int)InterlockedIncrement(&pDownload->nNext) - 1;
+		if (i >= pDownload->nChunks)
+			break;
+
+		HistoryChunk* pChunk = &pDownload->pChunks[i];
+		pChunk->pBars = new struct Quotation[pChunk->nSize];
+
+		while (!pChunk->bSucceeded && pChunk->nAttempts < HISTORY_CHUNK_ATTEMPTS)
+		{
+			if (pChunk->nAttempts++ > 0 && WaitForHistoryStop(pDownload->hStopEvent, HISTORY_CHUNK_RETRY_MS))
+				break;
+
+			// Start over on every attempt - a timed-out response may have left half its candles
+			HistoryMergeContext ctx(pChunk->pBars, pChunk->nSize, pDownload->nPeriodicity, -1);
+			int nCandles = 0;
+			if (RequestHistoryRange(pDownload->symbol, pDownload->exchange, pDownload->interval,
+				pChunk->startDate, pChunk->endDate, &ctx, &nCandles, pDownload->pBucket, pDownload->hStopEvent))
+			{
+				MergeHistoryRun(&ctx);
+				pChunk->nBars = ctx.quoteIndex;
+				pChunk->bSucceeded = TRUE;
+			}
+			else
+			{
+				CString failLog;
+				failLog.Format(_T("OpenAlgo: History chunk %s..%s for %s failed (attempt %d of %d)"),
+					(LPCTSTR)pChunk->startDate, (LPCTSTR)pChunk->endDate, (LPCTSTR)pDownload->symbol,
+					pChunk->nAttempts, HISTORY_CHUNK_ATTEMPTS);
+				OutputDebugString(failLog);
+			}
+		}
+	}
+}
+
+unsigned __stdcall HistoryChunkThreadProc(void* pParam)
+{
+	AFX_MANAGE_STATE(AfxGetStaticModuleState());
+
+	RunHistoryChunks((HistoryChunkDownload*)pParam);
+	return 0;
+}
+
+///////////////////////////////
+// History Request Coalescing
+///////////////////////////////
+//
+// Several charts, an Analysis window and a scan often ask for the same ticker and
+// periodicity at once, and each GetQuotesEx() ran its own /api/v1/history download.
+// RequestHistoryRange() now keys every request by symbol, exchange, interval and
+// dates. The first request (the leader) goes to the server and records each candle
+// it converts in its HistoryFlight; identical requests arriving while it runs wait on
+// hDone and replay those bars through AppendHistoryBar() into their own arrays, so
+// every waiter merges the same candle set. A flight is unlinked when it lands - a
+// request made after that fetches fresh data. GetStatus() shows how many requests
+// were coalesced.
+
+// Join the flight for key, or start one. *pbLeader = TRUE if the caller must do the
+// request and call LandHistoryFlight(). Returns NULL (no coalescing) if a flight
+// cannot be set up.
+HistoryFlight* JoinHistoryFlight(const CString& key, BOOL* pbLeader)
+{
+	*pbLeader = FALSE;
+
+	if (!g_bHistoryFlightCriticalSectionInitialized)
+		return NULL;
+
+	EnterCriticalSection(&g_HistoryFlightCriticalSection);
+
+	HistoryFlight* pFlight = g_pHistoryFlights;
+	while (pFlight != NULL && pFlight->key != key)
+		pFlight = pFlight->pNext;
+
+	if (pFlight != NULL)
+	{
+		pFlight->nRefs++;
+		InterlockedIncrement(&g_historyFlightStats.nCoalesced);
+	}
+	else
+	{
+		HANDLE hDone = CreateEvent(NULL, TRUE, FALSE, NULL);
+		if (hDone != NULL)
+		{
+			pFlight = new HistoryFlight();
+			pFlight->key = key;
+			pFlight->hDone = hDone;
+			pFlight->nRefs = 1;
+			pFlight->pNext = g_pHistoryFlights;
+			g_pHistoryFlights = pFlight;
+			InterlockedIncrement(&g_historyFlightStats.nFlights);
+			*pbLeader = TRUE;
+		}
+	}
+
+	LeaveCriticalSection(&g_HistoryFlightCriticalSection);
+
+	if (pFlight != NULL && !*pbLeader)
+	{
+		CString joinLog;
+		joinLog.Format(_T("OpenAlgo: History request %s joined the one in flight (%ld coalesced so far)"),
+			(LPCTSTR)key, g_historyFlightStats.nCoalesced);
+		OutputDebugString(joinLog);
+	}
+
+	return pFlight;
+}
+
+// Keep a converted candle for the waiters (leader thread only, before the flight lands)
+void RecordHistoryFlightBar(HistoryFlight* pFlight, const struct Quotation* pBar)
+{
+	if (pFlight->nBars == pFlight->nCapacity)
+	{
+		int nCapacity = max(1024, pFlight->nCapacity * 2);
+		struct Quotation* pBars = new struct Quotation[nCapacity];
+		if (pFlight->nBars > 0)
+			memcpy(pBars, pFlight->pBars, pFlight->nBars * sizeof(struct Quotation));
+		delete[] pFlight->pBars;
+		pFlight->pBars = pBars;
+		pFlight->nCapacity = nCapacity;
+	}
+
+	pFlight->pBars[pFlight->nBars++] = *pBar;
+}
+
+// The leader's request is finished: publish the result, wake the waiters and drop
+// the leader's reference
+void LandHistoryFlight(HistoryFlight* pFlight, BOOL bSucceeded, int nCandles)
+{
+	EnterCriticalSection(&g_HistoryFlightCriticalSection);
+
+	// Unlink - later requests must not be served this response
+	HistoryFlight** ppLink = &g_pHistoryFlights;
+	while (*ppLink != NULL && *ppLink != pFlight)
+		ppLink = &(*ppLink)->pNext;
+	if (*ppLink != NULL)
+		*ppLink = pFlight->pNext;
+	pFlight->pNext = NULL;
+
+	pFlight->bSucceeded = bSucceeded;
+	pFlight->nCandles = nCandles;
+
+	LeaveCriticalSection(&g_HistoryFlightCriticalSection);
+
+	SetEvent(pFlight->hDone);
+	ReleaseHistoryFlight(pFlight);
+}
+
+// Drop one reference; the last one frees the flight
+void ReleaseHistoryFlight(HistoryFlight* pFlight)
+{
+	EnterCriticalSection(&g_HistoryFlightCriticalSection);
+	BOOL bLast = (--pFlight->nRefs == 0);
+	LeaveCriticalSection(&g_HistoryFlightCriticalSection);
+
+	if (bLast)
+		delete pFlight;
 }
@@ -281,7 +281,7 @@ extern struct SiteInterface gSite;
 
 
 
-#define DAILY_MASK			0x000007FFffffFFC0i64
+#define DAILY_MASK			0x000007FFffffFFC0ULL
 
 struct PackedDate {
 						// lower 32 bits
@@ -0,0 +1,35 @@
+// QuoteTable.cpp - Latest quote per symbol, published with a per-slot seqlock
+#include "QuoteTable.h"
+
+LONG BeginQuoteWrite(QuoteSlot* pSlot)
+{
+	return SeqlockBeginWrite(&pSlot->nSeq);
+}
+
+void EndQuoteWrite(QuoteSlot* pSlot, LONG nSeq)
+{
+	SeqlockEndWrite(&pSlot->nSeq, nSeq);
+}
+
+void WriteQuoteSlot(QuoteSlot* pSlot, const QuoteCache* pQuote)
+{
+	BOOL bValid = (pQuote != NULL);
+	if (pQuote != NULL)
+		SeqlockStore(&pSlot->quote, pQuote, sizeof(QuoteCache));
+	SeqlockStore(&pSlot->bValid, &bValid, sizeof(BOOL));
+}
+
+BOOL LoadQuoteSlot(QuoteSlot* pSlot, QuoteCache* pQuote)
+{
+	for (;;)
+	{
+		LONG nSeq = SeqlockBeginRead(&pSlot->nSeq);
+
+		BOOL bValid;
+		SeqlockLoad(&bValid, &pSlot->bValid, sizeof(BOOL));
+		SeqlockLoad(pQuote, &pSlot->quote, sizeof(QuoteCache));
+
+		if (SeqlockEndRead(&pSlot->nSeq, nSeq))
+			return bValid;
+	}
+}
@@ -0,0 +1,59 @@
+// QuoteTable.h - Latest quote per symbol, published with a per-slot seqlock
+//
+// No MFC: Plugin.cpp keeps one QuoteSlot per symbol ID (in its SymbolState)
+// and adds the RecentInfo record; the slot itself lives here so the Linux test
+// build (tests/) can run readers against writers under ThreadSanitizer.
+#ifndef QUOTE_TABLE_H
+#define QUOTE_TABLE_H
+
+#include "OpenAlgoPortable.h"
+#include "Seqlock.h"
+
+#define QUOTE_EXCHANGE_SIZE        16
+
+// Cache for recent quotes
+// Fixed layout (no CString) so a quote can be copied into and out of a QuoteSlot
+// without allocating.
+struct QuoteCache {
+	TCHAR exchange[QUOTE_EXCHANGE_SIZE];
+	float ltp;
+	float open;
+	float high;
+	float low;
+	float close;
+	float volume;
+	float oi;
+	float bid;
+	float ask;
+	DWORD lastUpdate;
+	
+	// Constructor to initialize all values
+	QuoteCache() : ltp(0.0f), open(0.0f), high(0.0f), low(0.0f), 
+	               close(0.0f), volume(0.0f), oi(0.0f), bid(0.0f), ask(0.0f), lastUpdate(0) {
+		exchange[0] = _T('\0');
+	}
+};
+
+// Latest quote per symbol ID. Written by the WebSocket I/O thread (and by the
+// quote refresher's HTTP fallback), read by GetRecentInfo() without locking.
+// bValid and quote are only touched through SeqlockStore()/SeqlockLoad().
+struct QuoteSlot {
+	volatile LONG nSeq;      // Seqlock: odd while a writer is copying into quote
+	volatile BOOL bValid;    // FALSE until the first quote (or after ClearQuotes())
+	volatile QuoteCache quote;
+
+	QuoteSlot() : nSeq(0), bValid(FALSE) {
+	}
+};
+
+// Take the slot for writing (waits for the other writer); returns the sequence number for EndQuoteWrite()
+LONG BeginQuoteWrite(QuoteSlot* pSlot);
+void EndQuoteWrite(QuoteSlot* pSlot, LONG nSeq);
+
+// Between BeginQuoteWrite() and EndQuoteWrite(): store a quote, or forget it (pQuote NULL)
+void WriteQuoteSlot(QuoteSlot* pSlot, const QuoteCache* pQuote);
+
+// Copy the slot's quote; FALSE if none was stored yet
+BOOL LoadQuoteSlot(QuoteSlot* pSlot, QuoteCache* pQuote);
+
+#endif // QUOTE_TABLE_H
@@ -0,0 +1,127 @@
+// Seqlock.cpp - Records copied between threads without locking
+#include "Seqlock.h"
+
+#include <string.h>
+
+#ifdef _WIN32
+
+static inline LONG LoadWord(const volatile LONG* pWord)
+{
+	return *pWord;
+}
+
+static inline void StoreWord(volatile LONG* pWord, LONG nValue)
+{
+	*pWord = nValue;
+}
+
+static inline BYTE LoadByte(const volatile BYTE* pByte)
+{
+	return *pByte;
+}
+
+static inline void StoreByte(volatile BYTE* pByte, BYTE nValue)
+{
+	*pByte = nValue;
+}
+
+static inline LONG LoadSequence(const volatile LONG* pnSeq)
+{
+	LONG nSeq = *pnSeq;
+	MemoryBarrier();  // Acquire: the copy cannot start before this load
+	return nSeq;
+}
+
+#else // !_WIN32
+
+static inline LONG LoadWord(const volatile LONG* pWord)
+{
+	return __atomic_load_n(pWord, __ATOMIC_RELAXED);
+}
+
+static inline void StoreWord(volatile LONG* pWord, LONG nValue)
+{
+	__atomic_store_n(pWord, nValue, __ATOMIC_RELAXED);
+}
+
+static inline BYTE LoadByte(const volatile BYTE* pByte)
+{
+	return __atomic_load_n(pByte, __ATOMIC_RELAXED);
+}
+
+static inline void StoreByte(volatile BYTE* pByte, BYTE nValue)
+{
+	__atomic_store_n(pByte, nValue, __ATOMIC_RELAXED);
+}
+
+static inline LONG LoadSequence(const volatile LONG* pnSeq)
+{
+	return __atomic_load_n(pnSeq, __ATOMIC_ACQUIRE);
+}
+
+#endif // _WIN32
+
+LONG SeqlockBeginWrite(volatile LONG* pnSeq)
+{
+	for (;;)
+	{
+		LONG nSeq = LoadSequence(pnSeq);
+		if (!(nSeq & 1) && InterlockedCompareExchange(pnSeq, nSeq + 1, nSeq) == nSeq)
+		{
+			MemoryBarrier();  // The odd number is visible before any data store
+			return nSeq;
+		}
+		YieldProcessor();
+	}
+}
+
+void SeqlockEndWrite(volatile LONG* pnSeq, LONG nSeq)
+{
+	InterlockedExchange(pnSeq, nSeq + 2);  // Full barrier: every data store is visible first
+}
+
+LONG SeqlockBeginRead(const volatile LONG* pnSeq)
+{
+	for (;;)
+	{
+		LONG nSeq = LoadSequence(pnSeq);
+		if (!(nSeq & 1))
+			return nSeq;
+		YieldProcessor();
+	}
+}
+
+BOOL SeqlockEndRead(const volatile LONG* pnSeq, LONG nSeq)
+{
+	MemoryBarrier();  // Every data load completes before the number is checked again
+	return LoadSequence(pnSeq) == nSeq;
+}
+
+void SeqlockStore(volatile void* pDest, const void* pSource, size_t nBytes)
+{
+	volatile LONG* pWords = (volatile LONG*)pDest;
+	const BYTE* pBytes = (const BYTE*)pSource;
+	size_t nWords = nBytes / sizeof(LONG);
+	for (size_t i = 0; i < nWords; i++)
+	{
+		LONG nWord;
+		memcpy(&nWord, pBytes + i * sizeof(LONG), sizeof(LONG));
+		StoreWord(&pWords[i], nWord);
+	}
+	for (size_t i = nWords * sizeof(LONG); i < nBytes; i++)
+		StoreByte((volatile BYTE*)pDest + i, pBytes[i]);
+}
+
+void SeqlockLoad(void* pDest, const volatile void* pSource, size_t nBytes)
+{
+	const volatile LONG* pWords = (const volatile LONG*)pSource;
+	BYTE* pBytes = (BYTE*)pDest;
+	size_t nWords = nBytes / sizeof(LONG);
+	for (size_t i = 0; i < nWords; i++)
+	{
+		LONG nWord = LoadWord(&pWords[i]);
+		memcpy(pBytes + i * sizeof(LONG), &nWord, sizeof(LONG));
+	}
+	for (size_t i = nWords * sizeof(LONG); i < nBytes; i++)
+		pBytes[i] = LoadByte((const volatile BYTE*)pSource + i);
+}
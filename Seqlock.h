@@ -0,0 +1,40 @@
+// Seqlock.h - Records copied between threads without locking
+//
+// A writer makes a sequence number odd, copies the record in and makes it even
+// again; a reader copies the record out and retries if the number was odd or
+// changed meanwhile. Readers never block the writer. Plugin.cpp uses this for
+// the quote slots (see "Quote Table") and the bar snapshots.
+//
+// Memory model: a reader copies while a writer may be storing, so a protected
+// record is declared volatile and every byte of it goes through SeqlockStore()
+// and SeqlockLoad(), never an assignment or memcpy(). Those move one aligned
+// 32-bit word at a time: relaxed __atomic builtins on GCC/Clang (so
+// ThreadSanitizer sees no data race) and volatile accesses on MSVC, where an
+// aligned 32-bit access is a single instruction. A record torn between two
+// writes is possible and is what the retry throws away; a torn word is not.
+// Ordering comes only from the sequence number: full barriers between the
+// sequence updates and the data on the write side, an acquire load and a full
+// barrier around the copy on the read side. Records must be 4-byte aligned.
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include "OpenAlgoPortable.h"
+
+// Make the sequence number odd; returns the (even) value it had. Waits while
+// another writer holds it, so any number of writers may share one record.
+LONG SeqlockBeginWrite(volatile LONG* pnSeq);
+
+// Make the sequence number even again (nSeq is what SeqlockBeginWrite() returned)
+void SeqlockEndWrite(volatile LONG* pnSeq, LONG nSeq);
+
+// Wait until no write is in progress; returns the sequence number to pass to SeqlockEndRead()
+LONG SeqlockBeginRead(const volatile LONG* pnSeq);
+
+// TRUE if no write started since SeqlockBeginRead() - the copy is consistent
+BOOL SeqlockEndRead(const volatile LONG* pnSeq, LONG nSeq);
+
+// Copy nBytes into / out of a protected record, word by word
+void SeqlockStore(volatile void* pDest, const void* pSource, size_t nBytes);
+void SeqlockLoad(void* pDest, const volatile void* pSource, size_t nBytes);
+
+#endif // SEQLOCK_H
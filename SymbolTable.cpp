@@ -0,0 +1,227 @@
+// SymbolTable.cpp - Ticker to dense symbol ID, lock-free lookups
+//
+// Maps a ticker to a dense ID with one hash and a short linear probe in a
+// power-of-two bucket array kept at most half full (SymbolIndex). When an insert
+// would pass that, the index is rebuilt at twice the size from the stored
+// hashes and swapped in. Lookups take no lock: a bucket, index or chunk is
+// published with an interlocked store only after everything behind it is
+// written, and read with an acquire load. A lookup racing an insert may miss
+// the new ticker, which then goes through the locked path.
+#include "SymbolTable.h"
+
+#include <string.h>
+
+#ifdef _WIN32
+
+// Volatile reads have acquire semantics under MSVC on x86/x64
+template <typename T>
+static inline T LoadAcquire(T const volatile* pValue)
+{
+	return *pValue;
+}
+
+#else // !_WIN32
+
+template <typename T>
+static inline T LoadAcquire(T const volatile* pValue)
+{
+	return __atomic_load_n(pValue, __ATOMIC_ACQUIRE);
+}
+
+#endif // _WIN32
+
+UINT32 HashSymbol(LPCTSTR pszTicker, int* pnLength)
+{
+	UINT32 nHash = 2166136261u;
+	int nLength = 0;
+	for (; pszTicker[nLength] != _T('\0'); nLength++)
+	{
+		nHash ^= (UINT32)(_TUCHAR)pszTicker[nLength];
+		nHash *= 16777619u;
+	}
+	*pnLength = nLength;
+	return nHash;
+}
+
+void InitSymbolTable(SymbolTable* pTable, SymbolChunkProc pfnNewChunk, void* pContext)
+{
+	pTable->pIndex = NULL;
+	for (int i = 0; i < SYMBOL_TABLE_MAX_CHUNKS; i++)
+		pTable->apChunks[i] = NULL;
+	pTable->nCount = 0;
+	InitializeCriticalSection(&pTable->lock);
+	pTable->pfnNewChunk = pfnNewChunk;
+	pTable->pContext = pContext;
+}
+
+void DeleteSymbolTable(SymbolTable* pTable)
+{
+	SymbolIndex* pIndex = pTable->pIndex;
+	while (pIndex != NULL)
+	{
+		SymbolIndex* pRetired = pIndex->pRetired;
+		delete[] pIndex->pBuckets;
+		delete pIndex;
+		pIndex = pRetired;
+	}
+	pTable->pIndex = NULL;
+
+	for (int i = 0; i < SYMBOL_TABLE_MAX_CHUNKS; i++)
+	{
+		delete[] pTable->apChunks[i];
+		pTable->apChunks[i] = NULL;
+	}
+	pTable->nCount = 0;
+	DeleteCriticalSection(&pTable->lock);
+}
+
+static inline const SymbolKey* GetSymbolKey(SymbolTable* pTable, int nSymbolId)
+{
+	return &LoadAcquire(&pTable->apChunks[nSymbolId / SYMBOL_CHUNK_SIZE])[nSymbolId % SYMBOL_CHUNK_SIZE];
+}
+
+// Probe pIndex for pszTicker; returns its ID, or -1 with *pnBucket = the empty bucket that ends the probe
+static int ProbeSymbolIndex(SymbolTable* pTable, const SymbolIndex* pIndex, LPCTSTR pszTicker, UINT32 nHash, UINT32* pnBucket)
+{
+	UINT32 nMask = pIndex->nBuckets - 1;
+	for (UINT32 nBucket = nHash & nMask; ; nBucket = (nBucket + 1) & nMask)
+	{
+		LONG nEntry = LoadAcquire(&pIndex->pBuckets[nBucket]);
+		if (nEntry == 0)
+		{
+			*pnBucket = nBucket;
+			return -1;
+		}
+
+		const SymbolKey* pKey = GetSymbolKey(pTable, nEntry - 1);
+		if (pKey->nHash == nHash && _tcscmp(pKey->szTicker, pszTicker) == 0)
+			return nEntry - 1;
+	}
+}
+
+// Build an index with nBuckets buckets holding IDs 0..nCount-1. Caller must hold pTable->lock.
+static SymbolIndex* BuildSymbolIndex(SymbolTable* pTable, UINT32 nBuckets, int nCount, SymbolIndex* pRetired)
+{
+	SymbolIndex* pIndex = new SymbolIndex;
+	pIndex->nBuckets = nBuckets;
+	pIndex->pRetired = pRetired;
+	pIndex->pBuckets = new LONG[nBuckets];
+	memset((void*)pIndex->pBuckets, 0, nBuckets * sizeof(LONG));
+
+	for (int nId = 0; nId < nCount; nId++)
+	{
+		UINT32 nBucket = GetSymbolKey(pTable, nId)->nHash & (nBuckets - 1);
+		while (pIndex->pBuckets[nBucket] != 0)
+			nBucket = (nBucket + 1) & (nBuckets - 1);
+		pIndex->pBuckets[nBucket] = nId + 1;
+	}
+	return pIndex;
+}
+
+int SymbolTableFind(SymbolTable* pTable, LPCTSTR pszTicker)
+{
+	SymbolIndex* pIndex = LoadAcquire(&pTable->pIndex);
+	if (pIndex == NULL)
+		return -1;
+
+	int nLength;
+	UINT32 nHash = HashSymbol(pszTicker, &nLength);
+	UINT32 nBucket;
+	return ProbeSymbolIndex(pTable, pIndex, pszTicker, nHash, &nBucket);
+}
+
+// ID of a ticker with a precomputed HashSymbol(), assigning the next free one on first sight
+static int InternHashedSymbol(SymbolTable* pTable, LPCTSTR pszTicker, int nLength, UINT32 nHash)
+{
+	UINT32 nBucket;
+	SymbolIndex* pIndex = LoadAcquire(&pTable->pIndex);
+	int nId = (pIndex != NULL) ? ProbeSymbolIndex(pTable, pIndex, pszTicker, nHash, &nBucket) : -1;
+	if (nId >= 0 || nLength == 0 || nLength >= SYMBOL_TICKER_SIZE)
+		return nId;
+
+	EnterCriticalSection(&pTable->lock);
+
+	// Another thread may have added it (or grown the index) since the probe
+	pIndex = pTable->pIndex;
+	nId = (pIndex != NULL) ? ProbeSymbolIndex(pTable, pIndex, pszTicker, nHash, &nBucket) : -1;
+	int nCount = pTable->nCount;
+	if (nId < 0 && nCount < SYMBOL_TABLE_MAX_SYMBOLS)
+	{
+		// Keep the index at most half full
+		if (pIndex == NULL || (UINT32)(nCount + 1) * 2 > pIndex->nBuckets)
+		{
+			UINT32 nBuckets = (pIndex != NULL) ? pIndex->nBuckets * 2 : SYMBOL_TABLE_MIN_BUCKETS;
+			pIndex = BuildSymbolIndex(pTable, nBuckets, nCount, pIndex);
+			InterlockedExchangePointer((PVOID volatile*)&pTable->pIndex, pIndex);
+			ProbeSymbolIndex(pTable, pIndex, pszTicker, nHash, &nBucket);
+		}
+
+		if (nCount % SYMBOL_CHUNK_SIZE == 0)
+		{
+			int nChunk = nCount / SYMBOL_CHUNK_SIZE;
+			if (pTable->pfnNewChunk != NULL)
+				pTable->pfnNewChunk(pTable->pContext, nChunk);
+			InterlockedExchangePointer((PVOID volatile*)&pTable->apChunks[nChunk], new SymbolKey[SYMBOL_CHUNK_SIZE]);
+		}
+
+		nId = nCount;
+		SymbolKey* pKey = (SymbolKey*)GetSymbolKey(pTable, nId);
+		memcpy(pKey->szTicker, pszTicker, (nLength + 1) * sizeof(TCHAR));
+		pKey->nHash = nHash;
+		InterlockedExchange(&pIndex->pBuckets[nBucket], nId + 1);  // Publish
+		InterlockedIncrement(&pTable->nCount);
+	}
+
+	LeaveCriticalSection(&pTable->lock);
+
+	return nId;
+}
+
+int SymbolTableIntern(SymbolTable* pTable, LPCTSTR pszTicker)
+{
+	int nLength;
+	UINT32 nHash = HashSymbol(pszTicker, &nLength);
+	return InternHashedSymbol(pTable, pszTicker, nLength, nHash);
+}
+
+int SymbolTableInternPair(SymbolTable* pTable, const char* pszSymbol, const char* pszExchange)
+{
+	TCHAR szTicker[SYMBOL_TICKER_SIZE];
+	UINT32 nHash = 2166136261u;
+	int nLength = 0;
+
+	const char* apParts[2] = { pszSymbol, pszExchange };
+	for (int nPart = 0; nPart < 2; nPart++)
+	{
+		if (nPart == 1)
+		{
+			if (nLength >= SYMBOL_TICKER_SIZE - 1)
+				return -1;
+			szTicker[nLength++] = _T('-');
+			nHash ^= (UINT32)(_TUCHAR)_T('-');
+			nHash *= 16777619u;
+		}
+
+		for (const char* p = apParts[nPart]; *p != '\0'; p++)
+		{
+			if (nLength >= SYMBOL_TICKER_SIZE - 1)
+				return -1;
+			szTicker[nLength++] = (TCHAR)(unsigned char)*p;
+			nHash ^= (UINT32)(_TUCHAR)szTicker[nLength - 1];
+			nHash *= 16777619u;
+		}
+	}
+	szTicker[nLength] = _T('\0');
+
+	return InternHashedSymbol(pTable, szTicker, nLength, nHash);
+}
+
+LPCTSTR SymbolTableTicker(SymbolTable* pTable, int nSymbolId)
+{
+	return GetSymbolKey(pTable, nSymbolId)->szTicker;
+}
+
+int SymbolTableCount(SymbolTable* pTable)
+{
+	return LoadAcquire(&pTable->nCount);
+}
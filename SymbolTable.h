@@ -0,0 +1,70 @@
+// SymbolTable.h - Ticker to dense symbol ID, lock-free lookups
+//
+// No MFC: Plugin.cpp keeps one table (g_SymbolTable) and all per-symbol state
+// in SymbolState records found by ID (see "Symbol Table"); the hashing, the
+// growing open-addressing index and the ticker records live here, so the Linux
+// test build (tests/) can check them against std::unordered_map and hammer
+// lookups while the index grows.
+#ifndef SYMBOL_TABLE_H
+#define SYMBOL_TABLE_H
+
+#include "OpenAlgoPortable.h"
+
+#define SYMBOL_CHUNK_SIZE          1024    // Ticker records (and SymbolState records) allocated together
+#define SYMBOL_TABLE_MAX_CHUNKS    256     // Up to 262,144 symbols
+#define SYMBOL_TABLE_MAX_SYMBOLS   (SYMBOL_CHUNK_SIZE * SYMBOL_TABLE_MAX_CHUNKS)
+#define SYMBOL_TABLE_MIN_BUCKETS   2048    // Power of two; doubled whenever the index gets half full
+#define SYMBOL_TICKER_SIZE         48      // Incl. NUL; longer tickers get no ID
+
+// Called with the insert lock held before the first ID of chunk nChunk
+// (IDs nChunk * SYMBOL_CHUNK_SIZE and up) is handed out
+typedef void (*SymbolChunkProc)(void* pContext, int nChunk);
+
+struct SymbolKey {
+	TCHAR szTicker[SYMBOL_TICKER_SIZE];
+	UINT32 nHash;                // HashSymbol(szTicker)
+};
+
+// Open-addressing index from ticker to ID. An index is never modified after it is
+// replaced by a bigger one; the old one stays readable for lookups still probing it.
+struct SymbolIndex {
+	UINT32 nBuckets;             // Power of two
+	SymbolIndex* pRetired;       // The index this one replaced
+	volatile LONG* pBuckets;     // 0 = empty, else symbol ID + 1
+};
+
+struct SymbolTable {
+	SymbolIndex* volatile pIndex;
+	SymbolKey* volatile apChunks[SYMBOL_TABLE_MAX_CHUNKS];  // SYMBOL_CHUNK_SIZE records each
+	volatile LONG nCount;
+	CRITICAL_SECTION lock;       // Serializes inserts; lookups take no lock
+	SymbolChunkProc pfnNewChunk; // Or NULL
+	void* pContext;
+};
+
+void InitSymbolTable(SymbolTable* pTable, SymbolChunkProc pfnNewChunk, void* pContext);
+
+// Free every index and ticker record and delete the lock (after all users have stopped)
+void DeleteSymbolTable(SymbolTable* pTable);
+
+// FNV-1a over the ticker characters; *pnLength receives the length
+UINT32 HashSymbol(LPCTSTR pszTicker, int* pnLength);
+
+// ID of a ticker seen before, or -1
+int SymbolTableFind(SymbolTable* pTable, LPCTSTR pszTicker);
+
+// ID of a ticker, assigning the next free one on first sight.
+// Returns -1 if the ticker is empty or too long, or the table is full.
+int SymbolTableIntern(SymbolTable* pTable, LPCTSTR pszTicker);
+
+// The same for "SYMBOL-EXCHANGE" given the two parts as parsed from a WebSocket
+// frame. The ticker is assembled on the stack while it is hashed - one pass, no heap.
+int SymbolTableInternPair(SymbolTable* pTable, const char* pszSymbol, const char* pszExchange);
+
+// Ticker for an ID handed out by the table; valid until DeleteSymbolTable()
+LPCTSTR SymbolTableTicker(SymbolTable* pTable, int nSymbolId);
+
+// IDs 0..count-1 have been handed out
+int SymbolTableCount(SymbolTable* pTable);
+
+#endif // SYMBOL_TABLE_H
@@ -0,0 +1,158 @@
+// TickJournal.cpp - On-disk format and replay of the tick journal
+#include "TickJournal.h"
+#include "Calendar.h"
+
+#include <stddef.h>
+#include <string.h>
+
+void InitTickJournalHeader(TickJournalFileHeader* pHeader)
+{
+	memset(pHeader, 0, sizeof(TickJournalFileHeader));
+	pHeader->nMagic = TICK_JOURNAL_MAGIC;
+	pHeader->nVersion = TICK_JOURNAL_VERSION;
+	pHeader->nRecordSize = sizeof(TickJournalRecord);
+}
+
+BOOL IsTickJournalHeaderValid(const TickJournalFileHeader* pHeader)
+{
+	return pHeader->nMagic == TICK_JOURNAL_MAGIC &&
+		pHeader->nVersion == TICK_JOURNAL_VERSION &&
+		pHeader->nRecordSize == sizeof(TickJournalRecord);
+}
+
+UINT32 TickJournalChecksum(const TickJournalRecord* pRecord)
+{
+	// FNV-1a over every byte before nChecksum
+	const BYTE* pBytes = (const BYTE*)pRecord;
+	UINT32 nHash = 2166136261u;
+	for (int i = 0; i < (int)offsetof(TickJournalRecord, nChecksum); i++)
+	{
+		nHash ^= pBytes[i];
+		nHash *= 16777619u;
+	}
+	return nHash;
+}
+
+BOOL FillTickJournalRecord(TickJournalRecord* pRecord, INT64 nTimestamp, float fLtp, float fLastTradeQty, LPCTSTR pszTicker)
+{
+	int nTickerLength = (int)_tcslen(pszTicker);
+	if (nTickerLength >= TICK_JOURNAL_TICKER_SIZE)
+		return FALSE;
+
+	memset(pRecord, 0, sizeof(TickJournalRecord));
+	pRecord->nTimestamp = nTimestamp;
+	pRecord->fLtp = fLtp;
+	pRecord->fLastTradeQty = fLastTradeQty;
+	for (int i = 0; i < nTickerLength; i++)
+		pRecord->szTicker[i] = (char)pszTicker[i];
+	pRecord->nChecksum = TickJournalChecksum(pRecord);
+	return TRUE;
+}
+
+// Day boundaries come from the same fixed offset as the bars (see "Calendar
+// Conversion"), not from the PC's time zone: every local day is 86400 seconds.
+void GetTickJournalDay(INT64 nTime, int nUtcOffsetSeconds, INT64* pnDayStart, INT64* pnRotateAt, int* pnDate)
+{
+	INT64 nLocal = nTime + nUtcOffsetSeconds;
+	INT64 nDay = (nLocal >= 0 ? nLocal : nLocal - 86399) / 86400;
+	int nYear, nMonth, nDayOfMonth;
+	CivilFromDays(nDay, &nYear, &nMonth, &nDayOfMonth);
+
+	*pnDayStart = nDay * 86400 - nUtcOffsetSeconds;
+	*pnRotateAt = *pnDayStart + 86400;
+	*pnDate = nYear * 10000 + nMonth * 100 + nDayOfMonth;
+}
+
+INT64 ReplayTickJournalRecords(TickJournalReadProc pfnRead, void* pReader, TickJournalApplyProc pfnApply, void* pContext, BOOL* pbTorn)
+{
+	TickJournalRecord* pRecords = new TickJournalRecord[TICK_JOURNAL_REPLAY_RECORDS];
+	INT64 nGood = 0;
+	BOOL bTorn = FALSE;
+
+	DWORD dwRead = 0;
+	while (!bTorn && pfnRead(pReader, pRecords, TICK_JOURNAL_REPLAY_RECORDS * sizeof(TickJournalRecord), &dwRead) && dwRead > 0)
+	{
+		int nRecords = (int)(dwRead / sizeof(TickJournalRecord));
+		for (int i = 0; i < nRecords; i++)
+		{
+			const TickJournalRecord* pRecord = &pRecords[i];
+			if (pRecord->nChecksum != TickJournalChecksum(pRecord) || pRecord->szTicker[TICK_JOURNAL_TICKER_SIZE - 1] != '\0')
+			{
+				bTorn = TRUE;
+				break;
+			}
+			pfnApply(pContext, pRecord);
+			nGood++;
+		}
+
+		// A partial record at the end is a torn write
+		if (dwRead % sizeof(TickJournalRecord) != 0)
+			bTorn = TRUE;
+	}
+
+	delete[] pRecords;
+
+	if (pbTorn != NULL)
+		*pbTorn = bTorn;
+	return nGood;
+}
+
+void OpenTickJournalWriter(TickJournalWriter* pJournal, TickJournalWriteProc pfnWrite, TickJournalSyncProc pfnSync,
+	void* pWriter, DWORD dwNow)
+{
+	pJournal->pfnWrite = pfnWrite;
+	pJournal->pfnSync = pfnSync;
+	pJournal->pWriter = pWriter;
+	pJournal->nBuffered = 0;
+	pJournal->bUnsynced = FALSE;
+	pJournal->dwLastSync = dwNow;
+}
+
+// A failed write is reported by pfnWrite; its records are dropped either way
+static void WriteTickJournalBuffer(TickJournalWriter* pJournal)
+{
+	if (pJournal->nBuffered > 0 && pJournal->pWriter != NULL)
+	{
+		pJournal->pfnWrite(pJournal->pWriter, pJournal->buffer, pJournal->nBuffered * sizeof(TickJournalRecord));
+		pJournal->bUnsynced = TRUE;
+	}
+	pJournal->nBuffered = 0;
+}
+
+BOOL AppendTickJournalRecord(TickJournalWriter* pJournal, INT64 nTimestamp, float fLtp, float fLastTradeQty, LPCTSTR pszTicker)
+{
+	if (pJournal->pWriter == NULL ||
+		!FillTickJournalRecord(&pJournal->buffer[pJournal->nBuffered], nTimestamp, fLtp, fLastTradeQty, pszTicker))
+		return FALSE;
+
+	if (++pJournal->nBuffered == TICK_JOURNAL_BUFFER_RECORDS)
+		WriteTickJournalBuffer(pJournal);
+	return TRUE;
+}
+
+void FlushTickJournalWriter(TickJournalWriter* pJournal, BOOL bSync, DWORD dwNow, DWORD dwFsyncMs)
+{
+	if (pJournal->pWriter == NULL)
+		return;
+
+	WriteTickJournalBuffer(pJournal);
+
+	// Unsigned difference: correct across the 49.7-day wrap of the tick count
+	if (pJournal->bUnsynced && (bSync || dwNow - pJournal->dwLastSync >= dwFsyncMs))
+	{
+		pJournal->pfnSync(pJournal->pWriter);
+		pJournal->bUnsynced = FALSE;
+		pJournal->dwLastSync = dwNow;
+	}
+}
+
+void CloseTickJournalWriter(TickJournalWriter* pJournal)
+{
+	if (pJournal->pWriter == NULL)
+		return;
+
+	WriteTickJournalBuffer(pJournal);
+	pJournal->pfnSync(pJournal->pWriter);
+	pJournal->pWriter = NULL;
+	pJournal->bUnsynced = FALSE;
+}
@@ -0,0 +1,99 @@
+// TickJournal.h - On-disk format and replay of the tick journal
+//
+// No MFC: Plugin.cpp owns the file (CreateFile/WriteFile) and the BarBuilders;
+// the record layout, day boundaries, the write batching and the replay loop that
+// decides where a damaged journal is cut off live here, so the Linux test build
+// (tests/) can check them against truncated and corrupted files and measure the
+// write path against a real file.
+#ifndef TICK_JOURNAL_H
+#define TICK_JOURNAL_H
+
+#include "OpenAlgoPortable.h"
+
+#define TICK_JOURNAL_MAGIC             0x4A544F41  // "AOTJ"
+#define TICK_JOURNAL_VERSION           1
+#define TICK_JOURNAL_HEADER_SIZE       64
+#define TICK_JOURNAL_TICKER_SIZE       44          // "SYMBOL-EXCHANGE" incl. NUL; longer tickers are not journaled
+#define TICK_JOURNAL_REPLAY_RECORDS    16384       // Records per read during replay (1 MB)
+#define TICK_JOURNAL_BUFFER_RECORDS    1024        // Records per write (64 KB)
+#define TICK_JOURNAL_FSYNC_MS_DEFAULT  1000        // Registry "JournalFsyncMs"
+
+// First 64 bytes of a journal file; records follow back to back
+struct TickJournalFileHeader {
+	UINT32 nMagic;
+	UINT32 nVersion;
+	UINT32 nRecordSize;      // sizeof(TickJournalRecord)
+	UINT32 aReserved[13];
+};
+
+// One journaled tick - 64 bytes, little-endian, fixed width
+struct TickJournalRecord {
+	INT64 nTimestamp;                        // Tick time (Unix seconds) as passed to ProcessTick()
+	float fLtp;
+	float fLastTradeQty;
+	char szTicker[TICK_JOURNAL_TICKER_SIZE]; // NUL-padded
+	UINT32 nChecksum;                        // FNV-1a of the bytes above - detects a torn last write
+};
+
+void InitTickJournalHeader(TickJournalFileHeader* pHeader);
+BOOL IsTickJournalHeaderValid(const TickJournalFileHeader* pHeader);
+
+UINT32 TickJournalChecksum(const TickJournalRecord* pRecord);
+
+// Fill and checksum a record; FALSE if the ticker does not fit
+BOOL FillTickJournalRecord(TickJournalRecord* pRecord, INT64 nTimestamp, float fLtp, float fLastTradeQty, LPCTSTR pszTicker);
+
+// The journal day containing nTime in local time (UTC + nUtcOffsetSeconds):
+// its start, the next day's start (Unix seconds) and its date as YYYYMMDD
+void GetTickJournalDay(INT64 nTime, int nUtcOffsetSeconds, INT64* pnDayStart, INT64* pnRotateAt, int* pnDate);
+
+// Reads up to dwBytes of records (the file position is just after the header);
+// FALSE or *pdwRead == 0 ends the replay
+typedef BOOL (*TickJournalReadProc)(void* pReader, void* pBuffer, DWORD dwBytes, DWORD* pdwRead);
+
+// Called once per intact record, in file order
+typedef void (*TickJournalApplyProc)(void* pContext, const TickJournalRecord* pRecord);
+
+// Replay records until the end or the first damaged one (bad checksum, unterminated
+// ticker, partial record). Returns the number of intact records: the file should
+// be cut to TICK_JOURNAL_HEADER_SIZE + that many records.
+INT64 ReplayTickJournalRecords(TickJournalReadProc pfnRead, void* pReader, TickJournalApplyProc pfnApply, void* pContext, BOOL* pbTorn);
+
+// Writes dwBytes of records at the end of the file; FALSE if not all were written
+typedef BOOL (*TickJournalWriteProc)(void* pWriter, const void* pBuffer, DWORD dwBytes);
+
+// Flushes what was written to disk (FlushFileBuffers() in the plugin)
+typedef void (*TickJournalSyncProc)(void* pWriter);
+
+// Records collect in buffer and go out with one write per TICK_JOURNAL_BUFFER_RECORDS
+// or per FlushTickJournalWriter(); the file is synced at most once every dwFsyncMs.
+// Time is passed in (GetTickCount() in the plugin).
+struct TickJournalWriter {
+	TickJournalWriteProc pfnWrite;
+	TickJournalSyncProc pfnSync;
+	void* pWriter;           // NULL while no file is open
+	int nBuffered;           // Records in buffer not yet written
+	BOOL bUnsynced;          // Written since the last sync
+	DWORD dwLastSync;        // Time of the last sync (ms)
+	TickJournalRecord buffer[TICK_JOURNAL_BUFFER_RECORDS];
+
+	TickJournalWriter() : pfnWrite(NULL), pfnSync(NULL), pWriter(NULL), nBuffered(0),
+	                      bUnsynced(FALSE), dwLastSync(0) {
+	}
+};
+
+// Start writing to a file positioned at its end
+void OpenTickJournalWriter(TickJournalWriter* pJournal, TickJournalWriteProc pfnWrite, TickJournalSyncProc pfnSync,
+	void* pWriter, DWORD dwNow);
+
+// Buffer one tick, writing the buffer out when it is full. FALSE if no file is
+// open or the ticker does not fit.
+BOOL AppendTickJournalRecord(TickJournalWriter* pJournal, INT64 nTimestamp, float fLtp, float fLastTradeQty, LPCTSTR pszTicker);
+
+// Write the buffered records; sync if bSync or dwFsyncMs has passed since the last sync
+void FlushTickJournalWriter(TickJournalWriter* pJournal, BOOL bSync, DWORD dwNow, DWORD dwFsyncMs);
+
+// Write and sync everything; the caller closes the file afterwards
+void CloseTickJournalWriter(TickJournalWriter* pJournal);
+
+#endif // TICK_JOURNAL_H
@@ -0,0 +1,336 @@
+// WebSocketFrame.cpp - RFC 6455 frame reassembly and masking
+#include "WebSocketFrame.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+///////////////////////////////
+// WebSocket Masking
+///////////////////////////////
+//
+// RFC 6455 masking XORs the payload with a repeating 4-byte key. Every frame we
+// send is masked, and a masked frame from the server is unmasked in place.
+// The kernel XORs a scalar head until the pointer is 16-byte aligned, then 32
+// bytes (AVX2, if the CPU and OS support it) or 16 bytes (SSE2) at a time, then
+// 8 bytes, then the remaining tail. Every block is a multiple of 4 bytes, so one
+// key rotated to the aligned start serves all of them. The SIMD blocks are built
+// with MSVC and with GCC/Clang on x86, so the Linux tests (tests/) run them too.
+
+#if defined(_M_X64) || defined(_M_IX86)
+#define WS_MASK_SIMD
+#define WS_MASK_AVX2_TARGET
+#include <intrin.h>
+#include <immintrin.h>
+
+static void WebSocketMaskCpuid(int info[4], int nLeaf)
+{
+	__cpuidex(info, nLeaf, 0);
+}
+
+static UINT64 WebSocketMaskXgetbv(void)
+{
+	return _xgetbv(0);
+}
+#elif defined(__GNUC__) && defined(__SSE2__)
+// GCC/Clang (the Linux test build): only the AVX2 loop is compiled for AVX2
+#define WS_MASK_SIMD
+#define WS_MASK_AVX2_TARGET __attribute__((target("avx2")))
+#include <cpuid.h>
+#include <immintrin.h>
+
+static void WebSocketMaskCpuid(int info[4], int nLeaf)
+{
+	__cpuid_count(nLeaf, 0, info[0], info[1], info[2], info[3]);
+}
+
+static UINT64 WebSocketMaskXgetbv(void)
+{
+	unsigned int nLow, nHigh;
+	__asm__ __volatile__("xgetbv" : "=a"(nLow), "=d"(nHigh) : "c"(0));
+	return ((UINT64)nHigh << 32) | nLow;
+}
+#endif
+
+#ifdef WS_MASK_SIMD
+// TRUE if AVX2 instructions can be used (CPU support + OS saves YMM registers)
+static BOOL WebSocketMaskCpuHasAvx2(void)
+{
+	int info[4];
+	WebSocketMaskCpuid(info, 0);
+	if (info[0] < 7)
+		return FALSE;
+
+	WebSocketMaskCpuid(info, 1);
+	BOOL bOsxsave = (info[2] & (1 << 27)) != 0;
+	BOOL bAvx = (info[2] & (1 << 28)) != 0;
+	if (!bOsxsave || !bAvx)
+		return FALSE;
+
+	if ((WebSocketMaskXgetbv() & 0x6) != 0x6)
+		return FALSE;
+
+	WebSocketMaskCpuid(info, 7);
+	return (info[1] & (1 << 5)) != 0;
+}
+
+// XOR 32-byte blocks from pData[i]; returns the index of the first byte not done
+WS_MASK_AVX2_TARGET static int WebSocketMaskAvx2(unsigned char* pData, int i, int nLength, UINT32 nKey32)
+{
+	__m256i vKey256 = _mm256_set1_epi32((int)nKey32);
+	for (; i + 32 <= nLength; i += 32)
+	{
+		__m256i v = _mm256_loadu_si256((const __m256i*)(pData + i));
+		_mm256_storeu_si256((__m256i*)(pData + i), _mm256_xor_si256(v, vKey256));
+	}
+	_mm256_zeroupper();
+	return i;
+}
+
+static int g_nWebSocketMaskAvx2 = -1;  // -1 = not probed yet
+#endif
+
+void WebSocketMaskPayload(unsigned char* pData, int nLength, const unsigned char* maskKey)
+{
+	if (pData == NULL || nLength <= 0)
+		return;
+
+	// Copy the key first - the caller's key may sit right in front of the payload
+	const unsigned char key[4] = { maskKey[0], maskKey[1], maskKey[2], maskKey[3] };
+	int i = 0;
+
+#ifdef WS_MASK_SIMD
+	// Short payloads (subscribe and ping frames) skip the SIMD blocks and their
+	// aligned head and go straight to the 8-byte loop
+	BOOL bSimd = (nLength >= 32);
+
+	// Scalar head up to the first 16-byte boundary
+	while (bSimd && i < nLength && (((UINT_PTR)(pData + i)) & 15) != 0)
+	{
+		pData[i] ^= key[i & 3];
+		i++;
+	}
+#endif
+
+	// Key rotated so that its first byte lines up with pData[i]
+	unsigned char rotated[4];
+	for (int k = 0; k < 4; k++)
+	{
+		rotated[k] = key[(i + k) & 3];
+	}
+	UINT32 nKey32;
+	memcpy(&nKey32, rotated, 4);
+
+#ifdef WS_MASK_SIMD
+	if (bSimd)
+	{
+		if (nLength - i >= 32)
+		{
+			if (g_nWebSocketMaskAvx2 < 0)
+			{
+				g_nWebSocketMaskAvx2 = WebSocketMaskCpuHasAvx2() ? 1 : 0;
+			}
+
+			if (g_nWebSocketMaskAvx2)
+			{
+				i = WebSocketMaskAvx2(pData, i, nLength, nKey32);
+			}
+		}
+
+		__m128i vKey128 = _mm_set1_epi32((int)nKey32);
+		for (; i + 16 <= nLength; i += 16)
+		{
+			__m128i v = _mm_load_si128((const __m128i*)(pData + i));
+			_mm_store_si128((__m128i*)(pData + i), _mm_xor_si128(v, vKey128));
+		}
+	}
+#endif
+
+	UINT64 nKey64 = ((UINT64)nKey32 << 32) | nKey32;
+	for (; i + 8 <= nLength; i += 8)
+	{
+		UINT64 v;
+		memcpy(&v, pData + i, 8);
+		v ^= nKey64;
+		memcpy(pData + i, &v, 8);
+	}
+
+	for (; i < nLength; i++)
+	{
+		pData[i] ^= key[i & 3];
+	}
+}
+
+///////////////////////////////
+// WebSocket Frame Reassembly
+///////////////////////////////
+//
+// recv() returns whatever TCP has buffered, which under load is rarely exactly
+// one frame: the server coalesces many small market_data frames into a single
+// segment and splits large ones across segments. The receive buffer keeps
+// unconsumed bytes between reads and the parser pulls out zero or more complete
+// frames per read, leaving a trailing partial frame in place for the next recv().
+//
+// Layout: [consumed | unconsumed frames ... | free space]
+//          0         nReadPos                nWritePos     nCapacity
+//
+// Frames are returned as views into the buffer. Masked payloads are unmasked in
+// place, so no per-frame copy is made. Unconsumed bytes are moved to the front
+// only when the free space runs low, which keeps every frame contiguous.
+
+// Return a pointer to free space for the next recv(), compacting or growing the
+// buffer if needed. Invalidates any WebSocketFrame views handed out earlier.
+char* WsRecvBufferPrepare(WebSocketRecvBuffer* pBuf, int* pnFreeSpace)
+{
+	if (pBuf->pData == NULL)
+	{
+		pBuf->pData = (char*)malloc(WS_RECV_BUFFER_INITIAL_SIZE);
+		if (pBuf->pData == NULL)
+		{
+			*pnFreeSpace = 0;
+			return NULL;
+		}
+		pBuf->nCapacity = WS_RECV_BUFFER_INITIAL_SIZE;
+		pBuf->nReadPos = 0;
+		pBuf->nWritePos = 0;
+	}
+
+	// Everything consumed - rewind for free
+	if (pBuf->nReadPos == pBuf->nWritePos)
+	{
+		pBuf->nReadPos = 0;
+		pBuf->nWritePos = 0;
+	}
+
+	int nUnconsumed = pBuf->nWritePos - pBuf->nReadPos;
+
+	// A partial frame larger than the buffer needs a bigger buffer
+	int nRequired = max(nUnconsumed + WS_RECV_MIN_READ_SIZE, pBuf->nPendingFrame);
+	if (nRequired > pBuf->nCapacity)
+	{
+		int nNewCapacity = pBuf->nCapacity;
+		while (nNewCapacity < nRequired && nNewCapacity < WS_RECV_BUFFER_MAX_SIZE)
+			nNewCapacity *= 2;
+		if (nNewCapacity > WS_RECV_BUFFER_MAX_SIZE)
+			nNewCapacity = WS_RECV_BUFFER_MAX_SIZE;
+
+		if (nNewCapacity > pBuf->nCapacity)
+		{
+			char* pNewData = (char*)malloc(nNewCapacity);
+			if (pNewData != NULL)
+			{
+				memcpy(pNewData, pBuf->pData + pBuf->nReadPos, nUnconsumed);
+				free(pBuf->pData);
+				pBuf->pData = pNewData;
+				pBuf->nCapacity = nNewCapacity;
+				pBuf->nReadPos = 0;
+				pBuf->nWritePos = nUnconsumed;
+			}
+		}
+	}
+
+	// Compact: move the partial frame to the front when the tail is running out
+	if (pBuf->nCapacity - pBuf->nWritePos < WS_RECV_MIN_READ_SIZE && pBuf->nReadPos > 0)
+	{
+		memmove(pBuf->pData, pBuf->pData + pBuf->nReadPos, nUnconsumed);
+		pBuf->nReadPos = 0;
+		pBuf->nWritePos = nUnconsumed;
+	}
+
+	*pnFreeSpace = pBuf->nCapacity - pBuf->nWritePos;
+	return pBuf->pData + pBuf->nWritePos;
+}
+
+// Account for nBytes written by recv() into the space returned by WsRecvBufferPrepare()
+void WsRecvBufferCommit(WebSocketRecvBuffer* pBuf, int nBytes)
+{
+	if (nBytes > 0)
+		pBuf->nWritePos += nBytes;
+}
+
+// Drop all buffered bytes (new connection - old partial frames are meaningless)
+void WsRecvBufferReset(WebSocketRecvBuffer* pBuf)
+{
+	pBuf->nReadPos = 0;
+	pBuf->nWritePos = 0;
+	pBuf->nPendingFrame = 0;
+}
+
+void WsRecvBufferFree(WebSocketRecvBuffer* pBuf)
+{
+	if (pBuf->pData != NULL)
+	{
+		free(pBuf->pData);
+		pBuf->pData = NULL;
+	}
+	pBuf->nCapacity = 0;
+	WsRecvBufferReset(pBuf);
+}
+
+// Extract the next complete frame from the buffer
+// Returns WS_FRAME_COMPLETE, WS_FRAME_INCOMPLETE or WS_FRAME_ERROR
+int WsRecvBufferExtractFrame(WebSocketRecvBuffer* pBuf, WebSocketFrame* pFrame)
+{
+	int nAvailable = pBuf->nWritePos - pBuf->nReadPos;
+	if (nAvailable < 2)
+		return WS_FRAME_INCOMPLETE;
+
+	unsigned char* p = (unsigned char*)pBuf->pData + pBuf->nReadPos;
+
+	unsigned char opcode = p[0] & 0x0F;
+	BOOL bFinal = (p[0] & 0x80) != 0;
+	BOOL bMasked = (p[1] & 0x80) != 0;
+	unsigned __int64 payloadLen = p[1] & 0x7F;
+	int headerLen = 2;
+
+	// Extended payload length (16-bit or 64-bit, network byte order)
+	if (payloadLen == 126)
+	{
+		if (nAvailable < 4)
+			return WS_FRAME_INCOMPLETE;
+		payloadLen = ((unsigned __int64)p[2] << 8) | p[3];
+		headerLen = 4;
+	}
+	else if (payloadLen == 127)
+	{
+		if (nAvailable < 10)
+			return WS_FRAME_INCOMPLETE;
+		payloadLen = 0;
+		for (int i = 0; i < 8; i++)
+			payloadLen = (payloadLen << 8) | p[2 + i];
+		headerLen = 10;
+	}
+
+	if (bMasked)
+		headerLen += 4;
+
+	// Control frames may not exceed 125 bytes; data frames are capped by the buffer limit
+	if ((opcode & 0x08) && payloadLen > 125)
+		return WS_FRAME_ERROR;
+	if (payloadLen > (unsigned __int64)(WS_RECV_BUFFER_MAX_SIZE - headerLen))
+		return WS_FRAME_ERROR;
+
+	int frameLen = headerLen + (int)payloadLen;
+	if (nAvailable < frameLen)
+	{
+		// Remember how big this frame is so Prepare() can grow the buffer if needed
+		pBuf->nPendingFrame = frameLen;
+		return WS_FRAME_INCOMPLETE;
+	}
+
+	char* pPayload = (char*)p + headerLen;
+
+	// Servers should not mask, but unmask in place if one does
+	if (bMasked)
+	{
+		WebSocketMaskPayload((unsigned char*)pPayload, (int)payloadLen, p + headerLen - 4);
+	}
+
+	pFrame->opcode = opcode;
+	pFrame->bFinal = bFinal;
+	pFrame->pPayload = pPayload;
+	pFrame->nPayloadLen = (int)payloadLen;
+
+	pBuf->nReadPos += frameLen;
+	pBuf->nPendingFrame = 0;
+	return WS_FRAME_COMPLETE;
+}
@@ -0,0 +1,52 @@
+// WebSocketFrame.h - RFC 6455 frame reassembly and masking
+//
+// No MFC or socket calls: the I/O thread in Plugin.cpp feeds recv() bytes in,
+// and the Linux test build (tests/) exercises the same code.
+#ifndef WEBSOCKET_FRAME_H
+#define WEBSOCKET_FRAME_H
+
+#include "OpenAlgoPortable.h"
+
+// WebSocket receive buffer
+// Persists across recv() calls so that a frame split over several TCP segments
+// is reassembled, and several frames coalesced into one segment are all delivered.
+#define WS_RECV_BUFFER_INITIAL_SIZE (64 * 1024)        // 64 KB
+#define WS_RECV_BUFFER_MAX_SIZE     (4 * 1024 * 1024)  // Largest frame we accept
+#define WS_RECV_MIN_READ_SIZE       4096               // Minimum free space before recv()
+
+// Results of WsRecvBufferExtractFrame()
+#define WS_FRAME_INCOMPLETE 0   // Need more bytes from the socket
+#define WS_FRAME_COMPLETE   1   // One frame extracted
+#define WS_FRAME_ERROR      -1  // Protocol violation or frame too large
+
+struct WebSocketRecvBuffer {
+	char* pData;
+	int nCapacity;
+	int nReadPos;       // First byte not yet consumed by the frame parser
+	int nWritePos;      // One past the last byte received
+	int nPendingFrame;  // Total size of the partial frame at nReadPos (0 = unknown)
+
+	WebSocketRecvBuffer() : pData(NULL), nCapacity(0), nReadPos(0), nWritePos(0), nPendingFrame(0) {
+	}
+};
+
+// A decoded frame. pPayload points INTO the receive buffer (already unmasked)
+// and stays valid only until the next WsRecvBufferPrepare() call.
+struct WebSocketFrame {
+	unsigned char opcode;
+	BOOL bFinal;
+	const char* pPayload;
+	int nPayloadLen;
+};
+
+// Frame reassembly (see "WebSocket Frame Reassembly" in WebSocketFrame.cpp)
+char* WsRecvBufferPrepare(WebSocketRecvBuffer* pBuf, int* pnFreeSpace);
+void WsRecvBufferCommit(WebSocketRecvBuffer* pBuf, int nBytes);
+void WsRecvBufferReset(WebSocketRecvBuffer* pBuf);
+void WsRecvBufferFree(WebSocketRecvBuffer* pBuf);
+int WsRecvBufferExtractFrame(WebSocketRecvBuffer* pBuf, WebSocketFrame* pFrame);
+
+// RFC 6455 mask/unmask in place
+void WebSocketMaskPayload(unsigned char* pData, int nLength, const unsigned char* maskKey);
+
+#endif // WEBSOCKET_FRAME_H
@@ -0,0 +1,270 @@
+// WebSocketPoll.cpp - Readiness wait for the WebSocket I/O thread
+#include "WebSocketPoll.h"
+
+#ifndef _WIN32
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
+#ifdef _WIN32
+
+///////////////////////////////
+// Winsock Backend
+///////////////////////////////
+
+BOOL WsPollerOpen(WebSocketPoller* pPoller)
+{
+	pPoller->hStopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);  // Manual reset
+	pPoller->hReadEvent = WSACreateEvent();
+	pPoller->socket = INVALID_SOCKET;
+	if (pPoller->hStopEvent == NULL || pPoller->hReadEvent == WSA_INVALID_EVENT)
+	{
+		WsPollerClose(pPoller);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+void WsPollerClose(WebSocketPoller* pPoller)
+{
+	if (pPoller->hStopEvent != NULL)
+	{
+		CloseHandle(pPoller->hStopEvent);
+		pPoller->hStopEvent = NULL;
+	}
+	if (pPoller->hReadEvent != WSA_INVALID_EVENT)
+	{
+		WSACloseEvent(pPoller->hReadEvent);
+		pPoller->hReadEvent = WSA_INVALID_EVENT;
+	}
+	pPoller->socket = INVALID_SOCKET;
+}
+
+BOOL WsPollerSelect(WebSocketPoller* pPoller, SOCKET s)
+{
+	// closesocket() already dropped the association with a previous socket
+	pPoller->socket = s;
+	WSAResetEvent(pPoller->hReadEvent);
+	if (s == INVALID_SOCKET)
+		return TRUE;
+
+	if (WSAEventSelect(s, pPoller->hReadEvent, FD_READ | FD_CLOSE) == SOCKET_ERROR)
+	{
+		pPoller->socket = INVALID_SOCKET;
+		return FALSE;
+	}
+	return TRUE;
+}
+
+void WsPollerSignalStop(WebSocketPoller* pPoller)
+{
+	SetEvent(pPoller->hStopEvent);
+}
+
+BOOL WsPollerStopRequested(WebSocketPoller* pPoller)
+{
+	return (WaitForSingleObject(pPoller->hStopEvent, 0) == WAIT_OBJECT_0);
+}
+
+int WsPollerWait(WebSocketPoller* pPoller, DWORD dwTimeoutMs)
+{
+	if (pPoller->socket == INVALID_SOCKET)
+	{
+		// Nothing to read - only a stop request or the timeout can wake us
+		if (WaitForSingleObject(pPoller->hStopEvent, dwTimeoutMs) == WAIT_OBJECT_0)
+			return WS_IO_WAKE_STOP;
+		return WS_IO_WAKE_TIMEOUT;
+	}
+
+	WSAEVENT events[2] = { pPoller->hStopEvent, pPoller->hReadEvent };
+	DWORD dwResult = WSAWaitForMultipleEvents(2, events, FALSE, dwTimeoutMs, FALSE);
+
+	if (dwResult == WSA_WAIT_EVENT_0)
+		return WS_IO_WAKE_STOP;
+
+	if (dwResult == WSA_WAIT_EVENT_0 + 1)
+	{
+		// Resets the event; FD_READ is re-enabled by the next recv()
+		WSANETWORKEVENTS netEvents;
+		WSAEnumNetworkEvents(pPoller->socket, pPoller->hReadEvent, &netEvents);
+		return WS_IO_WAKE_READABLE;
+	}
+
+	return WS_IO_WAKE_TIMEOUT;
+}
+
+BOOL WsPollerReadable(WebSocketPoller* pPoller)
+{
+	if (pPoller->socket == INVALID_SOCKET)
+		return FALSE;
+
+	// Not the read event: WsPollerWait() already reset it, and FD_READ is only
+	// posted again after the next recv()
+	fd_set readfds;
+	FD_ZERO(&readfds);
+	FD_SET(pPoller->socket, &readfds);
+	struct timeval timeout;
+	timeout.tv_sec = 0;
+	timeout.tv_usec = 0;
+	return (select(0, &readfds, NULL, NULL, &timeout) > 0);
+}
+
+#else // !_WIN32
+
+///////////////////////////////
+// epoll Backend
+///////////////////////////////
+
+BOOL WsPollerOpen(WebSocketPoller* pPoller)
+{
+	pPoller->socket = INVALID_SOCKET;
+	pPoller->nEpollFd = epoll_create1(EPOLL_CLOEXEC);
+	pPoller->nStopFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (pPoller->nEpollFd < 0 || pPoller->nStopFd < 0)
+	{
+		WsPollerClose(pPoller);
+		return FALSE;
+	}
+
+	struct epoll_event event;
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.fd = pPoller->nStopFd;
+	if (epoll_ctl(pPoller->nEpollFd, EPOLL_CTL_ADD, pPoller->nStopFd, &event) != 0)
+	{
+		WsPollerClose(pPoller);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+void WsPollerClose(WebSocketPoller* pPoller)
+{
+	if (pPoller->nEpollFd >= 0)
+	{
+		close(pPoller->nEpollFd);
+		pPoller->nEpollFd = -1;
+	}
+	if (pPoller->nStopFd >= 0)
+	{
+		close(pPoller->nStopFd);
+		pPoller->nStopFd = -1;
+	}
+	pPoller->socket = INVALID_SOCKET;
+}
+
+BOOL WsPollerSelect(WebSocketPoller* pPoller, SOCKET s)
+{
+	// A closed socket has already left the epoll set; one that is still open has to be removed
+	if (pPoller->socket != INVALID_SOCKET)
+		epoll_ctl(pPoller->nEpollFd, EPOLL_CTL_DEL, pPoller->socket, NULL);
+	pPoller->socket = INVALID_SOCKET;
+	if (s == INVALID_SOCKET)
+		return TRUE;
+
+	// Level-triggered, like FD_READ being re-enabled by recv() on Windows
+	struct epoll_event event;
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN | EPOLLRDHUP;
+	event.data.fd = s;
+	if (epoll_ctl(pPoller->nEpollFd, EPOLL_CTL_ADD, s, &event) != 0 &&
+		(errno != EEXIST || epoll_ctl(pPoller->nEpollFd, EPOLL_CTL_MOD, s, &event) != 0))
+	{
+		return FALSE;
+	}
+	pPoller->socket = s;
+	return TRUE;
+}
+
+void WsPollerSignalStop(WebSocketPoller* pPoller)
+{
+	uint64_t nOne = 1;
+	ssize_t nWritten = write(pPoller->nStopFd, &nOne, sizeof(nOne));
+	(void)nWritten;  // Only fails if the counter is already huge, i.e. stop is already signaled
+}
+
+BOOL WsPollerStopRequested(WebSocketPoller* pPoller)
+{
+	struct pollfd pfd;
+	pfd.fd = pPoller->nStopFd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	return (poll(&pfd, 1, 0) == 1);
+}
+
+int WsPollerWait(WebSocketPoller* pPoller, DWORD dwTimeoutMs)
+{
+	int nTimeoutMs = (dwTimeoutMs > (DWORD)INT_MAX) ? -1 : (int)dwTimeoutMs;
+
+	struct epoll_event events[2];
+	int nEvents = epoll_wait(pPoller->nEpollFd, events, 2, nTimeoutMs);
+	if (nEvents <= 0)
+		return WS_IO_WAKE_TIMEOUT;  // Timeout or EINTR - the caller loops either way
+
+	BOOL bReadable = FALSE;
+	for (int i = 0; i < nEvents; i++)
+	{
+		if (events[i].data.fd == pPoller->nStopFd)
+			return WS_IO_WAKE_STOP;
+		if (pPoller->socket != INVALID_SOCKET && events[i].data.fd == pPoller->socket)
+			bReadable = TRUE;
+	}
+	return bReadable ? WS_IO_WAKE_READABLE : WS_IO_WAKE_TIMEOUT;
+}
+
+BOOL WsPollerReadable(WebSocketPoller* pPoller)
+{
+	if (pPoller->socket == INVALID_SOCKET)
+		return FALSE;
+
+	// Level-triggered, so looking does not use anything up
+	struct epoll_event events[2];
+	int nEvents = epoll_wait(pPoller->nEpollFd, events, 2, 0);
+	for (int i = 0; i < nEvents; i++)
+	{
+		if (events[i].data.fd == pPoller->socket)
+			return TRUE;
+	}
+	return FALSE;
+}
+
+#endif // _WIN32
+
+///////////////////////////////
+// Drain Loop Reads
+///////////////////////////////
+
+int WsPollerReadFrame(WebSocketPoller* pPoller, WebSocketRecvBuffer* pBuf, WebSocketFrame* pFrame, int* pnReceived)
+{
+	*pnReceived = 0;
+
+	for (;;)
+	{
+		int nResult = WsRecvBufferExtractFrame(pBuf, pFrame);
+		if (nResult != WS_FRAME_INCOMPLETE)
+			return nResult;
+
+		if (!WsPollerReadable(pPoller))
+			return WS_FRAME_INCOMPLETE;
+
+		// Append to whatever partial frame is already buffered
+		int nFreeSpace = 0;
+		char* pWrite = WsRecvBufferPrepare(pBuf, &nFreeSpace);
+		if (pWrite == NULL || nFreeSpace <= 0)
+			return WS_FRAME_BUFFER_FULL;
+
+		int nReceived = (int)recv(pPoller->socket, pWrite, nFreeSpace, 0);
+		if (nReceived == 0)
+			return WS_FRAME_CLOSED;
+		if (nReceived < 0)
+			return WS_FRAME_INCOMPLETE;  // Usually WSAEWOULDBLOCK - nothing more right now
+
+		WsRecvBufferCommit(pBuf, nReceived);
+		*pnReceived += nReceived;
+	}
+}
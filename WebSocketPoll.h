@@ -0,0 +1,71 @@
+// WebSocketPoll.h - Readiness wait for the WebSocket I/O thread
+//
+// WebSocketIoWait() in Plugin.cpp blocks in WsPollerWait() until the socket is
+// readable, the thread is asked to stop, or a timeout passes; the drain loop in
+// ProcessWebSocketData() then takes frames with WsPollerReadFrame(), which only
+// calls recv() while WsPollerReadable() says there is something to read. Windows
+// uses WSAEventSelect + WSAWaitForMultipleEvents; other platforms use epoll with
+// an eventfd for the stop request, which is what the Linux test build runs.
+#ifndef WEBSOCKET_POLL_H
+#define WEBSOCKET_POLL_H
+
+#ifdef _WIN32
+#include <winsock2.h>
+#endif
+#include "OpenAlgoPortable.h"
+#include "WebSocketFrame.h"
+
+// Results of WsPollerWait()
+#define WS_IO_WAKE_READABLE 0   // Socket has data (or was closed by the peer)
+#define WS_IO_WAKE_STOP     1   // WsPollerSignalStop() was called
+#define WS_IO_WAKE_TIMEOUT  2   // Periodic wake-up for keep-alive PING and reconnect
+
+// Results of WsPollerReadFrame() besides those of WsRecvBufferExtractFrame()
+#define WS_FRAME_CLOSED      -2  // recv() returned 0 - the server closed the connection
+#define WS_FRAME_BUFFER_FULL -3  // The receive buffer cannot grow for the next read
+
+struct WebSocketPoller {
+#ifdef _WIN32
+	HANDLE hStopEvent;      // Manual reset - stays signaled once stop is requested
+	WSAEVENT hReadEvent;    // FD_READ | FD_CLOSE of the selected socket
+#else
+	int nEpollFd;
+	int nStopFd;            // eventfd, never read - stays readable once stop is requested
+#endif
+	SOCKET socket;          // Socket being watched (INVALID_SOCKET = only stop/timeout wake us)
+
+	WebSocketPoller() :
+#ifdef _WIN32
+		hStopEvent(NULL), hReadEvent(WSA_INVALID_EVENT),
+#else
+		nEpollFd(-1), nStopFd(-1),
+#endif
+		socket(INVALID_SOCKET) {
+	}
+};
+
+BOOL WsPollerOpen(WebSocketPoller* pPoller);
+void WsPollerClose(WebSocketPoller* pPoller);
+
+// Watch s (INVALID_SOCKET stops watching). Call again after every reconnect.
+BOOL WsPollerSelect(WebSocketPoller* pPoller, SOCKET s);
+
+void WsPollerSignalStop(WebSocketPoller* pPoller);
+BOOL WsPollerStopRequested(WebSocketPoller* pPoller);
+
+// Returns WS_IO_WAKE_READABLE, WS_IO_WAKE_STOP or WS_IO_WAKE_TIMEOUT. A stop request wins
+// over pending data. Level-triggered: unread data wakes the next call again.
+int WsPollerWait(WebSocketPoller* pPoller, DWORD dwTimeoutMs);
+
+// Does the watched socket have data (or the peer's close) right now? Does not wait,
+// and does not use up the wake-up the next WsPollerWait() reports.
+BOOL WsPollerReadable(WebSocketPoller* pPoller);
+
+// Next frame for the drain loop. Frames already in pBuf come first; recv() from the
+// watched socket only happens when pBuf holds no complete frame and the socket is
+// readable. Returns WS_FRAME_COMPLETE, WS_FRAME_INCOMPLETE (nothing more to read
+// right now), WS_FRAME_ERROR, WS_FRAME_CLOSED or WS_FRAME_BUFFER_FULL.
+// *pnReceived = bytes recv() returned during the call.
+int WsPollerReadFrame(WebSocketPoller* pPoller, WebSocketRecvBuffer* pBuf, WebSocketFrame* pFrame, int* pnReceived);
+
+#endif // WEBSOCKET_POLL_H
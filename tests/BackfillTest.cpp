@@ -0,0 +1,333 @@
+// BackfillTest.cpp - Request pacing on a simulated clock, checkpoint round trip and damage checks
+#include "TestHarness.h"
+#include "Backfill.h"
+
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+///////////////////////////////
+// Token Bucket
+///////////////////////////////
+
+TEST_CASE(Backfill, FirstTokenAtOnce)
+{
+	TokenBucket bucket;
+	InitTokenBucket(&bucket, 5.0, 1000);
+	CHECK_EQ(TakeToken(&bucket, 1000), 0u);
+
+	// The next one is 200 ms away at 5/s
+	DWORD dwWait = TakeToken(&bucket, 1000);
+	CHECK(dwWait > 0);
+	CHECK(dwWait <= 201);
+	CHECK_EQ(TakeToken(&bucket, 1000 + dwWait), 0u);
+	DeleteTokenBucket(&bucket);
+}
+
+// Threads that take a token whenever one is free, and sleep as long as they
+// are told otherwise, never get more than 1 + rate * elapsed
+TEST_CASE(Backfill, RateUnderBurst)
+{
+	static const double s_afRates[] = { 1.0, 5.0, 7.0, 100.0 };
+	for (size_t r = 0; r < sizeof(s_afRates) / sizeof(s_afRates[0]); r++)
+	{
+		double fRate = s_afRates[r];
+		TokenBucket bucket;
+		InitTokenBucket(&bucket, fRate, 0);
+
+		// Four workers on one clock: each wakes at its own next time
+		DWORD adwWake[4] = { 0, 0, 0, 0 };
+		int nGranted = 0;
+		DWORD dwNow = 0;
+		while (dwNow < 60000)
+		{
+			int nNext = 0;
+			for (int w = 1; w < 4; w++)
+			{
+				if (adwWake[w] < adwWake[nNext])
+					nNext = w;
+			}
+			dwNow = adwWake[nNext];
+
+			DWORD dwWait = TakeToken(&bucket, dwNow);
+			if (dwWait == 0)
+			{
+				nGranted++;
+				CHECK(nGranted <= 1 + (int)(fRate * dwNow / 1000.0 + 1e-9));
+			}
+			adwWake[nNext] = dwNow + dwWait;
+		}
+
+		// And the workers kept up: within one token of the rate
+		CHECK(nGranted >= (int)(fRate * dwNow / 1000.0));
+		DeleteTokenBucket(&bucket);
+	}
+}
+
+// After a long idle spell the bucket holds fRate tokens, not everything it missed
+TEST_CASE(Backfill, RefillCap)
+{
+	TokenBucket bucket;
+	InitTokenBucket(&bucket, 5.0, 0);
+	CHECK_EQ(TakeToken(&bucket, 0), 0u);
+
+	DWORD dwNow = 3600 * 1000;
+	int nGranted = 0;
+	while (TakeToken(&bucket, dwNow) == 0)
+		nGranted++;
+	CHECK_EQ(nGranted, 5);
+	DeleteTokenBucket(&bucket);
+}
+
+TEST_CASE(Backfill, TickCountWrap)
+{
+	TokenBucket bucket;
+	InitTokenBucket(&bucket, 10.0, 0xFFFFFF00);
+	CHECK_EQ(TakeToken(&bucket, 0xFFFFFF00), 0u);
+	CHECK(TakeToken(&bucket, 0xFFFFFF00) > 0);
+
+	// 356 ms later, across the wrap: three more tokens, not four billion
+	int nGranted = 0;
+	while (TakeToken(&bucket, 100) == 0)
+		nGranted++;
+	CHECK_EQ(nGranted, 3);
+	DeleteTokenBucket(&bucket);
+}
+
+TEST_CASE(Backfill, ResetStartsWithOneToken)
+{
+	TokenBucket bucket;
+	InitTokenBucket(&bucket, 2.0, 0);
+	CHECK_EQ(TakeToken(&bucket, 5000), 0u);
+	CHECK_EQ(TakeToken(&bucket, 5000), 0u);
+	CHECK(TakeToken(&bucket, 5000) > 0);
+
+	ResetTokenBucket(&bucket, 50.0, 6000);
+	CHECK_EQ(TakeToken(&bucket, 6000), 0u);
+	DWORD dwWait = TakeToken(&bucket, 6000);
+	CHECK(dwWait > 0);
+	CHECK(dwWait <= 21);
+	DeleteTokenBucket(&bucket);
+}
+
+// Many threads on one clock value: exactly the tokens in the bucket go out
+TEST_CASE(Backfill, SharedByThreads)
+{
+	TokenBucket bucket;
+	InitTokenBucket(&bucket, 40.0, 0);
+	CHECK_EQ(TakeToken(&bucket, 0), 0u);
+
+	std::atomic<int> nGranted(0);
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 8; t++)
+	{
+		threads.push_back(std::thread([&bucket, &nGranted]() {
+			for (int i = 0; i < 1000; i++)
+			{
+				if (TakeToken(&bucket, 10000) == 0)
+					nGranted++;
+			}
+		}));
+	}
+	for (size_t t = 0; t < threads.size(); t++)
+		threads[t].join();
+
+	CHECK_EQ(nGranted.load(), 40);
+	DeleteTokenBucket(&bucket);
+}
+
+///////////////////////////////
+// Checkpoint
+///////////////////////////////
+
+struct MemoryCheckpoint {
+	const BYTE* pData;
+	size_t nSize;
+	size_t nPos;
+	DWORD dwMaxRead;         // 0 = as much as asked for, like ReadFile on a local file
+};
+
+static BOOL ReadMemoryCheckpoint(void* pReader, void* pBuffer, DWORD dwBytes, DWORD* pdwRead)
+{
+	MemoryCheckpoint* pCheckpoint = (MemoryCheckpoint*)pReader;
+	size_t nCopy = pCheckpoint->nSize - pCheckpoint->nPos;
+	if (nCopy > dwBytes)
+		nCopy = dwBytes;
+	if (pCheckpoint->dwMaxRead != 0 && nCopy > pCheckpoint->dwMaxRead)
+		nCopy = pCheckpoint->dwMaxRead;
+	memcpy(pBuffer, pCheckpoint->pData + pCheckpoint->nPos, nCopy);
+	pCheckpoint->nPos += nCopy;
+	*pdwRead = (DWORD)nCopy;
+	return TRUE;
+}
+
+// A checkpoint as StartBackfillJob writes it, with some symbols finished
+static std::vector<BYTE> MakeCheckpoint(int nSymbols, int nPeriodicity, int nDays)
+{
+	std::vector<BYTE> bytes(sizeof(BackfillCheckpointHeader) + nSymbols * sizeof(BackfillCheckpointRecord));
+	InitBackfillCheckpointHeader((BackfillCheckpointHeader*)bytes.data(), nPeriodicity, nDays, nSymbols);
+
+	BackfillCheckpointRecord* pRecords = (BackfillCheckpointRecord*)(bytes.data() + sizeof(BackfillCheckpointHeader));
+	static const char* s_apszTickers[] = { "RELIANCE-NSE", "NIFTY28OCT2525000CE-NFO", "CRUDEOIL19NOV25FUT-MCX" };
+	for (int i = 0; i < nSymbols; i++)
+		CHECK(FillBackfillCheckpointRecord(&pRecords[i], s_apszTickers[i % 3]));
+	return bytes;
+}
+
+static BackfillCheckpointRecord* GetRecords(std::vector<BYTE>& bytes)
+{
+	return (BackfillCheckpointRecord*)(bytes.data() + sizeof(BackfillCheckpointHeader));
+}
+
+// Load the first nSize bytes of a file that is nFileSize long
+static BackfillCheckpointRecord* Load(const std::vector<BYTE>& bytes, size_t nSize, UINT64 nFileSize, DWORD dwMaxRead,
+	BackfillCheckpointHeader* pHeader, int* pnDone)
+{
+	MemoryCheckpoint checkpoint = { bytes.data(), nSize, 0, dwMaxRead };
+	return ReadBackfillCheckpoint(ReadMemoryCheckpoint, &checkpoint, nFileSize, pHeader, pnDone);
+}
+
+static BOOL IsRejected(const std::vector<BYTE>& bytes)
+{
+	BackfillCheckpointHeader header;
+	int nDone = -1;
+	BackfillCheckpointRecord* pRecords = Load(bytes, bytes.size(), bytes.size(), 0, &header, &nDone);
+	delete[] pRecords;
+	return pRecords == NULL && nDone == 0;
+}
+
+TEST_CASE(Backfill, CheckpointLayout)
+{
+	CHECK_EQ(sizeof(BackfillCheckpointHeader), 64u);
+	CHECK_EQ(sizeof(BackfillCheckpointRecord), 48u);
+	CHECK_EQ(BackfillStateOffset(0), (INT64)(64 + 47));
+	CHECK_EQ(BackfillStateOffset(3), (INT64)(64 + 3 * 48 + 47));
+
+	BackfillCheckpointRecord record;
+	CHECK(!FillBackfillCheckpointRecord(&record, ""));
+	CHECK(FillBackfillCheckpointRecord(&record, "0123456789012345678901234567890123456789012345"));   // 46
+	CHECK(!FillBackfillCheckpointRecord(&record, "01234567890123456789012345678901234567890123456"));  // 47
+}
+
+TEST_CASE(Backfill, CheckpointRoundTrip)
+{
+	std::vector<BYTE> bytes = MakeCheckpoint(100, 60, 365);
+	for (int i = 0; i < 100; i += 4)
+		GetRecords(bytes)[i].nState = BACKFILL_DONE;
+
+	// Whole reads, and the 7-byte pieces a slow reader might hand back
+	static const DWORD s_adwMaxRead[] = { 0, 7 };
+	for (int r = 0; r < 2; r++)
+	{
+		BackfillCheckpointHeader header;
+		int nDone = 0;
+		BackfillCheckpointRecord* pRecords = Load(bytes, bytes.size(), bytes.size(), s_adwMaxRead[r], &header, &nDone);
+		CHECK(pRecords != NULL);
+		if (pRecords == NULL)
+			continue;
+		CHECK_EQ(header.nPeriodicity, 60);
+		CHECK_EQ(header.nDays, 365);
+		CHECK_EQ(header.nSymbols, 100u);
+		CHECK_EQ(nDone, 25);
+		CHECK(memcmp(pRecords, GetRecords(bytes), 100 * sizeof(BackfillCheckpointRecord)) == 0);
+		delete[] pRecords;
+	}
+}
+
+TEST_CASE(Backfill, FailedResetToPendingOnResume)
+{
+	std::vector<BYTE> bytes = MakeCheckpoint(6, 86400, 3650);
+	BackfillCheckpointRecord* pWritten = GetRecords(bytes);
+	pWritten[0].nState = BACKFILL_DONE;
+	pWritten[1].nState = BACKFILL_FAILED;
+	pWritten[3].nState = BACKFILL_DONE;
+	pWritten[4].nState = BACKFILL_FAILED;
+
+	BackfillCheckpointHeader header;
+	int nDone = 0;
+	BackfillCheckpointRecord* pRecords = Load(bytes, bytes.size(), bytes.size(), 0, &header, &nDone);
+	CHECK(pRecords != NULL);
+	if (pRecords == NULL)
+		return;
+
+	CHECK_EQ(nDone, 2);
+	static const BYTE s_anExpected[] = { BACKFILL_DONE, BACKFILL_PENDING, BACKFILL_PENDING,
+	                                     BACKFILL_DONE, BACKFILL_PENDING, BACKFILL_PENDING };
+	for (int i = 0; i < 6; i++)
+	{
+		CHECK_EQ(pRecords[i].nState, s_anExpected[i]);
+		CHECK(strcmp(pRecords[i].szTicker, pWritten[i].szTicker) == 0);
+	}
+	delete[] pRecords;
+}
+
+TEST_CASE(Backfill, TruncatedCheckpointRejected)
+{
+	std::vector<BYTE> bytes = MakeCheckpoint(10, 60, 30);
+
+	// Cut anywhere: in the header, between records, inside a record. The size
+	// check catches most; the reader running dry catches a size that lies.
+	static const size_t s_anCut[] = { 0, 1, 63, 64, 64 + 47, 64 + 48, bytes.size() - 1 };
+	for (size_t c = 0; c < sizeof(s_anCut) / sizeof(s_anCut[0]); c++)
+	{
+		BackfillCheckpointHeader header;
+		int nDone = -1;
+		BackfillCheckpointRecord* pRecords = Load(bytes, s_anCut[c], s_anCut[c], 0, &header, &nDone);
+		CHECK(pRecords == NULL);
+		CHECK_EQ(nDone, 0);
+		delete[] pRecords;
+
+		pRecords = Load(bytes, s_anCut[c], bytes.size(), 5, &header, &nDone);
+		CHECK(pRecords == NULL);
+		delete[] pRecords;
+	}
+
+	// Extra bytes at the end are damage too
+	std::vector<BYTE> longer = bytes;
+	longer.push_back(0);
+	CHECK(IsRejected(longer));
+}
+
+TEST_CASE(Backfill, DamagedCheckpointRejected)
+{
+	std::vector<BYTE> good = MakeCheckpoint(3, 60, 30);
+	CHECK(!IsRejected(good));
+
+	std::vector<BYTE> bytes = good;
+	((BackfillCheckpointHeader*)bytes.data())->nMagic ^= 1;
+	CHECK(IsRejected(bytes));
+
+	bytes = good;
+	((BackfillCheckpointHeader*)bytes.data())->nVersion = BACKFILL_CHECKPOINT_VERSION + 1;
+	CHECK(IsRejected(bytes));
+
+	bytes = good;
+	((BackfillCheckpointHeader*)bytes.data())->nPeriodicity = 300;
+	CHECK(IsRejected(bytes));
+
+	bytes = good;
+	((BackfillCheckpointHeader*)bytes.data())->nDays = 0;
+	CHECK(IsRejected(bytes));
+
+	// nSymbols that does not match the size of the file
+	bytes = good;
+	((BackfillCheckpointHeader*)bytes.data())->nSymbols = 2;
+	CHECK(IsRejected(bytes));
+	bytes = good;
+	((BackfillCheckpointHeader*)bytes.data())->nSymbols = 0;
+	CHECK(IsRejected(bytes));
+
+	// A ticker that runs into the state byte
+	bytes = good;
+	memset(GetRecords(bytes)[1].szTicker, 'A', BACKFILL_TICKER_SIZE);
+	CHECK(IsRejected(bytes));
+
+	bytes = good;
+	GetRecords(bytes)[2].szTicker[0] = '\0';
+	CHECK(IsRejected(bytes));
+
+	bytes = good;
+	GetRecords(bytes)[2].nState = BACKFILL_FAILED + 1;
+	CHECK(IsRejected(bytes));
+}
@@ -0,0 +1,403 @@
+// BarBuilderTest.cpp - Tick folding, the completed-bar ring, the per-builder lock and the
+// snapshot seqlock under load
+#include "TestHarness.h"
+#include "BarBuilder.h"
+#include "Calendar.h"
+
+#include <atomic>
+#include <deque>
+#include <thread>
+#include <vector>
+
+static const time_t BAR_TEST_START = 1761190200;  // 2025-10-23 09:00:00 IST
+
+static BarBuilder* NewTestBuilder(void)
+{
+	BarBuilder* pBuilder = new BarBuilder();
+	strcpy(pBuilder->exchange, "NSE");
+	return pBuilder;
+}
+
+TEST_CASE(BarBuilder, TicksFoldIntoMinuteBars)
+{
+	InitCalendarConversion(CALENDAR_UTC_OFFSET_IST, "");
+	BarBuilder* pBuilder = NewTestBuilder();
+	BarSnapshot snapshot;
+
+	ReadBarSnapshot(pBuilder, &snapshot);
+	CHECK(!snapshot.bBarStarted);
+	CHECK_EQ(snapshot.tickCount, 0);
+
+	CHECK(!AddTickToBarBuilder(pBuilder, 100.0f, 5.0f, BAR_TEST_START + 1));
+	CHECK(!AddTickToBarBuilder(pBuilder, 103.0f, 1.0f, BAR_TEST_START + 20));
+	CHECK(!AddTickToBarBuilder(pBuilder, 98.5f, 2.0f, BAR_TEST_START + 59));
+	ReadBarSnapshot(pBuilder, &snapshot);
+	CHECK(snapshot.bBarStarted);
+	CHECK_EQ(snapshot.tickCount, 3);
+	CHECK_EQ(snapshot.nBars, 0);
+	CHECK_EQ(snapshot.currentBar.Open, 100.0f);
+	CHECK_EQ(snapshot.currentBar.High, 103.0f);
+	CHECK_EQ(snapshot.currentBar.Low, 98.5f);
+	CHECK_EQ(snapshot.currentBar.Price, 98.5f);
+	CHECK_EQ(snapshot.currentBar.Volume, 8.0f);
+	CHECK_EQ((int)snapshot.currentBar.DateTime.PackDate.Hour, 9);
+	CHECK_EQ((int)snapshot.currentBar.DateTime.PackDate.Minute, 0);
+	CHECK_EQ((int)snapshot.currentBar.DateTime.PackDate.Second, 0);
+
+	// The next minute closes the bar
+	CHECK(AddTickToBarBuilder(pBuilder, 99.0f, 4.0f, BAR_TEST_START + 60));
+	ReadBarSnapshot(pBuilder, &snapshot);
+	CHECK_EQ(snapshot.nBars, 1);
+	CHECK_EQ(snapshot.tickCount, 1);
+	CHECK_EQ(snapshot.currentBar.Volume, 4.0f);
+	CHECK_EQ((int)snapshot.currentBar.DateTime.PackDate.Minute, 1);
+	CHECK_EQ(pBuilder->bars.GetLast().Volume, 8.0f);
+	CHECK_EQ(pBuilder->bars.GetLast().Price, 98.5f);
+
+	delete pBuilder;
+}
+
+// A completed bar told apart by its serial number
+static struct Quotation MakeRingBar(int nSerial)
+{
+	struct Quotation bar;
+	memset(&bar, 0, sizeof(bar));
+	bar.DateTime.Date = (UINT64)nSerial << 6;
+	bar.Price = (float)nSerial;
+	bar.Volume = (float)(nSerial % 1000);
+	return bar;
+}
+
+static bool SameRingBar(const struct Quotation& a, const struct Quotation& b)
+{
+	return memcmp(&a, &b, sizeof(struct Quotation)) == 0;
+}
+
+// Everything a reader can see of the ring against a deque that keeps the newest nCapacity bars
+static void CheckRingAgainstDeque(const BarRing& ring, const std::deque<struct Quotation>& expected, TestRandom* pRandom)
+{
+	int nCount = (int)expected.size();
+	CHECK_EQ(ring.GetCount(), nCount);
+	for (int i = 0; i < nCount; i++)
+		CHECK(SameRingBar(ring.GetAt(i), expected[i]));
+	if (nCount > 0)
+		CHECK(SameRingBar(ring.GetLast(), expected.back()));
+
+	const struct Quotation* pFirst;
+	const struct Quotation* pSecond;
+	int nFirst, nSecond;
+	ring.GetSpans(&pFirst, &nFirst, &pSecond, &nSecond);
+	CHECK_EQ(nFirst + nSecond, nCount);
+	CHECK(nFirst >= 0 && nSecond >= 0);
+	for (int i = 0; i < nCount; i++)
+		CHECK(SameRingBar(i < nFirst ? pFirst[i] : pSecond[i - nFirst], expected[i]));
+
+	// CopyTo() keeps the newest bars and writes nothing past them
+	int anMax[] = { -1, 0, 1, nCount - 1, nCount, nCount + 3, pRandom->Range(0, nCount + 1) };
+	for (size_t m = 0; m < sizeof(anMax) / sizeof(anMax[0]); m++)
+	{
+		int nMax = anMax[m];
+		std::vector<struct Quotation> dest(max(nMax, 0) + 2, MakeRingBar(-1));
+		int nCopied = ring.CopyTo(dest.data(), nMax);
+		CHECK_EQ(nCopied, min(nCount, max(nMax, 0)));
+		for (int i = 0; i < nCopied; i++)
+			CHECK(SameRingBar(dest[i], expected[nCount - nCopied + i]));
+		for (size_t i = nCopied; i < dest.size(); i++)
+			CHECK(SameRingBar(dest[i], MakeRingBar(-1)));
+	}
+}
+
+// Appends past capacity, wrap-around at every position, RemoveAll() in between
+TEST_CASE(BarBuilder, RingMatchesDeque)
+{
+	TestRandom random(12);
+	static const int s_anCapacities[] = { 1, 2, 3, 7, 16, 100 };
+	for (size_t c = 0; c < sizeof(s_anCapacities) / sizeof(s_anCapacities[0]); c++)
+	{
+		int nCapacity = s_anCapacities[c];
+		BarRing ring(nCapacity);
+		const struct Quotation* pStorage = ring.pBars;
+		std::deque<struct Quotation> expected;
+		CheckRingAgainstDeque(ring, expected, &random);
+
+		int nSerial = 0;
+		for (int nStep = 0; nStep < 20 * nCapacity + 50; nStep++)
+		{
+			if (random.Range(0, 4 * nCapacity + 20) == 0)
+			{
+				ring.RemoveAll();
+				expected.clear();
+			}
+			else
+			{
+				int nAdds = random.Range(1, 3);
+				for (int a = 0; a < nAdds; a++)
+				{
+					ring.Add(MakeRingBar(++nSerial));
+					expected.push_back(MakeRingBar(nSerial));
+					if ((int)expected.size() > nCapacity)
+						expected.pop_front();
+				}
+			}
+			CheckRingAgainstDeque(ring, expected, &random);
+		}
+
+		// Appending and evicting never moved or reallocated the storage
+		CHECK(ring.pBars == pStorage);
+		CHECK_EQ(ring.nCapacity, nCapacity);
+	}
+}
+
+// Tick threads feed a handful of builders, each taking the builder's own lock,
+// while reader threads copy snapshots the way GetQuotesEx() does. A snapshot
+// must never mix two ticks, and no tick may be lost or counted twice.
+TEST_CASE(BarBuilder, ConcurrentTicksAndSnapshots)
+{
+	InitCalendarConversion(CALENDAR_UTC_OFFSET_IST, "");
+	const int nBuilders = 8;
+	const int nTickThreads = 4;
+	const int nReaderThreads = 3;
+	const int nTicksEach = 100000;
+	const int nTicksPerBar = 1000;
+
+	std::vector<BarBuilder*> builders;
+	std::vector<int> ticksApplied(nBuilders, 0);  // Guarded by the builder's lock
+	for (int i = 0; i < nBuilders; i++)
+		builders.push_back(NewTestBuilder());
+
+	std::atomic<int> nTickThreadsLeft(nTickThreads);
+	std::atomic<long long> nMixed(0);
+	std::atomic<long long> nBackwards(0);
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < nTickThreads; t++)
+	{
+		threads.push_back(std::thread([&, t]() {
+			TestRandom random(100 + t);
+			for (int i = 0; i < nTicksEach; i++)
+			{
+				int b = random.Range(0, nBuilders - 1);
+				BarBuilder* pBuilder = builders[b];
+				float ltp = (float)random.Range(10000, 20000) / 100.0f;
+
+				EnterCriticalSection(&pBuilder->lock);
+				// One bar per nTicksPerBar ticks of this builder, so bar times only move forward
+				time_t timestamp = BAR_TEST_START + (ticksApplied[b] / nTicksPerBar) * 60 + (ticksApplied[b] % 60);
+				AddTickToBarBuilder(pBuilder, ltp, 1.0f, timestamp);
+				ticksApplied[b]++;
+				LeaveCriticalSection(&pBuilder->lock);
+			}
+			nTickThreadsLeft--;
+		}));
+	}
+	for (int r = 0; r < nReaderThreads; r++)
+	{
+		threads.push_back(std::thread([&, r]() {
+			TestRandom random(200 + r);
+			std::vector<long long> lastTicks(nBuilders, 0);
+			bool bLast = false;
+			while (!bLast)
+			{
+				bLast = (nTickThreadsLeft.load() == 0);
+				for (int b = 0; b < nBuilders; b++)
+				{
+					BarSnapshot snapshot;
+					ReadBarSnapshot(builders[b], &snapshot);
+					if (!snapshot.bBarStarted)
+						continue;
+
+					// Every tick has quantity 1: volume and tick count move together
+					const struct Quotation& bar = snapshot.currentBar;
+					if (bar.Volume != (float)snapshot.tickCount || bar.Low > bar.Price || bar.Price > bar.High ||
+						bar.Low > bar.Open || bar.Open > bar.High || (int)bar.DateTime.PackDate.Minute != snapshot.nBars % 60)
+					{
+						nMixed++;
+					}
+
+					long long nTicks = (long long)snapshot.nBars * nTicksPerBar + snapshot.tickCount;
+					if (nTicks < lastTicks[b])
+						nBackwards++;
+					lastTicks[b] = nTicks;
+				}
+			}
+		}));
+	}
+	for (size_t i = 0; i < threads.size(); i++)
+		threads[i].join();
+
+	CHECK_EQ(nMixed.load(), 0);
+	CHECK_EQ(nBackwards.load(), 0);
+
+	long long nTotal = 0;
+	for (int b = 0; b < nBuilders; b++)
+	{
+		BarBuilder* pBuilder = builders[b];
+		double fVolume = pBuilder->currentBar.Volume;
+		for (int i = 0; i < pBuilder->bars.GetCount(); i++)
+		{
+			CHECK_EQ(pBuilder->bars.GetAt(i).Volume, (float)nTicksPerBar);
+			fVolume += pBuilder->bars.GetAt(i).Volume;
+		}
+		CHECK_EQ((long long)fVolume, (long long)ticksApplied[b]);
+		CHECK_EQ(pBuilder->bars.GetCount(), (ticksApplied[b] - 1) / nTicksPerBar);
+
+		BarSnapshot snapshot;
+		ReadBarSnapshot(pBuilder, &snapshot);
+		CHECK_EQ(snapshot.nBars, pBuilder->bars.GetCount());
+		CHECK_EQ(snapshot.tickCount, pBuilder->tickCount);
+
+		nTotal += ticksApplied[b];
+		delete pBuilder;
+	}
+	CHECK_EQ(nTotal, (long long)nTickThreads * nTicksEach);
+}
+
+// Threads each ticking their own builder: with one lock per builder they do not
+// contend; the shared lock is what every tick used to take before
+static uint64_t TickFromThreads(int nThreads, int nTicksEach, bool bSharedLock)
+{
+	std::vector<BarBuilder*> builders;
+	for (int i = 0; i < nThreads; i++)
+		builders.push_back(NewTestBuilder());
+	CRITICAL_SECTION sharedLock;
+	InitializeCriticalSection(&sharedLock);
+
+	uint64_t nStart = TestNowNs();
+	std::vector<std::thread> threads;
+	for (int t = 0; t < nThreads; t++)
+	{
+		threads.push_back(std::thread([&, t]() {
+			BarBuilder* pBuilder = builders[t];
+			CRITICAL_SECTION* pLock = bSharedLock ? &sharedLock : &pBuilder->lock;
+			for (int i = 0; i < nTicksEach; i++)
+			{
+				EnterCriticalSection(pLock);
+				AddTickToBarBuilder(pBuilder, 100.0f + (i & 63), 1.0f, BAR_TEST_START + i / 50);
+				LeaveCriticalSection(pLock);
+			}
+		}));
+	}
+	for (size_t i = 0; i < threads.size(); i++)
+		threads[i].join();
+	uint64_t nElapsed = TestNowNs() - nStart;
+
+	DeleteCriticalSection(&sharedLock);
+	for (int i = 0; i < nThreads; i++)
+		delete builders[i];
+	return nElapsed;
+}
+
+BENCHMARK(BarBuilder, TicksAndSnapshots)
+{
+	InitCalendarConversion(CALENDAR_UTC_OFFSET_IST, "");
+	const int nOps = 5000000;
+	BarBuilder* pBuilder = NewTestBuilder();
+
+	uint64_t nStart = TestNowNs();
+	for (int i = 0; i < nOps; i++)
+	{
+		EnterCriticalSection(&pBuilder->lock);
+		AddTickToBarBuilder(pBuilder, 100.0f + (i & 63), 1.0f, BAR_TEST_START + i / 50);
+		LeaveCriticalSection(&pBuilder->lock);
+	}
+	BENCH_REPORT("Lock + AddTickToBarBuilder + Unlock", nOps, TestNowNs() - nStart);
+
+	volatile float fSink = 0;
+	BarSnapshot snapshot;
+	nStart = TestNowNs();
+	for (int i = 0; i < nOps; i++)
+	{
+		ReadBarSnapshot(pBuilder, &snapshot);
+		fSink = fSink + snapshot.currentBar.Price;
+	}
+	BENCH_REPORT("ReadBarSnapshot (no writer)", nOps, TestNowNs() - nStart);
+
+	// A chart reading while the I/O thread ticks the same symbol as fast as it can
+	std::atomic<bool> bStop(false);
+	std::thread writer([&]() {
+		for (int i = 0; !bStop.load(std::memory_order_relaxed); i++)
+		{
+			EnterCriticalSection(&pBuilder->lock);
+			AddTickToBarBuilder(pBuilder, 100.0f + (i & 63), 1.0f, BAR_TEST_START + i / 50);
+			LeaveCriticalSection(&pBuilder->lock);
+		}
+	});
+	nStart = TestNowNs();
+	for (int i = 0; i < nOps; i++)
+	{
+		ReadBarSnapshot(pBuilder, &snapshot);
+		fSink = fSink + snapshot.currentBar.Price;
+	}
+	BENCH_REPORT("ReadBarSnapshot (writer ticking)", nOps, TestNowNs() - nStart);
+	bStop = true;
+	writer.join();
+	delete pBuilder;
+
+	const int nThreads = 4;
+	const int nTicksEach = 1000000;
+	BENCH_REPORT("4 threads, lock per builder (per tick)", (long long)nThreads * nTicksEach,
+		TickFromThreads(nThreads, nTicksEach, false));
+	BENCH_REPORT("4 threads, one shared lock (per tick)", (long long)nThreads * nTicksEach,
+		TickFromThreads(nThreads, nTicksEach, true));
+}
+
+// Worst single append over nAppends, each timed on its own
+template <typename AppendProc>
+static uint64_t WorstAppendNs(int nAppends, AppendProc append)
+{
+	uint64_t nWorst = 0;
+	for (int i = 0; i < nAppends; i++)
+	{
+		uint64_t nStart = TestNowNs();
+		append(i);
+		nWorst = max(nWorst, TestNowNs() - nStart);
+	}
+	return nWorst;
+}
+
+// Appending to a full ring of BAR_BUILDER_MAX_BARS, against the array it replaced,
+// which shifted the oldest tenth out (RemoveAt(0, maxBars / 10)) whenever it filled up
+BENCHMARK(BarBuilder, RingAppendAtCapacity)
+{
+	const int nCapacity = BAR_BUILDER_MAX_BARS;
+	const int nAppends = 2000000;
+	struct Quotation bar = MakeRingBar(0);
+
+	BarRing ring(nCapacity);
+	for (int i = 0; i < nCapacity; i++)
+		ring.Add(MakeRingBar(i));
+	auto appendRing = [&](int i) {
+		bar.Price = (float)i;
+		ring.Add(bar);
+	};
+
+	std::vector<struct Quotation> array;
+	array.reserve(nCapacity + 1);
+	for (int i = 0; i < nCapacity; i++)
+		array.push_back(MakeRingBar(i));
+	auto appendArray = [&](int i) {
+		bar.Price = (float)i;
+		array.push_back(bar);
+		if ((int)array.size() > nCapacity)
+			array.erase(array.begin(), array.begin() + nCapacity / 10);
+	};
+
+	uint64_t nStart = TestNowNs();
+	for (int i = 0; i < nAppends; i++)
+		appendRing(i);
+	BENCH_REPORT("BarRing::Add at capacity", nAppends, TestNowNs() - nStart);
+	printf("  %-40s %12.1f us worst append\n", "", WorstAppendNs(nCapacity, appendRing) / 1000.0);
+
+	nStart = TestNowNs();
+	for (int i = 0; i < nAppends; i++)
+		appendArray(i);
+	BENCH_REPORT("array append + shift out a tenth when full", nAppends, TestNowNs() - nStart);
+	printf("  %-40s %12.1f us worst append\n", "", WorstAppendNs(nCapacity, appendArray) / 1000.0);
+
+	std::vector<struct Quotation> dest(nCapacity);
+	const int nCopies = 2000;
+	nStart = TestNowNs();
+	for (int i = 0; i < nCopies; i++)
+		ring.CopyTo(dest.data(), nCapacity);
+	BENCH_REPORT("BarRing::CopyTo, full ring (per bar)", (long long)nCopies * nCapacity, TestNowNs() - nStart);
+}
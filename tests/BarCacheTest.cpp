@@ -0,0 +1,337 @@
+// BarCacheTest.cpp - Bar cache files: round trip, growth, prepending, damaged headers, exchange dates
+#include "TestHarness.h"
+#include "BarCache.h"
+#include "Calendar.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+
+// A fresh file path in a directory of its own (removed with the test's files)
+struct TempCacheFile {
+	char szDir[64];
+	std::string path;
+
+	TempCacheFile() {
+		strcpy(szDir, "/tmp/openalgo-barcache-XXXXXX");
+		CHECK(mkdtemp(szDir) != NULL);
+		path = std::string(szDir) + "/TEST-NSE_60.bars";
+	}
+
+	~TempCacheFile() {
+		unlink(path.c_str());
+		rmdir(szDir);
+	}
+};
+
+static UINT32 DayKey(int nYear, int nMonth, int nDay)
+{
+	union AmiDate date;
+	date.Date = 0;
+	date.PackDate.Year = nYear;
+	date.PackDate.Month = nMonth;
+	date.PackDate.Day = nDay;
+	return BAR_CACHE_DAY_KEY(date.Date);
+}
+
+// One-minute bar nMinute (0..374) of a 09:15-15:29 session nDay days after 2025-01-01;
+// every price is derived from (nDay, nMinute) so a moved column is detectable
+static struct Quotation MakeMinuteBar(int nDay, int nMinute)
+{
+	int nYear, nMonth, nDayOfMonth;
+	CivilFromDays(DaysFromCivil(2025, 1, 1) + nDay, &nYear, &nMonth, &nDayOfMonth);
+
+	struct Quotation bar;
+	memset(&bar, 0, sizeof(bar));
+	bar.DateTime.PackDate.Year = nYear;
+	bar.DateTime.PackDate.Month = nMonth;
+	bar.DateTime.PackDate.Day = nDayOfMonth;
+	bar.DateTime.PackDate.Hour = (9 * 60 + 15 + nMinute) / 60;
+	bar.DateTime.PackDate.Minute = (9 * 60 + 15 + nMinute) % 60;
+	float fBase = 1000.0f + nDay + nMinute * 0.01f;
+	bar.Open = fBase;
+	bar.High = fBase + 1.0f;
+	bar.Low = fBase - 1.0f;
+	bar.Price = fBase + 0.5f;
+	bar.Volume = (float)(nDay * 1000 + nMinute);
+	bar.OpenInterest = (float)nDay;
+	return bar;
+}
+
+static struct Quotation MakeDailyBar(int nDay)
+{
+	struct Quotation bar = MakeMinuteBar(nDay, 0);
+	bar.DateTime.PackDate.Hour = DATE_EOD_HOURS;
+	bar.DateTime.PackDate.Minute = DATE_EOD_MINUTES;
+	return bar;
+}
+
+// nMinutes bars on each of days nFirstDay..nLastDay
+static std::vector<struct Quotation> MakeMinuteDays(int nFirstDay, int nLastDay, int nMinutes)
+{
+	std::vector<struct Quotation> bars;
+	for (int nDay = nFirstDay; nDay <= nLastDay; nDay++)
+	{
+		for (int nMinute = 0; nMinute < nMinutes; nMinute++)
+			bars.push_back(MakeMinuteBar(nDay, nMinute));
+	}
+	return bars;
+}
+
+static UINT32 DayKeyOf(int nDay)
+{
+	return BAR_CACHE_DAY_KEY(MakeMinuteBar(nDay, 0).DateTime.Date);
+}
+
+// What ReadBarCache() hands back are exactly the stored fields of the expected bars
+static bool SameBars(const std::vector<struct Quotation>& expected, const std::vector<struct Quotation>& actual)
+{
+	if (expected.size() != actual.size())
+		return false;
+	for (size_t i = 0; i < expected.size(); i++)
+	{
+		const struct Quotation& a = expected[i];
+		const struct Quotation& b = actual[i];
+		if (a.DateTime.Date != b.DateTime.Date || a.Open != b.Open || a.High != b.High || a.Low != b.Low ||
+			a.Price != b.Price || a.Volume != b.Volume || a.OpenInterest != b.OpenInterest ||
+			b.AuxData1 != 0 || b.AuxData2 != 0)
+			return false;
+	}
+	return true;
+}
+
+static std::vector<struct Quotation> ReadAll(const std::string& path, int nPeriodicity, int nRoom)
+{
+	std::vector<struct Quotation> bars(nRoom > 0 ? nRoom : 1);
+	int nRead = ReadBarCache(path.c_str(), nPeriodicity, nRoom, bars.data());
+	bars.resize(nRead);
+	return bars;
+}
+
+static BarCacheHeader ReadHeader(const std::string& path)
+{
+	BarCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	FILE* pFile = fopen(path.c_str(), "rb");
+	CHECK(pFile != NULL);
+	if (pFile != NULL)
+	{
+		CHECK_EQ(fread(&header, sizeof(header), 1, pFile), 1u);
+		fclose(pFile);
+	}
+	return header;
+}
+
+static void PatchFile(const std::string& path, long nOffset, const void* pBytes, size_t nBytes)
+{
+	FILE* pFile = fopen(path.c_str(), "r+b");
+	CHECK(pFile != NULL);
+	if (pFile != NULL)
+	{
+		fseek(pFile, nOffset, SEEK_SET);
+		CHECK_EQ(fwrite(pBytes, 1, nBytes, pFile), nBytes);
+		fclose(pFile);
+	}
+}
+
+static UINT64 FileSize(const std::string& path)
+{
+	struct stat st;
+	return (stat(path.c_str(), &st) == 0) ? (UINT64)st.st_size : 0;
+}
+
+TEST_CASE(BarCache, HeaderLayout)
+{
+	CHECK_EQ(sizeof(BarCacheHeader), (size_t)BAR_CACHE_HEADER_SIZE);
+	CHECK_EQ(BarCacheFileSize(BAR_CACHE_MIN_CAPACITY), (UINT64)(64 + 4096 * 32));
+	CHECK(DayKey(2025, 1, 31) < DayKey(2025, 2, 1));
+	CHECK(DayKey(2024, 12, 31) < DayKey(2025, 1, 1));
+}
+
+// Completed intraday days go in and come back out unchanged; today's bars and
+// EOD bars in the same array are left out
+TEST_CASE(BarCache, RoundTrip)
+{
+	TempCacheFile file;
+	CHECK_EQ(ReadAll(file.path, 60, 100).size(), 0u);  // No file yet
+
+	std::vector<struct Quotation> completed = MakeMinuteDays(0, 2, 375);
+	std::vector<struct Quotation> input = completed;
+	input.insert(input.begin(), MakeDailyBar(-1));
+	std::vector<struct Quotation> today = MakeMinuteDays(3, 3, 20);
+	input.insert(input.end(), today.begin(), today.end());
+
+	CHECK_EQ(WriteBarCache(file.path.c_str(), 60, DayKeyOf(3), (int)input.size(), input.data()), (int)completed.size());
+	CHECK(SameBars(completed, ReadAll(file.path, 60, 10000)));
+
+	BarCacheHeader header = ReadHeader(file.path);
+	CHECK_EQ(header.nMagic, (UINT32)BAR_CACHE_MAGIC);
+	CHECK_EQ(header.nCount, (UINT32)completed.size());
+	CHECK_EQ(header.nCapacity, (UINT32)BAR_CACHE_MIN_CAPACITY);
+	CHECK_EQ(header.nFirstDate, completed.front().DateTime.Date);
+	CHECK_EQ(header.nLastDate, completed.back().DateTime.Date);
+	CHECK_EQ(FileSize(file.path), BarCacheFileSize(BAR_CACHE_MIN_CAPACITY));
+
+	// Only the newest bars when they don't all fit
+	std::vector<struct Quotation> newest(completed.end() - 100, completed.end());
+	CHECK(SameBars(newest, ReadAll(file.path, 60, 100)));
+
+	// Storing the same response again writes nothing; the next day is appended
+	CHECK_EQ(WriteBarCache(file.path.c_str(), 60, DayKeyOf(3), (int)input.size(), input.data()), 0);
+	CHECK_EQ(WriteBarCache(file.path.c_str(), 60, DayKeyOf(4), (int)input.size(), input.data()), (int)today.size());
+	completed.insert(completed.end(), today.begin(), today.end());
+	CHECK(SameBars(completed, ReadAll(file.path, 60, 10000)));
+
+	// The daily file of the same symbol keeps only the EOD bar
+	std::string dailyPath = file.path + ".daily";
+	CHECK_EQ(WriteBarCache(dailyPath.c_str(), 86400, DayKeyOf(3), (int)input.size(), input.data()), 1);
+	std::vector<struct Quotation> daily(1, MakeDailyBar(-1));
+	CHECK(SameBars(daily, ReadAll(dailyPath, 86400, 10)));
+	CHECK_EQ(ReadAll(dailyPath, 60, 10).size(), 0u);  // Another periodicity's file
+	unlink(dailyPath.c_str());
+}
+
+// Past BAR_CACHE_MIN_CAPACITY the file is remapped at twice the size and the
+// float columns move out to their new offsets, more than once
+TEST_CASE(BarCache, GrowsPastMinCapacity)
+{
+	TempCacheFile file;
+	std::vector<struct Quotation> expected;
+
+	for (int nFirstDay = 0; nFirstDay < 40; nFirstDay += 10)
+	{
+		std::vector<struct Quotation> days = MakeMinuteDays(nFirstDay, nFirstDay + 9, 375);
+		CHECK_EQ(WriteBarCache(file.path.c_str(), 60, DayKeyOf(100), (int)days.size(), days.data()), (int)days.size());
+		expected.insert(expected.end(), days.begin(), days.end());
+		CHECK(SameBars(expected, ReadAll(file.path, 60, 100000)));
+
+		BarCacheHeader header = ReadHeader(file.path);
+		CHECK_EQ(header.nCount, (UINT32)expected.size());
+		CHECK(header.nCapacity >= expected.size());
+		CHECK_EQ(FileSize(file.path), BarCacheFileSize(header.nCapacity));
+	}
+	CHECK_EQ(ReadHeader(file.path).nCapacity, (UINT32)(4 * BAR_CACHE_MIN_CAPACITY));  // 15,000 rows
+
+	// One response bigger than twice the capacity grows straight to what it needs
+	TempCacheFile big;
+	std::vector<struct Quotation> days = MakeMinuteDays(0, 59, 375);
+	std::vector<struct Quotation> first(days.begin(), days.begin() + 375);
+	CHECK_EQ(WriteBarCache(big.path.c_str(), 60, DayKeyOf(100), (int)first.size(), first.data()), 375);
+	CHECK_EQ(WriteBarCache(big.path.c_str(), 60, DayKeyOf(100), (int)days.size(), days.data()), (int)days.size() - 375);
+	CHECK_EQ(ReadHeader(big.path).nCapacity, (UINT32)days.size());
+	CHECK(SameBars(days, ReadAll(big.path, 60, 100000)));
+}
+
+// A backfill of older days is prepended in front of what is cached; the span
+// already cached is skipped, and newer days in the same response are appended
+TEST_CASE(BarCache, PrependsOlderDays)
+{
+	TempCacheFile file;
+	std::vector<struct Quotation> middle = MakeMinuteDays(10, 12, 375);
+	CHECK_EQ(WriteBarCache(file.path.c_str(), 60, DayKeyOf(30), (int)middle.size(), middle.data()), (int)middle.size());
+
+	std::vector<struct Quotation> backfill = MakeMinuteDays(2, 15, 375);
+	CHECK_EQ(WriteBarCache(file.path.c_str(), 60, DayKeyOf(30), (int)backfill.size(), backfill.data()),
+		(int)(backfill.size() - middle.size()));
+	CHECK(SameBars(backfill, ReadAll(file.path, 60, 100000)));
+
+	BarCacheHeader header = ReadHeader(file.path);
+	CHECK_EQ(header.nFirstDate, backfill.front().DateTime.Date);
+	CHECK_EQ(header.nLastDate, backfill.back().DateTime.Date);
+
+	// Prepending that also has to grow the file
+	std::vector<struct Quotation> deep = MakeMinuteDays(-20, 15, 375);
+	CHECK_EQ(WriteBarCache(file.path.c_str(), 60, DayKeyOf(30), (int)deep.size(), deep.data()),
+		(int)(deep.size() - backfill.size()));
+	CHECK(SameBars(deep, ReadAll(file.path, 60, 100000)));
+	CHECK(ReadHeader(file.path).nCapacity >= deep.size());
+}
+
+// A file with another magic, version or periodicity, or shorter than its header
+// says, is not read, and the next store starts it over
+TEST_CASE(BarCache, RejectsDamagedHeader)
+{
+	std::vector<struct Quotation> days = MakeMinuteDays(0, 1, 375);
+	std::vector<struct Quotation> next = MakeMinuteDays(0, 2, 375);
+	std::vector<struct Quotation> lastDay(next.end() - 375, next.end());
+
+	for (int nCase = 0; nCase < 6; nCase++)
+	{
+		TempCacheFile file;
+		CHECK_EQ(WriteBarCache(file.path.c_str(), 60, DayKeyOf(10), (int)days.size(), days.data()), (int)days.size());
+		CHECK_EQ(ReadAll(file.path, 60, 10000).size(), days.size());
+
+		UINT32 nValue;
+		switch (nCase)
+		{
+		case 0:
+			nValue = BAR_CACHE_MAGIC + 1;
+			PatchFile(file.path, offsetof(BarCacheHeader, nMagic), &nValue, sizeof(nValue));
+			break;
+		case 1:
+			nValue = BAR_CACHE_VERSION + 1;
+			PatchFile(file.path, offsetof(BarCacheHeader, nVersion), &nValue, sizeof(nValue));
+			break;
+		case 2:
+			nValue = 86400;
+			PatchFile(file.path, offsetof(BarCacheHeader, nPeriodicity), &nValue, sizeof(nValue));
+			break;
+		case 3:
+			nValue = BAR_CACHE_MIN_CAPACITY + 1;  // Count beyond capacity
+			PatchFile(file.path, offsetof(BarCacheHeader, nCount), &nValue, sizeof(nValue));
+			break;
+		case 4:
+			CHECK_EQ(truncate(file.path.c_str(), (off_t)BarCacheFileSize(BAR_CACHE_MIN_CAPACITY) - 1), 0);
+			break;
+		case 5:
+			CHECK_EQ(truncate(file.path.c_str(), BAR_CACHE_HEADER_SIZE - 1), 0);
+			break;
+		}
+
+		CHECK_EQ(ReadAll(file.path, 60, 10000).size(), 0u);
+
+		// Every bar of the response goes into the new file, not just the ones after the old last bar
+		CHECK_EQ(WriteBarCache(file.path.c_str(), 60, DayKeyOf(10), (int)next.size(), next.data()), (int)next.size());
+		CHECK(SameBars(next, ReadAll(file.path, 60, 10000)));
+	}
+}
+
+// "Today" is the exchange's date, not this machine's: at 20:00 UTC it is already
+// tomorrow in India and still today in New York
+TEST_CASE(BarCache, TodayIsTheExchangeDate)
+{
+	const int nIst = CALENDAR_UTC_OFFSET_IST * 60;
+	INT64 nEvening = DaysFromCivil(2025, 3, 9) * 86400 + 20 * 3600;
+	CHECK_EQ(GetBarCacheTodayKey(nEvening, nIst), DayKey(2025, 3, 10));
+	CHECK_EQ(GetBarCacheTodayKey(nEvening, 0), DayKey(2025, 3, 9));
+	CHECK_EQ(GetBarCacheTodayKey(nEvening, -5 * 3600), DayKey(2025, 3, 9));
+	CHECK_EQ(GetBarCacheTodayKey(nEvening - 5400 - 1, nIst), DayKey(2025, 3, 9));  // 23:59:59 IST
+	CHECK_EQ(GetBarCacheTodayKey(nEvening - 5400, nIst), DayKey(2025, 3, 10));
+
+	// 08:30 IST on the 10th is still the 9th in UTC: the session bars of the 10th stay out
+	TempCacheFile file;
+	INT64 nMorning = DaysFromCivil(2025, 3, 10) * 86400 + 3 * 3600;
+	int nTenth = (int)(DaysFromCivil(2025, 3, 10) - DaysFromCivil(2025, 1, 1));
+	std::vector<struct Quotation> bars = MakeMinuteDays(nTenth - 1, nTenth, 375);
+	CHECK_EQ(WriteBarCache(file.path.c_str(), 60, GetBarCacheTodayKey(nMorning, nIst), (int)bars.size(), bars.data()), 375);
+	CHECK_EQ(ReadHeader(file.path).nLastDate, bars[374].DateTime.Date);
+}
+
+// LoadBarCache() on a year of 1-minute bars, as on every chart open
+BENCHMARK(BarCache, ReadYear)
+{
+	const int nRuns = 50;
+	TempCacheFile file;
+	std::vector<struct Quotation> year = MakeMinuteDays(0, 249, 375);
+	CHECK_EQ(WriteBarCache(file.path.c_str(), 60, DayKeyOf(400), (int)year.size(), year.data()), (int)year.size());
+
+	std::vector<struct Quotation> bars(year.size());
+	uint64_t nStart = TestNowNs();
+	for (int i = 0; i < nRuns; i++)
+		CHECK_EQ(ReadBarCache(file.path.c_str(), 60, (int)bars.size(), bars.data()), (int)year.size());
+	BENCH_REPORT("ReadBarCache (93,750 bars), per bar", (uint64_t)nRuns * year.size(), TestNowNs() - nStart);
+}
@@ -0,0 +1,182 @@
+// CalendarTest.cpp - AmiBroker date conversion against gmtime(), exchange offsets
+#include "TestHarness.h"
+#include "Calendar.h"
+
+#include <string.h>
+#include <time.h>
+
+static const time_t CALENDAR_TEST_START = 631152000;   // 1990-01-01 00:00:00 UTC
+static const time_t CALENDAR_TEST_END = 2208988800LL;  // 2040-01-01 00:00:00 UTC
+
+// What the plugin used to get from localtime() in a zone with this fixed offset
+static bool MatchesLibc(const union AmiDate* pDate, time_t t, int nUtcOffsetSeconds)
+{
+	time_t local = t + nUtcOffsetSeconds;
+	struct tm tmLocal;
+	gmtime_r(&local, &tmLocal);
+	const struct PackedDate& d = pDate->PackDate;
+	bool bMatch = (int)d.Year == tmLocal.tm_year + 1900 && (int)d.Month == tmLocal.tm_mon + 1 &&
+		(int)d.Day == tmLocal.tm_mday && (int)d.Hour == tmLocal.tm_hour &&
+		(int)d.Minute == tmLocal.tm_min && (int)d.Second == tmLocal.tm_sec &&
+		d.MilliSec == 0 && d.MicroSec == 0 && d.Reserved == 0 && d.IsFuturePad == 0;
+	if (!bMatch)
+	{
+		printf("  t=%lld offset=%d: %04u-%02u-%02u %02u:%02u:%02u, gmtime %04d-%02d-%02d %02d:%02d:%02d\n",
+			(long long)t, nUtcOffsetSeconds, d.Year, d.Month, d.Day, d.Hour, d.Minute, d.Second,
+			tmLocal.tm_year + 1900, tmLocal.tm_mon + 1, tmLocal.tm_mday,
+			tmLocal.tm_hour, tmLocal.tm_min, tmLocal.tm_sec);
+	}
+	return bMatch;
+}
+
+// Every minute of 50 years in IST, converted in order like a history download
+TEST_CASE(Calendar, EveryMinuteFiftyYearsIst)
+{
+	const int nOffset = CALENDAR_UTC_OFFSET_IST * 60;
+	PackedDateCache cache;
+	long long nMismatches = 0;
+	for (time_t t = CALENDAR_TEST_START; t < CALENDAR_TEST_END; t += 60)
+	{
+		union AmiDate date;
+		ConvertUnixToPackedDateCached(t, nOffset, &date, &cache);
+		if (!MatchesLibc(&date, t, nOffset) && ++nMismatches > 10)
+			break;
+	}
+	CHECK_EQ(nMismatches, 0);
+}
+
+// Other offsets (including negative and 45-minute ones), seconds not on a minute boundary
+TEST_CASE(Calendar, OtherOffsetsAndSeconds)
+{
+	static const int s_anOffsetMinutes[] = { 0, -300, -240, 60, 345, 525, 570, 840, -720, -210 };
+	for (size_t i = 0; i < sizeof(s_anOffsetMinutes) / sizeof(s_anOffsetMinutes[0]); i++)
+	{
+		int nOffset = s_anOffsetMinutes[i] * 60;
+		PackedDateCache cache;
+		for (time_t t = CALENDAR_TEST_START; t < CALENDAR_TEST_END; t += 3600 + 17)
+		{
+			union AmiDate date;
+			ConvertUnixToPackedDateCached(t, nOffset, &date, &cache);
+			CHECK(MatchesLibc(&date, t, nOffset));
+		}
+	}
+
+	// Random order, so the cached day is almost always stale; before 1970 too
+	TestRandom random(25);
+	PackedDateCache cache;
+	for (int i = 0; i < 1000000; i++)
+	{
+		time_t t = (time_t)(((INT64)random.Next() << 2) - 2000000000LL);
+		int nOffset = random.Range(-CALENDAR_UTC_OFFSET_MAX, CALENDAR_UTC_OFFSET_MAX) * 60;
+		union AmiDate cached, uncached;
+		ConvertUnixToPackedDateCached(t, nOffset, &cached, &cache);
+		ConvertUnixToPackedDate(t, nOffset, &uncached);
+		CHECK_EQ(cached.Date, uncached.Date);
+		CHECK(MatchesLibc(&cached, t, nOffset));
+	}
+}
+
+TEST_CASE(Calendar, DayNumbersRoundTrip)
+{
+	for (INT64 nDay = -800000; nDay <= 800000; nDay++)
+	{
+		int nYear, nMonth, nDayOfMonth;
+		CivilFromDays(nDay, &nYear, &nMonth, &nDayOfMonth);
+		if (DaysFromCivil(nYear, nMonth, nDayOfMonth) != nDay)
+		{
+			CHECK_EQ(DaysFromCivil(nYear, nMonth, nDayOfMonth), nDay);
+			break;
+		}
+	}
+	CHECK_EQ(DaysFromCivil(1970, 1, 1), 0);
+	CHECK_EQ(DaysFromCivil(2000, 3, 1), 11017);
+	CHECK_EQ(DaysFromCivil(2024, 2, 29), 19782);
+	CHECK_EQ(DaysFromCivil(1969, 12, 31), -1);
+}
+
+TEST_CASE(Calendar, ExchangeOffsets)
+{
+	InitCalendarConversion(CALENDAR_UTC_OFFSET_IST, "");
+	CHECK_EQ(GetExchangeUtcOffsetSeconds("NSE"), 19800);
+	CHECK_EQ(GetExchangeUtcOffsetSeconds("MCX"), 19800);
+	CHECK_EQ(GetExchangeUtcOffsetSeconds("bse"), 19800);
+	CHECK_EQ(GetExchangeUtcOffsetSeconds("NSE_INDEX"), 19800);
+	CHECK_EQ(GetExchangeUtcOffsetSeconds("NYSE"), 19800);  // Unknown: the default
+	CHECK_EQ(GetExchangeUtcOffsetSeconds(NULL), 19800);
+
+	// Overrides and new exchanges; the default only moves unknown exchanges
+	InitCalendarConversion(0, "MCX=-300, nyse=-240;LSE=+60,BAD,X=,Y=abc,Z=99999,TOOLONGEXCHANGENAME=5");
+	CHECK_EQ(GetExchangeUtcOffsetSeconds("MCX"), -300 * 60);
+	CHECK_EQ(GetExchangeUtcOffsetSeconds("NSE"), 19800);
+	CHECK_EQ(GetExchangeUtcOffsetSeconds("NYSE"), -240 * 60);
+	CHECK_EQ(GetExchangeUtcOffsetSeconds("Lse"), 3600);
+	CHECK_EQ(GetExchangeUtcOffsetSeconds("CME"), 0);
+	CHECK_EQ(GetExchangeUtcOffsetSeconds("BAD"), 0);
+	CHECK_EQ(GetExchangeUtcOffsetSeconds("Z"), 0);
+	CHECK_EQ(GetExchangeUtcOffsetSeconds("NS"), 0);    // No prefix matches
+	CHECK_EQ(GetExchangeUtcOffsetSeconds("NSEX"), 0);
+
+	// Reload without overrides: built-ins back to IST, added ones to the default
+	InitCalendarConversion(9999, NULL);  // Out of range: IST
+	CHECK_EQ(GetExchangeUtcOffsetSeconds("MCX"), 19800);
+	CHECK_EQ(GetExchangeUtcOffsetSeconds("NYSE"), 19800);
+	CHECK_EQ(GetExchangeUtcOffsetSeconds("CME"), 19800);
+	InitCalendarConversion(CALENDAR_UTC_OFFSET_IST, "");
+}
+
+// One year of 1-minute candles (375 per session day), as a history download converts them
+BENCHMARK(Calendar, HistoryCandles)
+{
+	const int nOffset = CALENDAR_UTC_OFFSET_IST * 60;
+	const time_t nStart = 1735702200;  // 2025-01-01 09:15 IST
+	const int nDays = 365;
+	long long nCandles = (long long)nDays * 375;
+	volatile DATE_TIME_INT nSink = 0;
+
+	uint64_t nBegin = TestNowNs();
+	PackedDateCache cache;
+	for (int d = 0; d < nDays; d++)
+	{
+		for (int m = 0; m < 375; m++)
+		{
+			union AmiDate date;
+			ConvertUnixToPackedDateCached(nStart + d * 86400 + m * 60, nOffset, &date, &cache);
+			nSink = nSink + date.Date;
+		}
+	}
+	BENCH_REPORT("ConvertUnixToPackedDateCached", nCandles, TestNowNs() - nBegin);
+
+	nBegin = TestNowNs();
+	for (int d = 0; d < nDays; d++)
+	{
+		for (int m = 0; m < 375; m++)
+		{
+			union AmiDate date;
+			ConvertUnixToPackedDate(nStart + d * 86400 + m * 60, nOffset, &date);
+			nSink = nSink + date.Date;
+		}
+	}
+	BENCH_REPORT("ConvertUnixToPackedDate (no cache)", nCandles, TestNowNs() - nBegin);
+
+	// The old way: a C runtime call per candle, then field by field
+	nBegin = TestNowNs();
+	for (int d = 0; d < nDays; d++)
+	{
+		for (int m = 0; m < 375; m++)
+		{
+			time_t t = nStart + d * 86400 + m * 60;
+			struct tm tmLocal;
+			localtime_r(&t, &tmLocal);
+			union AmiDate date;
+			date.Date = 0;
+			date.PackDate.Year = tmLocal.tm_year + 1900;
+			date.PackDate.Month = tmLocal.tm_mon + 1;
+			date.PackDate.Day = tmLocal.tm_mday;
+			date.PackDate.Hour = tmLocal.tm_hour;
+			date.PackDate.Minute = tmLocal.tm_min;
+			date.PackDate.Second = tmLocal.tm_sec;
+			nSink = nSink + date.Date;
+		}
+	}
+	BENCH_REPORT("localtime_r + pack", nCandles, TestNowNs() - nBegin);
+}
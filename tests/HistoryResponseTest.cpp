@@ -0,0 +1,590 @@
+// HistoryResponseTest.cpp - History merge against a reference, room and scratch handling,
+// the stream parser on responses split at every byte
+#include "TestHarness.h"
+#include "HistoryResponse.h"
+
+#include <malloc.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+static const time_t HISTORY_TEST_START = 1761190200;  // 2025-10-23 09:00:00 IST
+static const int HISTORY_READ_TEST_CHUNK = 16384;     // HISTORY_READ_CHUNK_SIZE in Plugin.cpp
+
+// A 1-minute bar nMinute minutes after HISTORY_TEST_START; prices carry nTag so merged bars can be told apart
+static struct Quotation MakeMinuteBar(int nMinute, float fTag)
+{
+	struct Quotation bar;
+	memset(&bar, 0, sizeof(bar));
+	ConvertUnixToPackedDate(HISTORY_TEST_START + nMinute * 60, CALENDAR_UTC_OFFSET_IST * 60, &bar.DateTime);
+	bar.Open = 100.0f + fTag;
+	bar.High = 110.0f + fTag;
+	bar.Low = 90.0f + fTag;
+	bar.Price = 105.0f + fTag;
+	bar.Volume = 1000.0f + fTag;
+	bar.OpenInterest = 50.0f + fTag;
+	return bar;
+}
+
+static UINT32 MinuteKey(int nMinute)
+{
+	struct Quotation bar = MakeMinuteBar(nMinute, 0.0f);
+	return HistoryBarKey(&bar);
+}
+
+// What a merge must produce: one bar per minute, existing bars updated by the last
+// candle of the response for that minute, new minutes added in time order
+static std::vector<struct Quotation> ReferenceMerge(const std::vector<struct Quotation>& existing,
+	const std::vector<struct Quotation>& response, int* pnUnique)
+{
+	std::map<UINT32, struct Quotation> latest;
+	for (size_t i = 0; i < response.size(); i++)
+		latest[HistoryBarKey(&response[i])] = response[i];
+
+	std::map<UINT32, struct Quotation> merged;
+	for (size_t i = 0; i < existing.size(); i++)
+		merged[HistoryBarKey(&existing[i])] = existing[i];
+
+	*pnUnique = 0;
+	for (std::map<UINT32, struct Quotation>::const_iterator it = latest.begin(); it != latest.end(); ++it)
+	{
+		std::map<UINT32, struct Quotation>::iterator found = merged.find(it->first);
+		if (found == merged.end())
+		{
+			merged[it->first] = it->second;
+			(*pnUnique)++;
+			continue;
+		}
+		struct Quotation& bar = found->second;
+		bar.Price = it->second.Price;
+		bar.High = std::max(bar.High, it->second.High);
+		bar.Low = (bar.Low == 0) ? it->second.Low : std::min(bar.Low, it->second.Low);
+		bar.Volume = it->second.Volume;
+		bar.OpenInterest = it->second.OpenInterest;
+	}
+
+	std::vector<struct Quotation> result;
+	for (std::map<UINT32, struct Quotation>::const_iterator it = merged.begin(); it != merged.end(); ++it)
+		result.push_back(it->second);
+	return result;
+}
+
+static bool SameBars(const struct Quotation* pQuotes, int nCount, const std::vector<struct Quotation>& expected)
+{
+	return nCount == (int)expected.size() &&
+		(nCount == 0 || memcmp(pQuotes, expected.data(), nCount * sizeof(struct Quotation)) == 0);
+}
+
+// Random existing bars and random responses (overlapping, repeated minutes, out of
+// order), appended candle by candle as the stream parser does
+TEST_CASE(HistoryResponse, MergeMatchesReference)
+{
+	TestRandom random(9);
+	for (int nTrial = 0; nTrial < 3000; nTrial++)
+	{
+		std::vector<struct Quotation> existing;
+		int nExistingSpan = random.Range(0, 600);
+		for (int m = 0; m < nExistingSpan; m++)
+		{
+			if (random.Range(0, 2) != 0)
+				existing.push_back(MakeMinuteBar(m, 0.0f));
+		}
+
+		// Mostly the usual shape (a sorted stretch from somewhere in the existing
+		// range to beyond it), with repeated and out-of-order candles mixed in
+		std::vector<struct Quotation> response;
+		int nFirst = random.Range(0, nExistingSpan + 10);
+		int nCount = random.Range(0, 300);
+		int nShape = random.Range(0, 3);
+		for (int k = 0; k < nCount; k++)
+		{
+			int nMinute = nFirst + k;
+			if (nShape == 1 && random.Range(0, 9) == 0)
+				nMinute = random.Range(0, nFirst + nCount);       // Out of order
+			response.push_back(MakeMinuteBar(nMinute, (float)(k + 1)));
+			if (nShape == 2 && random.Range(0, 4) == 0)
+				response.push_back(MakeMinuteBar(nMinute, (float)(k + 1) + 0.5f));  // Same minute again
+		}
+		if (nShape == 3)
+			std::reverse(response.begin(), response.end());
+
+		int nUnique = 0;
+		std::vector<struct Quotation> expected = ReferenceMerge(existing, response, &nUnique);
+
+		int nSize = 2 * (int)(existing.size() + response.size()) + 100;  // Never near full here
+		std::vector<struct Quotation> quotes(nSize);
+		if (!existing.empty())
+			memcpy(quotes.data(), existing.data(), existing.size() * sizeof(struct Quotation));
+
+		HistoryMergeContext ctx(quotes.data(), nSize, 60, (int)existing.size() - 1);
+		for (size_t i = 0; i < response.size(); i++)
+			AppendHistoryBar(&ctx, &response[i]);
+		MergeHistoryRun(&ctx);
+
+		CHECK(SameBars(quotes.data(), ctx.quoteIndex, expected));
+		CHECK_EQ(ctx.uniqueCount, nUnique);
+		if (!SameBars(quotes.data(), ctx.quoteIndex, expected))
+		{
+			printf("  trial %d: shape %d, %d existing, %d candles -> %d bars, expected %d\n", nTrial, nShape,
+				(int)existing.size(), (int)response.size(), ctx.quoteIndex, (int)expected.size());
+			break;
+		}
+	}
+}
+
+// The overlapping tail goes to a scratch buffer that the context keeps between merges
+TEST_CASE(HistoryResponse, ScratchBufferIsReused)
+{
+	const int nSize = 1000;
+	std::vector<struct Quotation> quotes(nSize);
+	for (int m = 0; m < 200; m++)
+		quotes[m] = MakeMinuteBar(m, 0.0f);
+
+	HistoryMergeContext ctx(quotes.data(), nSize, 60, 199);
+	CHECK(ctx.pScratch == NULL);
+
+	// Overlaps the last 50 bars
+	for (int m = 150; m < 260; m++)
+	{
+		struct Quotation bar = MakeMinuteBar(m, 1.0f);
+		AppendHistoryBar(&ctx, &bar);
+	}
+	MergeHistoryRun(&ctx);
+	CHECK_EQ(ctx.quoteIndex, 260);
+	CHECK(ctx.pScratch != NULL);
+	CHECK_EQ(ctx.nScratchSize, 50);
+	struct Quotation* pScratch = ctx.pScratch;
+
+	// A smaller overlap keeps the same buffer; a bigger one grows it
+	for (int m = 230; m < 270; m++)
+	{
+		struct Quotation bar = MakeMinuteBar(m, 2.0f);
+		AppendHistoryBar(&ctx, &bar);
+	}
+	MergeHistoryRun(&ctx);
+	CHECK_EQ(ctx.quoteIndex, 270);
+	CHECK(ctx.pScratch == pScratch);
+
+	for (int m = 100; m < 110; m++)
+	{
+		struct Quotation bar = MakeMinuteBar(m, 3.0f);
+		AppendHistoryBar(&ctx, &bar);
+	}
+	MergeHistoryRun(&ctx);
+	CHECK_EQ(ctx.quoteIndex, 270);
+	CHECK_EQ(ctx.nScratchSize, 170);
+	CHECK_EQ(quotes[105].Price, 105.0f + 3.0f);
+	CHECK_EQ(quotes[235].Price, 105.0f + 2.0f);
+	CHECK_EQ(quotes[155].Price, 105.0f + 1.0f);
+	CHECK_EQ(quotes[155].Open, 100.0f);  // Updated bars keep their open
+}
+
+// A nearly full array drops its oldest 10% before the first new bar; an empty response leaves it alone
+TEST_CASE(HistoryResponse, MakesRoomWhenNearlyFull)
+{
+	const int nSize = 100;
+	std::vector<struct Quotation> quotes(nSize);
+	for (int m = 0; m < 97; m++)
+		quotes[m] = MakeMinuteBar(m, 0.0f);
+
+	HistoryMergeContext empty(quotes.data(), nSize, 60, 96);
+	MergeHistoryRun(&empty);
+	CHECK_EQ(empty.quoteIndex, 97);
+	CHECK_EQ(HistoryBarKey(&quotes[0]), MinuteKey(0));
+
+	HistoryMergeContext ctx(quotes.data(), nSize, 60, 96);
+	for (int m = 97; m < 105; m++)
+	{
+		struct Quotation bar = MakeMinuteBar(m, 1.0f);
+		AppendHistoryBar(&ctx, &bar);
+	}
+	MergeHistoryRun(&ctx);
+	CHECK_EQ(ctx.nLastValid, 86);
+	CHECK_EQ(ctx.quoteIndex, 95);
+	CHECK_EQ(HistoryBarKey(&quotes[0]), MinuteKey(10));
+	CHECK_EQ(HistoryBarKey(&quotes[94]), MinuteKey(104));
+}
+
+// Out of room mid-response: merging frees the slots of candles for bars AmiBroker
+// already has; once nothing can be freed, the remaining candles are dropped
+TEST_CASE(HistoryResponse, FullArrayMergesThenDrops)
+{
+	const int nSize = 50;
+	std::vector<struct Quotation> quotes(nSize);
+	for (int m = 0; m < 40; m++)
+		quotes[m] = MakeMinuteBar(m, 0.0f);
+
+	// 20 candles for existing minutes, then 10 new ones: everything fits after merging
+	std::vector<struct Quotation> response;
+	for (int m = 20; m < 50; m++)
+		response.push_back(MakeMinuteBar(m, 1.0f));
+	CHECK_EQ(MergeHistoryBars(quotes.data(), nSize, 60, 39, response.data(), (int)response.size()), 50);
+	for (int m = 0; m < 50; m++)
+		CHECK_EQ(HistoryBarKey(&quotes[m]), MinuteKey(m));
+	CHECK_EQ(quotes[45].Price, 105.0f + 1.0f);
+
+	// Already full (and above the 95% mark, so the oldest 10% go first): 20 new minutes, 5 fit
+	for (int m = 0; m < 50; m++)
+		quotes[m] = MakeMinuteBar(m, 0.0f);
+	HistoryMergeContext ctx(quotes.data(), nSize, 60, 49);
+	for (int m = 50; m < 70; m++)
+	{
+		struct Quotation bar = MakeMinuteBar(m, 2.0f);
+		AppendHistoryBar(&ctx, &bar);
+	}
+	MergeHistoryRun(&ctx);
+	CHECK_EQ(ctx.quoteIndex, nSize);
+	CHECK_EQ(HistoryBarKey(&quotes[0]), MinuteKey(5));
+	CHECK_EQ(HistoryBarKey(&quotes[nSize - 1]), MinuteKey(54));
+}
+
+// Candles become bars in exchange time; daily candles carry the EOD markers
+TEST_CASE(HistoryResponse, CandlesToBars)
+{
+	InitCalendarConversion(CALENDAR_UTC_OFFSET_IST, "");
+	const int nSize = 10;
+	struct Quotation quotes[nSize];
+
+	MarketTick candle;
+	memset(&candle, 0, sizeof(candle));
+	strcpy(candle.timestamp, "1761190237");  // 2025-10-23 09:00:37 IST
+	candle.open = 1.0f;
+	candle.high = 4.0f;
+	candle.low = 0.5f;
+	candle.close = 2.0f;
+	candle.volume = 300.0f;
+	candle.oi = 7.0f;
+
+	std::vector<struct Quotation> recorded;
+	struct Recorder {
+		static void Record(void* pContext, const struct Quotation* pBar) {
+			((std::vector<struct Quotation>*)pContext)->push_back(*pBar);
+		}
+	};
+
+	HistoryMergeContext intraday(quotes, nSize, 60, -1);
+	intraday.pfnRecordBar = Recorder::Record;
+	intraday.pRecordContext = &recorded;
+	AppendHistoryCandle(&intraday, &candle);
+	MergeHistoryRun(&intraday);
+	CHECK_EQ(intraday.quoteIndex, 1);
+	CHECK_EQ(recorded.size(), 1u);
+	const struct PackedDate& d = quotes[0].DateTime.PackDate;
+	CHECK_EQ((int)d.Year, 2025);
+	CHECK_EQ((int)d.Month, 10);
+	CHECK_EQ((int)d.Day, 23);
+	CHECK_EQ((int)d.Hour, 9);
+	CHECK_EQ((int)d.Minute, 0);
+	CHECK_EQ((int)d.Second, 0);
+	CHECK_EQ(quotes[0].Price, 2.0f);
+	CHECK_EQ(quotes[0].Volume, 300.0f);
+	CHECK_EQ(quotes[0].OpenInterest, 7.0f);
+
+	HistoryMergeContext daily(quotes, nSize, 86400, -1);
+	AppendHistoryCandle(&daily, &candle);
+	strcpy(candle.timestamp, "1761276637");  // Next day
+	AppendHistoryCandle(&daily, &candle);
+	MergeHistoryRun(&daily);
+	CHECK_EQ(daily.quoteIndex, 2);
+	CHECK_EQ((int)quotes[0].DateTime.PackDate.Day, 23);
+	CHECK_EQ((int)quotes[1].DateTime.PackDate.Day, 24);
+	CHECK_EQ((int)quotes[1].DateTime.PackDate.Hour, 31);
+	CHECK_EQ((int)quotes[1].DateTime.PackDate.Minute, 63);
+	CHECK_EQ((int)quotes[1].DateTime.PackDate.Second, 0);
+	CHECK(HistoryBarKey(&quotes[0]) < HistoryBarKey(&quotes[1]));
+}
+
+// One /api/v1/history candle object as the server writes it, for MakeMinuteBar(nMinute, fTag)
+static std::string MakeCandleJson(int nMinute, float fTag)
+{
+	char szCandle[256];
+	sprintf(szCandle, "{\"close\":%.2f,\"high\":%.2f,\"low\":%.2f,\"oi\":%.2f,\"open\":%.2f,\"timestamp\":%lld,\"volume\":%.2f}",
+		105.0f + fTag, 110.0f + fTag, 90.0f + fTag, 50.0f + fTag, 100.0f + fTag,
+		(long long)(HISTORY_TEST_START + nMinute * 60), 1000.0f + fTag);
+	return szCandle;
+}
+
+// What the parser leaves behind for one response
+struct ParsedHistory {
+	std::vector<struct Quotation> bars;
+	int nCandles;
+	BOOL bStatusSuccess;
+	int nDepth;
+};
+
+// Feed the body in pieces of the given sizes (cycled; 0 = all at once) and merge into empty history
+static ParsedHistory ParseHistoryBody(const std::string& body, const std::vector<int>& chunks)
+{
+	const int nSize = 1000;
+	std::vector<struct Quotation> quotes(nSize);
+	HistoryMergeContext ctx(quotes.data(), nSize, 60, -1);
+	HistoryStreamParser parser;
+
+	int nPos = 0;
+	for (size_t k = 0; nPos < (int)body.size(); k++)
+	{
+		int nChunk = chunks.empty() ? 0 : chunks[k % chunks.size()];
+		if (nChunk <= 0 || nChunk > (int)body.size() - nPos)
+			nChunk = (int)body.size() - nPos;
+		HistoryStreamParserFeed(&parser, body.data() + nPos, nChunk, &ctx);
+		nPos += nChunk;
+	}
+	MergeHistoryRun(&ctx);
+
+	ParsedHistory parsed;
+	parsed.bars.assign(quotes.begin(), quotes.begin() + ctx.quoteIndex);
+	parsed.nCandles = parser.nCandles;
+	parsed.bStatusSuccess = parser.bStatusSuccess;
+	parsed.nDepth = parser.nDepth;
+	return parsed;
+}
+
+static bool SameParse(const ParsedHistory& a, const ParsedHistory& b)
+{
+	return a.nCandles == b.nCandles && a.bStatusSuccess == b.bStatusSuccess && a.nDepth == b.nDepth &&
+		SameBars(a.bars.data(), (int)a.bars.size(), b.bars);
+}
+
+// A plain response, whole and cut at every byte into two and into single bytes
+TEST_CASE(HistoryResponse, StreamSplitAtEveryByte)
+{
+	InitCalendarConversion(CALENDAR_UTC_OFFSET_IST, "");
+	std::vector<struct Quotation> expected;
+	std::string body = "{\"data\":[";
+	for (int m = 0; m < 5; m++)
+	{
+		if (m > 0)
+			body += ",";
+		body += MakeCandleJson(m, (float)m + 0.25f);
+		expected.push_back(MakeMinuteBar(m, (float)m + 0.25f));
+	}
+	body += "],\"status\":\"success\"}";
+
+	ParsedHistory whole = ParseHistoryBody(body, std::vector<int>());
+	CHECK(whole.bStatusSuccess);
+	CHECK_EQ(whole.nCandles, 5);
+	CHECK_EQ(whole.nDepth, 0);
+	CHECK(SameBars(whole.bars.data(), (int)whole.bars.size(), expected));
+
+	for (int nCut = 1; nCut < (int)body.size(); nCut++)
+	{
+		std::vector<int> chunks(1, nCut);
+		chunks.push_back((int)body.size());
+		CHECK(SameParse(ParseHistoryBody(body, chunks), whole));
+	}
+	CHECK(SameParse(ParseHistoryBody(body, std::vector<int>(1, 1)), whole));
+}
+
+// Everything around the candles that must not confuse the parser: strings holding
+// braces, brackets, quotes and escapes, nested objects and arrays, "data" keys
+// below the top level, other top-level arrays, status before or after the data
+TEST_CASE(HistoryResponse, StreamSkipsEverythingButCandles)
+{
+	InitCalendarConversion(CALENDAR_UTC_OFFSET_IST, "");
+	std::string body =
+		"{\"status\":\"success\","
+		"\"meta\":{\"note\":\"} ] [ { \\\"data\\\":[{\\\"timestamp\\\":1}] \\\\\",\"data\":[{\"timestamp\":1761190200}]},"
+		"\"symbols\":[{\"timestamp\":1761190260},[1,2,{\"a\":[]}]],"
+		"\"data\":["
+		"{\"timestamp\":1761190200,\"open\":100,\"high\":110,\"low\":90,\"close\":105,\"volume\":1000,\"oi\":50},"
+		"{\"note\":\"a } and a \\\" and { [\",\"extra\":{\"timestamp\":1},\"list\":[{\"close\":1}],"
+		"\"timestamp\":1761190260,\"open\":101,\"high\":111,\"low\":91,\"close\":106,\"volume\":1001,\"oi\":51},"
+		"{\"open\":1,\"close\":2}"  // No timestamp: counted, not added
+		"],\"tail\":\"]}\"}";
+
+	ParsedHistory parsed = ParseHistoryBody(body, std::vector<int>());
+	CHECK(parsed.bStatusSuccess);
+	CHECK_EQ(parsed.nCandles, 3);
+	CHECK_EQ(parsed.nDepth, 0);
+	std::vector<struct Quotation> expected;
+	expected.push_back(MakeMinuteBar(0, 0.0f));
+	expected.push_back(MakeMinuteBar(1, 1.0f));
+	CHECK(SameBars(parsed.bars.data(), (int)parsed.bars.size(), expected));
+
+	for (int nCut = 1; nCut < (int)body.size(); nCut++)
+	{
+		std::vector<int> chunks(1, nCut);
+		chunks.push_back((int)body.size());
+		CHECK(SameParse(ParseHistoryBody(body, chunks), parsed));
+	}
+	CHECK(SameParse(ParseHistoryBody(body, std::vector<int>(1, 1)), parsed));
+}
+
+TEST_CASE(HistoryResponse, StreamStatus)
+{
+	InitCalendarConversion(CALENDAR_UTC_OFFSET_IST, "");
+	std::string candle = MakeCandleJson(0, 0.0f);
+
+	CHECK(ParseHistoryBody("{\"data\":[" + candle + "],\"status\":\"success\"}", std::vector<int>()).bStatusSuccess);
+	CHECK(!ParseHistoryBody("{\"data\":[" + candle + "],\"status\":\"error\"}", std::vector<int>()).bStatusSuccess);
+	CHECK(!ParseHistoryBody("{\"data\":[" + candle + "]}", std::vector<int>()).bStatusSuccess);
+	CHECK(!ParseHistoryBody("{\"status\":\"successful\",\"data\":[]}", std::vector<int>()).bStatusSuccess);
+
+	// Only the top-level status counts
+	CHECK(!ParseHistoryBody("{\"meta\":{\"status\":\"success\"},\"data\":[]}", std::vector<int>()).bStatusSuccess);
+	CHECK(!ParseHistoryBody("{\"data\":[{\"status\":\"success\"}],\"status\":\"error\"}", std::vector<int>()).bStatusSuccess);
+	CHECK(!ParseHistoryBody("{\"status\":[\"success\"]}", std::vector<int>()).bStatusSuccess);
+
+	ParsedHistory error = ParseHistoryBody("{\"status\":\"error\",\"message\":\"Invalid \\\"symbol\\\" {x}\"}", std::vector<int>());
+	CHECK(!error.bStatusSuccess);
+	CHECK_EQ(error.nCandles, 0);
+	CHECK(error.bars.empty());
+}
+
+// A candle object past HISTORY_CANDLE_MAX_SIZE is dropped; its neighbours are not
+TEST_CASE(HistoryResponse, StreamOversizedCandle)
+{
+	InitCalendarConversion(CALENDAR_UTC_OFFSET_IST, "");
+	std::string candle = MakeCandleJson(1, 1.0f);
+	std::string fits = "{\"note\":\"" + std::string(HISTORY_CANDLE_MAX_SIZE - candle.size() - 10, 'x') + "\"," + candle.substr(1);
+	std::string oversized = "{\"note\":\"" + std::string(HISTORY_CANDLE_MAX_SIZE - candle.size() - 9, 'x') + "\"," + candle.substr(1);
+	CHECK_EQ((int)fits.size(), HISTORY_CANDLE_MAX_SIZE);
+	CHECK_EQ((int)oversized.size(), HISTORY_CANDLE_MAX_SIZE + 1);
+
+	std::string body = "{\"data\":[" + MakeCandleJson(0, 0.0f) + "," + fits + "," + MakeCandleJson(2, 2.0f) + "]}";
+	ParsedHistory parsed = ParseHistoryBody(body, std::vector<int>());
+	CHECK_EQ(parsed.nCandles, 3);
+	CHECK_EQ((int)parsed.bars.size(), 3);
+
+	body = "{\"data\":[" + MakeCandleJson(0, 0.0f) + "," + oversized + "," + MakeCandleJson(2, 2.0f) + "]}";
+	std::vector<struct Quotation> expected;
+	expected.push_back(MakeMinuteBar(0, 0.0f));
+	expected.push_back(MakeMinuteBar(2, 2.0f));
+	parsed = ParseHistoryBody(body, std::vector<int>());
+	CHECK_EQ(parsed.nCandles, 3);
+	CHECK_EQ(parsed.nDepth, 0);
+	CHECK(SameBars(parsed.bars.data(), (int)parsed.bars.size(), expected));
+	CHECK(SameParse(ParseHistoryBody(body, std::vector<int>(1, 7)), parsed));
+}
+
+// Long responses in random pieces, the way CHttpFile::Read() hands them over
+TEST_CASE(HistoryResponse, StreamRandomChunks)
+{
+	InitCalendarConversion(CALENDAR_UTC_OFFSET_IST, "");
+	TestRandom random(6);
+	for (int nTrial = 0; nTrial < 200; nTrial++)
+	{
+		int nCandles = random.Range(0, 400);
+		std::vector<struct Quotation> expected;
+		std::string body = "{\"data\":[";
+		for (int m = 0; m < nCandles; m++)
+		{
+			if (m > 0)
+				body += ",";
+			body += MakeCandleJson(m, (float)(m % 50) + 0.5f);
+			expected.push_back(MakeMinuteBar(m, (float)(m % 50) + 0.5f));
+		}
+		body += "],\"status\":\"success\"}";
+
+		std::vector<int> chunks;
+		for (int k = 0; k < 16; k++)
+			chunks.push_back(random.Range(1, random.Range(0, 1) ? 64 : HISTORY_READ_TEST_CHUNK));
+		ParsedHistory parsed = ParseHistoryBody(body, chunks);
+		CHECK(parsed.bStatusSuccess);
+		CHECK_EQ(parsed.nCandles, nCandles);
+		CHECK_EQ(parsed.nDepth, 0);
+		CHECK(SameBars(parsed.bars.data(), (int)parsed.bars.size(), expected));
+	}
+}
+
+// A refresh: the last two days of 1-minute bars again from the server, merged into
+// 10,000, 100,000 and 1,000,000 existing bars. Only the overlapping tail is touched,
+// so the cost per refresh should not grow with the existing bars.
+BENCHMARK(HistoryResponse, MergeRefresh)
+{
+	static const int s_anExisting[] = { 10000, 100000, 1000000 };
+	const int nResponse = 2 * 375;
+	for (size_t k = 0; k < sizeof(s_anExisting) / sizeof(s_anExisting[0]); k++)
+	{
+		const int nExisting = s_anExisting[k];
+		const int nSize = nExisting + nExisting / 4 + nResponse;   // Below MakeHistoryRoom()'s 95% mark
+		const int nRounds = 200;
+		std::vector<struct Quotation> existing;
+		for (int m = 0; m < nExisting; m++)
+			existing.push_back(MakeMinuteBar(m, 0.0f));
+		std::vector<struct Quotation> response;
+		for (int m = nExisting - nResponse + 10; m < nExisting + 10; m++)
+			response.push_back(MakeMinuteBar(m, 1.0f));
+		std::vector<struct Quotation> quotes(nSize);
+		memcpy(quotes.data(), existing.data(), nExisting * sizeof(struct Quotation));
+
+		// Every round merges into the unchanged existing bars: the response only
+		// rewrites the last nResponse - 10 of them, so restoring those is enough
+		const int nRestore = nResponse;
+		uint64_t nElapsed = 0;
+		for (int r = 0; r < nRounds; r++)
+		{
+			memcpy(quotes.data() + nExisting - nRestore, existing.data() + nExisting - nRestore,
+				nRestore * sizeof(struct Quotation));
+			uint64_t nStart = TestNowNs();
+			HistoryMergeContext ctx(quotes.data(), nSize, 60, nExisting - 1);
+			for (int i = 0; i < nResponse; i++)
+				AppendHistoryBar(&ctx, &response[i]);
+			MergeHistoryRun(&ctx);
+			nElapsed += TestNowNs() - nStart;
+			CHECK_EQ(ctx.quoteIndex, nExisting + 10);
+		}
+
+		char szLabel[64];
+		snprintf(szLabel, sizeof(szLabel), "refresh into %d bars (per refresh)", nExisting);
+		BENCH_REPORT(szLabel, nRounds, nElapsed);
+	}
+}
+
+// At least 100,000 1-minute candles (a 270-day backfill) in the 16 KB reads
+// RequestHistoryRange() makes. The parser keeps no more than one candle object
+// whatever the response size: the heap must not grow while the body streams in.
+BENCHMARK(HistoryResponse, StreamParse)
+{
+	InitCalendarConversion(CALENDAR_UTC_OFFSET_IST, "");
+	const int nCandles = 270 * 375;
+	const int nRounds = 10;
+	std::string body = "{\"data\":[";
+	for (int m = 0; m < nCandles; m++)
+	{
+		if (m > 0)
+			body += ",";
+		body += MakeCandleJson(m, (float)(m % 50) + 0.5f);
+	}
+	body += "],\"status\":\"success\"}";
+	std::vector<struct Quotation> quotes(nCandles + 100);
+
+	// One untimed pass that checks the heap after every read
+	size_t nPeakHeapGrowth = 0;
+	{
+		size_t nHeapBefore = mallinfo2().uordblks;
+		HistoryMergeContext ctx(quotes.data(), (int)quotes.size(), 60, -1);
+		HistoryStreamParser parser;
+		for (int nPos = 0; nPos < (int)body.size(); nPos += HISTORY_READ_TEST_CHUNK)
+		{
+			HistoryStreamParserFeed(&parser, body.data() + nPos, std::min(HISTORY_READ_TEST_CHUNK, (int)body.size() - nPos), &ctx);
+			size_t nHeap = mallinfo2().uordblks;
+			if (nHeap > nHeapBefore)
+				nPeakHeapGrowth = std::max(nPeakHeapGrowth, nHeap - nHeapBefore);
+		}
+		MergeHistoryRun(&ctx);
+		CHECK_EQ(ctx.quoteIndex, nCandles);
+	}
+	CHECK_EQ(nPeakHeapGrowth, (size_t)0);
+
+	uint64_t nElapsed = 0;
+	for (int r = 0; r < nRounds; r++)
+	{
+		uint64_t nStart = TestNowNs();
+		HistoryMergeContext ctx(quotes.data(), (int)quotes.size(), 60, -1);
+		HistoryStreamParser parser;
+		for (int nPos = 0; nPos < (int)body.size(); nPos += HISTORY_READ_TEST_CHUNK)
+			HistoryStreamParserFeed(&parser, body.data() + nPos, std::min(HISTORY_READ_TEST_CHUNK, (int)body.size() - nPos), &ctx);
+		MergeHistoryRun(&ctx);
+		nElapsed += TestNowNs() - nStart;
+	}
+
+	BENCH_REPORT("HistoryStreamParserFeed + MergeHistoryRun (per candle)", (long long)nRounds * nCandles, nElapsed);
+	printf("  %-40s %12.1f MB/s (%d candles, %.1f MB body)\n", "", (double)nRounds * body.size() * 1000.0 / nElapsed,
+		nCandles, body.size() / 1e6);
+	printf("  %-40s %12u bytes parser state, %zu bytes peak heap growth\n", "",
+		(unsigned)sizeof(HistoryStreamParser), nPeakHeapGrowth);
+}
@@ -0,0 +1,449 @@
+// HttpPoolTest.cpp - Connection reuse, eviction and the retry rule against a local stand-in server
+#include "TestHarness.h"
+#include "HttpPool.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// A minimal HTTP/1.1 keep-alive server on 127.0.0.1: every request gets a 200
+// with a small JSON body. It can drop its open connections (a restart, or its
+// own idle timeout) and can be told to close new connections without answering.
+class StandInServer {
+public:
+	StandInServer() : m_nListen(-1), m_nPort(0), m_bStop(false), m_bAnswer(true), m_nAccepted(0), m_nServed(0) {
+		m_nListen = socket(AF_INET, SOCK_STREAM, 0);
+		int nOn = 1;
+		setsockopt(m_nListen, SOL_SOCKET, SO_REUSEADDR, &nOn, sizeof(nOn));
+		sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		CHECK_EQ(bind(m_nListen, (sockaddr*)&addr, sizeof(addr)), 0);
+		CHECK_EQ(listen(m_nListen, 64), 0);
+		socklen_t nLen = sizeof(addr);
+		getsockname(m_nListen, (sockaddr*)&addr, &nLen);
+		m_nPort = ntohs(addr.sin_port);
+		m_acceptThread = std::thread(&StandInServer::AcceptLoop, this);
+	}
+
+	~StandInServer() {
+		m_bStop = true;
+		shutdown(m_nListen, SHUT_RDWR);
+		close(m_nListen);
+		m_acceptThread.join();
+		DropConnections();
+		// The accept thread is gone, so the list no longer changes; Serve() takes m_lock to finish
+		for (size_t i = 0; i < m_connectionThreads.size(); i++)
+			m_connectionThreads[i].join();
+	}
+
+	UINT GetPort() const { return m_nPort; }
+	int GetAccepted() const { return m_nAccepted.load(); }
+	int GetServed() const { return m_nServed.load(); }
+	void SetAnswer(bool bAnswer) { m_bAnswer = bAnswer; }
+
+	// Close every open connection from the server side
+	void DropConnections() {
+		std::lock_guard<std::mutex> guard(m_lock);
+		for (size_t i = 0; i < m_sockets.size(); i++)
+			shutdown(m_sockets[i], SHUT_RDWR);
+	}
+
+private:
+	void AcceptLoop() {
+		while (!m_bStop)
+		{
+			int nSocket = accept(m_nListen, NULL, NULL);
+			if (nSocket < 0)
+				break;
+			m_nAccepted++;
+			std::lock_guard<std::mutex> guard(m_lock);
+			m_sockets.push_back(nSocket);
+			m_connectionThreads.push_back(std::thread(&StandInServer::Serve, this, nSocket));
+		}
+	}
+
+	void Serve(int nSocket) {
+		std::string request;
+		char buffer[4096];
+		while (m_bAnswer)
+		{
+			ssize_t n = recv(nSocket, buffer, sizeof(buffer), 0);
+			if (n <= 0)
+				break;
+			request.append(buffer, n);
+			size_t nEnd;
+			while ((nEnd = request.find("\r\n\r\n")) != std::string::npos)
+			{
+				request.erase(0, nEnd + 4);
+				static const char s_szResponse[] = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n"
+					"Content-Length: 20\r\nConnection: keep-alive\r\n\r\n{\"status\":\"success\"}";
+				m_nServed++;  // Before the client can see the response
+				send(nSocket, s_szResponse, sizeof(s_szResponse) - 1, MSG_NOSIGNAL);
+			}
+		}
+
+		std::lock_guard<std::mutex> guard(m_lock);
+		for (size_t i = 0; i < m_sockets.size(); i++)
+		{
+			if (m_sockets[i] == nSocket)
+			{
+				m_sockets.erase(m_sockets.begin() + i);
+				break;
+			}
+		}
+		close(nSocket);
+	}
+
+	int m_nListen;
+	UINT m_nPort;
+	std::atomic<bool> m_bStop;
+	std::atomic<bool> m_bAnswer;
+	std::atomic<int> m_nAccepted;
+	std::atomic<int> m_nServed;
+	std::mutex m_lock;       // Guards m_sockets and m_connectionThreads
+	std::vector<int> m_sockets;  // Connections still being served
+	std::vector<std::thread> m_connectionThreads;
+	std::thread m_acceptThread;
+};
+
+// The plugin's three WinInet callbacks, over plain sockets
+struct TestConnection {
+	int nSocket;
+};
+
+static std::atomic<int> g_nTestConnectionsOpen(0);
+
+static void* OpenTestConnection(void* pContext, LPCTSTR pszServer, UINT nPort)
+{
+	int nSocket = socket(AF_INET, SOCK_STREAM, 0);
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons((unsigned short)nPort);
+	inet_pton(AF_INET, pszServer, &addr.sin_addr);
+	if (connect(nSocket, (sockaddr*)&addr, sizeof(addr)) != 0)
+	{
+		close(nSocket);
+		return NULL;
+	}
+	int nOn = 1;
+	setsockopt(nSocket, IPPROTO_TCP, TCP_NODELAY, &nOn, sizeof(nOn));
+	g_nTestConnectionsOpen++;
+	TestConnection* pConnection = new TestConnection;
+	pConnection->nSocket = nSocket;
+	return pConnection;
+}
+
+static void CloseTestConnection(void* pContext, void* pConnection)
+{
+	close(((TestConnection*)pConnection)->nSocket);
+	delete (TestConnection*)pConnection;
+	g_nTestConnectionsOpen--;
+}
+
+// A GET and its whole response (headers plus Content-Length bytes)
+static BOOL SendTestRequest(void* pRequest, void* pConnection)
+{
+	int nSocket = ((TestConnection*)pConnection)->nSocket;
+	static const char s_szRequest[] = "GET /api/v1/ping HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: keep-alive\r\n\r\n";
+	if (send(nSocket, s_szRequest, sizeof(s_szRequest) - 1, MSG_NOSIGNAL) != (ssize_t)(sizeof(s_szRequest) - 1))
+		return FALSE;
+
+	std::string response;
+	char buffer[1024];
+	size_t nHeaderEnd = std::string::npos;
+	size_t nTotal = 0;
+	while (nHeaderEnd == std::string::npos || response.size() < nTotal)
+	{
+		ssize_t n = recv(nSocket, buffer, sizeof(buffer), 0);
+		if (n <= 0)
+			return FALSE;
+		response.append(buffer, n);
+		if (nHeaderEnd == std::string::npos && (nHeaderEnd = response.find("\r\n\r\n")) != std::string::npos)
+		{
+			size_t nLength = response.find("Content-Length: ");
+			nTotal = nHeaderEnd + 4 + (size_t)atoi(response.c_str() + nLength + 16);
+		}
+	}
+	*(std::string*)pRequest = response.substr(nHeaderEnd + 4);
+	return response.compare(0, 15, "HTTP/1.1 200 OK") == 0;
+}
+
+// One request the way OpenAlgoHttpBegin()/OpenAlgoHttpEnd() make it
+static bool TestRequest(HttpConnectionPool* pPool, UINT nPort, DWORD dwNow, BOOL* pbReused)
+{
+	std::string body;
+	void* pConnection = SendOnHttpConnection(pPool, "127.0.0.1", nPort, dwNow, SendTestRequest, &body, pbReused);
+	if (pConnection == NULL)
+		return false;
+	ReleaseHttpConnection(pPool, pConnection, "127.0.0.1", nPort, dwNow, TRUE);
+	return body == "{\"status\":\"success\"}";
+}
+
+TEST_CASE(HttpPool, ReusesKeepAliveConnection)
+{
+	StandInServer server;
+	HttpConnectionPool pool;
+	InitHttpConnectionPool(&pool, OpenTestConnection, CloseTestConnection, NULL);
+
+	for (int i = 0; i < 50; i++)
+	{
+		BOOL bReused = FALSE;
+		CHECK(TestRequest(&pool, server.GetPort(), 1000, &bReused));
+		CHECK_EQ(bReused, (BOOL)(i > 0));
+	}
+	CHECK_EQ(server.GetAccepted(), 1);
+	CHECK_EQ(server.GetServed(), 50);
+
+	HttpClientStats stats;
+	GetHttpPoolStats(&pool, &stats);
+	CHECK_EQ(stats.nConnectionsOpened, 1);
+	CHECK_EQ(stats.nConnectionsReused, 49);
+	CHECK_EQ(pool.nIdle, 1);
+
+	DeleteHttpConnectionPool(&pool);
+	CHECK_EQ(g_nTestConnectionsOpen.load(), 0);
+}
+
+TEST_CASE(HttpPool, EvictsIdleAndOtherServer)
+{
+	StandInServer server;
+	StandInServer other;
+	HttpConnectionPool pool;
+	InitHttpConnectionPool(&pool, OpenTestConnection, CloseTestConnection, NULL);
+	BOOL bReused = FALSE;
+
+	// Idle for exactly the timeout is kept; a millisecond longer is not
+	CHECK(TestRequest(&pool, server.GetPort(), 5000, &bReused));
+	CHECK(TestRequest(&pool, server.GetPort(), 5000 + HTTP_POOL_IDLE_TIMEOUT_MS, &bReused));
+	CHECK(bReused);
+	CHECK(TestRequest(&pool, server.GetPort(), 5001 + 2 * HTTP_POOL_IDLE_TIMEOUT_MS, &bReused));
+	CHECK(!bReused);
+	CHECK_EQ(server.GetAccepted(), 2);
+
+	// The tick count wrapping around is not a long idle time
+	CHECK(TestRequest(&pool, server.GetPort(), 0xFFFFFF00u, &bReused));
+	CHECK(TestRequest(&pool, server.GetPort(), 0x00000100u, &bReused));
+	CHECK(bReused);
+
+	// A port change closes the connections to the old one
+	CHECK(TestRequest(&pool, other.GetPort(), 0x100, &bReused));
+	CHECK(!bReused);
+	CHECK_EQ(pool.nIdle, 1);
+	CHECK_EQ(g_nTestConnectionsOpen.load(), 1);
+
+	// Host names compare without case
+	BOOL bReusedUpper = FALSE;
+	void* pConnection = AcquireHttpConnection(&pool, "127.0.0.1", other.GetPort(), 0x100, &bReused);
+	ReleaseHttpConnection(&pool, pConnection, "LOCALHOST", other.GetPort(), 0x100, TRUE);
+	pConnection = AcquireHttpConnection(&pool, "localhost", other.GetPort(), 0x100, &bReusedUpper);
+	CHECK(bReusedUpper);
+	ReleaseHttpConnection(&pool, pConnection, "localhost", other.GetPort(), 0x100, FALSE);
+	CHECK_EQ(pool.nIdle, 0);
+
+	DeleteHttpConnectionPool(&pool);
+	CHECK_EQ(g_nTestConnectionsOpen.load(), 0);
+}
+
+TEST_CASE(HttpPool, KeepsAtMostMaxIdle)
+{
+	StandInServer server;
+	HttpConnectionPool pool;
+	InitHttpConnectionPool(&pool, OpenTestConnection, CloseTestConnection, NULL);
+
+	// More requests in flight than the pool keeps
+	const int nInFlight = HTTP_POOL_MAX_IDLE + 3;
+	std::vector<void*> connections;
+	for (int i = 0; i < nInFlight; i++)
+	{
+		BOOL bReused = TRUE;
+		connections.push_back(AcquireHttpConnection(&pool, "127.0.0.1", server.GetPort(), 0, &bReused));
+		CHECK(connections.back() != NULL);
+		CHECK(!bReused);
+	}
+	for (int i = 0; i < nInFlight; i++)
+		ReleaseHttpConnection(&pool, connections[i], "127.0.0.1", server.GetPort(), 0, TRUE);
+	CHECK_EQ(pool.nIdle, HTTP_POOL_MAX_IDLE);
+	CHECK_EQ(g_nTestConnectionsOpen.load(), HTTP_POOL_MAX_IDLE);
+
+	// The most recently returned connection goes out first
+	BOOL bReused = FALSE;
+	void* pConnection = AcquireHttpConnection(&pool, "127.0.0.1", server.GetPort(), 0, &bReused);
+	CHECK(bReused);
+	CHECK(pConnection == connections[HTTP_POOL_MAX_IDLE - 1]);
+
+	// A failed connection is closed, never pooled
+	ReleaseHttpConnection(&pool, pConnection, "127.0.0.1", server.GetPort(), 0, FALSE);
+	CHECK_EQ(pool.nIdle, HTTP_POOL_MAX_IDLE - 1);
+
+	// Nor is one to a host name too long to store
+	std::string longHost(HTTP_POOL_SERVER_SIZE, 'h');
+	pConnection = AcquireHttpConnection(&pool, "127.0.0.1", server.GetPort(), 0, &bReused);
+	ReleaseHttpConnection(&pool, pConnection, longHost.c_str(), server.GetPort(), 0, TRUE);
+	CHECK_EQ(pool.nIdle, HTTP_POOL_MAX_IDLE - 2);
+
+	DeleteHttpConnectionPool(&pool);
+	CHECK_EQ(g_nTestConnectionsOpen.load(), 0);
+}
+
+// The server drops its idle keep-alive connections: the next request fails on a
+// reused one and goes out again on a new one; the other dead ones are not tried
+TEST_CASE(HttpPool, RetriesOnceAfterServerDropsIdle)
+{
+	StandInServer server;
+	HttpConnectionPool pool;
+	InitHttpConnectionPool(&pool, OpenTestConnection, CloseTestConnection, NULL);
+
+	std::vector<void*> connections;
+	for (int i = 0; i < 4; i++)
+	{
+		BOOL bReused = FALSE;
+		connections.push_back(AcquireHttpConnection(&pool, "127.0.0.1", server.GetPort(), 0, &bReused));
+	}
+	for (int i = 0; i < 4; i++)
+		ReleaseHttpConnection(&pool, connections[i], "127.0.0.1", server.GetPort(), 0, TRUE);
+	for (int nWait = 0; nWait < 1000 && server.GetAccepted() < 4; nWait++)
+		usleep(1000);  // connect() returns before the server thread has seen the connection
+	CHECK_EQ(server.GetAccepted(), 4);
+
+	server.DropConnections();
+	usleep(20000);
+
+	BOOL bReused = TRUE;
+	CHECK(TestRequest(&pool, server.GetPort(), 0, &bReused));
+	CHECK(!bReused);
+	CHECK_EQ(server.GetAccepted(), 5);
+	CHECK_EQ(pool.nIdle, 1);
+	CHECK_EQ(g_nTestConnectionsOpen.load(), 1);
+
+	// A request that fails on a new connection is not retried
+	server.SetAnswer(false);
+	CloseIdleHttpConnections(&pool);
+	CHECK(!TestRequest(&pool, server.GetPort(), 0, &bReused));
+	CHECK_EQ(server.GetAccepted(), 6);
+	CHECK_EQ(pool.nIdle, 0);
+
+	// Nothing listening: no connection at all
+	UINT nPort = 0;
+	DeleteHttpConnectionPool(&pool);
+	InitHttpConnectionPool(&pool, OpenTestConnection, CloseTestConnection, NULL);
+	{
+		StandInServer closing;
+		nPort = closing.GetPort();
+	}
+	CHECK(!TestRequest(&pool, nPort, 0, &bReused));
+
+	HttpClientStats stats;
+	GetHttpPoolStats(&pool, &stats);
+	CHECK_EQ(stats.nConnectionsOpened, 0);
+	DeleteHttpConnectionPool(&pool);
+	CHECK_EQ(g_nTestConnectionsOpen.load(), 0);
+}
+
+TEST_CASE(HttpPool, LatencyCounters)
+{
+	HttpConnectionPool pool;
+	InitHttpConnectionPool(&pool, OpenTestConnection, CloseTestConnection, NULL);
+
+	HttpClientStats summary;
+	int nSummaries = 0;
+	for (int i = 1; i <= 2 * HTTP_STATS_LOG_INTERVAL + 10; i++)
+	{
+		if (RecordHttpRequest(&pool, i * 10, (i % 10) == 0, &summary))
+		{
+			nSummaries++;
+			CHECK_EQ(summary.nRequests, (LONG)i);
+		}
+	}
+	CHECK_EQ(nSummaries, 2);
+	CHECK_EQ(summary.nFailures, (LONG)(2 * HTTP_STATS_LOG_INTERVAL / 10));
+
+	const int n = 2 * HTTP_STATS_LOG_INTERVAL + 10;
+	HttpClientStats stats;
+	GetHttpPoolStats(&pool, &stats);
+	CHECK_EQ(stats.nRequests, (LONG)n);
+	CHECK_EQ(stats.nFailures, (LONG)(n / 10));
+	CHECK_EQ(stats.nTotalLatencyUs, 10LL * n * (n + 1) / 2);
+	CHECK_EQ(stats.nMaxLatencyUs, 10LL * n);
+	CHECK_EQ(stats.nLastLatencyUs, 10LL * n);
+
+	DeleteHttpConnectionPool(&pool);
+}
+
+// Background history fetches and the quote poller share the pool: no more
+// connections than requests in flight, and every connection reused afterwards
+TEST_CASE(HttpPool, ConcurrentRequests)
+{
+	StandInServer server;
+	HttpConnectionPool pool;
+	InitHttpConnectionPool(&pool, OpenTestConnection, CloseTestConnection, NULL);
+	const int nThreads = 6;
+	const int nRequestsEach = 200;
+
+	std::atomic<int> nFailed(0);
+	std::vector<std::thread> threads;
+	for (int t = 0; t < nThreads; t++)
+	{
+		threads.push_back(std::thread([&]() {
+			for (int i = 0; i < nRequestsEach; i++)
+			{
+				BOOL bReused = FALSE;
+				if (!TestRequest(&pool, server.GetPort(), 0, &bReused))
+					nFailed++;
+			}
+		}));
+	}
+	for (size_t i = 0; i < threads.size(); i++)
+		threads[i].join();
+
+	CHECK_EQ(nFailed.load(), 0);
+	CHECK_EQ(server.GetServed(), nThreads * nRequestsEach);
+	CHECK(server.GetAccepted() <= nThreads);
+	HttpClientStats stats;
+	GetHttpPoolStats(&pool, &stats);
+	CHECK_EQ(stats.nConnectionsOpened, (LONG)server.GetAccepted());
+	CHECK_EQ(stats.nConnectionsOpened + stats.nConnectionsReused, (LONG)(nThreads * nRequestsEach));
+	CHECK_EQ(pool.nIdle, server.GetAccepted());
+
+	DeleteHttpConnectionPool(&pool);
+	CHECK_EQ(g_nTestConnectionsOpen.load(), 0);
+}
+
+// Loopback request time with a new connection per request (as before the pool)
+// and on a kept-alive one; a real server adds its round trip to the first
+BENCHMARK(HttpPool, KeepAliveVsNewConnection)
+{
+	StandInServer server;
+	HttpConnectionPool pool;
+	InitHttpConnectionPool(&pool, OpenTestConnection, CloseTestConnection, NULL);
+	const int nRequests = 2000;
+
+	uint64_t nStart = TestNowNs();
+	for (int i = 0; i < nRequests; i++)
+	{
+		std::string body;
+		BOOL bReused = FALSE;
+		void* pConnection = SendOnHttpConnection(&pool, "127.0.0.1", server.GetPort(), 0, SendTestRequest, &body, &bReused);
+		ReleaseHttpConnection(&pool, pConnection, "127.0.0.1", server.GetPort(), 0, FALSE);
+	}
+	BENCH_REPORT("request, new connection each time", nRequests, TestNowNs() - nStart);
+
+	nStart = TestNowNs();
+	for (int i = 0; i < nRequests; i++)
+	{
+		BOOL bReused = FALSE;
+		TestRequest(&pool, server.GetPort(), 0, &bReused);
+	}
+	BENCH_REPORT("request, pooled keep-alive connection", nRequests, TestNowNs() - nStart);
+
+	DeleteHttpConnectionPool(&pool);
+}
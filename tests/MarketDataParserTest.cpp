@@ -0,0 +1,370 @@
+// MarketDataParserTest.cpp - Decimal parsing against the C library, tokenizer scope, tick timestamps
+#include "TestHarness.h"
+#include "MarketDataParser.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <time.h>
+#include <vector>
+
+static bool SameDouble(double a, double b)
+{
+	return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+static bool SameFloat(float a, float b)
+{
+	return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+// Both parsers must agree with strtod/strtof on the same bytes (no NUL needed by ours)
+static void CheckAgainstLibc(const std::string& text)
+{
+	double dExpected = strtod(text.c_str(), NULL);
+	float fExpected = strtof(text.c_str(), NULL);
+	double dActual = ParseDecimalDouble(text.data(), (int)text.size());
+	float fActual = ParseDecimalFloat(text.data(), (int)text.size());
+	if (!SameDouble(dActual, dExpected) || !SameFloat(fActual, fExpected))
+	{
+		printf("  \"%s\": double %.17g (strtod %.17g), float %.9g (strtof %.9g)\n",
+			text.c_str(), dActual, dExpected, (double)fActual, (double)fExpected);
+	}
+	CHECK(SameDouble(dActual, dExpected));
+	CHECK(SameFloat(fActual, fExpected));
+}
+
+TEST_CASE(MarketDataParser, FastPathBoundaries)
+{
+	// Double fast path: mantissa <= 2^53, |exponent| <= 22. Float: 2^24, 10.
+	static const unsigned long long s_anMantissas[] = {
+		1, 7, 9, 10, 999999, 16777215, 16777216, 16777217, 16777218, 33554431,
+		9007199254740991ULL, 9007199254740992ULL, 9007199254740993ULL, 9007199254740994ULL,
+		18014398509481983ULL, 999999999999999999ULL, 9999999999999999999ULL
+	};
+
+	char szText[64];
+	for (size_t m = 0; m < sizeof(s_anMantissas) / sizeof(s_anMantissas[0]); m++)
+	{
+		for (int nExp = -25; nExp <= 25; nExp++)
+		{
+			snprintf(szText, sizeof(szText), "%llue%d", s_anMantissas[m], nExp);
+			CheckAgainstLibc(szText);
+			snprintf(szText, sizeof(szText), "-%llue%+d", s_anMantissas[m], nExp);
+			CheckAgainstLibc(szText);
+		}
+
+		// The same mantissas written with a decimal point instead of an exponent
+		std::string digits = std::to_string(s_anMantissas[m]);
+		for (size_t nPoint = 0; nPoint <= digits.size(); nPoint++)
+		{
+			std::string text = digits.substr(0, nPoint) + "." + digits.substr(nPoint);
+			CheckAgainstLibc(text);
+			CheckAgainstLibc("0.0000" + text.substr(nPoint == 0 ? 1 : 0));
+		}
+	}
+}
+
+TEST_CASE(MarketDataParser, RandomNumbers)
+{
+	TestRandom random(2024);
+	char szText[128];
+	for (int i = 0; i < 300000; i++)
+	{
+		int nShape = random.Range(0, 3);
+		if (nShape == 0)
+		{
+			// Exchange prices: up to 6 integer digits, 0-4 decimals
+			int nDecimals = random.Range(0, 4);
+			unsigned nInteger = random.Next() % 1000000;
+			unsigned nFraction = random.Next() % 10000;
+			snprintf(szText, sizeof(szText), "%u.%0*u", nInteger, nDecimals, nFraction % (nDecimals ? (unsigned)pow(10, nDecimals) : 1));
+			if (nDecimals == 0)
+				snprintf(szText, sizeof(szText), "%u", nInteger);
+		}
+		else if (nShape == 1)
+		{
+			// Volumes and OI: integers up to 2^40
+			unsigned long long n = ((unsigned long long)random.Next() << 8) ^ random.Next();
+			snprintf(szText, sizeof(szText), "%llu", n);
+		}
+		else
+		{
+			// Anything: 1-25 significant digits, exponent -40..40
+			int nDigits = random.Range(1, 25);
+			int nPos = 0;
+			if (random.Range(0, 1))
+				szText[nPos++] = '-';
+			for (int d = 0; d < nDigits; d++)
+				szText[nPos++] = (char)('0' + random.Range(0, 9));
+			if (random.Range(0, 1))
+			{
+				int nPoint = random.Range(1, nPos);
+				memmove(szText + nPoint + 1, szText + nPoint, nPos - nPoint);
+				szText[nPoint] = '.';
+				nPos++;
+			}
+			nPos += snprintf(szText + nPos, sizeof(szText) - nPos, "e%d", random.Range(-40, 40));
+			szText[nPos] = '\0';
+		}
+		CheckAgainstLibc(szText);
+	}
+}
+
+TEST_CASE(MarketDataParser, FallbackAndEdgeCases)
+{
+	static const char* s_apszCases[] = {
+		"-0", "+0", "0", "0.0", "-0.000", "00012.50", "1e", "1e+", "1E-", "2.5E3", "-2.5e-3",
+		".5", "5.", "-.5", "1e308", "1.7976931348623157e308", "1e309", "4.9e-324", "1e-400",
+		"2.2250738585072011e-308", "1e99999999999", "1e-99999999999", "3.4028235e38", "3.4028236e38",
+		"1.17549435e-38", "1.4e-45", "7.038531e-26", "8.589973e9", "1.1754942e-38",
+		"123456789012345678901234567890", "0.1234567890123456789012345678901",
+		"9007199254740993.0000000000000000000000001", "1424.05", "1424.0500000000000000000001",
+		" 42", "\t-7.25",
+	};
+	for (size_t i = 0; i < sizeof(s_apszCases) / sizeof(s_apszCases[0]); i++)
+		CheckAgainstLibc(s_apszCases[i]);
+
+	// Long mantissas, past the 63-byte copy the fallback used to truncate to
+	std::string ones(400, '1');
+	CheckAgainstLibc(ones);
+	CheckAgainstLibc("0." + std::string(70, '0') + "1");
+	CheckAgainstLibc(std::string(80, '9') + "e-60");
+	CheckAgainstLibc("1." + std::string(100, '0') + "1");
+
+	// No digits: 0, like atof
+	static const char* s_apszEmpty[] = { "", "-", "+", ".", "-.", "e5", "abc", "null", "\"\"" };
+	for (size_t i = 0; i < sizeof(s_apszEmpty) / sizeof(s_apszEmpty[0]); i++)
+	{
+		const char* psz = s_apszEmpty[i];
+		CHECK(SameDouble(ParseDecimalDouble(psz, (int)strlen(psz)), 0.0));
+		CHECK(SameFloat(ParseDecimalFloat(psz, (int)strlen(psz)), 0.0f));
+	}
+	CHECK(signbit(ParseDecimalDouble("-0", 2)));
+	CHECK(signbit(ParseDecimalFloat("-0", 2)));
+
+	// Stops at the first character that cannot continue the number, and never reads past nLen
+	CHECK_EQ(ParseDecimalDouble("12.5,\"volume\"", 13), 12.5);
+	CHECK_EQ(ParseDecimalFloat("12.5}", 5), 12.5f);
+	CHECK_EQ(ParseDecimalDouble("123456", 3), 123.0);
+	CHECK_EQ(ParseDecimalDouble("1.5e10", 4), 1.5);
+	CHECK_EQ(ParseDecimalFloat("2e", 1), 2.0f);
+}
+
+TEST_CASE(MarketDataParser, ScanDecimalSplitsMantissaAndExponent)
+{
+	BOOL bNegative, bExact;
+	UINT64 nMantissa;
+	int nExp10;
+
+	CHECK(ScanDecimal("-1424.05", 8, &bNegative, &nMantissa, &nExp10, &bExact));
+	CHECK(bNegative && bExact);
+	CHECK_EQ(nMantissa, 142405ULL);
+	CHECK_EQ(nExp10, -2);
+
+	CHECK(ScanDecimal("0.00012e3", 9, &bNegative, &nMantissa, &nExp10, &bExact));
+	CHECK(!bNegative && bExact);
+	CHECK_EQ(nMantissa, 12ULL);
+	CHECK_EQ(nExp10, -2);
+
+	// 19 significant digits are kept; further non-zero digits make the scan inexact
+	CHECK(ScanDecimal("12345678901234567890", 20, &bNegative, &nMantissa, &nExp10, &bExact));
+	CHECK(bExact);
+	CHECK_EQ(nMantissa, 1234567890123456789ULL);
+	CHECK_EQ(nExp10, 1);
+	CHECK(ScanDecimal("12345678901234567891", 20, &bNegative, &nMantissa, &nExp10, &bExact));
+	CHECK(!bExact);
+
+	CHECK(!ScanDecimal("", 0, &bNegative, &nMantissa, &nExp10, &bExact));
+	CHECK(!ScanDecimal("-e3", 3, &bNegative, &nMantissa, &nExp10, &bExact));
+}
+
+// Typical tick fields, ours against strtof on a NUL-terminated copy
+BENCHMARK(MarketDataParser, PriceParsing)
+{
+	static const char* s_apszFields[] = {
+		"2451.35", "1234567", "0.05", "18234.9", "98.125", "45", "2460.5", "123456789",
+		"1.5e-05", "3110.4"
+	};
+	const int nFields = sizeof(s_apszFields) / sizeof(s_apszFields[0]);
+	int anLengths[nFields];
+	for (int i = 0; i < nFields; i++)
+		anLengths[i] = (int)strlen(s_apszFields[i]);
+
+	const int nRounds = 1000000;
+	volatile float fSink = 0;
+
+	uint64_t nStart = TestNowNs();
+	for (int r = 0; r < nRounds; r++)
+	{
+		for (int i = 0; i < nFields; i++)
+			fSink = fSink + ParseDecimalFloat(s_apszFields[i], anLengths[i]);
+	}
+	BENCH_REPORT("ParseDecimalFloat", (long long)nRounds * nFields, TestNowNs() - nStart);
+
+	nStart = TestNowNs();
+	for (int r = 0; r < nRounds; r++)
+	{
+		for (int i = 0; i < nFields; i++)
+		{
+			char szCopy[32];
+			memcpy(szCopy, s_apszFields[i], anLengths[i] + 1);
+			fSink = fSink + strtof(szCopy, NULL);
+		}
+	}
+	BENCH_REPORT("strtof (copy + parse)", (long long)nRounds * nFields, TestNowNs() - nStart);
+}
+
+static int ParseText(const char* pszJson, MarketTick* pTick)
+{
+	return ParseMarketDataMessage(pszJson, (int)strlen(pszJson), pTick);
+}
+
+TEST_CASE(MarketDataParser, TokenizerTakesTopLevelAndData)
+{
+	MarketTick tick;
+	CHECK_EQ(ParseText(
+		"{\"type\":\"market_data\",\"symbol\":\"RELIANCE\",\"exchange\":\"NSE\",\"mode\":3,"
+		"\"meta\":{\"ltp\":999,\"symbol\":\"WRONG\",\"type\":\"subscribe\",\"data\":{\"volume\":1}},"
+		"\"data\":{\"ltp\":1424.05,\"volume\":123456,\"timestamp\":1761190200000,"
+		"\"depth\":{\"buy\":[{\"price\":1424.0,\"quantity\":10,\"bid\":1}],\"sell\":[{\"price\":1424.1,\"ask\":2}]},"
+		"\"close\":1410.5},"
+		"\"history\":[{\"open\":1,\"close\":2},[{\"high\":3}]],\"oi\":7}", &tick), WS_MSG_MARKET_DATA);
+
+	CHECK(strcmp(tick.symbol, "RELIANCE") == 0);
+	CHECK(strcmp(tick.exchange, "NSE") == 0);
+	CHECK_EQ(tick.ltp, 1424.05f);
+	CHECK_EQ(tick.volume, 123456.0f);
+	CHECK_EQ(tick.close, 1410.5f);
+	CHECK_EQ(tick.oi, 7.0f);  // Top level, after the skipped containers
+	CHECK(strcmp(tick.timestamp, "1761190200000") == 0);
+
+	// Keys inside "meta", "depth" and "history" are never read
+	CHECK_EQ(tick.nFields, (DWORD)(TICK_FIELD_SYMBOL | TICK_FIELD_EXCHANGE | TICK_FIELD_LTP | TICK_FIELD_VOLUME |
+		TICK_FIELD_TIMESTAMP | TICK_FIELD_CLOSE | TICK_FIELD_OI));
+}
+
+TEST_CASE(MarketDataParser, TokenizerSkipsOnlyRealContainers)
+{
+	MarketTick tick;
+
+	// Braces and quotes inside strings do not open or close anything
+	CHECK_EQ(ParseText(
+		"{\"note\":{\"text\":\"} ] { \\\" [\",\"ltp\":5},\"symbol\":\"A\\\"}\",\"ltp\":12.5}", &tick), WS_MSG_MARKET_DATA);
+	CHECK_EQ(tick.ltp, 12.5f);
+	CHECK(strcmp(tick.symbol, "A\\\"}") == 0);  // Raw bytes, escapes kept
+
+	// "data" counts only at the top level and only as an object
+	CHECK_EQ(ParseText("{\"x\":{\"data\":{\"ltp\":5}},\"data\":[{\"ltp\":6}],\"symbol\":\"B\"}", &tick), WS_MSG_OTHER);
+	CHECK_EQ(tick.nFields, (DWORD)TICK_FIELD_SYMBOL);
+
+	// Keys after "data" closes are top-level again; "data" nested in "data" is skipped
+	CHECK_EQ(ParseText("{\"data\":{\"data\":{\"ltp\":1},\"bid_price\":3},\"ask_price\":4,\"symbol\":\"C\",\"ltp\":2}", &tick),
+		WS_MSG_MARKET_DATA);
+	CHECK_EQ(tick.ltp, 2.0f);
+	CHECK_EQ(tick.bid, 3.0f);
+	CHECK_EQ(tick.ask, 4.0f);
+
+	// A subscription ACK lists its symbols in an array: still an ACK, no fields
+	CHECK_EQ(ParseText("{\"type\":\"subscribe\",\"subscriptions\":[{\"symbol\":\"X\",\"exchange\":\"NSE\",\"type\":\"market_data\"}]}", &tick),
+		WS_MSG_SUBSCRIBE_ACK);
+	CHECK_EQ(tick.nFields, 0u);
+
+	// Truncated frames never read past nLength
+	const char* pszFull = "{\"symbol\":\"D\",\"data\":{\"ltp\":9,\"depth\":{\"buy\":[{\"price\":1}]}}}";
+	for (int nLen = 0; nLen <= (int)strlen(pszFull); nLen++)
+	{
+		std::vector<char> copy(pszFull, pszFull + nLen);
+		ParseMarketDataMessage(copy.data(), nLen, &tick);
+	}
+}
+
+TEST_CASE(MarketDataParser, TickTimestamps)
+{
+	CHECK_EQ(ParseTickTimestamp("1761190200000"), 1761190200LL);  // Milliseconds
+	CHECK_EQ(ParseTickTimestamp("1761190200999"), 1761190200LL);
+	CHECK_EQ(ParseTickTimestamp("1761190200"), 1761190200LL);     // Seconds
+	CHECK_EQ(ParseTickTimestamp(" 1761190200000"), 1761190200LL);
+	CHECK_EQ(ParseTickTimestamp("2025-10-23T03:30:00Z"), 1761190200LL);
+	CHECK_EQ(ParseTickTimestamp("2025-10-23T03:30:00.123Z"), 1761190200LL);
+	CHECK_EQ(ParseTickTimestamp("2025-10-23T09:00:00+05:30"), 1761190200LL);
+	CHECK_EQ(ParseTickTimestamp("2025-10-23 09:00:00+0530"), 1761190200LL);
+	CHECK_EQ(ParseTickTimestamp("2025-10-22T23:30:00-04:00"), 1761190200LL);
+	CHECK_EQ(ParseTickTimestamp("2025-10-23T03:30:00"), 1761190200LL);  // No zone: UTC
+	CHECK_EQ(ParseTickTimestamp("1970-01-01T00:00:00Z"), 0LL);
+
+	static const char* s_apszBad[] = { "", "abc", "2025-10-23", "2025-13-01T00:00:00Z", "2025-10-23T24:00:00Z",
+		"2025-10-23T03:30:00Zjunk", "2025-1-23T03:30:00Z", "1761190200000x", "99999999999999999999" };
+	for (size_t i = 0; i < sizeof(s_apszBad) / sizeof(s_apszBad[0]); i++)
+		CHECK_EQ(ParseTickTimestamp(s_apszBad[i]), -1LL);
+
+	// Every day from 1970 to 2100 against timegm()
+	for (time_t t = 0; t < 4102444800LL; t += 86400 + 3661)
+	{
+		struct tm tmUtc;
+		gmtime_r(&t, &tmUtc);
+		char szText[40];
+		strftime(szText, sizeof(szText), "%Y-%m-%dT%H:%M:%SZ", &tmUtc);
+		CHECK_EQ(ParseTickTimestamp(szText), (INT64)t);
+	}
+}
+
+// Replays tests/data/market_data_corpus.jsonl (one frame per line, the shapes the
+// OpenAlgo WebSocket sends in LTP, quote and depth modes plus subscription ACKs).
+// Set OPENALGO_CORPUS to a file of frames captured from a live feed to use that instead.
+BENCHMARK(MarketDataParser, CorpusMessages)
+{
+	const char* pszPath = getenv("OPENALGO_CORPUS");
+	if (pszPath == NULL)
+		pszPath = OPENALGO_TEST_DATA_DIR "/market_data_corpus.jsonl";
+	FILE* pFile = fopen(pszPath, "rb");
+	if (pFile == NULL)
+	{
+		printf("  cannot open %s\n", pszPath);
+		return;
+	}
+	std::vector<std::string> messages;
+	char szLine[65536];
+	size_t nBytes = 0;
+	while (fgets(szLine, sizeof(szLine), pFile) != NULL)
+	{
+		size_t nLen = strcspn(szLine, "\r\n");
+		if (nLen == 0)
+			continue;
+		messages.push_back(std::string(szLine, nLen));
+		nBytes += nLen;
+	}
+	fclose(pFile);
+	if (messages.empty())
+		return;
+
+	const int nRounds = 2000;
+	long long nMarketData = 0;
+	MarketTick tick;
+	uint64_t nStart = TestNowNs();
+	for (int r = 0; r < nRounds; r++)
+	{
+		for (size_t i = 0; i < messages.size(); i++)
+		{
+			if (ParseMarketDataMessage(messages[i].data(), (int)messages[i].size(), &tick) == WS_MSG_MARKET_DATA)
+				nMarketData++;
+		}
+	}
+	uint64_t nElapsed = TestNowNs() - nStart;
+	BENCH_REPORT("ParseMarketDataMessage", (long long)nRounds * messages.size(), nElapsed);
+	printf("  %-40s %12.1f ns/KB, %zu messages, %lld market_data\n", "",
+		(double)nElapsed * 1024.0 / ((double)nBytes * nRounds), messages.size(), nMarketData / nRounds);
+
+	volatile INT64 nSink = 0;
+	nStart = TestNowNs();
+	for (int r = 0; r < nRounds; r++)
+	{
+		for (size_t i = 0; i < messages.size(); i++)
+		{
+			ParseMarketDataMessage(messages[i].data(), (int)messages[i].size(), &tick);
+			nSink = nSink + ParseTickTimestamp(tick.timestamp);
+		}
+	}
+	BENCH_REPORT("  + ParseTickTimestamp", (long long)nRounds * messages.size(), TestNowNs() - nStart);
+}
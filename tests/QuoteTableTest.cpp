@@ -0,0 +1,189 @@
+// QuoteTableTest.cpp - Quote slot seqlock: readers against two writers (run under TSan too)
+#include "TestHarness.h"
+#include "QuoteTable.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Every field is derived from n, so a quote mixed from two writes is detectable
+static QuoteCache MakeQuote(UINT32 n)
+{
+	QuoteCache quote;
+	memset(quote.exchange, 0, sizeof(quote.exchange));
+	snprintf(quote.exchange, sizeof(quote.exchange), "X%u", n);
+	quote.ltp = (float)n;
+	quote.open = (float)n + 1.0f;
+	quote.high = (float)n + 2.0f;
+	quote.low = (float)n + 3.0f;
+	quote.close = (float)n + 4.0f;
+	quote.volume = (float)n + 5.0f;
+	quote.oi = (float)n + 6.0f;
+	quote.bid = (float)n + 7.0f;
+	quote.ask = (float)n + 8.0f;
+	quote.lastUpdate = n;
+	return quote;
+}
+
+static bool IsWholeQuote(const QuoteCache& quote)
+{
+	QuoteCache expected = MakeQuote(quote.lastUpdate);
+	return memcmp(&quote, &expected, sizeof(QuoteCache)) == 0;
+}
+
+static void StoreTestQuote(QuoteSlot* pSlot, const QuoteCache* pQuote)
+{
+	LONG nSeq = BeginQuoteWrite(pSlot);
+	WriteQuoteSlot(pSlot, pQuote);
+	EndQuoteWrite(pSlot, nSeq);
+}
+
+TEST_CASE(QuoteTable, StoreLoadClear)
+{
+	QuoteSlot slot;
+	QuoteCache quote;
+	CHECK(!LoadQuoteSlot(&slot, &quote));
+
+	QuoteCache stored = MakeQuote(42);
+	StoreTestQuote(&slot, &stored);
+	CHECK(LoadQuoteSlot(&slot, &quote));
+	CHECK(IsWholeQuote(quote));
+	CHECK_EQ(quote.lastUpdate, 42u);
+	CHECK_EQ(slot.nSeq, 2);
+
+	StoreTestQuote(&slot, NULL);
+	CHECK(!LoadQuoteSlot(&slot, &quote));
+	CHECK_EQ(slot.nSeq, 4);
+}
+
+TEST_CASE(QuoteTable, SeqlockCopiesEverySize)
+{
+	LONG aRecord[20];
+	BYTE aSource[sizeof(aRecord)];
+	BYTE aCopy[sizeof(aRecord)];
+	for (size_t nBytes = 0; nBytes <= sizeof(aRecord); nBytes++)
+	{
+		memset(aRecord, 0xCC, sizeof(aRecord));
+		for (size_t i = 0; i < nBytes; i++)
+			aSource[i] = (BYTE)(i * 7 + nBytes);
+		SeqlockStore(aRecord, aSource, nBytes);
+		CHECK(memcmp(aRecord, aSource, nBytes) == 0);
+		CHECK(nBytes == sizeof(aRecord) || ((BYTE*)aRecord)[nBytes] == 0xCC);
+
+		memset(aCopy, 0, sizeof(aCopy));
+		SeqlockLoad(aCopy, aRecord, nBytes);
+		CHECK(memcmp(aCopy, aSource, nBytes) == 0);
+	}
+}
+
+// Two writers (the I/O thread and the quote refresher) and three readers
+// (GetRecentInfo() and friends): every read is a whole quote, and each writer's
+// quotes are seen in the order it stored them. Build with -DOPENALGO_TSAN=ON to
+// have ThreadSanitizer check the accesses as well.
+TEST_CASE(QuoteTable, ConcurrentReadersAndWriters)
+{
+	const int nWriters = 2;
+	const int nReaders = 3;
+	const UINT32 nWritesEach = 200000;
+
+	QuoteSlot slot;
+	std::atomic<int> nWritersLeft(nWriters);
+	std::atomic<long long> nTorn(0);
+	std::atomic<long long> nBackwards(0);
+	std::atomic<long long> nReads(0);
+
+	std::vector<std::thread> threads;
+	for (int w = 0; w < nWriters; w++)
+	{
+		threads.push_back(std::thread([&, w]() {
+			for (UINT32 k = 1; k <= nWritesEach; k++)
+			{
+				QuoteCache quote = MakeQuote(k * nWriters + w);
+				StoreTestQuote(&slot, (k % 1000 == 500) ? NULL : &quote);
+			}
+			nWritersLeft--;
+		}));
+	}
+	for (int r = 0; r < nReaders; r++)
+	{
+		threads.push_back(std::thread([&]() {
+			UINT32 anLast[nWriters] = { 0 };
+			long long nLocalReads = 0;
+			bool bLast = false;
+			while (!bLast)
+			{
+				bLast = (nWritersLeft.load() == 0);  // One more read after the writers finish
+				QuoteCache quote;
+				LoadQuoteSlot(&slot, &quote);
+				nLocalReads++;
+				if (quote.lastUpdate == 0)
+					continue;  // Nothing stored yet
+				if (!IsWholeQuote(quote))
+				{
+					nTorn++;
+					continue;
+				}
+				UINT32 w = quote.lastUpdate % nWriters;
+				if (quote.lastUpdate < anLast[w])
+					nBackwards++;
+				anLast[w] = quote.lastUpdate;
+			}
+			nReads += nLocalReads;
+		}));
+	}
+	for (size_t i = 0; i < threads.size(); i++)
+		threads[i].join();
+
+	CHECK_EQ(nTorn.load(), 0);
+	CHECK_EQ(nBackwards.load(), 0);
+	CHECK(nReads.load() >= nReaders);
+	CHECK_EQ(slot.nSeq, (LONG)(2 * nWriters * nWritesEach));
+
+	QuoteCache quote;
+	CHECK(LoadQuoteSlot(&slot, &quote));
+	CHECK(IsWholeQuote(quote));
+}
+
+BENCHMARK(QuoteTable, LoadAndStore)
+{
+	const int nOps = 10000000;
+	QuoteSlot slot;
+	QuoteCache quote = MakeQuote(1);
+	StoreTestQuote(&slot, &quote);
+	volatile UINT32 nSink = 0;
+
+	uint64_t nStart = TestNowNs();
+	for (int i = 0; i < nOps; i++)
+	{
+		LoadQuoteSlot(&slot, &quote);
+		nSink = nSink + quote.lastUpdate;
+	}
+	BENCH_REPORT("LoadQuoteSlot (no writer)", nOps, TestNowNs() - nStart);
+
+	nStart = TestNowNs();
+	for (int i = 0; i < nOps; i++)
+	{
+		quote.lastUpdate = i;
+		StoreTestQuote(&slot, &quote);
+	}
+	BENCH_REPORT("BeginQuoteWrite + WriteQuoteSlot + End", nOps, TestNowNs() - nStart);
+
+	// A reader while the I/O thread stores a quote as fast as it can
+	std::atomic<bool> bStop(false);
+	std::thread writer([&]() {
+		QuoteCache written = MakeQuote(1);
+		while (!bStop.load(std::memory_order_relaxed))
+			StoreTestQuote(&slot, &written);
+	});
+	nStart = TestNowNs();
+	for (int i = 0; i < nOps; i++)
+	{
+		LoadQuoteSlot(&slot, &quote);
+		nSink = nSink + quote.lastUpdate;
+	}
+	BENCH_REPORT("LoadQuoteSlot (writer storing)", nOps, TestNowNs() - nStart);
+	bStop = true;
+	writer.join();
+}
@@ -0,0 +1,328 @@
+// SymbolTableTest.cpp - Ticker to ID table against std::unordered_map, lookups during growth (run under TSan too)
+#include "TestHarness.h"
+#include "SymbolTable.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Distinct tickers shaped like the real ones ("RELIANCE-NSE", "NIFTY24JUNFUT-NFO")
+static std::string MakeTicker(int n)
+{
+	static const char* const s_apExchanges[] = { "NSE", "BSE", "NFO", "MCX", "CDS" };
+	char szTicker[SYMBOL_TICKER_SIZE];
+	snprintf(szTicker, sizeof(szTicker), "S%c%c%d-%s", 'A' + n % 26, 'A' + (n / 26) % 26, n,
+		s_apExchanges[(n / 7) % 5]);
+	return szTicker;
+}
+
+// Records every SymbolChunkProc call, and checks it comes before the chunk is used
+struct ChunkLog {
+	SymbolTable* pTable;
+	std::vector<int> chunks;
+	int nOutOfOrder;
+};
+
+static void LogNewChunk(void* pContext, int nChunk)
+{
+	ChunkLog* pLog = (ChunkLog*)pContext;
+	if (SymbolTableCount(pLog->pTable) != nChunk * SYMBOL_CHUNK_SIZE || pLog->pTable->apChunks[nChunk] != NULL)
+		pLog->nOutOfOrder++;
+	pLog->chunks.push_back(nChunk);
+}
+
+TEST_CASE(SymbolTable, EmptyTable)
+{
+	SymbolTable table;
+	InitSymbolTable(&table, NULL, NULL);
+	CHECK_EQ(SymbolTableFind(&table, _T("RELIANCE-NSE")), -1);
+	CHECK_EQ(SymbolTableCount(&table), 0);
+	DeleteSymbolTable(&table);
+}
+
+// Interleaved inserts, repeat inserts and lookups of present and absent tickers
+// give the same answers as an unordered_map, through several index doublings
+// and chunk boundaries
+TEST_CASE(SymbolTable, MatchesUnorderedMap)
+{
+	const int nKeys = 20000;
+	SymbolTable table;
+	InitSymbolTable(&table, NULL, NULL);
+	std::unordered_map<std::string, int> reference;
+	TestRandom random(17);
+
+	for (int nStep = 0; nStep < 4 * nKeys; nStep++)
+	{
+		std::string ticker = MakeTicker(random.Range(0, nKeys - 1));
+		std::unordered_map<std::string, int>::const_iterator it = reference.find(ticker);
+		int nExpected = (it != reference.end()) ? it->second : -1;
+
+		if (random.Range(0, 1) == 0)
+		{
+			CHECK_EQ(SymbolTableFind(&table, ticker.c_str()), nExpected);
+			continue;
+		}
+
+		int nId = SymbolTableIntern(&table, ticker.c_str());
+		if (nExpected < 0)
+		{
+			// New tickers get the next dense ID
+			nExpected = (int)reference.size();
+			reference[ticker] = nExpected;
+		}
+		CHECK_EQ(nId, nExpected);
+		CHECK_EQ(SymbolTableCount(&table), (int)reference.size());
+	}
+	CHECK(reference.size() > 4 * SYMBOL_CHUNK_SIZE);
+	CHECK(table.pIndex->nBuckets >= 2 * reference.size());
+
+	for (std::unordered_map<std::string, int>::const_iterator it = reference.begin(); it != reference.end(); ++it)
+	{
+		CHECK_EQ(SymbolTableFind(&table, it->first.c_str()), it->second);
+		CHECK(it->first == SymbolTableTicker(&table, it->second));
+	}
+	CHECK_EQ(SymbolTableFind(&table, _T("NOT-LISTED")), -1);
+
+	DeleteSymbolTable(&table);
+}
+
+TEST_CASE(SymbolTable, PairMatchesJoinedTicker)
+{
+	SymbolTable table;
+	InitSymbolTable(&table, NULL, NULL);
+
+	int nId = SymbolTableInternPair(&table, "RELIANCE", "NSE");
+	CHECK_EQ(nId, 0);
+	CHECK_EQ(SymbolTableIntern(&table, _T("RELIANCE-NSE")), 0);
+	CHECK(strcmp(SymbolTableTicker(&table, 0), "RELIANCE-NSE") == 0);
+
+	CHECK_EQ(SymbolTableIntern(&table, _T("NIFTY-NSE_INDEX")), 1);
+	CHECK_EQ(SymbolTableInternPair(&table, "NIFTY", "NSE_INDEX"), 1);
+	CHECK_EQ(SymbolTableInternPair(&table, "NIFTY", "NSE"), 2);
+
+	// HashSymbol() over the joined ticker is the hash the pair form stores
+	int nLength;
+	CHECK_EQ(table.apChunks[0][2].nHash, HashSymbol(_T("NIFTY-NSE"), &nLength));
+	CHECK_EQ(nLength, 9);
+
+	DeleteSymbolTable(&table);
+}
+
+TEST_CASE(SymbolTable, RejectsEmptyAndLongTickers)
+{
+	SymbolTable table;
+	InitSymbolTable(&table, NULL, NULL);
+
+	char szLongest[SYMBOL_TICKER_SIZE];
+	memset(szLongest, 'A', SYMBOL_TICKER_SIZE - 1);
+	szLongest[SYMBOL_TICKER_SIZE - 1] = '\0';
+	std::string tooLong = std::string(szLongest) + "B";
+
+	CHECK_EQ(SymbolTableIntern(&table, _T("")), -1);
+	CHECK_EQ(SymbolTableIntern(&table, tooLong.c_str()), -1);
+	CHECK_EQ(SymbolTableIntern(&table, szLongest), 0);
+	CHECK(strcmp(SymbolTableTicker(&table, 0), szLongest) == 0);
+	CHECK_EQ(SymbolTableFind(&table, tooLong.c_str()), -1);
+
+	// The pair form gives up as soon as the joined ticker would not fit
+	std::string symbol(szLongest, SYMBOL_TICKER_SIZE - 5);
+	CHECK_EQ(SymbolTableInternPair(&table, symbol.c_str(), "NSE"), 1);
+	CHECK_EQ(SymbolTableInternPair(&table, symbol.c_str(), "NSEX"), -1);
+	CHECK_EQ(SymbolTableInternPair(&table, szLongest, ""), -1);
+	CHECK_EQ(SymbolTableCount(&table), 2);
+
+	DeleteSymbolTable(&table);
+}
+
+// Two tickers with the same FNV-1a hash (0x52F6F175) probe the same buckets and
+// are told apart by the string compare
+TEST_CASE(SymbolTable, SameHashDifferentTickers)
+{
+	int nLength;
+	CHECK_EQ(HashSymbol(_T("SYM899718-NSE"), &nLength), HashSymbol(_T("SYM1520662-NSE"), &nLength));
+
+	SymbolTable table;
+	InitSymbolTable(&table, NULL, NULL);
+	CHECK_EQ(SymbolTableIntern(&table, _T("SYM899718-NSE")), 0);
+	CHECK_EQ(SymbolTableFind(&table, _T("SYM1520662-NSE")), -1);
+	CHECK_EQ(SymbolTableIntern(&table, _T("SYM1520662-NSE")), 1);
+	CHECK_EQ(SymbolTableFind(&table, _T("SYM899718-NSE")), 0);
+	CHECK_EQ(SymbolTableFind(&table, _T("SYM1520662-NSE")), 1);
+	DeleteSymbolTable(&table);
+}
+
+// The chunk callback runs once per chunk, before the chunk's first ID is handed
+// out, and the table stops at SYMBOL_TABLE_MAX_SYMBOLS
+TEST_CASE(SymbolTable, ChunksAndFullTable)
+{
+	SymbolTable table;
+	ChunkLog log;
+	log.pTable = &table;
+	log.nOutOfOrder = 0;
+	InitSymbolTable(&table, LogNewChunk, &log);
+
+	for (int i = 0; i < SYMBOL_TABLE_MAX_SYMBOLS; i++)
+	{
+		if (SymbolTableIntern(&table, MakeTicker(i).c_str()) != i)
+		{
+			CHECK(false);
+			break;
+		}
+	}
+	CHECK_EQ(log.nOutOfOrder, 0);
+	CHECK_EQ((int)log.chunks.size(), SYMBOL_TABLE_MAX_CHUNKS);
+	for (size_t i = 0; i < log.chunks.size(); i++)
+		CHECK_EQ(log.chunks[i], (int)i);
+
+	CHECK_EQ(SymbolTableIntern(&table, _T("ONE-MORE")), -1);
+	CHECK_EQ(SymbolTableCount(&table), SYMBOL_TABLE_MAX_SYMBOLS);
+	CHECK_EQ(SymbolTableIntern(&table, MakeTicker(12345).c_str()), 12345);
+	CHECK_EQ(SymbolTableFind(&table, MakeTicker(SYMBOL_TABLE_MAX_SYMBOLS - 1).c_str()), SYMBOL_TABLE_MAX_SYMBOLS - 1);
+
+	DeleteSymbolTable(&table);
+}
+
+// Two writers intern the same tickers in different orders (the WebSocket thread
+// and GetQuotesEx()) while three readers look them up. A reader either misses a
+// ticker or finds the ID whose ticker is the one it asked for; every ticker ends
+// up with exactly one ID. Build with -DOPENALGO_TSAN=ON to have ThreadSanitizer
+// check the lock-free lookups as well.
+TEST_CASE(SymbolTable, ConcurrentFindWhileInterning)
+{
+	const int nKeys = 12000;
+	const int nWriters = 2;
+	const int nReaders = 3;
+
+	std::vector<std::string> tickers;
+	for (int i = 0; i < nKeys; i++)
+		tickers.push_back(MakeTicker(i));
+
+	SymbolTable table;
+	InitSymbolTable(&table, NULL, NULL);
+	std::vector<int> aWriterIds[nWriters];
+	std::atomic<int> nWritersLeft(nWriters);
+	std::atomic<long long> nWrongTicker(0);
+	std::atomic<long long> nFound(0);
+
+	std::vector<std::thread> threads;
+	for (int w = 0; w < nWriters; w++)
+	{
+		threads.push_back(std::thread([&, w]() {
+			std::vector<int>& ids = aWriterIds[w];
+			ids.assign(nKeys, -1);
+			for (int k = 0; k < nKeys; k++)
+			{
+				int i = (w == 0) ? k : nKeys - 1 - k;
+				ids[i] = SymbolTableIntern(&table, tickers[i].c_str());
+			}
+			nWritersLeft--;
+		}));
+	}
+	for (int r = 0; r < nReaders; r++)
+	{
+		threads.push_back(std::thread([&, r]() {
+			TestRandom random(100 + r);
+			long long nLocalFound = 0;
+			bool bLast = false;
+			while (!bLast)
+			{
+				bLast = (nWritersLeft.load() == 0);  // One more pass after the writers finish
+				for (int n = 0; n < 1000; n++)
+				{
+					int i = random.Range(0, nKeys - 1);
+					int nId = SymbolTableFind(&table, tickers[i].c_str());
+					if (nId < 0)
+						continue;
+					nLocalFound++;
+					if (tickers[i] != SymbolTableTicker(&table, nId))
+						nWrongTicker++;
+				}
+			}
+			nFound += nLocalFound;
+		}));
+	}
+	for (size_t i = 0; i < threads.size(); i++)
+		threads[i].join();
+
+	CHECK_EQ(nWrongTicker.load(), 0);
+	CHECK(nFound.load() > 0);
+	CHECK_EQ(SymbolTableCount(&table), nKeys);
+
+	std::vector<bool> abSeen(nKeys, false);
+	for (int i = 0; i < nKeys; i++)
+	{
+		int nId = aWriterIds[0][i];
+		CHECK(nId >= 0 && nId < nKeys);
+		CHECK_EQ(aWriterIds[1][i], nId);
+		CHECK_EQ(SymbolTableFind(&table, tickers[i].c_str()), nId);
+		if (nId >= 0 && nId < nKeys)
+		{
+			CHECK(!abSeen[nId]);
+			abSeen[nId] = true;
+		}
+	}
+
+	DeleteSymbolTable(&table);
+}
+
+// Lookups of known tickers (the per-tick path) and first-time inserts against
+// std::unordered_map<std::string, int> at watchlist-sized and larger tables
+BENCHMARK(SymbolTable, FindAndIntern)
+{
+	static const int s_anSizes[] = { 1000, 10000, 100000 };
+	const int nLookups = 2000000;
+
+	for (size_t nSize = 0; nSize < sizeof(s_anSizes) / sizeof(s_anSizes[0]); nSize++)
+	{
+		int nKeys = s_anSizes[nSize];
+		std::vector<std::string> tickers;
+		for (int i = 0; i < nKeys; i++)
+			tickers.push_back(MakeTicker(i));
+
+		std::vector<int> order(nLookups);
+		TestRandom random(5);
+		for (int i = 0; i < nLookups; i++)
+			order[i] = random.Range(0, nKeys - 1);
+
+		SymbolTable table;
+		InitSymbolTable(&table, NULL, NULL);
+		uint64_t nStart = TestNowNs();
+		for (int i = 0; i < nKeys; i++)
+			SymbolTableIntern(&table, tickers[i].c_str());
+		uint64_t nTableInsertNs = TestNowNs() - nStart;
+
+		std::unordered_map<std::string, int> map;
+		nStart = TestNowNs();
+		for (int i = 0; i < nKeys; i++)
+			map.insert(std::make_pair(std::string(tickers[i].c_str()), i));
+		uint64_t nMapInsertNs = TestNowNs() - nStart;
+
+		volatile int nSink = 0;
+		nStart = TestNowNs();
+		for (int i = 0; i < nLookups; i++)
+			nSink = nSink + SymbolTableFind(&table, tickers[order[i]].c_str());
+		uint64_t nTableFindNs = TestNowNs() - nStart;
+
+		// The callers have a C string, so the map pays for building the key too
+		nStart = TestNowNs();
+		for (int i = 0; i < nLookups; i++)
+			nSink = nSink + map.find(std::string(tickers[order[i]].c_str()))->second;
+		uint64_t nMapFindNs = TestNowNs() - nStart;
+
+		char szLabel[64];
+		snprintf(szLabel, sizeof(szLabel), "SymbolTableIntern (%d new)", nKeys);
+		BENCH_REPORT(szLabel, nKeys, nTableInsertNs);
+		snprintf(szLabel, sizeof(szLabel), "unordered_map insert (%d new)", nKeys);
+		BENCH_REPORT(szLabel, nKeys, nMapInsertNs);
+		snprintf(szLabel, sizeof(szLabel), "SymbolTableFind (%d keys)", nKeys);
+		BENCH_REPORT(szLabel, nLookups, nTableFindNs);
+		snprintf(szLabel, sizeof(szLabel), "unordered_map find (%d keys)", nKeys);
+		BENCH_REPORT(szLabel, nLookups, nMapFindNs);
+
+		DeleteSymbolTable(&table);
+	}
+}
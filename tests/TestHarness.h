@@ -0,0 +1,63 @@
+// TestHarness.h - Minimal test and benchmark registry for the engine tests
+//
+// No third-party framework: every test file registers its cases with TEST_CASE()
+// and BENCHMARK(). TestMain.cpp runs the tests (openalgo_tests) or the benchmarks
+// (openalgo_bench) whose name starts with the first command-line argument.
+#ifndef TEST_HARNESS_H
+#define TEST_HARNESS_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+typedef void (*TestFunction)(void);
+
+struct TestRegistrar {
+	TestRegistrar(const char* pszName, TestFunction pfnTest, bool bBenchmark);
+};
+
+void TestFail(const char* pszFile, int nLine, const char* pszExpression);
+
+// Nanoseconds from a monotonic clock
+uint64_t TestNowNs(void);
+
+// Deterministic pseudo-random numbers (xorshift), so a failing seed can be replayed
+struct TestRandom {
+	uint64_t nState;
+
+	explicit TestRandom(uint64_t nSeed) : nState(nSeed * 0x9E3779B97F4A7C15ULL + 1) {
+	}
+
+	uint32_t Next(void) {
+		nState ^= nState << 13;
+		nState ^= nState >> 7;
+		nState ^= nState << 17;
+		return (uint32_t)(nState >> 16);
+	}
+
+	// Uniform in [nLow, nHigh]
+	int Range(int nLow, int nHigh) {
+		return nLow + (int)(Next() % (uint32_t)(nHigh - nLow + 1));
+	}
+};
+
+#define TEST_CASE(suite, name) \
+	static void suite##_##name(void); \
+	static TestRegistrar s_test_##suite##_##name(#suite "." #name, suite##_##name, false); \
+	static void suite##_##name(void)
+
+#define BENCHMARK(suite, name) \
+	static void bench_##suite##_##name(void); \
+	static TestRegistrar s_bench_##suite##_##name(#suite "." #name, bench_##suite##_##name, true); \
+	static void bench_##suite##_##name(void)
+
+#define CHECK(cond) \
+	do { if (!(cond)) TestFail(__FILE__, __LINE__, #cond); } while (0)
+
+#define CHECK_EQ(a, b) CHECK((a) == (b))
+
+// Print one benchmark result line
+#define BENCH_REPORT(label, nOps, nElapsedNs) \
+	printf("  %-40s %12.1f ns/op  %14.0f ops/s\n", (label), \
+		(double)(nElapsedNs) / (double)(nOps), (double)(nOps) * 1e9 / (double)(nElapsedNs))
+
+#endif // TEST_HARNESS_H
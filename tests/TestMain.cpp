@@ -0,0 +1,73 @@
+// TestMain.cpp - Runs the registered tests (or benchmarks) whose name starts with argv[1]
+#include "TestHarness.h"
+
+#include <string.h>
+#include <time.h>
+
+struct RegisteredTest {
+	const char* pszName;
+	TestFunction pfnTest;
+	bool bBenchmark;
+};
+
+static RegisteredTest s_aTests[256];
+static int s_nTests = 0;
+static int s_nFailures = 0;
+
+TestRegistrar::TestRegistrar(const char* pszName, TestFunction pfnTest, bool bBenchmark)
+{
+	if (s_nTests < (int)(sizeof(s_aTests) / sizeof(s_aTests[0])))
+	{
+		s_aTests[s_nTests].pszName = pszName;
+		s_aTests[s_nTests].pfnTest = pfnTest;
+		s_aTests[s_nTests].bBenchmark = bBenchmark;
+		s_nTests++;
+	}
+}
+
+void TestFail(const char* pszFile, int nLine, const char* pszExpression)
+{
+	s_nFailures++;
+	if (s_nFailures <= 50)
+		fprintf(stderr, "%s:%d: CHECK failed: %s\n", pszFile, nLine, pszExpression);
+}
+
+uint64_t TestNowNs(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+int main(int argc, char** argv)
+{
+#ifdef OPENALGO_BENCHMARKS
+	const bool bBenchmarks = true;
+#else
+	const bool bBenchmarks = false;
+#endif
+	const char* pszFilter = (argc > 1) ? argv[1] : "";
+
+	int nRun = 0;
+	for (int i = 0; i < s_nTests; i++)
+	{
+		if (s_aTests[i].bBenchmark != bBenchmarks || strncmp(s_aTests[i].pszName, pszFilter, strlen(pszFilter)) != 0)
+			continue;
+
+		int nFailuresBefore = s_nFailures;
+		printf("[ RUN  ] %s\n", s_aTests[i].pszName);
+		fflush(stdout);
+		s_aTests[i].pfnTest();
+		printf("[ %s ] %s\n", s_nFailures == nFailuresBefore ? " OK " : "FAIL", s_aTests[i].pszName);
+		nRun++;
+	}
+
+	if (nRun == 0)
+	{
+		fprintf(stderr, "No test matches \"%s\"\n", pszFilter);
+		return 1;
+	}
+
+	printf("%d run, %d check(s) failed\n", nRun, s_nFailures);
+	return s_nFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,342 @@
+// TickJournalTest.cpp - Where replay cuts off a truncated or damaged journal, day boundaries
+#include "TestHarness.h"
+#include "TickJournal.h"
+#include "Calendar.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+// The bytes after the header, read in whatever pieces the reader allows
+struct MemoryJournal {
+	const BYTE* pData;
+	size_t nSize;
+	size_t nPos;
+	DWORD dwMaxRead;         // 0 = as much as asked for, like ReadFile on a local file
+};
+
+static BOOL ReadMemoryJournal(void* pReader, void* pBuffer, DWORD dwBytes, DWORD* pdwRead)
+{
+	MemoryJournal* pJournal = (MemoryJournal*)pReader;
+	size_t nCopy = pJournal->nSize - pJournal->nPos;
+	if (nCopy > dwBytes)
+		nCopy = dwBytes;
+	if (pJournal->dwMaxRead != 0 && nCopy > pJournal->dwMaxRead)
+		nCopy = pJournal->dwMaxRead;
+	memcpy(pBuffer, pJournal->pData + pJournal->nPos, nCopy);
+	pJournal->nPos += nCopy;
+	*pdwRead = (DWORD)nCopy;
+	return TRUE;
+}
+
+static void CollectRecord(void* pContext, const TickJournalRecord* pRecord)
+{
+	((std::vector<TickJournalRecord>*)pContext)->push_back(*pRecord);
+}
+
+static std::vector<BYTE> MakeJournal(int nRecords)
+{
+	std::vector<BYTE> bytes(nRecords * sizeof(TickJournalRecord));
+	TickJournalRecord* pRecords = (TickJournalRecord*)bytes.data();
+	static const char* s_apszTickers[] = { "RELIANCE-NSE", "NIFTY28OCT2525000CE-NFO", "CRUDEOIL19NOV25FUT-MCX" };
+	for (int i = 0; i < nRecords; i++)
+	{
+		CHECK(FillTickJournalRecord(&pRecords[i], 1761190200LL + i, 1424.05f + i * 0.05f, (float)(i % 100 + 1),
+			s_apszTickers[i % 3]));
+	}
+	return bytes;
+}
+
+static INT64 Replay(const std::vector<BYTE>& bytes, size_t nSize, DWORD dwMaxRead,
+	std::vector<TickJournalRecord>* pApplied, BOOL* pbTorn)
+{
+	MemoryJournal journal = { bytes.data(), nSize, 0, dwMaxRead };
+	pApplied->clear();
+	return ReplayTickJournalRecords(ReadMemoryJournal, &journal, CollectRecord, pApplied, pbTorn);
+}
+
+TEST_CASE(TickJournal, RecordLayout)
+{
+	CHECK_EQ(sizeof(TickJournalRecord), 64u);
+	CHECK_EQ(sizeof(TickJournalFileHeader), (size_t)TICK_JOURNAL_HEADER_SIZE);
+
+	TickJournalFileHeader header;
+	InitTickJournalHeader(&header);
+	CHECK(IsTickJournalHeaderValid(&header));
+	header.nRecordSize = 48;
+	CHECK(!IsTickJournalHeaderValid(&header));
+
+	TickJournalRecord record;
+	CHECK(FillTickJournalRecord(&record, 1, 2.0f, 3.0f, "ABCDEFGHIJKLMNOPQRSTUVWXYZABCDEFGHIJKLM-NSE"));  // 43 chars
+	CHECK(!FillTickJournalRecord(&record, 1, 2.0f, 3.0f, "ABCDEFGHIJKLMNOPQRSTUVWXYZABCDEFGHIJKLMN-NSE"));
+}
+
+// Cut the file at every byte: replay keeps exactly the whole records before the cut
+TEST_CASE(TickJournal, TruncatedMidRecord)
+{
+	const int nRecords = 20;
+	std::vector<BYTE> bytes = MakeJournal(nRecords);
+	std::vector<TickJournalRecord> applied;
+
+	for (size_t nSize = 0; nSize <= bytes.size(); nSize++)
+	{
+		BOOL bTorn = FALSE;
+		INT64 nGood = Replay(bytes, nSize, 0, &applied, &bTorn);
+		CHECK_EQ(nGood, (INT64)(nSize / sizeof(TickJournalRecord)));
+		CHECK_EQ(bTorn, (BOOL)(nSize % sizeof(TickJournalRecord) != 0));
+		CHECK_EQ((INT64)applied.size(), nGood);
+		if (!applied.empty())
+			CHECK(memcmp(applied.data(), bytes.data(), applied.size() * sizeof(TickJournalRecord)) == 0);
+	}
+}
+
+// Past the 1 MB replay buffer, so a cut can land in the second read
+TEST_CASE(TickJournal, TruncatedAcrossReadBuffer)
+{
+	const int nRecords = TICK_JOURNAL_REPLAY_RECORDS * 2 + 100;
+	std::vector<BYTE> bytes = MakeJournal(nRecords);
+	std::vector<TickJournalRecord> applied;
+
+	const size_t nRecord = sizeof(TickJournalRecord);
+	const size_t nBuffer = TICK_JOURNAL_REPLAY_RECORDS * nRecord;
+	size_t anCuts[] = { nBuffer - 1, nBuffer, nBuffer + 1, nBuffer + nRecord - 1, nBuffer + nRecord,
+		2 * nBuffer + 37, bytes.size() - 1, bytes.size() };
+	for (size_t i = 0; i < sizeof(anCuts) / sizeof(anCuts[0]); i++)
+	{
+		BOOL bTorn = FALSE;
+		CHECK_EQ(Replay(bytes, anCuts[i], 0, &applied, &bTorn), (INT64)(anCuts[i] / nRecord));
+		CHECK_EQ(bTorn, (BOOL)(anCuts[i] % nRecord != 0));
+	}
+
+	// A reader that returns short pieces: a piece that ends mid-record ends the replay
+	BOOL bTorn = FALSE;
+	CHECK_EQ(Replay(bytes, bytes.size(), 4096, &applied, &bTorn), (INT64)nRecords);
+	CHECK(!bTorn);
+	CHECK_EQ(Replay(bytes, bytes.size(), 4000, &applied, &bTorn), 62);  // 4000 = 62.5 records
+	CHECK(bTorn);
+}
+
+// A damaged record stops the replay there; nothing after it is applied
+TEST_CASE(TickJournal, DamagedRecord)
+{
+	const int nRecords = 50;
+	std::vector<TickJournalRecord> applied;
+	TestRandom random(11);
+
+	for (int nTrial = 0; nTrial < 500; nTrial++)
+	{
+		std::vector<BYTE> bytes = MakeJournal(nRecords);
+		int nBad = random.Range(0, nRecords - 1);
+		int nByte = random.Range(0, (int)sizeof(TickJournalRecord) - 1);
+		bytes[nBad * sizeof(TickJournalRecord) + nByte] ^= (BYTE)(1 << random.Range(0, 7));
+
+		BOOL bTorn = FALSE;
+		CHECK_EQ(Replay(bytes, bytes.size(), 0, &applied, &bTorn), nBad);
+		CHECK(bTorn);
+	}
+
+	// A checksum that matches but a ticker without its NUL (a record from a bigger layout)
+	std::vector<BYTE> bytes = MakeJournal(3);
+	TickJournalRecord* pRecord = (TickJournalRecord*)bytes.data() + 1;
+	memset(pRecord->szTicker, 'A', TICK_JOURNAL_TICKER_SIZE);
+	pRecord->nChecksum = TickJournalChecksum(pRecord);
+	BOOL bTorn = FALSE;
+	CHECK_EQ(Replay(bytes, bytes.size(), 0, &applied, &bTorn), 1);
+	CHECK(bTorn);
+
+	// All zeros (a file extended but never written) is not a record either
+	std::vector<BYTE> zeros(10 * sizeof(TickJournalRecord), 0);
+	CHECK_EQ(Replay(zeros, zeros.size(), 0, &applied, &bTorn), 0);
+	CHECK(bTorn);
+}
+
+TEST_CASE(TickJournal, DaysInExchangeTime)
+{
+	const int nIst = CALENDAR_UTC_OFFSET_IST * 60;
+	INT64 nDayStart, nRotateAt;
+	int nDate;
+
+	// 2025-10-23 23:59:59 IST is still the 23rd; a second later is the 24th
+	GetTickJournalDay(1761243999LL, nIst, &nDayStart, &nRotateAt, &nDate);
+	CHECK_EQ(nDate, 20251023);
+	CHECK_EQ(nDayStart, 1761157800LL);  // 2025-10-23 00:00 IST
+	CHECK_EQ(nRotateAt, 1761244200LL);
+	GetTickJournalDay(nRotateAt, nIst, &nDayStart, &nRotateAt, &nDate);
+	CHECK_EQ(nDate, 20251024);
+
+	// Every 7 hours for 50 years, against gmtime, in a few zones
+	static const int s_anOffsets[] = { nIst, 0, -5 * 3600, 9 * 3600 + 1800 };
+	for (size_t z = 0; z < sizeof(s_anOffsets) / sizeof(s_anOffsets[0]); z++)
+	{
+		for (INT64 t = 631152000LL; t < 2208988800LL; t += 7 * 3600 + 11)
+		{
+			GetTickJournalDay(t, s_anOffsets[z], &nDayStart, &nRotateAt, &nDate);
+			time_t local = (time_t)(t + s_anOffsets[z]);
+			struct tm tmLocal;
+			gmtime_r(&local, &tmLocal);
+			CHECK_EQ(nDate, (tmLocal.tm_year + 1900) * 10000 + (tmLocal.tm_mon + 1) * 100 + tmLocal.tm_mday);
+			CHECK(nDayStart <= t && t < nRotateAt);
+			CHECK_EQ(nRotateAt - nDayStart, 86400);
+			CHECK_EQ(nDayStart, (INT64)local - (tmLocal.tm_hour * 3600 + tmLocal.tm_min * 60 + tmLocal.tm_sec) - s_anOffsets[z]);
+		}
+	}
+}
+
+// Counts what the writer asks of the file
+struct CountingJournal {
+	std::vector<BYTE> bytes;
+	int nWrites;
+	int nSyncs;
+	size_t nSynced;          // Bytes written before the last sync
+};
+
+static BOOL WriteCountingJournal(void* pWriter, const void* pBuffer, DWORD dwBytes)
+{
+	CountingJournal* pJournal = (CountingJournal*)pWriter;
+	pJournal->bytes.insert(pJournal->bytes.end(), (const BYTE*)pBuffer, (const BYTE*)pBuffer + dwBytes);
+	pJournal->nWrites++;
+	return TRUE;
+}
+
+static void SyncCountingJournal(void* pWriter)
+{
+	CountingJournal* pJournal = (CountingJournal*)pWriter;
+	pJournal->nSyncs++;
+	pJournal->nSynced = pJournal->bytes.size();
+}
+
+TEST_CASE(TickJournal, WriterBatchesAndSyncs)
+{
+	CountingJournal file = { std::vector<BYTE>(), 0, 0, 0 };
+	TickJournalWriter* pJournal = new TickJournalWriter;  // 64 KB buffer - not on the stack
+	CHECK(!AppendTickJournalRecord(pJournal, 1761190200LL, 1.0f, 1.0f, "RELIANCE-NSE"));  // No file yet
+	OpenTickJournalWriter(pJournal, WriteCountingJournal, SyncCountingJournal, &file, 5000);
+
+	// A full buffer goes out at once, in one write
+	std::vector<BYTE> expected = MakeJournal(TICK_JOURNAL_BUFFER_RECORDS + 10);
+	const TickJournalRecord* pRecords = (const TickJournalRecord*)expected.data();
+	for (int i = 0; i < TICK_JOURNAL_BUFFER_RECORDS; i++)
+	{
+		CHECK(AppendTickJournalRecord(pJournal, pRecords[i].nTimestamp, pRecords[i].fLtp, pRecords[i].fLastTradeQty,
+			pRecords[i].szTicker));
+	}
+	CHECK_EQ(file.nWrites, 1);
+	CHECK_EQ(file.bytes.size(), (size_t)TICK_JOURNAL_BUFFER_RECORDS * sizeof(TickJournalRecord));
+	CHECK(!AppendTickJournalRecord(pJournal, 1761190200LL, 1.0f, 1.0f, "A-TICKER-THAT-DOES-NOT-FIT-IN-A-JOURNAL-RECORD"));
+
+	// Batches are written on every flush but synced once per interval
+	for (int i = TICK_JOURNAL_BUFFER_RECORDS; i < TICK_JOURNAL_BUFFER_RECORDS + 10; i++)
+	{
+		CHECK(AppendTickJournalRecord(pJournal, pRecords[i].nTimestamp, pRecords[i].fLtp, pRecords[i].fLastTradeQty,
+			pRecords[i].szTicker));
+		FlushTickJournalWriter(pJournal, FALSE, 5000 + i - TICK_JOURNAL_BUFFER_RECORDS, 1000);
+	}
+	CHECK_EQ(file.nWrites, 11);
+	CHECK_EQ(file.nSyncs, 0);
+	CHECK(file.bytes == expected);
+
+	FlushTickJournalWriter(pJournal, FALSE, 6000, 1000);
+	CHECK_EQ(file.nSyncs, 1);
+	CHECK_EQ(file.nSynced, expected.size());
+	FlushTickJournalWriter(pJournal, FALSE, 9000, 1000);   // Nothing new - no sync
+	CHECK_EQ(file.nSyncs, 1);
+	CHECK_EQ(file.nWrites, 11);
+
+	// bSync (the I/O thread stopping) syncs at once; close writes and syncs the rest
+	CHECK(AppendTickJournalRecord(pJournal, 1761190300LL, 2.0f, 1.0f, "RELIANCE-NSE"));
+	FlushTickJournalWriter(pJournal, TRUE, 9001, 1000);
+	CHECK_EQ(file.nSyncs, 2);
+	CHECK(AppendTickJournalRecord(pJournal, 1761190301LL, 2.0f, 1.0f, "RELIANCE-NSE"));
+	CloseTickJournalWriter(pJournal);
+	CHECK_EQ(file.nSyncs, 3);
+	CHECK_EQ(file.nSynced, expected.size() + 2 * sizeof(TickJournalRecord));
+	CHECK(!AppendTickJournalRecord(pJournal, 1761190302LL, 2.0f, 1.0f, "RELIANCE-NSE"));
+	delete pJournal;
+}
+
+// The file backend of the write benchmark: write() and fdatasync(), as WriteFile()
+// and FlushFileBuffers() are in the plugin
+static BOOL WriteJournalFd(void* pWriter, const void* pBuffer, DWORD dwBytes)
+{
+	return write(*(int*)pWriter, pBuffer, dwBytes) == (ssize_t)dwBytes;
+}
+
+static void SyncJournalFd(void* pWriter)
+{
+	fdatasync(*(int*)pWriter);
+}
+
+// The live write path on a busy feed: 20,000 ticks/s arriving in drained batches
+// of 64, each batch flushed as the I/O thread does, synced every JournalFsyncMs of
+// feed time (and, for comparison, after every batch). The feed clock is simulated,
+// so the file sees the syncs of 10 s of feed however fast the writes run. Put
+// TMPDIR on a real disk to measure the syncs; on tmpfs they cost nothing.
+BENCHMARK(TickJournal, Write)
+{
+	const int nTicks = 200000;
+	const int nTicksPerSec = 20000;
+	const int nBatch = 64;
+	std::vector<BYTE> bytes = MakeJournal(nTicks);
+	const TickJournalRecord* pRecords = (const TickJournalRecord*)bytes.data();
+
+	const char* pszTmp = getenv("TMPDIR");
+	std::string dir = std::string(pszTmp != NULL ? pszTmp : "/tmp") + "/openalgo-journal-XXXXXX";
+	std::vector<char> szDir(dir.begin(), dir.end());
+	szDir.push_back('\0');
+	CHECK(mkdtemp(szDir.data()) != NULL);
+	std::string path = std::string(szDir.data()) + "/ticks.bin";
+
+	static const DWORD s_adwFsyncMs[] = { TICK_JOURNAL_FSYNC_MS_DEFAULT, 0 };
+	for (size_t f = 0; f < sizeof(s_adwFsyncMs) / sizeof(s_adwFsyncMs[0]); f++)
+	{
+		int nFd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		CHECK(nFd >= 0);
+		TickJournalWriter* pJournal = new TickJournalWriter;
+		OpenTickJournalWriter(pJournal, WriteJournalFd, SyncJournalFd, &nFd, 0);
+
+		uint64_t nStart = TestNowNs();
+		for (int i = 0; i < nTicks; i++)
+		{
+			AppendTickJournalRecord(pJournal, pRecords[i].nTimestamp, pRecords[i].fLtp, pRecords[i].fLastTradeQty,
+				pRecords[i].szTicker);
+			if ((i + 1) % nBatch == 0)
+				FlushTickJournalWriter(pJournal, FALSE, (DWORD)((INT64)(i + 1) * 1000 / nTicksPerSec), s_adwFsyncMs[f]);
+		}
+		CloseTickJournalWriter(pJournal);
+		uint64_t nElapsed = TestNowNs() - nStart;
+
+		CHECK_EQ((long long)lseek(nFd, 0, SEEK_END), (long long)nTicks * (long long)sizeof(TickJournalRecord));
+		close(nFd);
+		delete pJournal;
+
+		char szLabel[64];
+		if (s_adwFsyncMs[f] > 0)
+			snprintf(szLabel, sizeof(szLabel), "append + flush, fsync every %lu ms (per tick)", (unsigned long)s_adwFsyncMs[f]);
+		else
+			snprintf(szLabel, sizeof(szLabel), "append + flush, fsync every batch (per tick)");
+		BENCH_REPORT(szLabel, nTicks, nElapsed);
+		printf("  %-40s %12.1f MB/s\n", "", (double)nTicks * sizeof(TickJournalRecord) * 1000.0 / nElapsed);
+	}
+
+	unlink(path.c_str());
+	rmdir(szDir.data());
+}
+
+// Init() replays a full trading day; this is the journal part of that cost
+BENCHMARK(TickJournal, Replay)
+{
+	const int nRecords = 1000000;
+	std::vector<BYTE> bytes = MakeJournal(nRecords);
+	std::vector<TickJournalRecord> applied;
+	applied.reserve(nRecords);
+
+	uint64_t nStart = TestNowNs();
+	BOOL bTorn = FALSE;
+	Replay(bytes, bytes.size(), 0, &applied, &bTorn);
+	BENCH_REPORT("ReplayTickJournalRecords", nRecords, TestNowNs() - nStart);
+}
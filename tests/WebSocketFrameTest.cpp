@@ -0,0 +1,400 @@
+// WebSocketFrameTest.cpp - Frame reassembly under arbitrary TCP segmentation, masking
+#include "TestHarness.h"
+#include "WebSocketFrame.h"
+
+#include <string>
+#include <vector>
+
+struct ExpectedFrame {
+	unsigned char opcode;
+	bool bFinal;
+	std::string payload;
+};
+
+// Append one frame; 7-bit, 16-bit (126) or 64-bit (127) length as RFC 6455 requires
+static void AppendFrame(std::string* pStream, unsigned char opcode, bool bFinal, const std::string& payload, bool bMasked)
+{
+	size_t nLen = payload.size();
+	pStream->push_back((char)((bFinal ? 0x80 : 0x00) | opcode));
+
+	unsigned char maskBit = bMasked ? 0x80 : 0x00;
+	if (nLen <= 125)
+	{
+		pStream->push_back((char)(maskBit | nLen));
+	}
+	else if (nLen <= 0xFFFF)
+	{
+		pStream->push_back((char)(maskBit | 126));
+		pStream->push_back((char)(nLen >> 8));
+		pStream->push_back((char)(nLen & 0xFF));
+	}
+	else
+	{
+		pStream->push_back((char)(maskBit | 127));
+		for (int i = 7; i >= 0; i--)
+			pStream->push_back((char)((uint64_t)nLen >> (i * 8)));
+	}
+
+	std::string body = payload;
+	if (bMasked)
+	{
+		const unsigned char key[4] = { 0x37, 0xFA, 0x21, 0x3D };
+		pStream->append((const char*)key, 4);
+		WebSocketMaskPayload((unsigned char*)&body[0], (int)body.size(), key);
+	}
+	pStream->append(body);
+}
+
+static std::string MakePayload(TestRandom* pRandom, int nLen)
+{
+	std::string payload(nLen, '\0');
+	for (int i = 0; i < nLen; i++)
+		payload[i] = (char)pRandom->Next();
+	return payload;
+}
+
+// A mix of every frame shape the server can send: small market_data text frames,
+// 126 and 127 extended lengths, fragmented messages and control frames in between
+static void BuildStream(TestRandom* pRandom, std::string* pStream, std::vector<ExpectedFrame>* pFrames)
+{
+	static const int s_anSizes[] = { 0, 1, 125, 126, 127, 300, 65535, 65536, 70000, 200000 };
+
+	for (int n = 0; n < 60; n++)
+	{
+		ExpectedFrame frame;
+		int nKind = pRandom->Range(0, 9);
+		if (nKind < 5)
+		{
+			frame.opcode = 0x1;
+			frame.bFinal = true;
+			frame.payload = MakePayload(pRandom, pRandom->Range(20, 400));
+		}
+		else if (nKind < 7)
+		{
+			frame.opcode = (nKind == 5) ? 0x1 : 0x2;
+			frame.bFinal = true;
+			frame.payload = MakePayload(pRandom, s_anSizes[pRandom->Range(0, 9)]);
+		}
+		else if (nKind == 7)
+		{
+			// Fragmented message with a PING between the fragments
+			ExpectedFrame first = { 0x1, false, MakePayload(pRandom, 200) };
+			ExpectedFrame ping = { 0x9, true, MakePayload(pRandom, pRandom->Range(0, 125)) };
+			ExpectedFrame last = { 0x0, true, MakePayload(pRandom, 90) };
+			AppendFrame(pStream, first.opcode, first.bFinal, first.payload, false);
+			AppendFrame(pStream, ping.opcode, ping.bFinal, ping.payload, false);
+			pFrames->push_back(first);
+			pFrames->push_back(ping);
+			frame = last;
+		}
+		else
+		{
+			frame.opcode = (nKind == 8) ? 0xA : 0x9;  // PONG / PING
+			frame.bFinal = true;
+			frame.payload = MakePayload(pRandom, pRandom->Range(0, 125));
+		}
+
+		AppendFrame(pStream, frame.opcode, frame.bFinal, frame.payload, pRandom->Range(0, 7) == 0);
+		pFrames->push_back(frame);
+	}
+}
+
+// Feed pStream in pieces of nMinChunk..nMaxChunk bytes, extracting after every piece
+static void FeedAndCheck(const std::string& stream, const std::vector<ExpectedFrame>& frames, TestRandom* pRandom,
+	int nMinChunk, int nMaxChunk)
+{
+	WebSocketRecvBuffer buffer;
+	size_t nFed = 0;
+	size_t nNext = 0;
+
+	while (nFed < stream.size())
+	{
+		int nFree = 0;
+		char* pWrite = WsRecvBufferPrepare(&buffer, &nFree);
+		CHECK(pWrite != NULL && nFree > 0);
+		if (pWrite == NULL || nFree <= 0)
+			break;
+
+		int nChunk = pRandom->Range(nMinChunk, nMaxChunk);
+		if (nChunk > nFree)
+			nChunk = nFree;
+		if ((size_t)nChunk > stream.size() - nFed)
+			nChunk = (int)(stream.size() - nFed);
+		memcpy(pWrite, stream.data() + nFed, nChunk);
+		WsRecvBufferCommit(&buffer, nChunk);
+		nFed += nChunk;
+
+		WebSocketFrame frame;
+		int nResult;
+		while ((nResult = WsRecvBufferExtractFrame(&buffer, &frame)) == WS_FRAME_COMPLETE)
+		{
+			CHECK(nNext < frames.size());
+			if (nNext >= frames.size())
+				break;
+			const ExpectedFrame& expected = frames[nNext++];
+			CHECK_EQ(frame.opcode, expected.opcode);
+			CHECK_EQ(frame.bFinal != FALSE, expected.bFinal);
+			CHECK_EQ(frame.nPayloadLen, (int)expected.payload.size());
+			CHECK(frame.nPayloadLen == (int)expected.payload.size() &&
+				memcmp(frame.pPayload, expected.payload.data(), expected.payload.size()) == 0);
+		}
+		CHECK(nResult != WS_FRAME_ERROR);
+	}
+
+	CHECK_EQ(nNext, frames.size());
+	CHECK_EQ(buffer.nReadPos, buffer.nWritePos);
+	WsRecvBufferFree(&buffer);
+}
+
+TEST_CASE(WebSocketFrame, RandomSplits)
+{
+	for (int nSeed = 1; nSeed <= 40; nSeed++)
+	{
+		TestRandom random(nSeed);
+		std::string stream;
+		std::vector<ExpectedFrame> frames;
+		BuildStream(&random, &stream, &frames);
+
+		FeedAndCheck(stream, frames, &random, 1, 7);         // Header bytes split across reads
+		FeedAndCheck(stream, frames, &random, 1, 3000);      // Typical segments
+		FeedAndCheck(stream, frames, &random, 4096, 70000);  // Many frames coalesced per read
+	}
+}
+
+TEST_CASE(WebSocketFrame, ExtendedLengthBoundaries)
+{
+	static const int s_anSizes[] = { 125, 126, 127, 65535, 65536 };
+	for (int i = 0; i < 5; i++)
+	{
+		TestRandom random(100 + i);
+		std::string stream;
+		std::vector<ExpectedFrame> frames;
+		ExpectedFrame frame = { 0x2, true, MakePayload(&random, s_anSizes[i]) };
+		AppendFrame(&stream, frame.opcode, frame.bFinal, frame.payload, false);
+		frames.push_back(frame);
+
+		// 126 uses a 4-byte header, 127 a 10-byte header
+		size_t nHeader = (s_anSizes[i] <= 125) ? 2 : (s_anSizes[i] <= 0xFFFF ? 4 : 10);
+		CHECK_EQ(stream.size(), nHeader + (size_t)s_anSizes[i]);
+		FeedAndCheck(stream, frames, &random, 1, 1);
+	}
+}
+
+TEST_CASE(WebSocketFrame, MaskedFrameIsUnmasked)
+{
+	TestRandom random(7);
+	std::string stream;
+	std::vector<ExpectedFrame> frames;
+	ExpectedFrame frame = { 0x1, true, "{\"type\":\"market_data\",\"symbol\":\"RELIANCE\"}" };
+	AppendFrame(&stream, frame.opcode, frame.bFinal, frame.payload, true);
+	frames.push_back(frame);
+	FeedAndCheck(stream, frames, &random, 1, 5);
+}
+
+TEST_CASE(WebSocketFrame, ProtocolErrors)
+{
+	// Control frame longer than 125 bytes
+	{
+		WebSocketRecvBuffer buffer;
+		std::string stream;
+		AppendFrame(&stream, 0x9, true, std::string(126, 'x'), false);
+		int nFree = 0;
+		char* pWrite = WsRecvBufferPrepare(&buffer, &nFree);
+		memcpy(pWrite, stream.data(), stream.size());
+		WsRecvBufferCommit(&buffer, (int)stream.size());
+		WebSocketFrame frame;
+		CHECK_EQ(WsRecvBufferExtractFrame(&buffer, &frame), WS_FRAME_ERROR);
+		WsRecvBufferFree(&buffer);
+	}
+
+	// Data frame larger than WS_RECV_BUFFER_MAX_SIZE (only the header is needed)
+	{
+		WebSocketRecvBuffer buffer;
+		unsigned char header[10] = { 0x82, 127 };
+		uint64_t nLen = (uint64_t)WS_RECV_BUFFER_MAX_SIZE + 1;
+		for (int i = 0; i < 8; i++)
+			header[2 + i] = (unsigned char)(nLen >> ((7 - i) * 8));
+		int nFree = 0;
+		char* pWrite = WsRecvBufferPrepare(&buffer, &nFree);
+		memcpy(pWrite, header, sizeof(header));
+		WsRecvBufferCommit(&buffer, sizeof(header));
+		WebSocketFrame frame;
+		CHECK_EQ(WsRecvBufferExtractFrame(&buffer, &frame), WS_FRAME_ERROR);
+		WsRecvBufferFree(&buffer);
+	}
+}
+
+TEST_CASE(WebSocketFrame, PartialHeaderIsIncomplete)
+{
+	WebSocketRecvBuffer buffer;
+	std::string stream;
+	AppendFrame(&stream, 0x2, true, std::string(70000, 'y'), false);
+
+	// Feed the 10-byte header one byte at a time
+	for (int i = 0; i < 10; i++)
+	{
+		int nFree = 0;
+		char* pWrite = WsRecvBufferPrepare(&buffer, &nFree);
+		pWrite[0] = stream[i];
+		WsRecvBufferCommit(&buffer, 1);
+		WebSocketFrame frame;
+		CHECK_EQ(WsRecvBufferExtractFrame(&buffer, &frame), WS_FRAME_INCOMPLETE);
+	}
+
+	// The pending size is known once the header is in - Prepare() grows the buffer
+	CHECK_EQ(buffer.nPendingFrame, (int)stream.size());
+	int nFree = 0;
+	WsRecvBufferPrepare(&buffer, &nFree);
+	CHECK(buffer.nCapacity >= (int)stream.size());
+	WsRecvBufferFree(&buffer);
+}
+
+// RFC 6455 as written: byte i is XORed with key byte i % 4
+static void ReferenceMask(unsigned char* pData, int nLength, const unsigned char* maskKey)
+{
+	for (int i = 0; i < nLength; i++)
+		pData[i] ^= maskKey[i % 4];
+}
+
+// Every length up to a few SIMD blocks at every alignment, so each head, block
+// and tail combination of the kernel runs; the bytes around the payload stay put
+static void CheckMaskAgainstReference(TestRandom* pRandom, int nLength, int nOffset)
+{
+	const int nGuard = 64;
+	std::vector<unsigned char> buffer(nOffset + nLength + 2 * nGuard);
+	for (size_t i = 0; i < buffer.size(); i++)
+		buffer[i] = (unsigned char)pRandom->Next();
+	unsigned char key[4];
+	for (int k = 0; k < 4; k++)
+		key[k] = (unsigned char)pRandom->Next();
+
+	std::vector<unsigned char> expected = buffer;
+	unsigned char* pData = buffer.data() + nGuard + nOffset;
+	ReferenceMask(expected.data() + nGuard + nOffset, nLength, key);
+	WebSocketMaskPayload(pData, nLength, key);
+	CHECK(memcmp(buffer.data(), expected.data(), buffer.size()) == 0);
+}
+
+TEST_CASE(WebSocketFrame, MaskMatchesReference)
+{
+	TestRandom random(4);
+	for (int nLength = 0; nLength <= 200; nLength++)
+	{
+		for (int nOffset = 0; nOffset < 32; nOffset++)
+			CheckMaskAgainstReference(&random, nLength, nOffset);
+	}
+	for (int n = 0; n < 200; n++)
+		CheckMaskAgainstReference(&random, random.Range(200, 70000), random.Range(0, 31));
+}
+
+TEST_CASE(WebSocketFrame, MaskEdgeCases)
+{
+	TestRandom random(5);
+	std::string payload = MakePayload(&random, 1000);
+	const unsigned char key[4] = { 0x01, 0x80, 0xFF, 0x7E };
+
+	// Masking twice restores the payload
+	std::string body = payload;
+	WebSocketMaskPayload((unsigned char*)&body[0], (int)body.size(), key);
+	CHECK(body != payload);
+	WebSocketMaskPayload((unsigned char*)&body[0], (int)body.size(), key);
+	CHECK(body == payload);
+
+	// A zero key leaves the payload alone; nothing happens for empty or NULL payloads
+	const unsigned char zero[4] = { 0, 0, 0, 0 };
+	WebSocketMaskPayload((unsigned char*)&body[0], (int)body.size(), zero);
+	CHECK(body == payload);
+	WebSocketMaskPayload((unsigned char*)&body[0], 0, key);
+	WebSocketMaskPayload((unsigned char*)&body[0], -1, key);
+	WebSocketMaskPayload(NULL, 10, key);
+	CHECK(body == payload);
+
+	// The key read from a received frame sits right in front of the payload
+	for (int nLength = 0; nLength < 100; nLength++)
+	{
+		std::string frame = std::string((const char*)key, 4) + payload.substr(0, nLength);
+		std::string expected = frame;
+		ReferenceMask((unsigned char*)&expected[4], nLength, key);
+		WebSocketMaskPayload((unsigned char*)&frame[4], nLength, (const unsigned char*)&frame[0]);
+		CHECK(frame == expected);
+	}
+}
+
+// Throughput of the receive path for typical market_data frames
+BENCHMARK(WebSocketFrame, Throughput)
+{
+	TestRandom random(1);
+	std::string stream;
+	std::string tick = "{\"type\":\"market_data\",\"symbol\":\"RELIANCE\",\"exchange\":\"NSE\",\"mode\":2,"
+		"\"data\":{\"ltp\":2451.35,\"volume\":1234567,\"open\":2440.0,\"high\":2460.5,\"low\":2431.1}}";
+	const int nFramesPerStream = 20000;
+	for (int i = 0; i < nFramesPerStream; i++)
+		AppendFrame(&stream, 0x1, true, tick, false);
+
+	for (int nChunk = 1460; nChunk <= 65536; nChunk *= 4)
+	{
+		const int nRounds = 20;
+		WebSocketRecvBuffer buffer;
+		uint64_t nStart = TestNowNs();
+		long long nFrames = 0;
+		for (int r = 0; r < nRounds; r++)
+		{
+			size_t nFed = 0;
+			while (nFed < stream.size())
+			{
+				int nFree = 0;
+				char* pWrite = WsRecvBufferPrepare(&buffer, &nFree);
+				int n = (int)min((size_t)min(nChunk, nFree), stream.size() - nFed);
+				memcpy(pWrite, stream.data() + nFed, n);
+				WsRecvBufferCommit(&buffer, n);
+				nFed += n;
+
+				WebSocketFrame frame;
+				while (WsRecvBufferExtractFrame(&buffer, &frame) == WS_FRAME_COMPLETE)
+					nFrames++;
+			}
+		}
+		uint64_t nElapsed = TestNowNs() - nStart;
+		WsRecvBufferFree(&buffer);
+
+		char szLabel[64];
+		snprintf(szLabel, sizeof(szLabel), "frames, %d-byte reads", nChunk);
+		BENCH_REPORT(szLabel, nFrames, nElapsed);
+		printf("  %-40s %12.1f MB/s\n", "", (double)stream.size() * nRounds * 1000.0 / (double)nElapsed);
+	}
+}
+
+// Masking cost per payload size against the plain byte loop: outgoing subscribe
+// and ping frames are small, a masked frame from a server can be large
+BENCHMARK(WebSocketFrame, Mask)
+{
+	static const int s_anSizes[] = { 16, 64, 256, 1460, 65536 };
+	const long long nBytesPerSize = 256LL * 1024 * 1024;
+	std::vector<unsigned char> buffer(65536 + 64);
+	const unsigned char key[4] = { 0x37, 0xFA, 0x21, 0x3D };
+
+	for (size_t s = 0; s < sizeof(s_anSizes) / sizeof(s_anSizes[0]); s++)
+	{
+		int nSize = s_anSizes[s];
+		long long nRounds = nBytesPerSize / nSize;
+		unsigned char* pData = buffer.data() + 3;  // Unaligned, as a payload after a frame header is
+
+		uint64_t nStart = TestNowNs();
+		for (long long r = 0; r < nRounds; r++)
+			WebSocketMaskPayload(pData, nSize, key);
+		uint64_t nKernel = TestNowNs() - nStart;
+
+		nStart = TestNowNs();
+		for (long long r = 0; r < nRounds; r++)
+			ReferenceMask((unsigned char* volatile)pData, nSize, key);
+		uint64_t nReference = TestNowNs() - nStart;
+
+		char szLabel[64];
+		snprintf(szLabel, sizeof(szLabel), "WebSocketMaskPayload, %d bytes", nSize);
+		BENCH_REPORT(szLabel, nRounds, nKernel);
+		printf("  %-40s %12.1f MB/s\n", "", (double)nBytesPerSize * 1000.0 / (double)nKernel);
+		snprintf(szLabel, sizeof(szLabel), "byte loop, %d bytes", nSize);
+		BENCH_REPORT(szLabel, nRounds, nReference);
+		printf("  %-40s %12.1f MB/s\n", "", (double)nBytesPerSize * 1000.0 / (double)nReference);
+	}
+}
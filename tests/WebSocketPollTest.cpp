@@ -0,0 +1,369 @@
+// WebSocketPollTest.cpp - I/O thread wake-ups (stop, readable, timeout, reconnect) and drain-loop reads
+#include "TestHarness.h"
+#include "WebSocketPoll.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+static void MakeSocketPair(SOCKET* pLocal, SOCKET* pPeer)
+{
+	int fds[2];
+	CHECK_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+	*pLocal = fds[0];
+	*pPeer = fds[1];
+}
+
+TEST_CASE(WebSocketPoll, TimeoutWithoutSocket)
+{
+	WebSocketPoller poller;
+	CHECK(WsPollerOpen(&poller));
+
+	uint64_t nStart = TestNowNs();
+	CHECK_EQ(WsPollerWait(&poller, 20), WS_IO_WAKE_TIMEOUT);
+	CHECK(TestNowNs() - nStart >= 15ull * 1000000);
+	CHECK(!WsPollerStopRequested(&poller));
+
+	WsPollerClose(&poller);
+}
+
+TEST_CASE(WebSocketPoll, StopWakesWaiterAndStaysSignaled)
+{
+	WebSocketPoller poller;
+	CHECK(WsPollerOpen(&poller));
+
+	int nResult = -1;
+	uint64_t nStart = TestNowNs();
+	std::thread waiter([&]() { nResult = WsPollerWait(&poller, 10000); });
+	usleep(20000);
+	WsPollerSignalStop(&poller);
+	waiter.join();
+
+	CHECK_EQ(nResult, WS_IO_WAKE_STOP);
+	CHECK(TestNowNs() - nStart < 5000ull * 1000000);
+
+	// Manual reset: the drain loop and every later wait still see the request
+	CHECK(WsPollerStopRequested(&poller));
+	CHECK_EQ(WsPollerWait(&poller, 0), WS_IO_WAKE_STOP);
+	WsPollerSignalStop(&poller);
+	CHECK(WsPollerStopRequested(&poller));
+
+	WsPollerClose(&poller);
+}
+
+TEST_CASE(WebSocketPoll, ReadableIsLevelTriggered)
+{
+	WebSocketPoller poller;
+	CHECK(WsPollerOpen(&poller));
+	SOCKET local, peer;
+	MakeSocketPair(&local, &peer);
+	CHECK(WsPollerSelect(&poller, local));
+
+	CHECK_EQ(WsPollerWait(&poller, 0), WS_IO_WAKE_TIMEOUT);
+
+	CHECK_EQ(write(peer, "abcd", 4), 4);
+	CHECK_EQ(WsPollerWait(&poller, 1000), WS_IO_WAKE_READABLE);
+
+	// A drain that stops early (budget exhausted) must be woken again for the rest
+	char buffer[4];
+	CHECK_EQ(read(local, buffer, 2), 2);
+	CHECK_EQ(WsPollerWait(&poller, 1000), WS_IO_WAKE_READABLE);
+	CHECK_EQ(read(local, buffer, 2), 2);
+	CHECK_EQ(WsPollerWait(&poller, 10), WS_IO_WAKE_TIMEOUT);
+
+	// A stop request wins over pending data
+	CHECK_EQ(write(peer, "x", 1), 1);
+	WsPollerSignalStop(&poller);
+	CHECK_EQ(WsPollerWait(&poller, 1000), WS_IO_WAKE_STOP);
+
+	close(local);
+	close(peer);
+	WsPollerClose(&poller);
+}
+
+TEST_CASE(WebSocketPoll, PeerCloseIsReadable)
+{
+	WebSocketPoller poller;
+	CHECK(WsPollerOpen(&poller));
+	SOCKET local, peer;
+	MakeSocketPair(&local, &peer);
+	CHECK(WsPollerSelect(&poller, local));
+
+	// recv() then returns 0 and ProcessWebSocketData() reconnects
+	close(peer);
+	CHECK_EQ(WsPollerWait(&poller, 1000), WS_IO_WAKE_READABLE);
+	char c;
+	CHECK_EQ(read(local, &c, 1), 0);
+
+	close(local);
+	WsPollerClose(&poller);
+}
+
+TEST_CASE(WebSocketPoll, ReselectAfterReconnect)
+{
+	WebSocketPoller poller;
+	CHECK(WsPollerOpen(&poller));
+	SOCKET local, peer;
+	MakeSocketPair(&local, &peer);
+	CHECK(WsPollerSelect(&poller, local));
+
+	// Disconnect: the socket is closed first, then the I/O thread deselects it
+	close(local);
+	close(peer);
+	CHECK(WsPollerSelect(&poller, INVALID_SOCKET));
+	CHECK_EQ(WsPollerWait(&poller, 10), WS_IO_WAKE_TIMEOUT);
+
+	// The new socket usually reuses the old descriptor number
+	MakeSocketPair(&local, &peer);
+	CHECK(WsPollerSelect(&poller, local));
+	CHECK_EQ(write(peer, "y", 1), 1);
+	CHECK_EQ(WsPollerWait(&poller, 1000), WS_IO_WAKE_READABLE);
+
+	// Selecting the same socket twice is harmless
+	CHECK(WsPollerSelect(&poller, local));
+	CHECK_EQ(WsPollerWait(&poller, 1000), WS_IO_WAKE_READABLE);
+
+	// A socket that is deselected while still open no longer wakes us
+	CHECK(WsPollerSelect(&poller, INVALID_SOCKET));
+	CHECK_EQ(WsPollerWait(&poller, 10), WS_IO_WAKE_TIMEOUT);
+
+	close(local);
+	close(peer);
+	WsPollerClose(&poller);
+}
+
+// An unmasked text frame, as the server sends them
+static std::string MakeServerFrame(const std::string& payload)
+{
+	std::string frame;
+	frame.push_back((char)0x81);
+	if (payload.size() <= 125)
+	{
+		frame.push_back((char)payload.size());
+	}
+	else
+	{
+		frame.push_back((char)126);
+		frame.push_back((char)(payload.size() >> 8));
+		frame.push_back((char)(payload.size() & 0xFF));
+	}
+	return frame + payload;
+}
+
+static bool WriteAll(SOCKET s, const std::string& bytes)
+{
+	return write(s, bytes.data(), bytes.size()) == (ssize_t)bytes.size();
+}
+
+TEST_CASE(WebSocketPoll, ReadFrameBufferedFirst)
+{
+	WebSocketPoller poller;
+	CHECK(WsPollerOpen(&poller));
+	SOCKET local, peer;
+	MakeSocketPair(&local, &peer);
+	CHECK(WsPollerSelect(&poller, local));
+	WebSocketRecvBuffer buffer;
+	WebSocketFrame frame;
+	int nReceived = -1;
+
+	// Nothing sent: no recv(), nothing to deliver
+	CHECK_EQ(WsPollerReadFrame(&poller, &buffer, &frame, &nReceived), WS_FRAME_INCOMPLETE);
+	CHECK_EQ(nReceived, 0);
+
+	// Two frames in one segment: one recv(), then the second comes from the buffer
+	std::string first = MakeServerFrame("{\"type\":\"market_data\",\"n\":1}");
+	std::string second = MakeServerFrame("{\"type\":\"market_data\",\"n\":2}");
+	CHECK(WriteAll(peer, first + second));
+	CHECK_EQ(WsPollerReadFrame(&poller, &buffer, &frame, &nReceived), WS_FRAME_COMPLETE);
+	CHECK_EQ(nReceived, (int)(first.size() + second.size()));
+	CHECK(std::string(frame.pPayload, frame.nPayloadLen) == "{\"type\":\"market_data\",\"n\":1}");
+	CHECK_EQ(WsPollerReadFrame(&poller, &buffer, &frame, &nReceived), WS_FRAME_COMPLETE);
+	CHECK_EQ(nReceived, 0);
+	CHECK(std::string(frame.pPayload, frame.nPayloadLen) == "{\"type\":\"market_data\",\"n\":2}");
+	CHECK_EQ(WsPollerReadFrame(&poller, &buffer, &frame, &nReceived), WS_FRAME_INCOMPLETE);
+
+	// A frame split over two segments: the first half is kept, the rest completes it
+	std::string split = MakeServerFrame(std::string(300, 'x'));
+	CHECK(WriteAll(peer, split.substr(0, 100)));
+	CHECK_EQ(WsPollerReadFrame(&poller, &buffer, &frame, &nReceived), WS_FRAME_INCOMPLETE);
+	CHECK_EQ(nReceived, 100);
+	CHECK(WriteAll(peer, split.substr(100)));
+	CHECK_EQ(WsPollerReadFrame(&poller, &buffer, &frame, &nReceived), WS_FRAME_COMPLETE);
+	CHECK_EQ(frame.nPayloadLen, 300);
+
+	// Looking for data does not use up the I/O thread's next wake-up
+	CHECK(WriteAll(peer, first));
+	CHECK(WsPollerReadable(&poller));
+	CHECK_EQ(WsPollerWait(&poller, 1000), WS_IO_WAKE_READABLE);
+	CHECK_EQ(WsPollerReadFrame(&poller, &buffer, &frame, &nReceived), WS_FRAME_COMPLETE);
+	CHECK(!WsPollerReadable(&poller));
+
+	close(local);
+	close(peer);
+	WsRecvBufferFree(&buffer);
+	WsPollerClose(&poller);
+}
+
+TEST_CASE(WebSocketPoll, ReadFrameClosedAndDamaged)
+{
+	WebSocketPoller poller;
+	CHECK(WsPollerOpen(&poller));
+	SOCKET local, peer;
+	MakeSocketPair(&local, &peer);
+	CHECK(WsPollerSelect(&poller, local));
+	WebSocketRecvBuffer buffer;
+	WebSocketFrame frame;
+	int nReceived = 0;
+
+	// A frame that arrived before the close is still delivered, then the close
+	CHECK(WriteAll(peer, MakeServerFrame("last")));
+	close(peer);
+	CHECK_EQ(WsPollerReadFrame(&poller, &buffer, &frame, &nReceived), WS_FRAME_COMPLETE);
+	CHECK_EQ(WsPollerReadFrame(&poller, &buffer, &frame, &nReceived), WS_FRAME_CLOSED);
+	close(local);
+	CHECK(WsPollerSelect(&poller, INVALID_SOCKET));
+	WsRecvBufferReset(&buffer);
+
+	// A length no frame may have: the stream is out of sync
+	MakeSocketPair(&local, &peer);
+	CHECK(WsPollerSelect(&poller, local));
+	std::string bad = "\x81\x7F";
+	bad.append(8, (char)0x7F);
+	CHECK(WriteAll(peer, bad));
+	CHECK_EQ(WsPollerReadFrame(&poller, &buffer, &frame, &nReceived), WS_FRAME_ERROR);
+
+	// With no socket selected nothing is read, even if data is waiting
+	CHECK(WsPollerSelect(&poller, INVALID_SOCKET));
+	WsRecvBufferReset(&buffer);
+	CHECK(WriteAll(peer, MakeServerFrame("unread")));
+	CHECK_EQ(WsPollerReadFrame(&poller, &buffer, &frame, &nReceived), WS_FRAME_INCOMPLETE);
+	CHECK_EQ(nReceived, 0);
+
+	close(local);
+	close(peer);
+	WsRecvBufferFree(&buffer);
+	WsPollerClose(&poller);
+}
+
+// The I/O thread's loop: wait for readiness, drain frames until there is nothing
+// more, wait again - against a peer writing frames in arbitrary pieces
+TEST_CASE(WebSocketPoll, DrainLoopDeliversEveryFrame)
+{
+	WebSocketPoller poller;
+	CHECK(WsPollerOpen(&poller));
+	SOCKET local, peer;
+	MakeSocketPair(&local, &peer);
+	CHECK(WsPollerSelect(&poller, local));
+
+	const int nFrames = 20000;
+	std::string stream;
+	for (int i = 0; i < nFrames; i++)
+		stream += MakeServerFrame("{\"n\":" + std::to_string(i) + ",\"pad\":\"" + std::string(i % 300, 'p') + "\"}");
+
+	std::thread writer([&]() {
+		TestRandom random(11);
+		size_t nPos = 0;
+		while (nPos < stream.size())
+		{
+			size_t nChunk = std::min((size_t)random.Range(1, 9000), stream.size() - nPos);
+			if (write(peer, stream.data() + nPos, nChunk) != (ssize_t)nChunk)
+				break;
+			nPos += nChunk;
+		}
+		close(peer);
+	});
+
+	WebSocketRecvBuffer buffer;
+	int nDelivered = 0;
+	bool bInOrder = true;
+	bool bClosed = false;
+	while (!bClosed)
+	{
+		if (WsPollerWait(&poller, 5000) != WS_IO_WAKE_READABLE)
+			break;
+
+		for (;;)
+		{
+			WebSocketFrame frame;
+			int nReceived = 0;
+			int nResult = WsPollerReadFrame(&poller, &buffer, &frame, &nReceived);
+			if (nResult == WS_FRAME_COMPLETE)
+			{
+				std::string expected = "{\"n\":" + std::to_string(nDelivered) + ",";
+				if (std::string(frame.pPayload, std::min(frame.nPayloadLen, (int)expected.size())) != expected)
+					bInOrder = false;
+				nDelivered++;
+				continue;
+			}
+			bClosed = (nResult == WS_FRAME_CLOSED);
+			CHECK(nResult == WS_FRAME_INCOMPLETE || nResult == WS_FRAME_CLOSED);
+			break;
+		}
+	}
+	writer.join();
+
+	CHECK(bClosed);
+	CHECK(bInOrder);
+	CHECK_EQ(nDelivered, nFrames);
+
+	close(local);
+	WsRecvBufferFree(&buffer);
+	WsPollerClose(&poller);
+}
+
+// Cost of one wake-up: the peer writes a tick, the I/O thread wakes, reads it, waits again
+BENCHMARK(WebSocketPoll, WakeLatency)
+{
+	WebSocketPoller poller;
+	WsPollerOpen(&poller);
+	SOCKET local, peer;
+	MakeSocketPair(&local, &peer);
+	WsPollerSelect(&poller, local);
+
+	const int nRounds = 200000;
+	char buffer[64];
+	uint64_t nStart = TestNowNs();
+	for (int i = 0; i < nRounds; i++)
+	{
+		if (write(peer, "t", 1) != 1)
+			break;
+		WsPollerWait(&poller, 1000);
+		if (read(local, buffer, sizeof(buffer)) <= 0)
+			break;
+	}
+	BENCH_REPORT("wake+read, same thread", nRounds, TestNowNs() - nStart);
+
+	// Cross-thread: what the server-to-I/O-thread path pays per message
+	std::atomic<bool> bDone(false);
+	long long nWakes = 0;
+	std::thread reader([&]() {
+		char readBuffer[4096];
+		while (!bDone)
+		{
+			if (WsPollerWait(&poller, 100) == WS_IO_WAKE_READABLE)
+			{
+				if (read(local, readBuffer, sizeof(readBuffer)) > 0)
+					nWakes++;
+			}
+		}
+	});
+	nStart = TestNowNs();
+	for (int i = 0; i < nRounds; i++)
+	{
+		if (write(peer, "t", 1) != 1)
+			break;
+	}
+	uint64_t nElapsed = TestNowNs() - nStart;
+	usleep(50000);
+	bDone = true;
+	reader.join();
+	BENCH_REPORT("messages, writer thread", nRounds, nElapsed);
+	printf("  %-40s %12lld wake-ups (messages coalesce per read)\n", "", nWakes);
+
+	close(local);
+	close(peer);
+	WsPollerClose(&poller);
+}
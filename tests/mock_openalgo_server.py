@@ -0,0 +1,152 @@
+#!/usr/bin/env python3
+"""Minimal OpenAlgo REST mock for trying the plugin without a broker.
+
+Serves the endpoints the plugin calls over HTTP:
+
+  POST /api/v1/ping         {"status":"success","data":{"message":"pong"}}
+  POST /api/v1/quotes       one quote for {"symbol","exchange"}
+  POST /api/v1/multiquotes  quotes for {"symbols":[{"symbol","exchange"}, ...]}
+  POST /api/v1/history      generated candles for {"symbol","exchange","interval","start_date","end_date"}
+
+History is deterministic per symbol: interval "1m" returns 09:15-15:29 IST for every
+weekday in the range, "D" one candle per weekday. Timestamps are Unix seconds, as
+the real server sends them.
+
+Point the plugin's Server at 127.0.0.1 and Port at --port (any API key is accepted).
+--delay-ms slows every history response and --fail-every N answers every Nth
+history request with HTTP 500, to exercise chunk retries and backfill stop/resume:
+
+  python3 tests/mock_openalgo_server.py --port 5000 --delay-ms 2000 --fail-every 7
+"""
+
+import argparse
+import datetime
+import json
+import threading
+import time
+import zlib
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+IST = datetime.timezone(datetime.timedelta(minutes=330))
+
+state = {"history_requests": 0}
+state_lock = threading.Lock()
+
+
+def base_price(symbol):
+    return 100.0 + (zlib.crc32(symbol.encode()) % 400000) / 100.0
+
+
+def candle(symbol, ts, step):
+    # Smooth, repeatable prices so a merged chart shows seams as visible jumps
+    price = base_price(symbol) * (1.0 + 0.02 * (((ts // step) % 200) - 100) / 100.0)
+    return {
+        "timestamp": ts,
+        "open": round(price, 2),
+        "high": round(price * 1.002, 2),
+        "low": round(price * 0.998, 2),
+        "close": round(price * 1.001, 2),
+        "volume": 1000 + (ts // step) % 5000,
+        "oi": 0,
+    }
+
+
+def history(symbol, interval, start_date, end_date):
+    day = datetime.date.fromisoformat(start_date)
+    last = datetime.date.fromisoformat(end_date)
+    candles = []
+    while day <= last:
+        if day.weekday() < 5:
+            if interval == "D":
+                ts = int(datetime.datetime(day.year, day.month, day.day, tzinfo=IST).timestamp())
+                candles.append(candle(symbol, ts, 86400))
+            else:
+                start = int(datetime.datetime(day.year, day.month, day.day, 9, 15, tzinfo=IST).timestamp())
+                for minute in range(375):
+                    candles.append(candle(symbol, start + minute * 60, 60))
+        day += datetime.timedelta(days=1)
+    return candles
+
+
+def quote(symbol):
+    price = base_price(symbol)
+    return {
+        "ltp": round(price, 2),
+        "open": round(price * 0.99, 2),
+        "high": round(price * 1.01, 2),
+        "low": round(price * 0.98, 2),
+        "prev_close": round(price * 0.995, 2),
+        "volume": 123456,
+        "oi": 0,
+        "bid": round(price - 0.05, 2),
+        "ask": round(price + 0.05, 2),
+    }
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"  # Keep-alive, like the plugin's pooled connections
+    options = None
+
+    def reply(self, code, body):
+        data = json.dumps(body, separators=(",", ":")).encode()
+        self.send_response(code)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(data)))
+        self.end_headers()
+        self.wfile.write(data)
+
+    def do_POST(self):
+        length = int(self.headers.get("Content-Length", "0"))
+        try:
+            request = json.loads(self.rfile.read(length) or b"{}")
+        except ValueError:
+            self.reply(400, {"status": "error", "message": "invalid JSON"})
+            return
+
+        if self.path == "/api/v1/ping":
+            self.reply(200, {"status": "success", "data": {"message": "pong", "broker": "mock"}})
+        elif self.path == "/api/v1/quotes":
+            self.reply(200, {"status": "success", "data": quote(request.get("symbol", ""))})
+        elif self.path == "/api/v1/multiquotes":
+            results = [{"symbol": s.get("symbol", ""), "exchange": s.get("exchange", ""),
+                        "data": quote(s.get("symbol", ""))} for s in request.get("symbols", [])]
+            self.reply(200, {"status": "success", "results": results})
+        elif self.path == "/api/v1/history":
+            with state_lock:
+                state["history_requests"] += 1
+                count = state["history_requests"]
+            if self.options.delay_ms > 0:
+                time.sleep(self.options.delay_ms / 1000.0)
+            if self.options.fail_every > 0 and count % self.options.fail_every == 0:
+                self.reply(500, {"status": "error", "message": "mock failure"})
+                return
+            try:
+                candles = history(request.get("symbol", ""), request.get("interval", "D"),
+                                  request.get("start_date", ""), request.get("end_date", ""))
+            except ValueError:
+                self.reply(400, {"status": "error", "message": "invalid date"})
+                return
+            self.reply(200, {"status": "success", "data": candles})
+        else:
+            self.reply(404, {"status": "error", "message": "not found"})
+
+    def log_message(self, fmt, *args):
+        if not self.options.quiet:
+            super().log_message(fmt, *args)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--port", type=int, default=5000)
+    parser.add_argument("--delay-ms", type=int, default=0, help="delay before every history response")
+    parser.add_argument("--fail-every", type=int, default=0, help="answer every Nth history request with HTTP 500")
+    parser.add_argument("--quiet", action="store_true")
+    Handler.options = parser.parse_args()
+
+    server = ThreadingHTTPServer(("127.0.0.1", Handler.options.port), Handler)
+    print("OpenAlgo mock listening on http://127.0.0.1:%d" % Handler.options.port)
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()